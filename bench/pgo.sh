@@ -0,0 +1,93 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+usage() {
+  cat >&2 <<USAGE
+Usage:
+  $0 [-r REPEAT] [--quick]
+
+Builds minishell and minihttpd three ways and runs bench/run.sh against each:
+
+  debug    BUILD=debug (-O0)
+  release  BUILD=release (-O2, LTO, -march=\$MARCH)
+  pgo      BUILD=release PGO=gen, trained with "bench/run.sh --train",
+           then rebuilt with PGO=use
+
+and writes artifacts/bench/pgo-<timestamp>/report.txt with the speedup of
+release over debug, pgo over release and pgo over debug.
+
+  -r REPEAT  repetitions per scenario (default 5)
+  --quick    shorter scenarios (smoke test)
+
+Environment:
+  MARCH      -march for the release builds (default native)
+USAGE
+}
+
+root_dir="$(cd "$(dirname "$0")/.." && pwd -P)"
+run_args=()
+
+while [[ $# -gt 0 ]]; do
+  case "$1" in
+    -r) run_args+=(-r "$2"); shift ;;
+    --quick) run_args+=(--quick) ;;
+    -h|--help) usage; exit 0 ;;
+    *) usage; exit 2 ;;
+  esac
+  shift
+done
+
+march="${MARCH:-native}"
+ts="$(date +%Y%m%d-%H%M%S)"
+outdir="${root_dir}/artifacts/bench/pgo-${ts}"
+mkdir -p "$outdir"
+
+build() {
+  # build ARGS...  （minishell / minihttpd を同じ引数でビルドする。出力は build.log に）
+  local d
+  for d in minishell minihttpd; do
+    if ! make -C "${root_dir}/${d}" "$@" >>"$outdir/build.log" 2>&1; then
+      echo "pgo: make -C $d $* failed (see $outdir/build.log)" >&2
+      exit 1
+    fi
+  done
+}
+
+bench() {
+  # bench STAGE SUBDIR  （その段のバイナリで測り、結果ディレクトリを $outdir/STAGE に移す）
+  local stage="$1" sub="$2" res
+  echo "pgo: bench $stage" >&2
+  res="$(MINISHELL="${root_dir}/minishell/${sub}minishell" MINIHTTPD="${root_dir}/minihttpd/${sub}minihttpd" \
+    "${root_dir}/bench/run.sh" --no-compare ${run_args[@]+"${run_args[@]}"} | tail -n 1)"
+  mv "$res" "$outdir/$stage"
+}
+
+make -C "${root_dir}/bench" >>"$outdir/build.log" 2>&1
+
+build
+bench debug ""
+
+build BUILD=release MARCH="$march"
+bench release build/release/
+
+# 計装ビルドを学習用の負荷で一度回し、.gcda を集めてから使う側でビルドし直す
+# （前回の .gcda が混ざらないよう re で消してから）
+build BUILD=release PGO=gen MARCH="$march" re
+echo "pgo: train" >&2
+MINISHELL="${root_dir}/minishell/build/release-pgo/minishell" \
+  MINIHTTPD="${root_dir}/minihttpd/build/release-pgo/minihttpd" \
+  "${root_dir}/bench/run.sh" --train >/dev/null
+build BUILD=release PGO=use MARCH="$march" clean all
+bench pgo build/release-pgo/
+
+# benchstat は -b と比べた退行で 1 を返すが、ここでは表が欲しいだけなので見ない
+{
+  for pair in "release debug" "pgo release" "pgo debug"; do
+    read -r cur base <<<"$pair"
+    echo "== $cur vs $base"
+    "${root_dir}/bench/benchstat" -b "$outdir/$base/results.json" "$outdir/$cur/raw.txt" || true
+    echo
+  done
+} >"$outdir/report.txt"
+cat "$outdir/report.txt" >&2
+printf '%s\n' "$outdir"
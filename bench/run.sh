@@ -0,0 +1,354 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+usage() {
+  cat >&2 <<USAGE
+Usage:
+  $0 [-r REPEAT] [-t PCT] [-b BASELINE] [--quick] [--only sh|http|route]
+     [--save-baseline | --no-compare | --train]
+
+Runs the fixed scenario set against the release builds of minishell and minihttpd
+(build them with "make bench" from the top directory), REPEAT times each, and
+writes artifacts/bench/<timestamp>/{raw.txt,results.json}.
+
+  -r REPEAT        repetitions per scenario (default 5)
+  -t PCT           regression threshold in percent (default 10)
+  -b BASELINE      baseline file (default bench/baseline.json)
+  --quick          fewer iterations / shorter load runs (smoke test)
+  --only sh|http|route
+                   run only the minishell, the minihttpd or the router scenarios
+  --save-baseline  write the results to BASELINE instead of comparing
+  --no-compare     only write the results
+  --train          run every scenario once as a PGO training workload
+                   (no results; minihttpd is stopped with SIGTERM so it exits normally)
+
+Environment:
+  MINISHELL / MINIHTTPD
+                    binaries to run (default: minishell/build/release/minishell,
+                    minihttpd/build/release/minihttpd)
+  BENCH_CPU_SERVER  CPU for minishell / minihttpd (default 1, or 0 on 1 CPU)
+  BENCH_CPU_CLIENT  CPU for the load generator (default 2, or 0 on <= 2 CPUs)
+USAGE
+}
+
+root_dir="$(cd "$(dirname "$0")/.." && pwd -P)"
+repeat=5
+threshold=10
+baseline="${root_dir}/bench/baseline.json"
+quick=0
+only=""
+save_baseline=0
+compare=1
+train=0
+
+while [[ $# -gt 0 ]]; do
+  case "$1" in
+    -r) repeat="$2"; shift ;;
+    -t) threshold="$2"; shift ;;
+    -b) baseline="$2"; shift ;;
+    --quick) quick=1 ;;
+    --only) only="$2"; shift ;;
+    --save-baseline) save_baseline=1 ;;
+    --no-compare) compare=0 ;;
+    --train) train=1; quick=1; repeat=1 ;;
+    -h|--help) usage; exit 0 ;;
+    *) usage; exit 2 ;;
+  esac
+  shift
+done
+
+minishell="${MINISHELL:-${root_dir}/minishell/build/release/minishell}"
+minihttpd="${MINIHTTPD:-${root_dir}/minihttpd/build/release/minihttpd}"
+loadgen="${root_dir}/bench/loadgen"
+benchstat="${root_dir}/bench/benchstat"
+routebench="${root_dir}/bench/routebench"
+for bin in "$minishell" "$minihttpd" "$loadgen" "$benchstat" "$routebench"; do
+  if [[ ! -x "$bin" ]]; then
+    echo "not built: $bin (run: make bench)" >&2
+    exit 1
+  fi
+done
+
+ncpu="$(nproc)"
+cpu_server="${BENCH_CPU_SERVER:-$(( ncpu > 1 ? 1 : 0 ))}"
+cpu_client="${BENCH_CPU_CLIENT:-$(( ncpu > 2 ? 2 : 0 ))}"
+pin_server=()
+pin_client=()
+if command -v taskset >/dev/null 2>&1; then
+  pin_server=(taskset -c "$cpu_server")
+  pin_client=(taskset -c "$cpu_client")
+else
+  echo "taskset not found; running without CPU pinning" >&2
+fi
+
+if [[ "$quick" == "1" ]]; then
+  sh_iters=50; script_lines=200; http_dur=0.5; http_warm=0.1; route_lookups=500000
+else
+  sh_iters=300; script_lines=2000; http_dur=2; http_warm=0.5; route_lookups=5000000
+fi
+
+ts="$(date +%Y%m%d-%H%M%S)"
+work="$(mktemp -d "${TMPDIR:-/tmp}/bench.XXXXXX")"
+if [[ "$train" == "1" ]]; then
+  outdir="$work"
+else
+  outdir="${root_dir}/artifacts/bench/${ts}"
+  mkdir -p "$outdir"
+fi
+raw="$outdir/raw.txt"
+: >"$raw"
+server_pid=""
+
+cleanup() {
+  if [[ -n "$server_pid" ]]; then
+    kill "$server_pid" 2>/dev/null || true
+    wait "$server_pid" 2>/dev/null || true
+  fi
+  rm -rf "$work"
+}
+trap cleanup EXIT
+
+json_num() {
+  # json_num KEY < line  （自分たちの出す JSON 1 行から数値を 1 つ抜く）
+  sed -n "s/.*\"$1\":\\([0-9.eE+-]*\\).*/\\1/p"
+}
+
+# --- minishell -----------------------------------------------------------
+# :bench は 1 回パースした行を同じ実行経路で繰り返すので、起動コストを除いた spawn / pipe / redirect を見る
+head -c 65536 /dev/zero | tr '\0' 'x' >"$work/in"
+sh_scenarios=(
+  "sh/single|true"
+  "sh/pipe2|echo hi | cat"
+  "sh/pipe4|echo hi | cat | cat | cat"
+  "sh/pipe8|echo hi | cat | cat | cat | cat | cat | cat | cat"
+  "sh/redirect|wc -c < ${work}/in > ${work}/out"
+)
+
+# スクリプトの処理量: REPL に行を流し込み、起動から終了まで（パースも含む）の lines/sec
+for ((i = 0; i < script_lines; i++)); do
+  case $(( i % 4 )) in
+    0) echo "true" ;;
+    1) echo "echo line $i > ${work}/script.out" ;;
+    2) echo "echo line $i | cat > /dev/null" ;;
+    3) echo "wc -c < ${work}/in > /dev/null" ;;
+  esac
+done >"$work/script.msh"
+
+run_sh() {
+  local spec name line out
+  for spec in "${sh_scenarios[@]}"; do
+    name="${spec%%|*}"
+    line="${spec#*|}"
+    out="$(cd "$work" && printf ':bench -j -w 10 %s %s\n' "$sh_iters" "$line" \
+      | ${pin_server[@]+"${pin_server[@]}"} "$minishell")"
+    if [[ "$(json_num failed <<<"$out")" != "0" ]]; then
+      echo "bench: $name failed: $out" >&2
+      exit 1
+    fi
+    echo "$name cmds_per_sec higher $(json_num cmds_per_sec <<<"$out")" >>"$raw"
+    echo "$name p99_us lower $(json_num p99_us <<<"$out")" >>"$raw"
+  done
+
+  local t0 t1
+  t0="$EPOCHREALTIME"
+  (cd "$work" && ${pin_server[@]+"${pin_server[@]}"} "$minishell" <"$work/script.msh" >/dev/null)
+  t1="$EPOCHREALTIME"
+  awk -v n="$script_lines" -v a="$t0" -v b="$t1" \
+    'BEGIN { printf "sh/script lines_per_sec higher %.1f\n", n / (b - a) }' >>"$raw"
+}
+
+# --- minihttpd -----------------------------------------------------------
+# start_server [ARGS...]  （ARGS は minihttpd にそのまま渡す）
+start_server() {
+  if "$loadgen" -c 1 -d 0.05 -w 0 >/dev/null 2>&1; then
+    echo "port 8080 is already in use; stop the other server first" >&2
+    exit 1
+  fi
+  ${pin_server[@]+"${pin_server[@]}"} "$minihttpd" "$@" >"$work/httpd.log" 2>&1 &
+  server_pid=$!
+  for _ in $(seq 50); do
+    if "$loadgen" -c 1 -d 0.05 -w 0 >/dev/null 2>&1; then
+      return
+    fi
+    sleep 0.1
+  done
+  echo "minihttpd did not start (see $work/httpd.log)" >&2
+  exit 1
+}
+
+stop_server() {
+  kill "$server_pid" 2>/dev/null || true
+  wait "$server_pid" 2>/dev/null || true
+  server_pid=""
+}
+
+# サーバの CPU 時間（user + sys、clock tick）
+server_ticks() {
+  awk '{ print $14 + $15 }' "/proc/$server_pid/stat"
+}
+
+# check_http NAME OUT  （1 つも返ってこなかったら止める）
+check_http() {
+  if [[ -z "$(json_num requests <<<"$2")" || "$(json_num requests <<<"$2")" == "0" ]]; then
+    echo "bench: $1 got no responses: $2" >&2
+    exit 1
+  fi
+}
+
+run_http() {
+  local conns ka name out
+  for conns in 1 8 64; do
+    for ka in 0 1; do
+      name="http/c${conns}"
+      [[ "$ka" == "1" ]] && name="${name}-keepalive"
+      out="$(${pin_client[@]+"${pin_client[@]}"} "$loadgen" -c "$conns" -d "$http_dur" -w "$http_warm" \
+        $([[ "$ka" == "1" ]] && echo -k))" || true
+      check_http "$name" "$out"
+      echo "$name rps higher $(json_num rps <<<"$out")" >>"$raw"
+      echo "$name p99_us lower $(json_num p99_us <<<"$out")" >>"$raw"
+    done
+  done
+  run_http_mixed
+  run_http_h2
+  run_http_blob
+  run_http_ratelimit
+}
+
+# 遅いハンドラ（/slow、ワーカープールで動く）を裏で叩きながら、軽い "/" の p99 が崩れないかを見る
+run_http_mixed() {
+  local name="http/c8-keepalive+slow" out bg
+  ${pin_client[@]+"${pin_client[@]}"} "$loadgen" -c 4 -k -w 0 \
+    -d "$(awk -v d="$http_dur" -v w="$http_warm" 'BEGIN { print d + w + 0.5 }')" "/slow?ms=20" >/dev/null 2>&1 &
+  bg=$!
+  sleep 0.2
+  out="$(${pin_client[@]+"${pin_client[@]}"} "$loadgen" -c 8 -k -d "$http_dur" -w "$http_warm")" || true
+  wait "$bg" || true
+  check_http "$name" "$out"
+  echo "$name rps higher $(json_num rps <<<"$out")" >>"$raw"
+  echo "$name p99_us lower $(json_num p99_us <<<"$out")" >>"$raw"
+}
+
+# h2c で 1 本の接続に 64 ストリーム / 8 本 × 8 ストリーム。同じ 64 並列の http/c64-keepalive と比べる
+run_http_h2() {
+  local spec name conns streams out
+  for spec in "c1-m64|1|64" "c8-m8|8|8"; do
+    IFS='|' read -r name conns streams <<<"$spec"
+    name="http/h2-${name}"
+    out="$(${pin_client[@]+"${pin_client[@]}"} "$loadgen" -2 -c "$conns" -m "$streams" \
+      -d "$http_dur" -w "$http_warm")" || true
+    check_http "$name" "$out"
+    echo "$name rps higher $(json_num rps <<<"$out")" >>"$raw"
+    echo "$name p99_us lower $(json_num p99_us <<<"$out")" >>"$raw"
+  done
+}
+
+# メモリ上の 1 MiB の本文（/blob）を、コピー（既定）と MSG_ZEROCOPY（--zerocopy）で送ったときの
+# サーバの CPU 時間 / GB。サーバを起動し直すので warm-up は置かず、測る間の CPU 時間を全部数える
+run_http_blob() {
+  local mode name out t0 t1
+  for mode in copy zerocopy; do
+    name="http/blob1m-${mode}"
+    stop_server
+    if [[ "$mode" == "zerocopy" ]]; then
+      start_server --zerocopy
+    else
+      start_server
+    fi
+    t0="$(server_ticks)"
+    out="$(${pin_client[@]+"${pin_client[@]}"} "$loadgen" -c 4 -k -d "$http_dur" -w 0 "/blob?size=1048576")" || true
+    t1="$(server_ticks)"
+    check_http "$name" "$out"
+    echo "$name rps higher $(json_num rps <<<"$out")" >>"$raw"
+    awk -v n="$name" -v t="$(( t1 - t0 ))" -v hz="$(getconf CLK_TCK)" -v b="$(json_num bytes <<<"$out")" \
+      'BEGIN { printf "%s cpu_ms_per_gb lower %.2f\n", n, t * 1000 / hz / (b / 1e9) }' >>"$raw"
+  done
+  stop_server
+  start_server
+}
+
+# 接続元ごとの流量制限（--rate-limit=200）。127.0.0.2 から /slow?ms=1 を 32 本で叩き続ける（ワーカープールを
+# 埋める）横で、127.0.0.3 が毎秒 100 回だけ同じものを頼む。行儀のよい方の p99 が、ひとりのときから崩れないかを見る
+run_http_ratelimit() {
+  local name="http/ratelimit-good" out bg
+  stop_server
+  start_server --rate-limit=200
+  ${pin_client[@]+"${pin_client[@]}"} "$loadgen" -b 127.0.0.2 -c 32 -k -w 0 \
+    -d "$(awk -v d="$http_dur" -v w="$http_warm" 'BEGIN { print d + w + 0.5 }')" "/slow?ms=1" >/dev/null 2>&1 &
+  bg=$!
+  sleep 0.2
+  out="$(${pin_client[@]+"${pin_client[@]}"} "$loadgen" -b 127.0.0.3 -c 4 -k -R 100 \
+    -d "$http_dur" -w "$http_warm" "/slow?ms=1")" || true
+  wait "$bg" || true
+  check_http "$name" "$out"
+  if [[ "$(json_num rejected <<<"$out")" != "0" ]]; then
+    echo "bench: $name was rate limited: $out" >&2
+    exit 1
+  fi
+  echo "$name p99_us lower $(json_num p99_us <<<"$out")" >>"$raw"
+  stop_server
+  start_server
+}
+
+# --- router --------------------------------------------------------------
+# minihttpd の振り分け（完全ハッシュ + radix trie）だけを、ルート数を変えて 1 回あたりの ns で見る
+run_route() {
+  local out line n
+  out="$(${pin_server[@]+"${pin_server[@]}"} "$routebench" -n "$route_lookups" 10 100 1000)" || {
+    echo "bench: routebench failed: $out" >&2
+    exit 1
+  }
+  while IFS= read -r line; do
+    n="$(json_num routes <<<"$line")"
+    echo "route/r${n} ns_per_lookup lower $(json_num ns_per_lookup <<<"$line")" >>"$raw"
+  done <<<"$out"
+}
+
+if [[ "$only" == "" || "$only" == "http" ]]; then
+  start_server
+fi
+
+# 繰り返しはシナリオごとにまとめず 1 周ずつ回す（温度やほかの負荷の変化が 1 つのシナリオに偏らない）
+for ((r = 1; r <= repeat; r++)); do
+  echo "bench: round $r/$repeat" >&2
+  if [[ "$only" == "" || "$only" == "sh" ]]; then
+    run_sh
+  fi
+  if [[ "$only" == "" || "$only" == "http" ]]; then
+    run_http
+  fi
+  # PGO の学習では minishell / minihttpd を動かさないものは回さない
+  if [[ ("$only" == "" || "$only" == "route") && "$train" == "0" ]]; then
+    run_route
+  fi
+done
+
+if [[ "$train" == "1" ]]; then
+  exit 0
+fi
+
+meta=(
+  -m "date=${ts}"
+  -m "host=$(uname -n)"
+  -m "kernel=$(uname -r)"
+  -m "cpus=${ncpu}"
+  -m "cpu_server=${cpu_server}"
+  -m "cpu_client=${cpu_client}"
+  -m "repeat=${repeat}"
+  -m "quick=${quick}"
+  -m "minishell=${minishell#"${root_dir}"/}"
+  -m "minihttpd=${minihttpd#"${root_dir}"/}"
+  -m "commit=$(git -C "$root_dir" rev-parse --short HEAD 2>/dev/null || echo unknown)"
+)
+
+rc=0
+if [[ "$save_baseline" == "1" ]]; then
+  "$benchstat" -o "$outdir/results.json" "${meta[@]}" "$raw" || rc=$?
+  cp "$outdir/results.json" "$baseline"
+  echo "bench: baseline saved to $baseline" >&2
+elif [[ "$compare" == "0" ]]; then
+  "$benchstat" -o "$outdir/results.json" "${meta[@]}" "$raw" || rc=$?
+else
+  "$benchstat" -o "$outdir/results.json" -b "$baseline" -t "$threshold" "${meta[@]}" "$raw" || rc=$?
+fi
+printf '%s\n' "$outdir"
+exit "$rc"
@@ -0,0 +1,306 @@
+#define _GNU_SOURCE
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * benchstat: 繰り返し測った値をまとめ、基準（baseline）と比べる
+ *
+ * 入力は 1 行 1 測定の "name metric higher|lower value"（同じ name/metric が繰り返しの回数だけ並ぶ）。
+ * name/metric ごとに n・平均・標準偏差・95% 信頼区間の半幅（t 分布）・最小・最大を出し、
+ * -o FILE に JSON（1 結果 1 行）で書く。
+ *
+ * -b FILE を渡すと、同じ形式の基準と name/metric で突き合わせ、差（%）とよい向きに何倍か（speedup）を出す。
+ * 悪い方向に -t PCT % より大きく動き、
+ * かつその差が両方の信頼区間の和より大きいものを退行とみなし、1 つでもあれば終了コード 1。
+ */
+
+#define NAME_MAX_LEN 64
+
+typedef struct s_res
+{
+	char	name[NAME_MAX_LEN];
+	char	metric[NAME_MAX_LEN];
+	int		higher;       // 1: 大きいほどよい（req/s など）、0: 小さいほどよい（latency）
+	double	*v;
+	size_t	n;
+	size_t	cap;
+	double	mean;
+	double	sd;
+	double	ci;
+	double	min;
+	double	max;
+}	t_res;
+
+typedef struct s_set
+{
+	t_res	*r;
+	size_t	n;
+	size_t	cap;
+}	t_set;
+
+static t_res	*res_get(t_set *s, const char *name, const char *metric)
+{
+	for (size_t i = 0; i < s->n; i++)
+		if (strcmp(s->r[i].name, name) == 0 && strcmp(s->r[i].metric, metric) == 0)
+			return &s->r[i];
+	if (s->n == s->cap)
+	{
+		size_t	ncap = s->cap ? s->cap * 2 : 32;
+		t_res	*nr = realloc(s->r, ncap * sizeof(t_res));
+		if (!nr)
+			return NULL;
+		s->r = nr;
+		s->cap = ncap;
+	}
+	s->r[s->n] = (t_res){0};
+	snprintf(s->r[s->n].name, NAME_MAX_LEN, "%s", name);
+	snprintf(s->r[s->n].metric, NAME_MAX_LEN, "%s", metric);
+	return &s->r[s->n++];
+}
+
+// 両側 95% の t 値（自由度 1..30。それより大きければ正規分布の 1.96）
+static double	t95(size_t df)
+{
+	static const double t[] = {
+		0, 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+		2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+		2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+	};
+
+	return (df < sizeof(t) / sizeof(t[0])) ? t[df] : 1.960;
+}
+
+static void	res_stats(t_res *r)
+{
+	double sum = 0;
+	double ss = 0;
+
+	r->min = r->max = r->n ? r->v[0] : 0;
+	for (size_t i = 0; i < r->n; i++)
+	{
+		sum += r->v[i];
+		if (r->v[i] < r->min)
+			r->min = r->v[i];
+		if (r->v[i] > r->max)
+			r->max = r->v[i];
+	}
+	r->mean = r->n ? sum / (double)r->n : 0;
+	for (size_t i = 0; i < r->n; i++)
+		ss += (r->v[i] - r->mean) * (r->v[i] - r->mean);
+	r->sd = (r->n > 1) ? sqrt(ss / (double)(r->n - 1)) : 0;
+	r->ci = (r->n > 1) ? t95(r->n - 1) * r->sd / sqrt((double)r->n) : 0;
+}
+
+static int	load_raw(const char *path, t_set *s)
+{
+	FILE	*fp = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+	char	line[512];
+
+	if (!fp)
+		return perror(path), -1;
+	while (fgets(line, sizeof(line), fp))
+	{
+		char	name[NAME_MAX_LEN];
+		char	metric[NAME_MAX_LEN];
+		char	dir[16];
+		double	v;
+		t_res	*r;
+
+		if (line[0] == '#' || sscanf(line, "%63s %63s %15s %lf", name, metric, dir, &v) != 4)
+			continue;
+		if ((r = res_get(s, name, metric)) == NULL)
+			break;
+		r->higher = (strcmp(dir, "higher") == 0);
+		if (r->n == r->cap)
+		{
+			size_t	ncap = r->cap ? r->cap * 2 : 8;
+			double	*nv = realloc(r->v, ncap * sizeof(double));
+			if (!nv)
+				break;
+			r->v = nv;
+			r->cap = ncap;
+		}
+		r->v[r->n++] = v;
+	}
+	if (fp != stdin)
+		fclose(fp);
+	return 0;
+}
+
+// 自分で書いた形式だけ読めればよいので、1 行 1 結果の "key":value を拾う
+static int	json_field(const char *line, const char *key, char *out, size_t n)
+{
+	char		pat[NAME_MAX_LEN + 4];
+	const char	*p;
+	size_t		k = 0;
+
+	snprintf(pat, sizeof(pat), "\"%s\":", key);
+	if ((p = strstr(line, pat)) == NULL)
+		return 0;
+	p += strlen(pat);
+	if (*p == '"')
+		p++;
+	while (p[k] && p[k] != '"' && p[k] != ',' && p[k] != '}' && k + 1 < n)
+		k++;
+	memcpy(out, p, k);
+	out[k] = '\0';
+	return 1;
+}
+
+static int	load_json(const char *path, t_set *s)
+{
+	FILE	*fp = fopen(path, "r");
+	char	line[1024];
+
+	if (!fp)
+		return -1;
+	while (fgets(line, sizeof(line), fp))
+	{
+		char	name[NAME_MAX_LEN];
+		char	metric[NAME_MAX_LEN];
+		char	num[64];
+		t_res	*r;
+
+		if (!json_field(line, "name", name, sizeof(name)) || !json_field(line, "metric", metric, sizeof(metric))
+			|| (r = res_get(s, name, metric)) == NULL)
+			continue;
+		if (json_field(line, "better", num, sizeof(num)))
+			r->higher = (strcmp(num, "higher") == 0);
+		if (json_field(line, "n", num, sizeof(num)))
+			r->n = strtoul(num, NULL, 10);
+		if (json_field(line, "mean", num, sizeof(num)))
+			r->mean = strtod(num, NULL);
+		if (json_field(line, "ci95", num, sizeof(num)))
+			r->ci = strtod(num, NULL);
+	}
+	fclose(fp);
+	return 0;
+}
+
+static int	write_json(const char *path, const t_set *s, char **meta, int nmeta)
+{
+	FILE *fp = fopen(path, "w");
+
+	if (!fp)
+		return perror(path), -1;
+	fprintf(fp, "{\n  \"meta\": {");
+	for (int i = 0; i < nmeta; i++)
+	{
+		char *eq = strchr(meta[i], '=');
+		if (!eq)
+			continue;
+		fprintf(fp, "%s\"%.*s\": \"", i ? ", " : "", (int)(eq - meta[i]), meta[i]);
+		for (const char *p = eq + 1; *p; p++)
+			fprintf(fp, (*p == '"' || *p == '\\') ? "\\%c" : "%c", *p);
+		fputc('"', fp);
+	}
+	fprintf(fp, "},\n  \"results\": [\n");
+	for (size_t i = 0; i < s->n; i++)
+	{
+		const t_res *r = &s->r[i];
+		fprintf(fp, "    {\"name\":\"%s\",\"metric\":\"%s\",\"better\":\"%s\",\"n\":%zu,"
+			"\"mean\":%.3f,\"sd\":%.3f,\"ci95\":%.3f,\"min\":%.3f,\"max\":%.3f}%s\n",
+			r->name, r->metric, r->higher ? "higher" : "lower", r->n,
+			r->mean, r->sd, r->ci, r->min, r->max, (i + 1 < s->n) ? "," : "");
+	}
+	fprintf(fp, "  ]\n}\n");
+	return fclose(fp);
+}
+
+static int	compare(const t_set *cur, const t_set *base, double threshold)
+{
+	int bad = 0;
+
+	printf("%-28s %-14s %12s %10s %12s %8s %8s  %s\n", "name", "metric", "mean", "+-ci95", "baseline", "delta",
+		"speedup", "");
+	for (size_t i = 0; i < cur->n; i++)
+	{
+		const t_res	*r = &cur->r[i];
+		const t_res	*b = NULL;
+		const char	*verdict = "";
+		double		delta = 0;
+
+		for (size_t k = 0; base && k < base->n; k++)
+			if (strcmp(base->r[k].name, r->name) == 0 && strcmp(base->r[k].metric, r->metric) == 0)
+				b = &base->r[k];
+		if (b && b->mean != 0)
+		{
+			// 悪くなった向きを正にする
+			delta = (r->mean - b->mean) / fabs(b->mean) * 100.0;
+			double worse = r->higher ? -delta : delta;
+			if (worse > threshold && fabs(r->mean - b->mean) > r->ci + b->ci)
+			{
+				verdict = "REGRESSION";
+				bad = 1;
+			}
+			else if (-worse > threshold && fabs(r->mean - b->mean) > r->ci + b->ci)
+				verdict = "improved";
+		}
+		if (b)
+		{
+			// speedup は「よい向きに何倍か」（latency なら基準 / いま）
+			double sp = r->higher ? (b->mean != 0 ? r->mean / b->mean : 0) : (r->mean != 0 ? b->mean / r->mean : 0);
+			printf("%-28s %-14s %12.1f %10.1f %12.1f %+7.1f%% %7.2fx  %s\n", r->name, r->metric, r->mean, r->ci,
+				b->mean, delta, sp, verdict);
+		}
+		else
+			printf("%-28s %-14s %12.1f %10.1f %12s %8s\n", r->name, r->metric, r->mean, r->ci, "-", "-");
+	}
+	return bad;
+}
+
+static void	usage(void)
+{
+	fprintf(stderr, "Usage: benchstat [-o OUT.json] [-b BASELINE.json] [-t PCT] [-m KEY=VALUE]... <raw.txt|->\n");
+}
+
+int	main(int argc, char **argv)
+{
+	t_set		cur = {0};
+	t_set		base = {0};
+	const char	*out = NULL;
+	const char	*bpath = NULL;
+	double		threshold = 10.0;
+	char		**meta = calloc((size_t)argc, sizeof(char *));
+	int			nmeta = 0;
+	int			i;
+	int			rc = 0;
+
+	for (i = 1; i < argc - 1 && argv[i][0] == '-' && argv[i][1]; i++)
+	{
+		if (strcmp(argv[i], "-o") == 0)
+			out = argv[++i];
+		else if (strcmp(argv[i], "-b") == 0)
+			bpath = argv[++i];
+		else if (strcmp(argv[i], "-t") == 0)
+			threshold = atof(argv[++i]);
+		else if (strcmp(argv[i], "-m") == 0 && meta)
+			meta[nmeta++] = argv[++i];
+		else
+			return free(meta), usage(), 2;
+	}
+	if (i != argc - 1 || load_raw(argv[i], &cur) != 0)
+		return free(meta), usage(), 2;
+	for (size_t k = 0; k < cur.n; k++)
+		res_stats(&cur.r[k]);
+	if (out && write_json(out, &cur, meta, nmeta) != 0)
+		rc = 2;
+	if (bpath && load_json(bpath, &base) != 0)
+	{
+		fprintf(stderr, "benchstat: no baseline at %s (make bench-baseline to create one)\n", bpath);
+		bpath = NULL;
+	}
+	if (compare(&cur, bpath ? &base : NULL, threshold) && rc == 0)
+	{
+		fprintf(stderr, "benchstat: regression beyond %.1f%% against %s\n", threshold, bpath);
+		rc = 1;
+	}
+	for (size_t k = 0; k < cur.n; k++)
+		free(cur.r[k].v);
+	free(cur.r);
+	free(base.r);
+	free(meta);
+	return rc;
+}
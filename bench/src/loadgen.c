@@ -0,0 +1,656 @@
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * minihttpd 用の小さな負荷生成器
+ *
+ * 1 スレッドの epoll で -c 本の接続を同時に張り、それぞれ「リクエストを書く → レスポンスを読み切る」を
+ * -d 秒のあいだ繰り返す。-k なら同じ接続で次のリクエストを送り（サーバが Connection: close を返したら
+ * 張り直す）、-k なしなら 1 リクエストごとに張り直す。
+ * 最初の -w 秒は数えない（warm-up）。結果は JSON 1 行で stdout に出す。
+ * ヘッダが揃ったら本文は buf の頭に上書きしながら読み捨てるので、どれだけ大きな本文でも受けられる。
+ *
+ * -2 なら HTTP/2（h2c、prior knowledge）で、接続ごとに -m 本のストリームをいつも飛ばしておき、
+ * 1 本返ってくるたびに次を送る（接続は張りっぱなし）。レイテンシはストリームごとに数える。
+ * 受ける窓は最初に大きく開け、接続の窓は読んだ分を WINDOW_UPDATE で戻す。
+ *
+ * -R RATE（-k のとき）は全体で毎秒 RATE リクエストに抑え、接続ごとに間隔をあけて送る（行儀のよいクライアント）。
+ * -b ADDR は接続元のアドレス（127.0.0.2 など）。サーバの流量制限は接続元ごとなので、別のクライアントを装える。
+ */
+
+#define RESP_MAX     65536
+#define H2_OUT_MAX   8192
+#define H2_STREAMS   100          // minihttpd の SETTINGS_MAX_CONCURRENT_STREAMS
+#define H2_WINDOW    0x7fffffff
+#define H2_REFILL    (16u << 20)  // 接続の窓をこれだけ読んだら戻す
+
+typedef struct s_h2s
+{
+	uint32_t	id;         // 0: 空き
+	uint64_t	t0;
+	size_t		bytes;      // このストリームのフレーム（9 バイトのヘッダ込み）
+}	t_h2s;
+
+typedef enum e_cst
+{
+	C_CONNECTING,
+	C_WRITING,
+	C_READING,
+	C_IDLE,     // -R: 次に送る時刻（due）まで待つ
+	C_H2
+}	t_cst;
+
+typedef struct s_conn
+{
+	int			fd;
+	t_cst		st;
+	size_t		sent;
+	size_t		got;        // このレスポンスで読んだ量（ヘッダ + 本文）
+	size_t		need;       // ヘッダ + Content-Length（0: ヘッダがまだ揃っていない、SIZE_MAX: EOF まで）
+	int			can_keep;
+	int			rejected;   // 429 だった
+	uint64_t	t0;
+	uint64_t	due;
+	uint32_t	next_id;    // -2: 次に使うストリーム ID
+	size_t		unacked;    // -2: 読んだが WINDOW_UPDATE で戻していない DATA
+	size_t		olen;       // -2: out のうち書くもの
+	size_t		ooff;
+	t_h2s		*s;         // -2: 飛ばしているストリーム（streams 個）
+	char		out[H2_OUT_MAX];
+	char		buf[RESP_MAX];
+}	t_conn;
+
+typedef struct s_lg
+{
+	struct sockaddr_in	addr;
+	struct sockaddr_in	src;
+	int					bind_src;
+	uint64_t			gap;        // -R: 1 本の接続が送る間隔（us）。0: 間をあけない
+	int					ep;
+	int					keepalive;
+	int					h2;
+	int					streams;
+	char				req[256];
+	size_t				reqlen;
+	uint64_t			rec_from;   // この時刻より後に終わったリクエストだけ数える
+	uint64_t			*lat;
+	size_t				nlat;
+	size_t				latcap;
+	uint64_t			errors;
+	uint64_t			rejected;   // 429 で返ってきた数（数えたもののうち）
+	uint64_t			connects;
+	uint64_t			bytes;      // 数えたレスポンスの合計（ヘッダ込み）
+}	t_lg;
+
+static uint64_t	now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000ull + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static int	conn_open(t_lg *g, t_conn *c)
+{
+	int one = 1;
+
+	c->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (c->fd < 0)
+		return -1;
+	setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	if (g->bind_src && bind(c->fd, (struct sockaddr *)&g->src, sizeof(g->src)) != 0)
+	{
+		close(c->fd);
+		c->fd = -1;
+		return -1;
+	}
+	c->st = C_CONNECTING;
+	c->sent = 0;
+	c->got = 0;
+	c->need = 0;
+	c->t0 = now_us();
+	c->due = c->t0;
+	c->next_id = 1;
+	c->unacked = 0;
+	c->olen = 0;
+	c->ooff = 0;
+	if (c->s)
+		memset(c->s, 0, (size_t)g->streams * sizeof(t_h2s));
+	g->connects++;
+	if (connect(c->fd, (struct sockaddr *)&g->addr, sizeof(g->addr)) == 0)
+		c->st = C_WRITING;
+	else if (errno != EINPROGRESS)
+	{
+		close(c->fd);
+		c->fd = -1;
+		return -1;
+	}
+	struct epoll_event ev = {.events = EPOLLOUT, .data.ptr = c};
+	if (epoll_ctl(g->ep, EPOLL_CTL_ADD, c->fd, &ev) != 0)
+	{
+		close(c->fd);
+		c->fd = -1;
+		return -1;
+	}
+	return 0;
+}
+
+static void	conn_reopen(t_lg *g, t_conn *c)
+{
+	if (c->fd >= 0)
+		close(c->fd);
+	c->fd = -1;
+	if (conn_open(g, c) != 0)
+		g->errors++;
+}
+
+static void	conn_watch(t_lg *g, t_conn *c, uint32_t events)
+{
+	struct epoll_event ev = {.events = events, .data.ptr = c};
+
+	epoll_ctl(g->ep, EPOLL_CTL_MOD, c->fd, &ev);
+}
+
+static void	record(t_lg *g, uint64_t t0, uint64_t t1, size_t bytes, int rejected)
+{
+	if (t1 < g->rec_from)
+		return;
+	g->bytes += bytes;
+	g->rejected += (uint64_t)rejected;
+	if (g->nlat == g->latcap)
+	{
+		size_t		ncap = g->latcap ? g->latcap * 2 : 65536;
+		uint64_t	*nl = realloc(g->lat, ncap * sizeof(uint64_t));
+		if (!nl)
+			return;
+		g->lat = nl;
+		g->latcap = ncap;
+	}
+	g->lat[g->nlat++] = t1 - t0;
+}
+
+// ヘッダが揃っていれば need（ヘッダ + 本文の長さ）と keep-alive できるかを埋めて 1
+static int	resp_head(t_conn *c)
+{
+	const char	*end = memmem(c->buf, c->got, "\r\n\r\n", 4);
+	const char	*p;
+	size_t		hlen;
+	long		clen = -1;
+
+	if (!end)
+		return 0;
+	hlen = (size_t)(end - c->buf) + 4;
+	c->can_keep = (strncmp(c->buf, "HTTP/1.1", 8) == 0);
+	c->rejected = (strncmp(c->buf + 8, " 429", 4) == 0);
+	for (p = c->buf; p && p < end; p = memchr(p, '\n', (size_t)(end - p)), p = p ? p + 1 : NULL)
+	{
+		if (strncasecmp(p, "Content-Length:", 15) == 0)
+			clen = strtol(p + 15, NULL, 10);
+		else if (strncasecmp(p, "Connection:", 11) == 0)
+		{
+			const char *v = p + 11;
+			while (*v == ' ')
+				v++;
+			c->can_keep = (strncasecmp(v, "close", 5) != 0);
+		}
+	}
+	// 長さの分からないレスポンスは EOF で終わりとみなす
+	c->need = (clen < 0) ? SIZE_MAX : hlen + (size_t)clen;
+	return 1;
+}
+
+// --- -2: h2c ---------------------------------------------------------------
+
+static void	put_frame(t_conn *c, size_t len, int type, int flags, uint32_t id, const void *p)
+{
+	unsigned char *o = (unsigned char *)c->out + c->olen;
+
+	if (c->olen + 9 + len > sizeof(c->out))
+		return;   // 溜まりすぎ（返事が読めていない）。落としても次の読みで取り返す
+	o[0] = (unsigned char)(len >> 16);
+	o[1] = (unsigned char)(len >> 8);
+	o[2] = (unsigned char)len;
+	o[3] = (unsigned char)type;
+	o[4] = (unsigned char)flags;
+	o[5] = (unsigned char)(id >> 24);
+	o[6] = (unsigned char)(id >> 16);
+	o[7] = (unsigned char)(id >> 8);
+	o[8] = (unsigned char)id;
+	memcpy(o + 9, p, len);
+	c->olen += 9 + len;
+}
+
+static void	put_window_update(t_conn *c, uint32_t incr)
+{
+	unsigned char v[4] = {incr >> 24, incr >> 16, incr >> 8, incr};
+
+	put_frame(c, 4, 0x8, 0, 0, v);
+}
+
+// 空いているストリームにリクエストを 1 つ積む（g->req はヘッダブロック）
+static void	h2_send_request(t_lg *g, t_conn *c, t_h2s *s)
+{
+	s->id = c->next_id;
+	s->t0 = now_us();
+	s->bytes = 0;
+	c->next_id += 2;
+	put_frame(c, g->reqlen, 0x1, 0x4 | 0x1, s->id, g->req);   // END_HEADERS | END_STREAM
+}
+
+// 接続できたら preface、SETTINGS（ストリームの窓を最大に）、接続の窓を最大に、最初の -m 本
+static void	h2_start(t_lg *g, t_conn *c)
+{
+	static const unsigned char settings[] = {
+		0x00, 0x02, 0, 0, 0, 0,                  // ENABLE_PUSH 0
+		0x00, 0x04, 0x7f, 0xff, 0xff, 0xff };    // INITIAL_WINDOW_SIZE
+	memcpy(c->out, "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n", 24);
+	c->olen = 24;
+	put_frame(c, sizeof(settings), 0x4, 0, 0, settings);
+	put_window_update(c, H2_WINDOW - 65535);
+	for (int i = 0; i < g->streams; i++)
+		h2_send_request(g, c, &c->s[i]);
+	c->st = C_H2;
+	c->got = 0;
+}
+
+static t_h2s	*h2_stream(t_lg *g, t_conn *c, uint32_t id)
+{
+	for (int i = 0; i < g->streams; i++)
+		if (c->s[i].id == id)
+			return &c->s[i];
+	return NULL;
+}
+
+// buf にある完全なフレームを全部処理する。-1: 張り直す
+static int	h2_frames(t_lg *g, t_conn *c)
+{
+	const unsigned char	*b = (const unsigned char *)c->buf;
+	size_t				off = 0;
+
+	while (c->got - off >= 9)
+	{
+		size_t		len = (size_t)b[off] << 16 | (size_t)b[off + 1] << 8 | b[off + 2];
+		int			type = b[off + 3];
+		int			flags = b[off + 4];
+		uint32_t	id = ((uint32_t)b[off + 5] << 24 | (uint32_t)b[off + 6] << 16
+						| (uint32_t)b[off + 7] << 8 | b[off + 8]) & 0x7fffffff;
+		t_h2s		*s = id ? h2_stream(g, c, id) : NULL;
+
+		if (len + 9 > sizeof(c->buf))
+			return -1;
+		if (c->got - off < 9 + len)
+			break;
+		if (type == 0x4 && !(flags & 0x1))
+			put_frame(c, 0, 0x4, 0x1, 0, NULL);                 // SETTINGS ACK
+		else if (type == 0x6 && !(flags & 0x1) && len == 8)
+			put_frame(c, 8, 0x6, 0x1, 0, b + off + 9);          // PING ACK
+		else if (type == 0x7)
+			return -1;                                          // GOAWAY
+		else if (type == 0x3 && s)
+		{
+			g->errors++;                                        // RST_STREAM
+			h2_send_request(g, c, s);
+		}
+		if (type == 0x0 && (c->unacked += len) >= H2_REFILL)
+		{
+			put_window_update(c, (uint32_t)c->unacked);
+			c->unacked = 0;
+		}
+		if (s && (type == 0x0 || type == 0x1 || type == 0x9))
+		{
+			s->bytes += 9 + len;
+			if ((type == 0x0 || type == 0x1) && (flags & 0x1))  // END_STREAM
+			{
+				record(g, s->t0, now_us(), s->bytes, 0);
+				h2_send_request(g, c, s);
+			}
+		}
+		off += 9 + len;
+	}
+	memmove(c->buf, c->buf + off, c->got - off);
+	c->got -= off;
+	return 0;
+}
+
+static void	h2_event(t_lg *g, t_conn *c, uint32_t events)
+{
+	if (events & EPOLLIN)
+	{
+		for (;;)
+		{
+			ssize_t n = read(c->fd, c->buf + c->got, sizeof(c->buf) - c->got);
+
+			if (n < 0 && errno == EAGAIN)
+				break;
+			if (n <= 0 || (c->got += (size_t)n, h2_frames(g, c)) != 0)
+			{
+				g->errors++;
+				conn_reopen(g, c);
+				return;
+			}
+		}
+	}
+	while (c->ooff < c->olen)
+	{
+		ssize_t n = write(c->fd, c->out + c->ooff, c->olen - c->ooff);
+
+		if (n < 0 && errno == EAGAIN)
+			break;
+		if (n <= 0)
+		{
+			g->errors++;
+			conn_reopen(g, c);
+			return;
+		}
+		c->ooff += (size_t)n;
+	}
+	if (c->ooff == c->olen)
+		c->olen = c->ooff = 0;
+	conn_watch(g, c, EPOLLIN | (c->olen ? EPOLLOUT : 0));
+}
+
+// -R: 時刻の来た接続に次を送らせる。いちばん近い due までのミリ秒（待つものが無ければ -1）
+static int	wake_idle(t_lg *g, t_conn *c, int conns, uint64_t t)
+{
+	uint64_t next = UINT64_MAX;
+
+	for (int i = 0; i < conns; i++)
+	{
+		if (c[i].st != C_IDLE)
+			continue;
+		if (c[i].due <= t)
+		{
+			c[i].st = C_WRITING;
+			c[i].t0 = t;
+			conn_watch(g, &c[i], EPOLLOUT);
+		}
+		else if (c[i].due < next)
+			next = c[i].due;
+	}
+	return next == UINT64_MAX ? -1 : (int)((next - t + 999) / 1000);
+}
+
+static void	on_event(t_lg *g, t_conn *c, uint32_t events)
+{
+	if (c->st == C_IDLE)
+	{
+		// 待っている間に閉じられた
+		if (events & (EPOLLERR | EPOLLHUP))
+			conn_reopen(g, c);
+		return;
+	}
+	if (c->st == C_H2)
+	{
+		h2_event(g, c, events);
+		return;
+	}
+	if (c->st == C_CONNECTING)
+	{
+		int		err = 0;
+		socklen_t len = sizeof(err);
+
+		getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+		if (err != 0 || (events & (EPOLLERR | EPOLLHUP)))
+		{
+			g->errors++;
+			conn_reopen(g, c);
+			return;
+		}
+		c->st = C_WRITING;
+		if (g->h2)
+		{
+			h2_start(g, c);
+			h2_event(g, c, EPOLLOUT);
+			return;
+		}
+	}
+	if (c->st == C_WRITING)
+	{
+		ssize_t n = write(c->fd, g->req + c->sent, g->reqlen - c->sent);
+
+		if (n < 0 && errno == EAGAIN)
+			return;
+		if (n <= 0)
+		{
+			g->errors++;
+			conn_reopen(g, c);
+			return;
+		}
+		c->sent += (size_t)n;
+		if (c->sent < g->reqlen)
+			return;
+		c->st = C_READING;
+		c->got = 0;
+		c->need = 0;
+		conn_watch(g, c, EPOLLIN);
+		return;
+	}
+
+	size_t	off = c->need ? 0 : c->got;
+	ssize_t	n = read(c->fd, c->buf + off, sizeof(c->buf) - off);
+
+	if (n < 0 && errno == EAGAIN)
+		return;
+	if (n > 0)
+	{
+		c->got += (size_t)n;
+		if (!c->need && !resp_head(c))
+		{
+			if (c->got < sizeof(c->buf))
+				return;
+			c->need = c->got;   // ヘッダが buf に収まらない。ここまでを 1 つと数える
+			c->can_keep = 0;
+		}
+		if (c->got < c->need)
+			return;
+	}
+	else if (!c->need)
+	{
+		// 何も返さずに閉じられた
+		g->errors++;
+		conn_reopen(g, c);
+		return;
+	}
+	record(g, c->t0, now_us(), c->got, c->rejected);
+	if (g->keepalive && c->can_keep && n > 0)
+	{
+		c->sent = 0;
+		if (g->gap)
+		{
+			// 遅れても取り返さない（次は早くても今から gap 後）
+			c->due += g->gap;
+			if (c->due < now_us())
+				c->due = now_us();
+			c->st = C_IDLE;
+			conn_watch(g, c, 0);
+			return;
+		}
+		c->st = C_WRITING;
+		c->t0 = now_us();
+		conn_watch(g, c, EPOLLOUT);
+		return;
+	}
+	conn_reopen(g, c);
+}
+
+static int	cmp_u64(const void *x, const void *y)
+{
+	uint64_t a = *(const uint64_t *)x;
+	uint64_t b = *(const uint64_t *)y;
+
+	return (a > b) - (a < b);
+}
+
+static double	pct(const uint64_t *v, size_t n, int p)
+{
+	if (n == 0)
+		return 0;
+	size_t i = (n * (size_t)p + 99) / 100;
+	return (double)v[i ? i - 1 : 0];
+}
+
+/*
+ * -2 のリクエストのヘッダブロック（HPACK。動的テーブルは使わない）:
+ * :method GET（静的 2）、:scheme http（静的 6）、:path（"/" なら静的 4、ほかは名前だけ 4 番で値は生）、
+ * :authority（名前 1 番、値は生）。path は 126 バイトまでなので長さは 7 ビットの 1 バイトに収まる
+ */
+static size_t	h2_request_block(char *dst, const char *path, const char *host)
+{
+	size_t	n = 0;
+	size_t	l;
+
+	dst[n++] = (char)0x82;
+	dst[n++] = (char)0x86;
+	if (strcmp(path, "/") == 0)
+		dst[n++] = (char)0x84;
+	else
+	{
+		l = strlen(path);
+		dst[n++] = 0x04;
+		dst[n++] = (char)l;
+		memcpy(dst + n, path, l);
+		n += l;
+	}
+	l = strlen(host);
+	dst[n++] = 0x01;
+	dst[n++] = (char)l;
+	memcpy(dst + n, host, l);
+	return n + l;
+}
+
+static void	usage(void)
+{
+	fprintf(stderr, "Usage: loadgen [-H HOST] [-p PORT] [-b SRC] [-c CONNS] [-d SEC] [-w SEC]\n"
+		"               [-k [-R RATE] | -2 [-m STREAMS]] [PATH]\n");
+}
+
+int	main(int argc, char **argv)
+{
+	t_lg		g = {0};
+	const char	*host = "127.0.0.1";
+	const char	*path = "/";
+	int			port = 8080;
+	int			conns = 1;
+	double		dur = 2.0;
+	double		warm = 0.5;
+	int			opt;
+	double		rate = 0;
+	const char	*src = NULL;
+
+	g.streams = 1;
+	while ((opt = getopt(argc, argv, "H:p:b:c:d:w:k2m:R:")) != -1)
+	{
+		if (opt == 'H')
+			host = optarg;
+		else if (opt == 'p')
+			port = atoi(optarg);
+		else if (opt == 'c')
+			conns = atoi(optarg);
+		else if (opt == 'd')
+			dur = atof(optarg);
+		else if (opt == 'w')
+			warm = atof(optarg);
+		else if (opt == 'k')
+			g.keepalive = 1;
+		else if (opt == '2')
+			g.h2 = g.keepalive = 1;
+		else if (opt == 'm')
+			g.streams = atoi(optarg);
+		else if (opt == 'R')
+			rate = atof(optarg);
+		else if (opt == 'b')
+			src = optarg;
+		else
+			return usage(), 2;
+	}
+	if (optind < argc)
+		path = argv[optind++];
+	if (optind != argc || conns <= 0 || conns > 10000 || dur <= 0 || warm < 0
+		|| g.streams <= 0 || g.streams > H2_STREAMS || (g.streams > 1 && !g.h2)
+		|| strlen(path) > 126 || strlen(host) > 63 || rate < 0 || (rate > 0 && (!g.keepalive || g.h2)))
+		return usage(), 2;
+
+	g.addr.sin_family = AF_INET;
+	g.addr.sin_port = htons((uint16_t)port);
+	if (inet_pton(AF_INET, host, &g.addr.sin_addr) != 1)
+	{
+		fprintf(stderr, "loadgen: bad address: %s\n", host);
+		return 2;
+	}
+	if (src)
+	{
+		g.src.sin_family = AF_INET;
+		g.bind_src = 1;
+		if (inet_pton(AF_INET, src, &g.src.sin_addr) != 1)
+		{
+			fprintf(stderr, "loadgen: bad address: %s\n", src);
+			return 2;
+		}
+	}
+	if (rate > 0)
+		g.gap = (uint64_t)(1e6 * conns / rate);
+	if (g.h2)
+		g.reqlen = h2_request_block(g.req, path, host);
+	else
+		g.reqlen = (size_t)snprintf(g.req, sizeof(g.req),
+			"GET %s HTTP/1.1\r\nHost: %s\r\nConnection: %s\r\n\r\n",
+			path, host, g.keepalive ? "keep-alive" : "close");
+	if ((g.ep = epoll_create1(EPOLL_CLOEXEC)) < 0)
+		return perror("epoll_create1"), 1;
+
+	t_conn *c = calloc((size_t)conns, sizeof(t_conn));
+	if (!c)
+		return perror("loadgen"), 1;
+	uint64_t start = now_us();
+	uint64_t stop = start + (uint64_t)((warm + dur) * 1e6);
+	g.rec_from = start + (uint64_t)(warm * 1e6);
+	for (int i = 0; i < conns; i++)
+	{
+		c[i].fd = -1;
+		if (g.h2 && (c[i].s = calloc((size_t)g.streams, sizeof(t_h2s))) == NULL)
+			return perror("loadgen"), 1;
+		if (conn_open(&g, &c[i]) != 0)
+			g.errors++;
+	}
+
+	struct epoll_event	ev[256];
+	uint64_t			t;
+
+	while ((t = now_us()) < stop)
+	{
+		int wait = (int)((stop - t) / 1000) + 1;
+		int idle = g.gap ? wake_idle(&g, c, conns, t) : -1;
+		int n = epoll_wait(g.ep, ev, 256, idle >= 0 && idle < wait ? idle : wait);
+		for (int i = 0; i < n; i++)
+			on_event(&g, ev[i].data.ptr, ev[i].events);
+	}
+	qsort(g.lat, g.nlat, sizeof(uint64_t), cmp_u64);
+	printf("{\"conns\":%d,\"keepalive\":%d,\"streams\":%d,\"duration_s\":%.2f,\"requests\":%zu,\"errors\":%llu,"
+		"\"connects\":%llu,\"rejected\":%llu,\"bytes\":%llu,\"rps\":%.1f,\"p50_us\":%.0f,\"p99_us\":%.0f,\"max_us\":%.0f}\n",
+		conns, g.keepalive, g.h2 ? g.streams : 1, dur, g.nlat, (unsigned long long)g.errors,
+		(unsigned long long)g.connects, (unsigned long long)g.rejected, (unsigned long long)g.bytes, (double)g.nlat / dur,
+		pct(g.lat, g.nlat, 50), pct(g.lat, g.nlat, 99), g.nlat ? (double)g.lat[g.nlat - 1] : 0.0);
+	for (int i = 0; i < conns; i++)
+	{
+		if (c[i].fd >= 0)
+			close(c[i].fd);
+		free(c[i].s);
+	}
+	free(c);
+	free(g.lat);
+	close(g.ep);
+	return (g.nlat == 0);
+}
@@ -0,0 +1,189 @@
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "router.h"
+
+/*
+ * minihttpd の router（完全ハッシュ + radix trie）の振り分けにかかる時間を測る
+ *
+ * ルート数 N ごとに、8 割を完全一致（"/api/v1/svcK/items" など）、2 割をプレフィックス（"/files/gK/"）で
+ * 登録し、完全一致 6 割・プレフィックス 2 割・どれにも当たらない 2 割の混ざったパスを引き続ける。
+ * 比べるために、同じルートを先頭から strcmp / strncmp で舐める素朴な実装も測る。
+ * 2 つの結果が 1 つでも食い違えば終了コード 1。結果は N ごとに JSON 1 行。
+ */
+
+#define WORK_N 4096
+
+typedef struct s_set
+{
+	char	**path;
+	int		*kind;
+	size_t	n;
+}	t_set;
+
+static uint64_t	now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t	rnd(uint64_t *s)
+{
+	*s ^= *s << 13;
+	*s ^= *s >> 7;
+	*s ^= *s << 17;
+	return *s;
+}
+
+static void	*linear_match(const t_set *set, const char *path, size_t len)
+{
+	size_t	best = 0;
+	void	*hit = NULL;
+
+	for (size_t i = 0; i < set->n; i++)
+		if (set->kind[i] == ROUTE_EXACT && strlen(set->path[i]) == len && memcmp(set->path[i], path, len) == 0)
+			return set->path[i];
+	for (size_t i = 0; i < set->n; i++)
+	{
+		size_t pl = strlen(set->path[i]);
+		if (set->kind[i] == ROUTE_PREFIX && pl <= len && pl >= best && memcmp(set->path[i], path, pl) == 0)
+		{
+			best = pl;
+			hit = set->path[i];
+		}
+	}
+	return hit;
+}
+
+static double	time_lookups(const t_router *r, const t_set *set, char **work, const size_t *wlen, size_t lookups)
+{
+	uintptr_t	sink = 0;
+	uint64_t	t0 = now_ns();
+
+	for (size_t i = 0; i < lookups; i++)
+	{
+		size_t k = i & (WORK_N - 1);
+		sink += (uintptr_t)(r ? router_match(r, work[k], wlen[k]) : linear_match(set, work[k], wlen[k]));
+	}
+	uint64_t t1 = now_ns();
+	__asm__ volatile("" : : "r"(sink));
+	return (double)(t1 - t0) / (double)lookups;
+}
+
+static int	run(size_t nroutes, size_t lookups)
+{
+	t_router	r = {0};
+	t_set		set = {calloc(nroutes, sizeof(char *)), calloc(nroutes, sizeof(int)), nroutes};
+	char		*work[WORK_N];
+	size_t		wlen[WORK_N];
+	uint64_t	seed = 0x243f6a8885a308d3ull ^ nroutes;
+	size_t		nexact = nroutes - nroutes / 5;
+	int			bad = 0;
+
+	if (!set.path || !set.kind)
+		return perror("routebench"), -1;
+	for (size_t i = 0; i < nroutes; i++)
+	{
+		char buf[64];
+
+		if (i < nexact)
+			snprintf(buf, sizeof(buf), "/api/v%zu/svc%zu/%s", i % 3 + 1, i, (i & 1) ? "items" : "status");
+		else
+			snprintf(buf, sizeof(buf), "/files/g%zu/", i - nexact);
+		set.path[i] = strdup(buf);
+		set.kind[i] = (i < nexact) ? ROUTE_EXACT : ROUTE_PREFIX;
+		// data はどのルートか分かればよいので、比べやすいよう set のパス文字列を指す
+		if (!set.path[i] || router_add(&r, buf, set.kind[i], set.path[i]) != 0)
+			return perror("routebench"), -1;
+	}
+
+	uint64_t t0 = now_ns();
+	if (router_compile(&r) != 0)
+		return -1;
+	double compile_us = (double)(now_ns() - t0) / 1000.0;
+
+	for (size_t k = 0; k < WORK_N; k++)
+	{
+		char		buf[96];
+		uint64_t	x = rnd(&seed);
+		size_t		i = (size_t)(x >> 8);
+
+		if (x % 10 < 6)
+			snprintf(buf, sizeof(buf), "%s", set.path[i % nexact]);
+		else if (x % 10 < 8 && nroutes > nexact)
+			snprintf(buf, sizeof(buf), "%sdoc%zu.txt", set.path[nexact + i % (nroutes - nexact)], k);
+		else
+			snprintf(buf, sizeof(buf), "/api/v1/svc%zu/missing", k);
+		work[k] = strdup(buf);
+		wlen[k] = strlen(buf);
+		if (!work[k])
+			return perror("routebench"), -1;
+		if (router_match(&r, work[k], wlen[k]) != linear_match(&set, work[k], wlen[k]))
+		{
+			fprintf(stderr, "routebench: mismatch for %s\n", work[k]);
+			bad = 1;
+		}
+	}
+
+	// 一度回して温めてから測る
+	time_lookups(&r, &set, work, wlen, lookups / 10 + 1);
+	double ns = time_lookups(&r, &set, work, wlen, lookups);
+	// 素朴な方は N に比例して遅いので、回数を減らす
+	double lin = time_lookups(NULL, &set, work, wlen, lookups / (nroutes / 10 + 1) + WORK_N);
+
+	printf("{\"routes\":%zu,\"exact\":%zu,\"prefix\":%zu,\"lookups\":%zu,\"compile_us\":%.1f,"
+		"\"ns_per_lookup\":%.2f,\"linear_ns_per_lookup\":%.2f}\n",
+		nroutes, nexact, nroutes - nexact, lookups, compile_us, ns, lin);
+	for (size_t k = 0; k < WORK_N; k++)
+		free(work[k]);
+	for (size_t i = 0; i < nroutes; i++)
+		free(set.path[i]);
+	free(set.path);
+	free(set.kind);
+	router_free(&r);
+	return bad ? -1 : 0;
+}
+
+static void	usage(void)
+{
+	fprintf(stderr, "Usage: routebench [-n LOOKUPS] [ROUTES...]   (default: 10 100 1000)\n");
+}
+
+int	main(int argc, char **argv)
+{
+	size_t	lookups = 5000000;
+	int		opt;
+	int		rc = 0;
+
+	while ((opt = getopt(argc, argv, "n:")) != -1)
+	{
+		if (opt == 'n')
+			lookups = strtoul(optarg, NULL, 10);
+		else
+			return usage(), 2;
+	}
+	if (lookups == 0)
+		return usage(), 2;
+	if (optind == argc)
+	{
+		static const size_t def[] = {10, 100, 1000};
+		for (size_t i = 0; i < sizeof(def) / sizeof(def[0]); i++)
+			rc |= (run(def[i], lookups) != 0);
+		return rc;
+	}
+	for (int i = optind; i < argc; i++)
+	{
+		long n = atol(argv[i]);
+		if (n < 1)
+			return usage(), 2;
+		rc |= (run((size_t)n, lookups) != 0);
+	}
+	return rc;
+}
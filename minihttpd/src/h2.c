@@ -0,0 +1,937 @@
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "h2.h"
+
+// フレームの種類（RFC 9113 6）
+#define F_DATA          0x0
+#define F_HEADERS       0x1
+#define F_PRIORITY      0x2
+#define F_RST_STREAM    0x3
+#define F_SETTINGS      0x4
+#define F_PUSH_PROMISE  0x5
+#define F_PING          0x6
+#define F_GOAWAY        0x7
+#define F_WINDOW_UPDATE 0x8
+#define F_CONTINUATION  0x9
+
+#define FL_END_STREAM   0x01
+#define FL_ACK          0x01
+#define FL_END_HEADERS  0x04
+#define FL_PADDED       0x08
+#define FL_PRIORITY     0x20
+
+// エラーコード（RFC 9113 7）
+#define E_NO_ERROR      0x0
+#define E_PROTOCOL      0x1
+#define E_INTERNAL      0x2
+#define E_FLOW_CONTROL  0x3
+#define E_STREAM_CLOSED 0x5
+#define E_FRAME_SIZE    0x6
+#define E_REFUSED       0x7
+#define E_COMPRESSION   0x9
+
+#define S_HEADER_TABLE_SIZE   0x1
+#define S_ENABLE_PUSH         0x2
+#define S_MAX_CONCURRENT      0x3
+#define S_INITIAL_WINDOW_SIZE 0x4
+#define S_MAX_FRAME_SIZE      0x5
+
+#define WINDOW_MAX      0x7fffffff
+#define DEFAULT_WINDOW  65535
+#define STREAM_WINDOW   (1 << 20)       // こちらが受けるストリームの窓（SETTINGS_INITIAL_WINDOW_SIZE）
+#define CONN_WINDOW     (16 << 20)      // こちらが受ける接続の窓
+#define HBLOCK_MAX      (32 * 1024)     // CONTINUATION でつながるヘッダブロック
+#define OUT_LOW         (64 * 1024)     // 書き待ちがこれより少なければ DATA を詰め足す
+#define OUT_HIGH        (1 << 20)       // 書き待ちがこれより多ければ読むのを止める
+
+enum { ST_OPEN, ST_HALF };   // 本文を受けている / 受け終えて応答待ちか送っている
+
+struct s_h2
+{
+	void			*ctx;
+	int				(*on_request)(void *ctx, t_h2stream *s);
+	t_hpack			dec;
+	t_hpack			enc;
+	int				enc_resize;     // 次のヘッダブロックの頭に動的テーブルのサイズ更新を置く
+	t_h2stream		*streams;
+	int				nstreams;       // reset していないもの（MAX_CONCURRENT_STREAMS と比べる）
+	int				npooled;
+	t_h2stream		*rhead;         // DATA を送る列
+	t_h2stream		*rtail;
+	uint32_t		last_id;
+	int64_t			send_window;
+	int64_t			recv_window;
+	int64_t			peer_window;    // 相手の SETTINGS_INITIAL_WINDOW_SIZE
+	int				got_settings;
+	uint32_t		cont_id;        // CONTINUATION を待っているストリーム（0: 待っていない）
+	uint8_t			cont_flags;
+	int				goaway_sent;
+	int				goaway_recv;
+	int				dead;           // http.c が閉じた
+	int				fatal;          // メモリが無い。すぐ閉じる
+	unsigned char	*out;
+	size_t			olen;
+	size_t			ooff;
+	size_t			ocap;
+	size_t			hblen;
+	size_t			inlen;
+	unsigned char	hblock[HBLOCK_MAX];
+	char			scratch[H2_HEAD_MAX];
+	unsigned char	in[9 + H2_FRAME_MAX];
+};
+
+static uint32_t	get32(const unsigned char *p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void	put32(unsigned char *p, uint32_t v)
+{
+	p[0] = (unsigned char)(v >> 24);
+	p[1] = (unsigned char)(v >> 16);
+	p[2] = (unsigned char)(v >> 8);
+	p[3] = (unsigned char)v;
+}
+
+static void	frame_head(unsigned char *p, size_t len, uint8_t type, uint8_t flags, uint32_t sid)
+{
+	p[0] = (unsigned char)(len >> 16);
+	p[1] = (unsigned char)(len >> 8);
+	p[2] = (unsigned char)len;
+	p[3] = type;
+	p[4] = flags;
+	put32(p + 5, sid & 0x7fffffffu);
+}
+
+// 書き待ちの後ろに n バイトの場所を取る（まだ olen は進めない）
+static unsigned char	*out_reserve(t_h2 *h, size_t n)
+{
+	if (h->ocap - h->olen >= n)
+		return h->out + h->olen;
+	if (h->ooff > 0)
+	{
+		memmove(h->out, h->out + h->ooff, h->olen - h->ooff);
+		h->olen -= h->ooff;
+		h->ooff = 0;
+	}
+	if (h->ocap - h->olen < n)
+	{
+		size_t			ncap = h->ocap ? h->ocap * 2 : 65536;
+		unsigned char	*no;
+
+		while (ncap - h->olen < n)
+			ncap *= 2;
+		if ((no = realloc(h->out, ncap)) == NULL)
+		{
+			h->fatal = 1;
+			return NULL;
+		}
+		h->out = no;
+		h->ocap = ncap;
+	}
+	return h->out + h->olen;
+}
+
+static void	put_frame(t_h2 *h, uint8_t type, uint8_t flags, uint32_t sid, const void *payload, size_t len)
+{
+	unsigned char *p = out_reserve(h, 9 + len);
+
+	if (!p)
+		return;
+	frame_head(p, len, type, flags, sid);
+	if (len > 0)
+		memcpy(p + 9, payload, len);
+	h->olen += 9 + len;
+}
+
+static void	put_window_update(t_h2 *h, uint32_t sid, uint32_t inc)
+{
+	unsigned char b[4];
+
+	put32(b, inc);
+	put_frame(h, F_WINDOW_UPDATE, 0, sid, b, 4);
+}
+
+static void	put_rst(t_h2 *h, uint32_t sid, uint32_t code)
+{
+	unsigned char b[4];
+
+	put32(b, code);
+	put_frame(h, F_RST_STREAM, 0, sid, b, 4);
+}
+
+// 接続のエラー。GOAWAY を送り、以後は読まない（書き終えたら http.c が閉じる）
+static void	goaway(t_h2 *h, uint32_t code)
+{
+	unsigned char b[8];
+
+	if (h->goaway_sent)
+		return;
+	put32(b, h->last_id);
+	put32(b + 4, code);
+	put_frame(h, F_GOAWAY, 0, 0, b, 8);
+	h->goaway_sent = 1;
+}
+
+static void	ready_push(t_h2 *h, t_h2stream *s)
+{
+	s->queued = 1;
+	s->rnext = NULL;
+	if (h->rtail)
+		h->rtail->rnext = s;
+	else
+		h->rhead = s;
+	h->rtail = s;
+}
+
+static t_h2stream	*ready_pop(t_h2 *h)
+{
+	t_h2stream *s = h->rhead;
+
+	if (!s)
+		return NULL;
+	h->rhead = s->rnext;
+	if (!h->rhead)
+		h->rtail = NULL;
+	s->queued = 0;
+	return s;
+}
+
+static t_h2stream	*stream_find(t_h2 *h, uint32_t id)
+{
+	for (t_h2stream *s = h->streams; s; s = s->next)
+		if (s->id == id && !s->reset)
+			return s;
+	return NULL;
+}
+
+static t_h2stream	*stream_new(t_h2 *h, uint32_t id)
+{
+	t_h2stream *s = malloc(sizeof(t_h2stream));
+
+	if (!s)
+		return NULL;
+	// 大きな resp.buf / path / head は使う分だけ書くので、ゼロで埋めない
+	memset(s, 0, offsetof(t_h2stream, resp));
+	memset(&s->id, 0, offsetof(t_h2stream, path) - offsetof(t_h2stream, id));
+	s->h2 = h;
+	s->id = id;
+	s->state = ST_OPEN;
+	s->send_window = h->peer_window;
+	s->recv_window = STREAM_WINDOW;
+	resp_reset(&s->resp);
+	s->next = h->streams;
+	if (h->streams)
+		h->streams->prev = s;
+	h->streams = s;
+	h->nstreams++;
+	return s;
+}
+
+static void	stream_reset(t_h2 *h, t_h2stream *s)
+{
+	if (!s->reset)
+		h->nstreams--;
+	s->reset = 1;
+}
+
+// 列に並んでいるもの・プールで動いているものは、出てきたときに消す
+static void	stream_free(t_h2 *h, t_h2stream *s)
+{
+	stream_reset(h, s);
+	if (s->queued || s->pooled)
+		return;
+	if (s->prev)
+		s->prev->next = s->next;
+	else
+		h->streams = s->next;
+	if (s->next)
+		s->next->prev = s->prev;
+	resp_release(&s->resp);
+	free(s->body);
+	free(s);
+}
+
+void	*h2_ctx(const t_h2 *h)
+{
+	return h->ctx;
+}
+
+t_h2	*h2_new(void *ctx, int (*on_request)(void *ctx, t_h2stream *s))
+{
+	t_h2			*h = malloc(sizeof(t_h2));
+	unsigned char	set[18];
+
+	if (!h)
+		return NULL;
+	memset(h, 0, offsetof(t_h2, hblock));
+	h->ctx = ctx;
+	h->on_request = on_request;
+	hpack_init(&h->dec, HPACK_TABLE_MAX);
+	hpack_init(&h->enc, HPACK_TABLE_MAX);
+	h->send_window = DEFAULT_WINDOW;
+	h->recv_window = CONN_WINDOW;
+	h->peer_window = DEFAULT_WINDOW;
+	// サーバの connection preface: SETTINGS と、接続の窓を広げる WINDOW_UPDATE
+	set[0] = 0;
+	set[1] = S_MAX_CONCURRENT;
+	put32(set + 2, H2_STREAMS_MAX);
+	set[6] = 0;
+	set[7] = S_INITIAL_WINDOW_SIZE;
+	put32(set + 8, STREAM_WINDOW);
+	set[12] = 0;
+	set[13] = S_ENABLE_PUSH;
+	put32(set + 14, 0);
+	put_frame(h, F_SETTINGS, 0, 0, set, sizeof(set));
+	put_window_update(h, 0, CONN_WINDOW - DEFAULT_WINDOW);
+	if (h->fatal)
+	{
+		free(h->out);
+		free(h);
+		return NULL;
+	}
+	return h;
+}
+
+static void	destroy(t_h2 *h)
+{
+	hpack_free(&h->dec);
+	hpack_free(&h->enc);
+	free(h->out);
+	free(h);
+}
+
+void	h2_free(t_h2 *h)
+{
+	t_h2stream *s = h->streams;
+
+	h->dead = 1;
+	h->rhead = h->rtail = NULL;
+	while (s)
+	{
+		t_h2stream *next = s->next;
+
+		s->queued = 0;
+		stream_free(h, s);
+		s = next;
+	}
+	if (h->npooled == 0)
+		destroy(h);
+}
+
+// ヘッダ 1 つを stream に写す。疑似ヘッダ（":" で始まる）は通常のヘッダより前でないといけない
+static int	take_field(t_h2stream *s, const t_hpfield *f, int *regular)
+{
+	t_hpfield host;
+
+	if (f->nlen > 0 && f->name[0] == ':')
+	{
+		if (*regular)
+			return -1;
+		if (f->nlen == 7 && memcmp(f->name, ":method", 7) == 0)
+			s->req.method = http_parse_method(f->value, f->vlen);
+		else if (f->nlen == 5 && memcmp(f->name, ":path", 5) == 0)
+		{
+			if (f->vlen == 0 || f->value[0] != '/')
+				return -1;
+			// HTTP/1.1 と同じく、ハンドラが strtol などで読み進めても止まるよう NUL で終える
+			if (f->vlen >= sizeof(s->path))
+				s->answered = 431;
+			else
+			{
+				memcpy(s->path, f->value, f->vlen);
+				s->path[f->vlen] = '\0';
+				s->req.path = s->path;
+				s->req.path_len = f->vlen;
+			}
+		}
+		else if (f->nlen == 10 && memcmp(f->name, ":authority", 10) == 0)
+		{
+			host = (t_hpfield){"host", 4, f->value, f->vlen};
+			f = &host;
+		}
+		else
+			return 0;   // :scheme など
+		if (f->name[0] == ':')
+			return 0;
+	}
+	else
+		*regular = 1;
+	// http_header で引けるように "name: value\r\n" の並びにしておく
+	if (s->hlen + f->nlen + f->vlen + 4 > sizeof(s->head))
+	{
+		s->answered = 431;
+		return 0;
+	}
+	memcpy(s->head + s->hlen, f->name, f->nlen);
+	s->hlen += f->nlen;
+	memcpy(s->head + s->hlen, ": ", 2);
+	s->hlen += 2;
+	memcpy(s->head + s->hlen, f->value, f->vlen);
+	s->hlen += f->vlen;
+	memcpy(s->head + s->hlen, "\r\n", 2);
+	s->hlen += 2;
+	return 0;
+}
+
+// 本文まで揃った。リクエストを組み立てて http.c に渡す
+static void	request_ready(t_h2 *h, t_h2stream *s)
+{
+	t_req		*req = &s->req;
+	const char	*q;
+
+	s->state = ST_HALF;
+	req->fd = -1;   // 本文は全部メモリにある（http_read_body は fd を読まない）
+	req->head = s->head;
+	req->head_len = s->hlen;
+	req->body = s->body;
+	req->body_len = s->body_len;
+	req->content_length = s->body_len;
+	req->keepalive = 1;
+	if (req->path && (q = memchr(req->path, '?', req->path_len)) != NULL)
+	{
+		req->query = q + 1;
+		req->query_len = req->path_len - (size_t)(q + 1 - req->path);
+		req->path_len = (size_t)(q - req->path);
+	}
+	s->head_only = (req->method == HTTP_HEAD);
+	if (s->too_big)
+		s->answered = 413;
+	else if (!s->answered && req->method == 0)
+		s->answered = 501;
+	if (s->answered)
+		resp_printf(&s->resp, s->answered, "%s\n", http_reason(s->answered));
+	if (h->on_request(h->ctx, s))
+	{
+		s->pooled = 1;
+		h->npooled++;
+	}
+}
+
+// 1 つのヘッダブロック（HEADERS + CONTINUATION）を読む
+static void	on_headers(t_h2 *h, uint32_t sid, uint8_t flags, const unsigned char *p, size_t len)
+{
+	const unsigned char	*end = p + len;
+	t_h2stream			*s = stream_find(h, sid);
+	t_hpfield			f;
+	int					trailer = 0;
+	int					regular = 0;
+	int					bad = 0;
+	int					r;
+
+	if (!s)
+	{
+		// 閉じたストリームへの HEADERS（id が前のものより小さい）は接続のエラー
+		if (sid <= h->last_id)
+			return goaway(h, E_STREAM_CLOSED);
+		h->last_id = sid;
+		if (!h->goaway_recv && h->nstreams < H2_STREAMS_MAX)
+		{
+			if ((s = stream_new(h, sid)) == NULL)
+				put_rst(h, sid, E_INTERNAL);
+		}
+		else if (!h->goaway_recv)
+			put_rst(h, sid, E_REFUSED);
+	}
+	else if (s->state != ST_OPEN)
+		bad = 1;
+	else
+		trailer = 1;   // 本文の後ろのヘッダ。中身は使わない
+	// 使わないブロックも、動的テーブルを相手と揃えるために最後まで読む
+	while ((r = hpack_decode(&h->dec, &p, end, h->scratch, sizeof(h->scratch), &f)) == 1)
+		if (s && !bad && !trailer && take_field(s, &f, &regular) != 0)
+			bad = 1;
+	if (r < 0)
+		return goaway(h, E_COMPRESSION);
+	if (!s)
+		return;
+	if (bad || (trailer && !(flags & FL_END_STREAM)) || (!s->req.path && !s->answered))
+	{
+		put_rst(h, sid, E_PROTOCOL);
+		stream_free(h, s);
+		return;
+	}
+	if (flags & FL_END_STREAM)
+		request_ready(h, s);
+}
+
+// PADDED の詰め物を外す。0 / -1（詰め物が本体より長い）
+static int	unpad(uint8_t flags, const unsigned char **p, size_t *len)
+{
+	size_t pad;
+
+	if (!(flags & FL_PADDED))
+		return 0;
+	if (*len < 1)
+		return -1;
+	pad = (*p)[0];
+	if (pad >= *len)
+		return -1;
+	*p += 1;
+	*len -= 1 + pad;
+	return 0;
+}
+
+static void	on_data(t_h2 *h, uint32_t sid, uint8_t flags, const unsigned char *p, size_t len)
+{
+	t_h2stream	*s = stream_find(h, sid);
+	size_t		flen = len;   // 窓は詰め物も含めて数える
+
+	if (sid == 0)
+		return goaway(h, E_PROTOCOL);
+	if ((h->recv_window -= (int64_t)flen) < 0)
+		return goaway(h, E_FLOW_CONTROL);
+	if (unpad(flags, &p, &len) != 0)
+		return goaway(h, E_PROTOCOL);
+	// 接続の窓は、どのストリームの分でも受けたらすぐ戻す
+	if (h->recv_window < CONN_WINDOW / 2)
+	{
+		put_window_update(h, 0, (uint32_t)(CONN_WINDOW - h->recv_window));
+		h->recv_window = CONN_WINDOW;
+	}
+	if (!s || s->state != ST_OPEN)
+	{
+		if (sid > h->last_id)
+			return goaway(h, E_PROTOCOL);
+		put_rst(h, sid, E_STREAM_CLOSED);
+		return;
+	}
+	if ((s->recv_window -= (int64_t)flen) < 0)
+	{
+		put_rst(h, sid, E_FLOW_CONTROL);
+		stream_free(h, s);
+		return;
+	}
+	if (s->body_len + len > H2_BODY_MAX)
+		s->too_big = 1;
+	if (!s->too_big && len > 0)
+	{
+		if (s->body_len + len > s->body_cap)
+		{
+			size_t	ncap = s->body_cap ? s->body_cap : 16384;
+			char	*nb;
+
+			while (ncap < s->body_len + len)
+				ncap *= 2;
+			if ((nb = realloc(s->body, ncap)) == NULL)
+				s->too_big = 1;
+			else
+			{
+				s->body = nb;
+				s->body_cap = ncap;
+			}
+		}
+		if (!s->too_big)
+		{
+			memcpy(s->body + s->body_len, p, len);
+			s->body_len += len;
+		}
+	}
+	if (flags & FL_END_STREAM)
+	{
+		request_ready(h, s);
+		return;
+	}
+	if (s->recv_window < STREAM_WINDOW / 2)
+	{
+		put_window_update(h, sid, (uint32_t)(STREAM_WINDOW - s->recv_window));
+		s->recv_window = STREAM_WINDOW;
+	}
+}
+
+// 窓が開いたストリームを列に戻す
+static void	unblock(t_h2 *h, t_h2stream *s)
+{
+	if (s->blocked && s->send_window > 0)
+	{
+		s->blocked = 0;
+		ready_push(h, s);
+	}
+}
+
+static void	on_settings(t_h2 *h, uint32_t sid, uint8_t flags, const unsigned char *p, size_t len)
+{
+	if (sid != 0)
+		return goaway(h, E_PROTOCOL);
+	if (flags & FL_ACK)
+	{
+		if (len != 0)
+			goaway(h, E_FRAME_SIZE);
+		return;
+	}
+	if (len % 6 != 0)
+		return goaway(h, E_FRAME_SIZE);
+	for (size_t i = 0; i < len; i += 6)
+	{
+		unsigned	id = ((unsigned)p[i] << 8) | p[i + 1];
+		uint32_t	v = get32(p + i + 2);
+
+		if (id == S_HEADER_TABLE_SIZE)
+		{
+			// 相手の読む側の表の上限。こちらの書く側を合わせ、次のブロックの頭で知らせる
+			size_t max = v < HPACK_TABLE_MAX ? v : HPACK_TABLE_MAX;
+			if (max != h->enc.max)
+			{
+				hpack_resize(&h->enc, max);
+				h->enc_resize = 1;
+			}
+		}
+		else if (id == S_ENABLE_PUSH && v > 1)
+			return goaway(h, E_PROTOCOL);
+		else if (id == S_INITIAL_WINDOW_SIZE)
+		{
+			if (v > WINDOW_MAX)
+				return goaway(h, E_FLOW_CONTROL);
+			// 開いているストリームの窓を差分だけずらす（負になることもある）
+			for (t_h2stream *s = h->streams; s; s = s->next)
+			{
+				s->send_window += (int64_t)v - h->peer_window;
+				if (s->send_window > WINDOW_MAX)
+					return goaway(h, E_FLOW_CONTROL);
+				unblock(h, s);
+			}
+			h->peer_window = v;
+		}
+		else if (id == S_MAX_FRAME_SIZE && (v < 16384 || v > 16777215))
+			return goaway(h, E_PROTOCOL);
+	}
+	h->got_settings = 1;
+	put_frame(h, F_SETTINGS, FL_ACK, 0, NULL, 0);
+}
+
+static void	on_window_update(t_h2 *h, uint32_t sid, const unsigned char *p, size_t len)
+{
+	uint32_t	inc;
+	t_h2stream	*s;
+
+	if (len != 4)
+		return goaway(h, E_FRAME_SIZE);
+	inc = get32(p) & 0x7fffffffu;
+	if (sid == 0)
+	{
+		if (inc == 0)
+			return goaway(h, E_PROTOCOL);
+		if ((h->send_window += inc) > WINDOW_MAX)
+			return goaway(h, E_FLOW_CONTROL);
+		return;
+	}
+	if ((s = stream_find(h, sid)) == NULL)
+	{
+		if (sid > h->last_id)
+			goaway(h, E_PROTOCOL);
+		return;   // 閉じたばかりのストリームへのものは捨てる
+	}
+	if (inc == 0 || (s->send_window += inc) > WINDOW_MAX)
+	{
+		put_rst(h, sid, inc == 0 ? E_PROTOCOL : E_FLOW_CONTROL);
+		stream_free(h, s);
+		return;
+	}
+	unblock(h, s);
+}
+
+static void	on_rst_stream(t_h2 *h, uint32_t sid, size_t len)
+{
+	t_h2stream *s;
+
+	if (len != 4)
+		return goaway(h, E_FRAME_SIZE);
+	if (sid == 0 || sid > h->last_id)
+		return goaway(h, E_PROTOCOL);
+	if ((s = stream_find(h, sid)) != NULL)
+		stream_free(h, s);
+}
+
+static void	on_frame(t_h2 *h, uint8_t type, uint8_t flags, uint32_t sid, const unsigned char *p, size_t len)
+{
+	// 最初のフレームは SETTINGS（クライアントの connection preface の続き）
+	if (!h->got_settings && type != F_SETTINGS)
+		return goaway(h, E_PROTOCOL);
+	// ヘッダブロックの途中には、同じストリームの CONTINUATION しか挟めない
+	if (h->cont_id != 0 && (type != F_CONTINUATION || sid != h->cont_id))
+		return goaway(h, E_PROTOCOL);
+	switch (type)
+	{
+		case F_DATA:
+			on_data(h, sid, flags, p, len);
+			break;
+		case F_HEADERS:
+			if (sid == 0 || (sid & 1) == 0)
+				return goaway(h, E_PROTOCOL);
+			if (unpad(flags, &p, &len) != 0)
+				return goaway(h, E_PROTOCOL);
+			if (flags & FL_PRIORITY)
+			{
+				if (len < 5)
+					return goaway(h, E_FRAME_SIZE);
+				p += 5;
+				len -= 5;
+			}
+			if (flags & FL_END_HEADERS)
+				return on_headers(h, sid, flags, p, len);
+			// 続きがあるので貯める
+			if (len > sizeof(h->hblock))
+				return goaway(h, E_PROTOCOL);
+			memcpy(h->hblock, p, len);
+			h->hblen = len;
+			h->cont_id = sid;
+			h->cont_flags = flags;
+			break;
+		case F_CONTINUATION:
+			if (h->cont_id == 0)
+				return goaway(h, E_PROTOCOL);
+			if (h->hblen + len > sizeof(h->hblock))
+				return goaway(h, E_PROTOCOL);
+			memcpy(h->hblock + h->hblen, p, len);
+			h->hblen += len;
+			if (flags & FL_END_HEADERS)
+			{
+				h->cont_id = 0;
+				on_headers(h, sid, h->cont_flags, h->hblock, h->hblen);
+			}
+			break;
+		case F_PRIORITY:
+			if (sid == 0)
+				return goaway(h, E_PROTOCOL);
+			if (len != 5)
+				put_rst(h, sid, E_FRAME_SIZE);
+			break;   // 優先度は使わない（全部同じ重みで順に回す）
+		case F_RST_STREAM:
+			on_rst_stream(h, sid, len);
+			break;
+		case F_SETTINGS:
+			on_settings(h, sid, flags, p, len);
+			break;
+		case F_PUSH_PROMISE:
+			goaway(h, E_PROTOCOL);   // クライアントは push しない
+			break;
+		case F_PING:
+			if (sid != 0)
+				return goaway(h, E_PROTOCOL);
+			if (len != 8)
+				return goaway(h, E_FRAME_SIZE);
+			if (!(flags & FL_ACK))
+				put_frame(h, F_PING, FL_ACK, 0, p, 8);
+			break;
+		case F_GOAWAY:
+			if (sid != 0)
+				return goaway(h, E_PROTOCOL);
+			// 新しいストリームは受けず、いまあるものを返し終えたら閉じる
+			h->goaway_recv = 1;
+			break;
+		case F_WINDOW_UPDATE:
+			on_window_update(h, sid, p, len);
+			break;
+		default:
+			break;   // 知らない種類は読み飛ばす
+	}
+}
+
+char	*h2_rbuf(t_h2 *h, size_t *room)
+{
+	*room = sizeof(h->in) - h->inlen;
+	return (char *)h->in + h->inlen;
+}
+
+void	h2_feed(t_h2 *h, size_t n)
+{
+	size_t off = 0;
+
+	h->inlen += n;
+	while (!h->goaway_sent && !h->fatal && h->inlen - off >= 9)
+	{
+		const unsigned char	*f = h->in + off;
+		size_t				len = ((size_t)f[0] << 16) | ((size_t)f[1] << 8) | f[2];
+
+		if (len > H2_FRAME_MAX)
+		{
+			goaway(h, E_FRAME_SIZE);
+			break;
+		}
+		if (h->inlen - off < 9 + len)
+			break;
+		on_frame(h, f[3], f[4], get32(f + 5) & 0x7fffffffu, f + 9, len);
+		off += 9 + len;
+	}
+	memmove(h->in, h->in + off, h->inlen - off);
+	h->inlen -= off;
+}
+
+// :status / content-type / content-length と resp->extra の行を HEADERS にする
+static int	encode_headers(t_h2 *h, t_h2stream *s, unsigned char *dst, size_t room)
+{
+	t_resp		*resp = &s->resp;
+	char		num[24];
+	int			k = 0;
+	int			w;
+	const char	*ctype = resp->ctype ? resp->ctype : "text/plain";
+
+	if (h->enc_resize)
+	{
+		if ((k = hpack_encode_size(dst, room, h->enc.max)) < 0)
+			return -1;
+		h->enc_resize = 0;
+	}
+	snprintf(num, sizeof(num), "%03d", resp->status);
+	if ((w = hpack_encode(&h->enc, dst + k, room - (size_t)k, ":status", 7, num, 3, 1)) < 0)
+		return -1;
+	k += w;
+	if ((w = hpack_encode(&h->enc, dst + k, room - (size_t)k, "content-type", 12, ctype, strlen(ctype), 1)) < 0)
+		return -1;
+	k += w;
+	w = snprintf(num, sizeof(num), "%zu", resp->file_fd >= 0 ? resp->file_len : resp->body_len);
+	// 長さは応答ごとに違うので表には入れない
+	if ((w = hpack_encode(&h->enc, dst + k, room - (size_t)k, "content-length", 14, num, (size_t)w, 0)) < 0)
+		return -1;
+	k += w;
+	for (const char *l = resp->extra; l && *l; )
+	{
+		const char	*eol = strstr(l, "\r\n");
+		const char	*colon = memchr(l, ':', eol ? (size_t)(eol - l) : strlen(l));
+		const char	*v;
+		char		name[64];
+		size_t		nlen;
+
+		if (!eol || !colon || (nlen = (size_t)(colon - l)) >= sizeof(name))
+			break;
+		// HTTP/2 のヘッダ名は小文字
+		for (size_t i = 0; i < nlen; i++)
+			name[i] = (char)tolower((unsigned char)l[i]);
+		for (v = colon + 1; v < eol && *v == ' '; v++)
+			;
+		if ((w = hpack_encode(&h->enc, dst + k, room - (size_t)k, name, nlen, v, (size_t)(eol - v), 1)) < 0)
+			return -1;
+		k += w;
+		l = eol + 2;
+	}
+	return k;
+}
+
+int	h2_respond(t_h2stream *s)
+{
+	t_h2			*h = s->h2;
+	unsigned char	*p;
+	int				k;
+
+	if (s->pooled)
+	{
+		s->pooled = 0;
+		h->npooled--;
+	}
+	if (h->dead)
+	{
+		stream_free(h, s);
+		if (h->npooled == 0)
+			destroy(h);
+		return 0;
+	}
+	if (s->reset)
+	{
+		stream_free(h, s);
+		return 1;
+	}
+	s->blen = s->head_only ? 0 : (s->resp.file_fd >= 0 ? s->resp.file_len : s->resp.body_len);
+	s->boff = 0;
+	if ((p = out_reserve(h, 9 + 1024)) == NULL)
+		return 1;
+	if ((k = encode_headers(h, s, p + 9, 1024)) < 0)
+	{
+		// 表に入れかけたものが相手とずれるので、接続ごと終える
+		goaway(h, E_INTERNAL);
+		stream_free(h, s);
+		return 1;
+	}
+	frame_head(p, (size_t)k, F_HEADERS, FL_END_HEADERS | (s->blen == 0 ? FL_END_STREAM : 0), s->id);
+	h->olen += 9 + (size_t)k;
+	if (s->blen == 0)
+		stream_free(h, s);
+	else
+		ready_push(h, s);
+	return 1;
+}
+
+// 準備のできたストリームを 1 フレームずつ順に回して DATA を詰める
+static void	pump(t_h2 *h)
+{
+	t_h2stream *s;
+
+	while (h->olen - h->ooff < OUT_LOW && h->send_window > 0 && (s = ready_pop(h)) != NULL)
+	{
+		size_t			n = s->blen - s->boff;
+		unsigned char	*p;
+		int				end;
+
+		if (s->reset)
+		{
+			stream_free(h, s);
+			continue;
+		}
+		if (s->send_window <= 0)
+		{
+			s->blocked = 1;
+			continue;
+		}
+		if ((int64_t)n > h->send_window)
+			n = (size_t)h->send_window;
+		if ((int64_t)n > s->send_window)
+			n = (size_t)s->send_window;
+		if (n > H2_FRAME_MAX)
+			n = H2_FRAME_MAX;
+		if ((p = out_reserve(h, 9 + n)) == NULL)
+			return;
+		if (s->resp.file_fd >= 0)
+		{
+			if (pread(s->resp.file_fd, p + 9, n, (off_t)s->boff) != (ssize_t)n)
+			{
+				put_rst(h, s->id, E_INTERNAL);
+				stream_free(h, s);
+				continue;
+			}
+		}
+		else
+			memcpy(p + 9, s->resp.body + s->boff, n);
+		s->boff += n;
+		end = (s->boff == s->blen);
+		frame_head(p, n, F_DATA, end ? FL_END_STREAM : 0, s->id);
+		h->olen += 9 + n;
+		h->send_window -= (int64_t)n;
+		s->send_window -= (int64_t)n;
+		if (end)
+			stream_free(h, s);
+		else
+			ready_push(h, s);
+	}
+}
+
+const char	*h2_out(t_h2 *h, size_t *len)
+{
+	pump(h);
+	*len = h->olen - h->ooff;
+	return (const char *)h->out + h->ooff;
+}
+
+void	h2_sent(t_h2 *h, size_t n)
+{
+	h->ooff += n;
+	if (h->ooff == h->olen)
+		h->ooff = h->olen = 0;
+}
+
+int	h2_want_read(const t_h2 *h)
+{
+	return !h->goaway_sent && h->olen - h->ooff < OUT_HIGH;
+}
+
+int	h2_finished(const t_h2 *h)
+{
+	if (h->fatal)
+		return 1;
+	if (h->olen != h->ooff)
+		return 0;
+	return h->goaway_sent || (h->goaway_recv && h->nstreams == 0);
+}
@@ -0,0 +1,85 @@
+#ifndef H2_H
+#define H2_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hpack.h"
+#include "http.h"
+#include "wpool.h"
+
+/*
+ * HTTP/2（RFC 9113）の cleartext 版 h2c を prior knowledge で（TLS も "Upgrade: h2c" も無し）
+ *
+ * ここは I/O をしない。http.c が読んだバイト列を h2_feed に渡し、h2_out で取り出したものを書く。
+ * リクエストが揃った（END_STREAM まで来た）ストリームは on_request で http.c に渡し、http.c が
+ * HTTP/1.1 と同じハンドラを（I/O ループの中かワーカープールで）呼んで、終わったら h2_respond で返す。
+ * on_request はプールに回したら 1、その場で h2_respond まで済ませたら 0 を返す。
+ *
+ * 応答の DATA は、送れる窓（接続とストリーム）の分だけ、準備のできたストリームを 1 フレームずつ
+ * 順に回して詰めるので、大きな応答の後ろで小さな応答が待たされない。
+ * 受ける側の窓は、本文をメモリに貯める（上限 H2_BODY_MAX）たびに WINDOW_UPDATE で戻す。
+ */
+
+#define H2_PREFACE      "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"
+#define H2_PREFACE_LEN  24
+#define H2_FRAME_MAX    16384         // 受ける・送るフレームの本体（SETTINGS_MAX_FRAME_SIZE の既定）
+#define H2_STREAMS_MAX  100           // SETTINGS_MAX_CONCURRENT_STREAMS
+#define H2_PATH_MAX     2048
+#define H2_HEAD_MAX     8192          // 1 リクエストのヘッダ（"name: value\r\n" に直した長さ）
+#define H2_BODY_MAX     (16u << 20)   // 1 リクエストの本文
+
+typedef struct s_h2	t_h2;
+
+typedef struct s_h2stream
+{
+	t_job				job;        // 先頭に置く（プールから返ってきた job をそのまま stream として扱う）
+	t_h2				*h2;
+	t_route				*rt;        // ここから rc までは http.c が使う
+	int					rc;
+	int					answered;   // h2.c がもう応答を入れた（413 / 431 など。振り分けない）
+	t_req				req;
+	t_resp				resp;
+	// ここから下は h2.c の中だけで使う
+	uint32_t			id;
+	int					state;
+	int					pooled;
+	int					queued;     // DATA を送る列に並んでいる
+	int					blocked;    // ストリームの送る窓が 0 で列から外れている
+	int					reset;      // RST_STREAM を受けた・送った（返ってきたら・列から出たら消す）
+	int					head_only;
+	int64_t				send_window;
+	int64_t				recv_window;
+	size_t				blen;       // 送る本文
+	size_t				boff;
+	char				*body;      // 受けた本文
+	size_t				body_len;
+	size_t				body_cap;
+	int					too_big;
+	size_t				hlen;
+	struct s_h2stream	*prev;
+	struct s_h2stream	*next;
+	struct s_h2stream	*rnext;
+	char				path[H2_PATH_MAX];
+	char				head[H2_HEAD_MAX];
+}	t_h2stream;
+
+// 接続の最初のサーバ側 SETTINGS と WINDOW_UPDATE を積んだ状態で返す。NULL: メモリが無い
+t_h2		*h2_new(void *ctx, int (*on_request)(void *ctx, t_h2stream *s));
+void		*h2_ctx(const t_h2 *h);
+// 読み込み先（room バイトまで）。読んだら h2_feed で n バイトを処理する
+char		*h2_rbuf(t_h2 *h, size_t *room);
+void		h2_feed(t_h2 *h, size_t n);
+// ハンドラの終わったストリームの応答を積む。接続がもう閉じていればストリームを捨てて 0、あれば 1
+int			h2_respond(t_h2stream *s);
+// 書くもの（無ければ *len が 0）。呼ぶたびに、窓の許す分の DATA を詰め足す
+const char	*h2_out(t_h2 *h, size_t *len);
+void		h2_sent(t_h2 *h, size_t n);
+// 読んでよいか（GOAWAY を送ったあとや、書けずに溜まっているあいだは読まない）
+int			h2_want_read(const t_h2 *h);
+// 閉じてよいか（GOAWAY を送って書き終えた / 受けて全部返した）
+int			h2_finished(const t_h2 *h);
+// http.c が接続を閉じる。プールで動いているストリームがあれば、全部返ってきてから消える
+void		h2_free(t_h2 *h);
+
+#endif
@@ -0,0 +1,289 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "handlers.h"
+#include "http.h"
+
+#define SLOW_MAX_MS 10000
+#define BLOB_MAX    (16u << 20)   // /blob と /report の上限
+#define BLOB_DEFAULT (1u << 20)
+
+// /blob が返すキャッシュ（起動時に 1 度だけ作り、止まるまで書き換えない）
+static char	*g_blob;
+
+static int	h_hello(t_req *req, t_resp *resp, void *arg)
+{
+	static const char body[] = "hello, world!\n";
+
+	(void)req;
+	(void)arg;
+	resp->status = 200;
+	resp->ctype = "text/plain";
+	resp->body = body;
+	resp->body_len = sizeof(body) - 1;
+	return 0;
+}
+
+static int	h_health(t_req *req, t_resp *resp, void *arg)
+{
+	(void)req;
+	(void)arg;
+	return resp_printf(resp, 200, "ok\n");
+}
+
+static int	h_metrics(t_req *req, t_resp *resp, void *arg)
+{
+	const uint64_t		*st = http_status_counts();
+	size_t				n;
+	const t_route *const *rt = http_routes(&n);
+	size_t				k = 0;
+	int					w;
+
+	(void)req;
+	(void)arg;
+	for (int c = 1; c <= 5; c++)
+	{
+		w = snprintf(resp->buf + k, sizeof(resp->buf) - k,
+			"minihttpd_responses_total{code=\"%dxx\"} %llu\n", c, (unsigned long long)st[c]);
+		if (w < 0 || (size_t)w >= sizeof(resp->buf) - k)
+			break;
+		k += (size_t)w;
+	}
+	// ルートが多いと入りきらないので、1 回も呼ばれていないものは出さない
+	for (size_t i = 0; i < n; i++)
+	{
+		if (rt[i]->hits == 0)
+			continue;
+		w = snprintf(resp->buf + k, sizeof(resp->buf) - k, "minihttpd_route_hits_total{route=\"%s%s\"} %llu\n",
+			rt[i]->path, rt[i]->kind == ROUTE_PREFIX ? "*" : "", (unsigned long long)rt[i]->hits);
+		if (w < 0 || (size_t)w >= sizeof(resp->buf) - k)
+			break;
+		k += (size_t)w;
+	}
+	{
+		const t_zc_stats *zs = http_zerocopy_stats();
+		w = snprintf(resp->buf + k, sizeof(resp->buf) - k,
+			"minihttpd_zerocopy_sends_total %llu\nminihttpd_zerocopy_bytes_total %llu\n"
+			"minihttpd_zerocopy_copied_total %llu\nminihttpd_zerocopy_fallbacks_total %llu\n",
+			(unsigned long long)zs->sends, (unsigned long long)zs->bytes,
+			(unsigned long long)zs->copied, (unsigned long long)zs->fallbacks);
+		if (w > 0 && (size_t)w < sizeof(resp->buf) - k)
+			k += (size_t)w;
+	}
+	if (http_ratelimit())
+	{
+		const t_rlimit *rl = http_ratelimit();
+		w = snprintf(resp->buf + k, sizeof(resp->buf) - k,
+			"minihttpd_ratelimited_total %llu\nminihttpd_ratelimit_clients %llu\n"
+			"minihttpd_ratelimit_reused_total %llu\nminihttpd_ratelimit_overflow_total %llu\n",
+			(unsigned long long)__atomic_load_n(&rl->limited, __ATOMIC_RELAXED),
+			(unsigned long long)__atomic_load_n(&rl->clients, __ATOMIC_RELAXED),
+			(unsigned long long)__atomic_load_n(&rl->reused, __ATOMIC_RELAXED),
+			(unsigned long long)__atomic_load_n(&rl->overflow, __ATOMIC_RELAXED));
+		if (w > 0 && (size_t)w < sizeof(resp->buf) - k)
+			k += (size_t)w;
+	}
+	resp->status = 200;
+	resp->ctype = "text/plain; version=0.0.4";
+	resp->body = resp->buf;
+	resp->body_len = k;
+	return 0;
+}
+
+static const char	*mime_type(const char *path, size_t n)
+{
+	static const struct { const char *ext; const char *type; } tab[] = {
+		{".html", "text/html"}, {".css", "text/css"}, {".js", "text/javascript"},
+		{".json", "application/json"}, {".txt", "text/plain"}, {".png", "image/png"},
+		{".svg", "image/svg+xml"},
+	};
+
+	for (size_t i = 0; i < sizeof(tab) / sizeof(tab[0]); i++)
+	{
+		size_t el = strlen(tab[i].ext);
+		if (n >= el && memcmp(path + n - el, tab[i].ext, el) == 0)
+			return tab[i].type;
+	}
+	return "application/octet-stream";
+}
+
+// prefix の後ろを static_dir の下のファイルとして開く。".." の段を含むものは外へ出られるので断る。
+// 開けたら fd、だめなら resp に 403 / 404 を入れて -1
+static int	open_under(const char *dir, const t_req *req, size_t prefix_len, t_resp *resp, struct stat *st)
+{
+	const char	*rel = req->path + prefix_len;
+	size_t		rlen = req->path_len - prefix_len;
+	char		path[PATH_MAX];
+	int			fd;
+
+	if (rlen == 0)
+		return resp_printf(resp, 404, "not found\n"), -1;
+	for (size_t i = 0; i + 1 < rlen; i++)
+		if (rel[i] == '.' && rel[i + 1] == '.' && (i == 0 || rel[i - 1] == '/')
+			&& (i + 2 == rlen || rel[i + 2] == '/'))
+			return resp_printf(resp, 403, "forbidden\n"), -1;
+	if (memchr(rel, '\0', rlen) || snprintf(path, sizeof(path), "%s/%.*s", dir, (int)rlen, rel) >= (int)sizeof(path))
+		return resp_printf(resp, 404, "not found\n"), -1;
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+		return resp_printf(resp, 404, "not found\n"), -1;
+	if (fstat(fd, st) != 0 || !S_ISREG(st->st_mode))
+	{
+		close(fd);
+		return resp_printf(resp, 404, "not found\n"), -1;
+	}
+	return fd;
+}
+
+static int	h_static(t_req *req, t_resp *resp, void *arg)
+{
+	struct stat	st;
+	int			fd = open_under(arg, req, strlen("/static/"), resp, &st);
+
+	if (fd < 0)
+		return 0;
+	resp->status = 200;
+	resp->ctype = mime_type(req->path, req->path_len);
+	resp->file_fd = fd;
+	resp->file_len = (size_t)st.st_size;
+	return 0;
+}
+
+// ファイルを読んで FNV-1a 64 を返す（ディスク I/O と CPU を使う。プールで動かす）
+static int	h_hash(t_req *req, t_resp *resp, void *arg)
+{
+	struct stat	st;
+	int			fd = open_under(arg, req, strlen("/hash/"), resp, &st);
+	uint64_t	h = 1469598103934665603ull;
+	size_t		total = 0;
+	ssize_t		n;
+
+	if (fd < 0)
+		return 0;
+	// 読む先は resp->buf を借りる（結果を書く前なので上書きしてよい）
+	while ((n = read(fd, resp->buf, sizeof(resp->buf))) > 0)
+	{
+		for (ssize_t i = 0; i < n; i++)
+			h = (h ^ (unsigned char)resp->buf[i]) * 1099511628211ull;
+		total += (size_t)n;
+	}
+	close(fd);
+	if (n < 0)
+		return -1;
+	return resp_printf(resp, 200, "fnv1a64 %016llx %zu\n", (unsigned long long)h, total);
+}
+
+// ?ms=N だけ眠ってから返す（遅いバックエンドを待つハンドラの代わり。プールで動かす）
+static int	h_slow(t_req *req, t_resp *resp, void *arg)
+{
+	long			ms = 100;
+	struct timespec	ts;
+
+	(void)arg;
+	if (req->query_len > 3 && strncmp(req->query, "ms=", 3) == 0)
+		ms = strtol(req->query + 3, NULL, 10);
+	if (ms < 0 || ms > SLOW_MAX_MS)
+		return resp_printf(resp, 400, "ms must be 0..%d\n", SLOW_MAX_MS);
+	ts.tv_sec = ms / 1000;
+	ts.tv_nsec = (ms % 1000) * 1000000L;
+	while (nanosleep(&ts, &ts) != 0)
+		;
+	return resp_printf(resp, 200, "slept %ld ms\n", ms);
+}
+
+// ?size=N（既定 1 MiB）の大きさを読む。範囲外なら resp に 400 を入れて -1
+static int	query_size(const t_req *req, t_resp *resp, size_t *n)
+{
+	long v = BLOB_DEFAULT;
+
+	if (req->query_len > 5 && strncmp(req->query, "size=", 5) == 0)
+		v = strtol(req->query + 5, NULL, 10);
+	if (v < 0 || v > (long)BLOB_MAX)
+		return resp_printf(resp, 400, "size must be 0..%u\n", BLOB_MAX), -1;
+	*n = (size_t)v;
+	return 0;
+}
+
+// キャッシュ済みの塊の先頭 size バイト（コピーせずに body で指す）
+static int	h_blob(t_req *req, t_resp *resp, void *arg)
+{
+	size_t n;
+
+	(void)arg;
+	if (query_size(req, resp, &n) != 0)
+		return 0;
+	resp->status = 200;
+	resp->ctype = "application/octet-stream";
+	resp->body = g_blob;
+	resp->body_len = n;
+	return 0;
+}
+
+// リクエストごとに組み立てる本文（malloc したものを送り終えてから free する。プールで動かす）
+static int	h_report(t_req *req, t_resp *resp, void *arg)
+{
+	size_t	n;
+	size_t	k = 0;
+	char	*p;
+
+	(void)arg;
+	if (query_size(req, resp, &n) != 0)
+		return 0;
+	if ((p = malloc(n + 1)) == NULL)
+		return -1;
+	// 1 行 32 バイト（番号 + 埋め草）。最後の行は切れる
+	while (k < n)
+	{
+		int w = snprintf(p + k, n + 1 - k, "%010zu ....................\n", k / 32);
+		if (w < 0)
+			break;
+		k += ((size_t)w < n - k) ? (size_t)w : n - k;
+	}
+	resp->status = 200;
+	resp->ctype = "text/plain";
+	resp->body = p;
+	resp->body_len = n;
+	resp->body_free = free;
+	resp->body_owner = p;
+	return 0;
+}
+
+static int	h_upload(t_req *req, t_resp *resp, void *arg)
+{
+	size_t	total = 0;
+	ssize_t	n;
+
+	(void)arg;
+	// 本文は resp->buf を借りて読み捨てる（返す本文を書く前なので上書きしてよい）
+	while ((n = http_read_body(req, resp->buf, sizeof(resp->buf))) > 0)
+		total += (size_t)n;
+	if (n < 0 || total != req->content_length)
+		return resp_printf(resp, 400, "short body: %zu of %zu bytes\n", total, req->content_length);
+	return resp_printf(resp, 200, "received %zu bytes\n", total);
+}
+
+int	handlers_register(const char *static_dir)
+{
+	if (!g_blob && (g_blob = malloc(BLOB_MAX)) == NULL)
+		return -1;
+	for (size_t i = 0; i < BLOB_MAX; i++)
+		g_blob[i] = (char)('a' + i % 26);
+	if (http_route(HTTP_GET, "/", ROUTE_EXACT, HTTP_INLINE, h_hello, NULL) != 0
+		|| http_route(HTTP_GET, "/health", ROUTE_EXACT, HTTP_INLINE, h_health, NULL) != 0
+		|| http_route(HTTP_GET, "/metrics", ROUTE_EXACT, HTTP_INLINE, h_metrics, NULL) != 0
+		|| http_route(HTTP_GET, "/static/", ROUTE_PREFIX, HTTP_INLINE, h_static, (void *)static_dir) != 0
+		|| http_route(HTTP_GET, "/hash/", ROUTE_PREFIX, HTTP_POOL, h_hash, (void *)static_dir) != 0
+		|| http_route(HTTP_GET, "/slow", ROUTE_EXACT, HTTP_POOL, h_slow, NULL) != 0
+		|| http_route(HTTP_GET, "/blob", ROUTE_EXACT, HTTP_INLINE, h_blob, NULL) != 0
+		|| http_route(HTTP_GET, "/report", ROUTE_EXACT, HTTP_POOL, h_report, NULL) != 0
+		|| http_route(HTTP_POST, "/upload", ROUTE_EXACT, HTTP_POOL, h_upload, NULL) != 0)
+		return -1;
+	return 0;
+}
@@ -0,0 +1,22 @@
+#ifndef HANDLERS_H
+#define HANDLERS_H
+
+/*
+ * 組み込みのエンドポイント
+ *
+ *   GET  /          "hello, world!"
+ *   GET  /health    "ok"
+ *   GET  /metrics   リクエスト数（ステータスクラス別・ルート別）を Prometheus のテキスト形式で
+ *   GET  /static/   static_dir の下のファイル（".." を含むパスは 403）
+ *   GET  /hash/     static_dir の下のファイルの FNV-1a 64（ワーカープール）
+ *   GET  /slow      ?ms=N（既定 100）だけ眠ってから返す（ワーカープール）
+ *   GET  /blob      ?size=N（既定 1 MiB）バイトを起動時に作ったキャッシュからコピーせずに返す
+ *   GET  /report    ?size=N バイトの本文を毎回組み立てて返す（ワーカープール。送り終えたら free）
+ *   POST /upload    本文を読み捨て、受け取ったバイト数を返す（ワーカープール）
+ *
+ * static_dir はコピーせずに持つので、サーバが止まるまで生きている文字列を渡す。
+ * http_routes_compile の前に呼ぶ。0 / -1
+ */
+int	handlers_register(const char *static_dir);
+
+#endif
@@ -0,0 +1,438 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "hpack.h"
+
+// RFC 7541 Appendix A（番号は添字 + 1）
+static const struct
+{
+	const char	*name;
+	size_t		nlen;
+	const char	*value;
+	size_t		vlen;
+}	g_static[] = {
+	{":authority", 10, "", 0},
+	{":method", 7, "GET", 3},
+	{":method", 7, "POST", 4},
+	{":path", 5, "/", 1},
+	{":path", 5, "/index.html", 11},
+	{":scheme", 7, "http", 4},
+	{":scheme", 7, "https", 5},
+	{":status", 7, "200", 3},
+	{":status", 7, "204", 3},
+	{":status", 7, "206", 3},
+	{":status", 7, "304", 3},
+	{":status", 7, "400", 3},
+	{":status", 7, "404", 3},
+	{":status", 7, "500", 3},
+	{"accept-charset", 14, "", 0},
+	{"accept-encoding", 15, "gzip, deflate", 13},
+	{"accept-language", 15, "", 0},
+	{"accept-ranges", 13, "", 0},
+	{"accept", 6, "", 0},
+	{"access-control-allow-origin", 27, "", 0},
+	{"age", 3, "", 0},
+	{"allow", 5, "", 0},
+	{"authorization", 13, "", 0},
+	{"cache-control", 13, "", 0},
+	{"content-disposition", 19, "", 0},
+	{"content-encoding", 16, "", 0},
+	{"content-language", 16, "", 0},
+	{"content-length", 14, "", 0},
+	{"content-location", 16, "", 0},
+	{"content-range", 13, "", 0},
+	{"content-type", 12, "", 0},
+	{"cookie", 6, "", 0},
+	{"date", 4, "", 0},
+	{"etag", 4, "", 0},
+	{"expect", 6, "", 0},
+	{"expires", 7, "", 0},
+	{"from", 4, "", 0},
+	{"host", 4, "", 0},
+	{"if-match", 8, "", 0},
+	{"if-modified-since", 17, "", 0},
+	{"if-none-match", 13, "", 0},
+	{"if-range", 8, "", 0},
+	{"if-unmodified-since", 19, "", 0},
+	{"last-modified", 13, "", 0},
+	{"link", 4, "", 0},
+	{"location", 8, "", 0},
+	{"max-forwards", 12, "", 0},
+	{"proxy-authenticate", 18, "", 0},
+	{"proxy-authorization", 19, "", 0},
+	{"range", 5, "", 0},
+	{"referer", 7, "", 0},
+	{"refresh", 7, "", 0},
+	{"retry-after", 11, "", 0},
+	{"server", 6, "", 0},
+	{"set-cookie", 10, "", 0},
+	{"strict-transport-security", 25, "", 0},
+	{"transfer-encoding", 17, "", 0},
+	{"user-agent", 10, "", 0},
+	{"vary", 4, "", 0},
+	{"via", 3, "", 0},
+	{"www-authenticate", 16, "", 0},
+};
+
+#define NSTATIC (sizeof(g_static) / sizeof(g_static[0]))
+
+// RFC 7541 Appendix B の符号の長さ（256 は EOS）。符号は canonical Huffman なので長さだけで決まる
+static const unsigned char	g_hlen[257] = {
+	13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+	28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+	6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+	5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+	13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+	7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+	15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+	6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+	20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+	24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+	22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+	21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+	26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+	19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+	20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+	26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+	30,
+};
+
+// 長さごとの最初の符号・個数・g_sym の中の位置（huff_build で作る）
+static uint32_t	g_first[31];
+static uint16_t	g_count[31];
+static uint16_t	g_off[31];
+static uint16_t	g_sym[257];
+static int		g_huff_ready;
+
+static void	huff_build(void)
+{
+	uint32_t	code = 0;
+	uint16_t	k = 0;
+
+	for (int len = 1; len <= 30; len++)
+	{
+		g_first[len] = code;
+		g_off[len] = k;
+		for (int s = 0; s < 257; s++)
+			if (g_hlen[s] == len)
+				g_sym[k++] = (uint16_t)s;
+		g_count[len] = (uint16_t)(k - g_off[len]);
+		code = (code + g_count[len]) << 1;
+	}
+	g_huff_ready = 1;
+}
+
+// 1 ビットずつ読み、長さ len の符号の範囲に入ったら 1 文字
+static int	huff_decode(const unsigned char *s, size_t n, char *dst, size_t room, size_t *len)
+{
+	uint32_t	code = 0;
+	int			clen = 0;
+	size_t		k = 0;
+
+	for (size_t i = 0; i < n; i++)
+	{
+		for (int b = 7; b >= 0; b--)
+		{
+			code = (code << 1) | ((s[i] >> b) & 1u);
+			clen++;
+			if (code - g_first[clen] < g_count[clen])
+			{
+				uint16_t sym = g_sym[g_off[clen] + code - g_first[clen]];
+				// EOS を文字として含めてはいけない
+				if (sym == 256 || k >= room)
+					return -1;
+				dst[k++] = (char)sym;
+				code = 0;
+				clen = 0;
+			}
+			else if (clen == 30)
+				return -1;
+		}
+	}
+	// 端数は EOS の頭（すべて 1）で、7 ビットまで
+	if (clen > 7 || code != (1u << clen) - 1)
+		return -1;
+	*len = k;
+	return 0;
+}
+
+// nbits のプレフィックスに入る整数（RFC 7541 5.1）
+static int	int_decode(const unsigned char **p, const unsigned char *end, int nbits, size_t *out)
+{
+	size_t	mask = ((size_t)1 << nbits) - 1;
+	size_t	v;
+	int		shift = 0;
+
+	if (*p >= end)
+		return -1;
+	v = *(*p)++ & mask;
+	if (v < mask)
+		return *out = v, 0;
+	for (;;)
+	{
+		unsigned char b;
+
+		// 大きすぎる値（2^28 を超えるもの）は長さとしても番号としても使えないので断る
+		if (*p >= end || shift > 21)
+			return -1;
+		b = *(*p)++;
+		v += (size_t)(b & 0x7f) << shift;
+		shift += 7;
+		if (!(b & 0x80))
+			break;
+	}
+	*out = v;
+	return 0;
+}
+
+static int	int_encode(unsigned char *dst, size_t room, int nbits, unsigned char flags, size_t v)
+{
+	size_t	mask = ((size_t)1 << nbits) - 1;
+	size_t	k = 0;
+
+	if (room == 0)
+		return -1;
+	if (v < mask)
+	{
+		dst[0] = (unsigned char)(flags | v);
+		return 1;
+	}
+	dst[k++] = (unsigned char)(flags | mask);
+	v -= mask;
+	for (; v >= 128; v >>= 7)
+	{
+		if (k >= room)
+			return -1;
+		dst[k++] = (unsigned char)((v & 0x7f) | 0x80);
+	}
+	if (k >= room)
+		return -1;
+	dst[k++] = (unsigned char)v;
+	return (int)k;
+}
+
+static int	str_decode(const unsigned char **p, const unsigned char *end, char *dst, size_t room, size_t *len)
+{
+	int		huff = (*p < end) && (**p & 0x80);
+	size_t	n;
+
+	if (int_decode(p, end, 7, &n) != 0 || (size_t)(end - *p) < n)
+		return -1;
+	if (huff)
+	{
+		if (huff_decode(*p, n, dst, room, len) != 0)
+			return -1;
+	}
+	else
+	{
+		if (n > room)
+			return -1;
+		memcpy(dst, *p, n);
+		*len = n;
+	}
+	*p += n;
+	return 0;
+}
+
+static int	str_encode(unsigned char *dst, size_t room, const char *s, size_t n)
+{
+	int k = int_encode(dst, room, 7, 0x00, n);
+
+	if (k < 0 || room - (size_t)k < n)
+		return -1;
+	memcpy(dst + k, s, n);
+	return k + (int)n;
+}
+
+static t_hpent	*dyn(t_hpack *t, size_t i)
+{
+	return &t->ent[(t->head + i) % HPACK_ENTRIES_MAX];
+}
+
+static void	evict(t_hpack *t)
+{
+	t_hpent *e = dyn(t, t->n - 1);
+
+	t->size -= e->nlen + e->vlen + 32;
+	free(e->name);
+	t->n--;
+}
+
+void	hpack_init(t_hpack *t, size_t limit)
+{
+	if (!g_huff_ready)
+		huff_build();
+	memset(t, 0, sizeof(*t));
+	t->max = limit;
+	t->limit = limit;
+}
+
+void	hpack_free(t_hpack *t)
+{
+	while (t->n > 0)
+		evict(t);
+}
+
+void	hpack_resize(t_hpack *t, size_t max)
+{
+	t->max = max;
+	while (t->size > t->max)
+		evict(t);
+}
+
+// 先頭（62 番）に入れる。大きすぎるものは表を空にするだけ（RFC 7541 4.4）
+static t_hpent	*insert(t_hpack *t, const char *name, size_t nlen, const char *value, size_t vlen)
+{
+	size_t	sz = nlen + vlen + 32;
+	char	*p;
+	t_hpent	*e;
+
+	if (sz > t->max)
+	{
+		while (t->n > 0)
+			evict(t);
+		return NULL;
+	}
+	// 名前が追い出される側を指していることがあるので、先に写してから追い出す
+	if ((p = malloc(nlen + vlen + 1)) == NULL)
+		return NULL;
+	memcpy(p, name, nlen);
+	memcpy(p + nlen, value, vlen);
+	while (t->size + sz > t->max)
+		evict(t);
+	t->head = (t->head + HPACK_ENTRIES_MAX - 1) % HPACK_ENTRIES_MAX;
+	t->n++;
+	t->size += sz;
+	e = dyn(t, 0);
+	*e = (t_hpent){p, nlen, p + nlen, vlen};
+	return e;
+}
+
+static int	lookup(t_hpack *t, size_t idx, t_hpfield *f)
+{
+	if (idx >= 1 && idx <= NSTATIC)
+	{
+		*f = (t_hpfield){g_static[idx - 1].name, g_static[idx - 1].nlen,
+			g_static[idx - 1].value, g_static[idx - 1].vlen};
+		return 0;
+	}
+	if (idx > NSTATIC && idx - NSTATIC - 1 < t->n)
+	{
+		t_hpent *e = dyn(t, idx - NSTATIC - 1);
+		*f = (t_hpfield){e->name, e->nlen, e->value, e->vlen};
+		return 0;
+	}
+	return -1;
+}
+
+int	hpack_decode(t_hpack *t, const unsigned char **p, const unsigned char *end,
+		char *scratch, size_t n, t_hpfield *f)
+{
+	size_t	idx;
+
+	for (;;)
+	{
+		unsigned char	b;
+		int				incr;
+
+		if (*p >= end)
+			return 0;
+		b = **p;
+		if (b & 0x80)
+		{
+			// 表の番号だけ
+			if (int_decode(p, end, 7, &idx) != 0 || idx == 0 || lookup(t, idx, f) != 0)
+				return -1;
+			return 1;
+		}
+		if ((b & 0xe0) == 0x20)
+		{
+			// 動的テーブルのサイズ更新
+			if (int_decode(p, end, 5, &idx) != 0 || idx > t->limit)
+				return -1;
+			hpack_resize(t, idx);
+			continue;
+		}
+		// 表に入れる (01) / 入れない (0000) / 決して入れない (0001) リテラル
+		incr = ((b & 0xc0) == 0x40);
+		if (int_decode(p, end, incr ? 6 : 4, &idx) != 0)
+			return -1;
+		if (idx != 0)
+		{
+			if (lookup(t, idx, f) != 0)
+				return -1;
+		}
+		else
+		{
+			if (str_decode(p, end, scratch, n, &f->nlen) != 0)
+				return -1;
+			f->name = scratch;
+		}
+		{
+			size_t used = (f->name == scratch) ? f->nlen : 0;
+
+			if (str_decode(p, end, scratch + used, n - used, &f->vlen) != 0)
+				return -1;
+			f->value = scratch + used;
+		}
+		if (incr)
+		{
+			t_hpent *e = insert(t, f->name, f->nlen, f->value, f->vlen);
+
+			if (e)
+				*f = (t_hpfield){e->name, e->nlen, e->value, e->vlen};
+			else if (f->nlen + f->vlen + 32 <= t->max)
+				return -1;   // malloc に失敗した（表が相手とずれる）
+		}
+		return 1;
+	}
+}
+
+int	hpack_encode(t_hpack *t, unsigned char *dst, size_t room,
+		const char *name, size_t nlen, const char *value, size_t vlen, int index)
+{
+	size_t	nidx = 0;
+	int		k;
+	int		w;
+
+	for (size_t i = 0; i < NSTATIC; i++)
+	{
+		if (g_static[i].nlen != nlen || memcmp(g_static[i].name, name, nlen) != 0)
+			continue;
+		if (g_static[i].vlen == vlen && memcmp(g_static[i].value, value, vlen) == 0)
+			return int_encode(dst, room, 7, 0x80, i + 1);
+		if (nidx == 0)
+			nidx = i + 1;
+	}
+	for (size_t i = 0; i < t->n; i++)
+	{
+		t_hpent *e = dyn(t, i);
+
+		if (e->nlen != nlen || memcmp(e->name, name, nlen) != 0)
+			continue;
+		if (e->vlen == vlen && memcmp(e->value, value, vlen) == 0)
+			return int_encode(dst, room, 7, 0x80, NSTATIC + 1 + i);
+		if (nidx == 0)
+			nidx = NSTATIC + 1 + i;
+	}
+	if ((k = int_encode(dst, room, index ? 6 : 4, index ? 0x40 : 0x00, nidx)) < 0)
+		return -1;
+	if (nidx == 0)
+	{
+		if ((w = str_encode(dst + k, room - (size_t)k, name, nlen)) < 0)
+			return -1;
+		k += w;
+	}
+	if ((w = str_encode(dst + k, room - (size_t)k, value, vlen)) < 0)
+		return -1;
+	k += w;
+	// 入れられなかったら相手の表とずれるので、書いたものごと無かったことにする
+	if (index && !insert(t, name, nlen, value, vlen) && nlen + vlen + 32 <= t->max)
+		return -1;
+	return k;
+}
+
+int	hpack_encode_size(unsigned char *dst, size_t room, size_t max)
+{
+	return int_encode(dst, room, 5, 0x20, max);
+}
@@ -0,0 +1,66 @@
+#ifndef HPACK_H
+#define HPACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * HPACK（RFC 7541）: HTTP/2 のヘッダ圧縮
+ *
+ * 静的テーブル（61 個）と、接続ごと・向きごとの動的テーブル（新しいものが 62 番。大きさは
+ * 名前 + 値 + 32 バイトで数え、上限を超えたら古いものから追い出す）。
+ * 文字列の Huffman 符号は読む側だけ（書く側はいつも生の文字列で出す）。
+ */
+
+#define HPACK_TABLE_MAX   4096                   // 動的テーブルの上限（SETTINGS_HEADER_TABLE_SIZE の既定）
+#define HPACK_ENTRIES_MAX (HPACK_TABLE_MAX / 32)  // 1 個は少なくとも 32 バイト
+
+typedef struct s_hpent
+{
+	char	*name;      // name と value は 1 回の malloc（name の直後に value）
+	size_t	nlen;
+	char	*value;
+	size_t	vlen;
+}	t_hpent;
+
+typedef struct s_hpack
+{
+	t_hpent	ent[HPACK_ENTRIES_MAX];   // リング。head が最新
+	size_t	head;
+	size_t	n;
+	size_t	size;       // いまの大きさ
+	size_t	max;        // いまの上限（サイズ更新で変わる）
+	size_t	limit;      // max の上限（SETTINGS で決まる）
+}	t_hpack;
+
+typedef struct s_hpfield
+{
+	const char	*name;
+	size_t		nlen;
+	const char	*value;
+	size_t		vlen;
+}	t_hpfield;
+
+void	hpack_init(t_hpack *t, size_t limit);
+void	hpack_free(t_hpack *t);
+// 上限を変える（小さくなれば追い出す）
+void	hpack_resize(t_hpack *t, size_t max);
+
+/*
+ * ヘッダブロックから 1 つ読む。*p を進め、1: f に 1 つ読めた / 0: 終わり / -1: 壊れている
+ * （COMPRESSION_ERROR。以後この t は使えない）。
+ * Huffman を解いた文字列は scratch（n バイト）に置くので、f は次に呼ぶまで有効
+ */
+int		hpack_decode(t_hpack *t, const unsigned char **p, const unsigned char *end,
+			char *scratch, size_t n, t_hpfield *f);
+
+/*
+ * 1 つ書く。同じ名前と値が表にあれば番号だけ、無ければ名前を番号で引いて値を生で書き、
+ * index が 1 なら動的テーブルにも入れる。書いたバイト数、入りきらなければ -1
+ */
+int		hpack_encode(t_hpack *t, unsigned char *dst, size_t room,
+			const char *name, size_t nlen, const char *value, size_t vlen, int index);
+// 動的テーブルのサイズ更新（ヘッダブロックの先頭に置く）。書いたバイト数 / -1
+int		hpack_encode_size(unsigned char *dst, size_t room, size_t max);
+
+#endif
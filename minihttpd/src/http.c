@@ -0,0 +1,1011 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "h2.h"
+#include "http.h"
+#include "wpool.h"
+
+#define HTTP_BODY_TIMEOUT_MS 10000
+#define EPOLL_BATCH 256
+
+typedef enum e_cst
+{
+	C_READ,
+	C_POOL,     // ハンドラがワーカーで動いている（epoll からは外してある）
+	C_WRITE,
+	C_ZCWAIT,   // 書き終えたが、MSG_ZEROCOPY の完了通知がまだ揃っていない
+	C_H2,       // h2c。読み書きは h2.c が組み立てたものをそのまま流す
+	C_CLOSED    // 閉じた。同じ epoll_wait の残りのイベントが指しているかもしれないので、回り終えてから free
+}	t_cst;
+
+typedef struct s_conn
+{
+	t_job			job;        // 先頭に置く（完了で返ってきた job をそのまま conn として扱う）
+	int				fd;
+	t_cst			st;
+	t_route			*rt;
+	int				rc;         // ハンドラの戻り値
+	int				head_only;
+	size_t			got;        // buf に読んだ量
+	size_t			used;       // いまのリクエストが buf の先頭から使う量（ヘッダ + buf 内の本文）
+	char			hdr[512];
+	size_t			hlen;
+	size_t			sent;       // hdr と body のうち書き終えた量
+	off_t			foff;
+	int				zc;         // MSG_ZEROCOPY を使う（SO_ZEROCOPY が通り、カーネルがコピーに倒していない）
+	uint32_t		zc_issued;  // MSG_ZEROCOPY で送れた sendmsg の数（= 次の通知番号）
+	uint32_t		zc_done;    // 完了通知で返ってきた数
+	t_h2			*h2;
+	uint32_t		h2_ev;      // h2 の接続でいま epoll に頼んでいるもの
+	uint64_t		rl_key;     // 流量制限の鍵（接続元）
+	struct s_loop	*lp;
+	struct s_conn	*prev;
+	struct s_conn	*next;
+	t_req			req;
+	t_resp			resp;
+	char			buf[HTTP_REQ_MAX];
+}	t_conn;
+
+typedef struct s_loop
+{
+	int			ep;
+	int			lfd;
+	int			pooled;
+	t_wpool		pool;
+	size_t		zc_min;     // これ以上の本文を MSG_ZEROCOPY で送る（0: 使わない）
+	t_conn		*conns;     // 開いている接続すべて（止めるときに閉じる）
+	t_conn		*closed;    // conn_close したもの（next でつなぐ）
+}	t_loop;
+
+static t_router	g_router;
+static t_route	**g_routes;
+static size_t	g_nroutes;
+static uint64_t	g_status[6];
+static t_zc_stats	g_zc;
+static t_rlimit		*g_rl;
+
+// 429 は毎回組み立てない（流量を超えたクライアントにはできるだけ安く返す）
+#define RL_BODY "too many requests\n"
+#define RL_HEAD(conn) "HTTP/1.1 429 Too Many Requests\r\n" \
+	"Content-Type: text/plain\r\n" \
+	"Content-Length: 18\r\n" \
+	"Retry-After: 1\r\n" \
+	"Connection: " conn "\r\n" \
+	"\r\n"
+
+static const char	g_429_head[2][sizeof(RL_HEAD("keep-alive"))] = {RL_HEAD("close"), RL_HEAD("keep-alive")};
+static const size_t	g_429_hlen[2] = {sizeof(RL_HEAD("close")) - 1, sizeof(RL_HEAD("keep-alive")) - 1};
+
+int	http_route(unsigned methods, const char *path, int kind, unsigned flags, t_handler fn, void *arg)
+{
+	t_route	*rt = calloc(1, sizeof(t_route));
+	t_route	**nv = realloc(g_routes, (g_nroutes + 1) * sizeof(t_route *));
+
+	if (!rt || !nv)
+		return free(rt), -1;
+	g_routes = nv;
+	// router のデータはこのポインタ。配列を伸ばしても動かないように 1 本ずつ確保する
+	if (router_add(&g_router, path, kind, rt) != 0)
+		return free(rt), -1;
+	rt->path = g_router.ent[g_router.n - 1].path;
+	rt->kind = kind;
+	rt->methods = methods;
+	rt->flags = flags;
+	rt->fn = fn;
+	rt->arg = arg;
+	snprintf(rt->allow, sizeof(rt->allow), "Allow:%s%s%s%s\r\n",
+		(methods & HTTP_GET) ? " GET, HEAD," : "", (methods & HTTP_POST) ? " POST," : "",
+		(methods & HTTP_PUT) ? " PUT," : "", (methods & HTTP_DELETE) ? " DELETE," : "");
+	// 最後の ',' を消す
+	char *comma = strrchr(rt->allow, ',');
+	if (comma)
+		memmove(comma, comma + 1, strlen(comma));
+	g_routes[g_nroutes++] = rt;
+	return 0;
+}
+
+int	http_routes_compile(void)
+{
+	return router_compile(&g_router);
+}
+
+void	http_routes_free(void)
+{
+	for (size_t i = 0; i < g_nroutes; i++)
+		free(g_routes[i]);
+	free(g_routes);
+	g_routes = NULL;
+	g_nroutes = 0;
+	router_free(&g_router);
+}
+
+const t_route	*const *http_routes(size_t *n)
+{
+	*n = g_nroutes;
+	return (const t_route *const *)g_routes;
+}
+
+const uint64_t	*http_status_counts(void)
+{
+	return g_status;
+}
+
+const t_zc_stats	*http_zerocopy_stats(void)
+{
+	return &g_zc;
+}
+
+const t_rlimit	*http_ratelimit(void)
+{
+	return g_rl;
+}
+
+const char	*http_reason(int status)
+{
+	switch (status)
+	{
+		case 200: return "OK";
+		case 201: return "Created";
+		case 204: return "No Content";
+		case 400: return "Bad Request";
+		case 403: return "Forbidden";
+		case 404: return "Not Found";
+		case 405: return "Method Not Allowed";
+		case 413: return "Payload Too Large";
+		case 429: return "Too Many Requests";
+		case 431: return "Request Header Fields Too Large";
+		case 500: return "Internal Server Error";
+		case 501: return "Not Implemented";
+		case 503: return "Service Unavailable";
+		default: return "Unknown";
+	}
+}
+
+int	resp_printf(t_resp *resp, int status, const char *fmt, ...)
+{
+	va_list	ap;
+	int		n;
+
+	va_start(ap, fmt);
+	n = vsnprintf(resp->buf, sizeof(resp->buf), fmt, ap);
+	va_end(ap);
+	resp->status = status;
+	resp->ctype = "text/plain";
+	resp->body = resp->buf;
+	if (n < 0)
+		n = 0;
+	resp->body_len = ((size_t)n < sizeof(resp->buf)) ? (size_t)n : sizeof(resp->buf) - 1;
+	return ((size_t)n < sizeof(resp->buf)) ? 0 : -1;
+}
+
+const char	*http_header(const t_req *req, const char *name, size_t *len)
+{
+	size_t		nlen = strlen(name);
+	const char	*p = req->head;
+	const char	*end = req->head + req->head_len;
+
+	while (p < end)
+	{
+		const char	*eol = memchr(p, '\n', (size_t)(end - p));
+		const char	*le = eol ? eol : end;
+
+		if ((size_t)(le - p) > nlen && p[nlen] == ':' && strncasecmp(p, name, nlen) == 0)
+		{
+			const char *v = p + nlen + 1;
+			while (v < le && (*v == ' ' || *v == '\t'))
+				v++;
+			while (le > v && (le[-1] == '\r' || le[-1] == ' ' || le[-1] == '\t'))
+				le--;
+			*len = (size_t)(le - v);
+			return v;
+		}
+		p = le + 1;
+	}
+	return NULL;
+}
+
+ssize_t	http_read_body(t_req *req, void *buf, size_t n)
+{
+	size_t	left = req->content_length - req->body_read;
+	ssize_t	got;
+
+	if (left == 0 || n == 0)
+		return 0;
+	if (n > left)
+		n = left;
+	if (req->body_read < req->body_len)
+	{
+		if (n > req->body_len - req->body_read)
+			n = req->body_len - req->body_read;
+		memcpy(buf, req->body + req->body_read, n);
+		req->body_read += n;
+		return (ssize_t)n;
+	}
+	for (;;)
+	{
+		struct pollfd pfd = {.fd = req->fd, .events = POLLIN};
+
+		got = read(req->fd, buf, n);
+		if (got >= 0 || (errno != EINTR && errno != EAGAIN))
+			break;
+		if (errno == EAGAIN && poll(&pfd, 1, HTTP_BODY_TIMEOUT_MS) == 0)
+		{
+			errno = ETIMEDOUT;
+			return -1;
+		}
+	}
+	if (got > 0)
+		req->body_read += (size_t)got;
+	return got;
+}
+
+unsigned	http_parse_method(const char *s, size_t n)
+{
+	static const struct { const char *name; unsigned bit; } tab[] = {
+		{"GET", HTTP_GET}, {"HEAD", HTTP_HEAD}, {"POST", HTTP_POST},
+		{"PUT", HTTP_PUT}, {"DELETE", HTTP_DELETE},
+	};
+
+	for (size_t i = 0; i < sizeof(tab) / sizeof(tab[0]); i++)
+		if (strlen(tab[i].name) == n && memcmp(tab[i].name, s, n) == 0)
+			return tab[i].bit;
+	return 0;
+}
+
+// "METHOD SP target SP HTTP/1.x" を分ける。0 / 400 / 501
+static int	parse_request_line(t_req *req, const char *line, size_t n)
+{
+	const char	*sp1 = memchr(line, ' ', n);
+	const char	*sp2;
+	const char	*q;
+
+	if (!sp1)
+		return 400;
+	sp2 = memchr(sp1 + 1, ' ', (size_t)(line + n - sp1 - 1));
+	if (!sp2 || sp2 == sp1 + 1 || sp1[1] != '/' || (size_t)(line + n - sp2 - 1) < 8
+		|| strncmp(sp2 + 1, "HTTP/1.", 7) != 0)
+		return 400;
+	if ((req->method = http_parse_method(line, (size_t)(sp1 - line))) == 0)
+		return 501;
+	req->path = sp1 + 1;
+	req->path_len = (size_t)(sp2 - req->path);
+	if ((q = memchr(req->path, '?', req->path_len)) != NULL)
+	{
+		req->query = q + 1;
+		req->query_len = req->path_len - (size_t)(q + 1 - req->path);
+		req->path_len = (size_t)(q - req->path);
+	}
+	return 0;
+}
+
+// MSG_ZEROCOPY なら完了通知が揃ってから呼ぶ
+void	resp_release(t_resp *resp)
+{
+	if (resp->file_fd >= 0)
+		close(resp->file_fd);
+	resp->file_fd = -1;
+	if (resp->body_free)
+		resp->body_free(resp->body_owner);
+	resp->body_free = NULL;
+	resp->body_owner = NULL;
+}
+
+static void	conn_close(t_loop *lp, t_conn *c)
+{
+	// 通知の揃っていない本文も、ソケットを閉じる以上は送り切る必要がないので手放す
+	resp_release(&c->resp);
+	if (c->h2)
+		h2_free(c->h2);
+	close(c->fd);   // epoll からも外れる
+	if (c->prev)
+		c->prev->next = c->next;
+	else
+		lp->conns = c->next;
+	if (c->next)
+		c->next->prev = c->prev;
+	c->st = C_CLOSED;
+	c->next = lp->closed;
+	lp->closed = c;
+}
+
+static void	free_closed(t_loop *lp)
+{
+	while (lp->closed)
+	{
+		t_conn *c = lp->closed;
+
+		lp->closed = c->next;
+		free(c);
+	}
+}
+
+static void	conn_watch(t_loop *lp, t_conn *c, int op, uint32_t events)
+{
+	struct epoll_event ev = {.events = events, .data.ptr = c};
+
+	if (epoll_ctl(lp->ep, op, c->fd, &ev) != 0)
+		perror("epoll_ctl");
+}
+
+void	resp_reset(t_resp *resp)
+{
+	resp->status = 200;
+	resp->ctype = NULL;
+	resp->extra = NULL;
+	resp->body = NULL;
+	resp->body_len = 0;
+	resp->file_fd = -1;
+	resp->file_len = 0;
+	resp->body_free = NULL;
+	resp->body_owner = NULL;
+}
+
+static void	conn_write(t_loop *lp, t_conn *c);
+static void	conn_request(t_loop *lp, t_conn *c);
+
+// ヘッダを組んで書き始める。keep-alive は本文を読み残していないときだけ
+static void	start_write(t_loop *lp, t_conn *c)
+{
+	t_resp	*resp = &c->resp;
+	size_t	blen = resp->file_fd >= 0 ? resp->file_len : resp->body_len;
+	int		hlen;
+
+	if (c->req.body_read < c->req.content_length && c->req.body_len < c->req.content_length)
+		c->req.keepalive = 0;
+	hlen = snprintf(c->hdr, sizeof(c->hdr),
+		"HTTP/1.1 %d %s\r\n"
+		"Content-Type: %s\r\n"
+		"Content-Length: %zu\r\n"
+		"%s"
+		"Connection: %s\r\n"
+		"\r\n",
+		resp->status, http_reason(resp->status), resp->ctype ? resp->ctype : "text/plain", blen,
+		resp->extra ? resp->extra : "", c->req.keepalive ? "keep-alive" : "close");
+	if (hlen < 0 || (size_t)hlen >= sizeof(c->hdr))
+	{
+		conn_close(lp, c);
+		return;
+	}
+	g_status[resp->status / 100 < 6 ? resp->status / 100 : 0]++;
+	c->hlen = (size_t)hlen;
+	c->sent = 0;
+	c->foff = 0;
+	if (c->head_only || resp->file_fd >= 0)
+		resp->body_len = 0;
+	if (c->head_only && resp->file_fd >= 0)
+	{
+		close(resp->file_fd);
+		resp->file_fd = -1;
+	}
+	c->st = C_WRITE;
+	conn_write(lp, c);
+}
+
+static void	respond_error(t_loop *lp, t_conn *c, int status, const char *msg)
+{
+	resp_reset(&c->resp);
+	c->req.keepalive = 0;
+	c->head_only = 0;
+	resp_printf(&c->resp, status, "%s\n", msg);
+	start_write(lp, c);
+}
+
+// 起動時に組んだ 429 をそのまま書く（ルーティングも snprintf もしない）
+static void	respond_429(t_loop *lp, t_conn *c)
+{
+	int ka = c->req.keepalive
+		&& !(c->req.body_read < c->req.content_length && c->req.body_len < c->req.content_length);
+
+	memcpy(c->hdr, g_429_head[ka], g_429_hlen[ka]);
+	c->hlen = g_429_hlen[ka];
+	c->req.keepalive = ka;
+	c->resp.status = 429;
+	c->resp.body = RL_BODY;
+	c->resp.body_len = c->head_only ? 0 : sizeof(RL_BODY) - 1;
+	g_status[4]++;
+	c->sent = 0;
+	c->foff = 0;
+	c->st = C_WRITE;
+	conn_write(lp, c);
+}
+
+static void	handler_done(t_loop *lp, t_conn *c)
+{
+	if (c->rc != 0)
+	{
+		resp_release(&c->resp);
+		resp_reset(&c->resp);
+		resp_printf(&c->resp, 500, "internal server error\n");
+	}
+	start_write(lp, c);
+}
+
+static void	run_job(t_job *job)
+{
+	t_conn *c = (t_conn *)job;
+
+	c->rc = c->rt->fn(&c->req, &c->resp, c->rt->arg);
+}
+
+// ルートを引く。無いか、メソッドが合わなければ resp に 404 / 405 を入れて NULL
+static t_route	*route(const t_req *req, t_resp *resp)
+{
+	t_route		*rt = router_match(&g_router, req->path, req->path_len);
+	unsigned	m = (req->method == HTTP_HEAD) ? HTTP_GET : req->method;
+
+	if (!rt)
+	{
+		resp_printf(resp, 404, "not found\n");
+		return NULL;
+	}
+	if (!(rt->methods & m))
+	{
+		resp_printf(resp, 405, "method not allowed\n");
+		resp->extra = rt->allow;
+		return NULL;
+	}
+	rt->hits++;
+	return rt;
+}
+
+static void	dispatch(t_loop *lp, t_conn *c)
+{
+	t_route *rt;
+
+	if (g_rl && !rl_allow(g_rl, c->rl_key))
+	{
+		respond_429(lp, c);
+		return;
+	}
+	if (!(rt = route(&c->req, &c->resp)))
+	{
+		start_write(lp, c);
+		return;
+	}
+	c->rt = rt;
+	if ((rt->flags & HTTP_POOL) && lp->pooled)
+	{
+		// 返ってくるまで epoll から外す（HUP などで触らないように）
+		epoll_ctl(lp->ep, EPOLL_CTL_DEL, c->fd, NULL);
+		c->st = C_POOL;
+		c->job.run = run_job;
+		if (wpool_submit(&lp->pool, &c->job) == 0)
+			return;
+		conn_watch(lp, c, EPOLL_CTL_ADD, 0);
+		respond_error(lp, c, 503, "busy");
+		return;
+	}
+	run_job(&c->job);
+	handler_done(lp, c);
+}
+
+// --- h2c ------------------------------------------------------------------
+
+static void	run_stream(t_job *job)
+{
+	t_h2stream *s = (t_h2stream *)job;
+
+	s->rc = s->rt->fn(&s->req, &s->resp, s->rt->arg);
+}
+
+// 書けるだけ書き、読む・書くのどちらを epoll で待つかを決め直す
+static void	conn_h2_flush(t_loop *lp, t_conn *c)
+{
+	size_t		len = 0;
+	const char	*p;
+	uint32_t	ev;
+
+	while ((p = h2_out(c->h2, &len)), len > 0)
+	{
+		ssize_t w = send(c->fd, p, len, MSG_NOSIGNAL);
+		if (w < 0 && errno == EINTR)
+			continue;
+		if (w < 0 && errno == EAGAIN)
+			break;
+		if (w <= 0)
+		{
+			conn_close(lp, c);
+			return;
+		}
+		h2_sent(c->h2, (size_t)w);
+	}
+	if (h2_finished(c->h2))
+	{
+		conn_close(lp, c);
+		return;
+	}
+	ev = (h2_want_read(c->h2) ? EPOLLIN : 0) | (len > 0 ? EPOLLOUT : 0);
+	if (ev != c->h2_ev)
+	{
+		conn_watch(lp, c, EPOLL_CTL_MOD, ev);
+		c->h2_ev = ev;
+	}
+}
+
+// ハンドラが終わったストリームを返す。flush は h2_feed の外から呼ばれたときだけ
+static void	stream_done(t_loop *lp, t_h2stream *s, int flush)
+{
+	t_h2 *h = s->h2;
+
+	if (s->rc != 0)
+	{
+		resp_release(&s->resp);
+		resp_reset(&s->resp);
+		resp_printf(&s->resp, 500, "internal server error\n");
+	}
+	g_status[s->resp.status / 100 < 6 ? s->resp.status / 100 : 0]++;
+	if (h2_respond(s) && flush)
+		conn_h2_flush(lp, h2_ctx(h));
+}
+
+// h2.c から、リクエストの揃ったストリームごとに呼ばれる（h2_feed の中）
+static int	h2_request(void *ctx, t_h2stream *s)
+{
+	t_conn *c = ctx;
+	t_loop *lp = c->lp;
+
+	s->rc = 0;
+	if (!s->answered && g_rl && !rl_allow(g_rl, c->rl_key))
+	{
+		s->resp.status = 429;
+		s->resp.body = RL_BODY;
+		s->resp.body_len = sizeof(RL_BODY) - 1;
+		s->resp.extra = "Retry-After: 1\r\n";
+		stream_done(lp, s, 0);
+		return 0;
+	}
+	if (s->answered || (s->rt = route(&s->req, &s->resp)) == NULL)
+	{
+		stream_done(lp, s, 0);
+		return 0;
+	}
+	s->job.run = run_stream;
+	if ((s->rt->flags & HTTP_POOL) && lp->pooled)
+	{
+		if (wpool_submit(&lp->pool, &s->job) == 0)
+			return 1;
+		resp_printf(&s->resp, 503, "busy\n");
+		stream_done(lp, s, 0);
+		return 0;
+	}
+	run_stream(&s->job);
+	stream_done(lp, s, 0);
+	return 0;
+}
+
+static void	conn_h2_read(t_loop *lp, t_conn *c)
+{
+	while (h2_want_read(c->h2))
+	{
+		size_t	room;
+		char	*buf = h2_rbuf(c->h2, &room);
+		ssize_t	n = read(c->fd, buf, room);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && errno == EAGAIN)
+			break;
+		if (n <= 0)
+		{
+			conn_close(lp, c);
+			return;
+		}
+		h2_feed(c->h2, (size_t)n);
+	}
+	conn_h2_flush(lp, c);
+}
+
+// connection preface を読み終えた接続を h2c に切り替える。preface の後ろに読めていた分もそのまま渡す
+static void	h2_start(t_loop *lp, t_conn *c)
+{
+	size_t	rest = c->got - H2_PREFACE_LEN;
+	size_t	room;
+	char	*buf;
+
+	if ((c->h2 = h2_new(c, h2_request)) == NULL)
+	{
+		conn_close(lp, c);
+		return;
+	}
+	c->st = C_H2;
+	c->h2_ev = EPOLLIN;
+	buf = h2_rbuf(c->h2, &room);
+	memcpy(buf, c->buf + H2_PREFACE_LEN, rest);
+	c->got = 0;
+	h2_feed(c->h2, rest);
+	conn_h2_read(lp, c);
+}
+
+// buf にヘッダが揃っていれば 1 リクエスト分を振り分ける。揃っていなければ読むのを待つ
+static void	conn_request(t_loop *lp, t_conn *c)
+{
+	const char	*end = memmem(c->buf, c->got, "\r\n\r\n", 4);
+	const char	*eol;
+	const char	*v;
+	size_t		vlen;
+	int			st;
+
+	// HTTP/2 の connection preface で始まっていれば h2c（prior knowledge）
+	if (c->got >= 3 && memcmp(c->buf, H2_PREFACE,
+			c->got < H2_PREFACE_LEN ? c->got : H2_PREFACE_LEN) == 0)
+	{
+		if (c->got >= H2_PREFACE_LEN)
+			h2_start(lp, c);
+		return;
+	}
+	if (!end)
+	{
+		if (c->got == sizeof(c->buf))
+			respond_error(lp, c, 431, "request header too large");
+		return;
+	}
+	memset(&c->req, 0, sizeof(c->req));
+	resp_reset(&c->resp);
+	c->req.fd = c->fd;
+	eol = memchr(c->buf, '\r', (size_t)(end - c->buf) + 2);
+	if ((st = parse_request_line(&c->req, c->buf, (size_t)(eol - c->buf))) != 0)
+	{
+		respond_error(lp, c, st, st == 501 ? "not implemented" : "bad request");
+		return;
+	}
+	c->req.head = eol + 2;
+	c->req.head_len = (size_t)(end + 2 - c->req.head);
+	c->req.body = end + 4;
+	c->req.body_len = c->got - (size_t)(end + 4 - c->buf);
+	if ((v = http_header(&c->req, "Content-Length", &vlen)) != NULL)
+		c->req.content_length = strtoul(v, NULL, 10);
+	if (c->req.body_len > c->req.content_length)
+		c->req.body_len = c->req.content_length;
+	c->used = (size_t)(c->req.body - c->buf) + c->req.body_len;
+	// HTTP/1.1 は close と言われない限り、HTTP/1.0 は keep-alive と言われたときだけ続ける
+	c->req.keepalive = (eol[-1] == '1');
+	if ((v = http_header(&c->req, "Connection", &vlen)) != NULL)
+	{
+		if (vlen == 5 && strncasecmp(v, "close", 5) == 0)
+			c->req.keepalive = 0;
+		else if (vlen == 10 && strncasecmp(v, "keep-alive", 10) == 0)
+			c->req.keepalive = 1;
+	}
+	c->head_only = (c->req.method == HTTP_HEAD);
+	dispatch(lp, c);
+}
+
+// 書き終えたら、keep-alive なら次のリクエスト（すでに読んであればそのまま）へ、でなければ閉じる
+static void	write_done(t_loop *lp, t_conn *c)
+{
+	resp_release(&c->resp);
+	if (!c->req.keepalive)
+	{
+		conn_close(lp, c);
+		return;
+	}
+	memmove(c->buf, c->buf + c->used, c->got - c->used);
+	c->got -= c->used;
+	c->used = 0;
+	c->st = C_READ;
+	conn_watch(lp, c, EPOLL_CTL_MOD, EPOLLIN);
+	if (c->got > 0)
+		conn_request(lp, c);
+}
+
+// エラーキューから MSG_ZEROCOPY の完了通知を読み切る。通知は送った順の番号の範囲 [ee_info, ee_data]。
+// 読めた通知の数を返す
+static uint32_t	zc_drain(t_conn *c)
+{
+	char		ctl[CMSG_SPACE(sizeof(struct sock_extended_err))];
+	uint32_t	before = c->zc_done;
+
+	while (c->zc_done != c->zc_issued)
+	{
+		struct msghdr	msg = {.msg_control = ctl, .msg_controllen = sizeof(ctl)};
+		struct cmsghdr	*cm;
+
+		if (recvmsg(c->fd, &msg, MSG_ERRQUEUE) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		for (cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm))
+		{
+			struct sock_extended_err *ee = (struct sock_extended_err *)CMSG_DATA(cm);
+
+			if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)
+					|| (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))
+				|| ee->ee_errno != 0 || ee->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+				continue;
+			c->zc_done += ee->ee_data - ee->ee_info + 1;
+			// ループバックなどで結局コピーされた。この接続ではもう使わない（ページの固定が無駄になる）
+			if (ee->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+			{
+				g_zc.copied++;
+				c->zc = 0;
+			}
+		}
+	}
+	return c->zc_done - before;
+}
+
+// 完了通知が揃っていれば本文を手放して次へ、揃っていなければ EPOLLERR（常に届く）を待つ
+static void	zc_wait(t_loop *lp, t_conn *c)
+{
+	zc_drain(c);
+	if (c->zc_done == c->zc_issued)
+	{
+		write_done(lp, c);
+		return;
+	}
+	if (c->st != C_ZCWAIT)
+	{
+		c->st = C_ZCWAIT;
+		conn_watch(lp, c, EPOLL_CTL_MOD, 0);
+	}
+}
+
+static void	conn_write(t_loop *lp, t_conn *c)
+{
+	t_resp	*resp = &c->resp;
+	int		zc = c->zc && resp->body_len >= lp->zc_min;
+
+	while (c->sent < c->hlen + resp->body_len)
+	{
+		struct iovec	iov[2];
+		struct msghdr	msg = {.msg_iov = iov};
+		ssize_t			w;
+
+		if (c->sent < c->hlen)
+			iov[msg.msg_iovlen++] = (struct iovec){c->hdr + c->sent, c->hlen - c->sent};
+		if (resp->body_len > 0)
+		{
+			size_t boff = c->sent > c->hlen ? c->sent - c->hlen : 0;
+			iov[msg.msg_iovlen++] = (struct iovec){(char *)resp->body + boff, resp->body_len - boff};
+		}
+		w = sendmsg(c->fd, &msg, MSG_NOSIGNAL | (zc ? MSG_ZEROCOPY : 0));
+		if (w < 0 && errno == EINTR)
+			continue;
+		if (w < 0 && errno == ENOBUFS && zc)
+		{
+			// 通知用のメモリ（optmem）や固定できるページ（RLIMIT_MEMLOCK）が足りない。この応答はコピーで
+			g_zc.fallbacks++;
+			zc = 0;
+			continue;
+		}
+		if (w > 0 && zc)
+		{
+			c->zc_issued++;
+			g_zc.sends++;
+			g_zc.bytes += (size_t)w;
+		}
+		if (w < 0 && errno == EAGAIN)
+		{
+			conn_watch(lp, c, EPOLL_CTL_MOD, EPOLLOUT);
+			return;
+		}
+		if (w <= 0)
+		{
+			conn_close(lp, c);
+			return;
+		}
+		c->sent += (size_t)w;
+	}
+	while (resp->file_fd >= 0 && (size_t)c->foff < resp->file_len)
+	{
+		ssize_t w = sendfile(c->fd, resp->file_fd, &c->foff, resp->file_len - (size_t)c->foff);
+		if (w < 0 && errno == EINTR)
+			continue;
+		if (w < 0 && errno == EAGAIN)
+		{
+			conn_watch(lp, c, EPOLL_CTL_MOD, EPOLLOUT);
+			return;
+		}
+		if (w <= 0)
+		{
+			conn_close(lp, c);
+			return;
+		}
+	}
+	zc_wait(lp, c);
+}
+
+static void	conn_read(t_loop *lp, t_conn *c)
+{
+	while (c->got < sizeof(c->buf))
+	{
+		ssize_t n = read(c->fd, c->buf + c->got, sizeof(c->buf) - c->got);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && errno == EAGAIN)
+			break;
+		if (n <= 0)
+		{
+			// 途中で閉じられた・keep-alive の待ちで閉じられた
+			conn_close(lp, c);
+			return;
+		}
+		c->got += (size_t)n;
+	}
+	conn_request(lp, c);
+}
+
+static void	accept_all(t_loop *lp)
+{
+	int one = 1;
+
+	for (;;)
+	{
+		struct sockaddr_storage	sa;
+		socklen_t				salen = sizeof(sa);
+		int						fd = accept4(lp->lfd, (struct sockaddr *)&sa, &salen,
+									SOCK_NONBLOCK | SOCK_CLOEXEC);
+		t_conn					*c;
+
+		if (fd < 0)
+		{
+			if (errno != EAGAIN && errno != EINTR && errno != ECONNABORTED)
+				perror("accept");
+			return;
+		}
+		if ((c = malloc(sizeof(t_conn))) == NULL)
+		{
+			close(fd);
+			continue;
+		}
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		c->zc = 0;
+		if (lp->zc_min > 0 && setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) != 0)
+		{
+			perror("minihttpd: SO_ZEROCOPY (falling back to copying)");
+			lp->zc_min = 0;
+		}
+		c->zc = (lp->zc_min > 0);
+		c->zc_issued = 0;
+		c->zc_done = 0;
+		c->h2 = NULL;
+		c->lp = lp;
+		c->rl_key = g_rl ? rl_key(fd, (struct sockaddr *)&sa, salen) : 0;
+		c->fd = fd;
+		c->st = C_READ;
+		c->got = 0;
+		c->used = 0;
+		resp_reset(&c->resp);
+		memset(&c->req, 0, sizeof(c->req));
+		c->prev = NULL;
+		c->next = lp->conns;
+		if (lp->conns)
+			lp->conns->prev = c;
+		lp->conns = c;
+		conn_watch(lp, c, EPOLL_CTL_ADD, EPOLLIN);
+	}
+}
+
+// ワーカーから返ってきた接続を epoll に戻して書く
+static void	collect_done(t_loop *lp)
+{
+	t_job *job = wpool_done(&lp->pool);
+
+	while (job)
+	{
+		t_job *next = job->next;
+
+		if (job->run == run_stream)
+			stream_done(lp, (t_h2stream *)job, 1);
+		else
+		{
+			conn_watch(lp, (t_conn *)job, EPOLL_CTL_ADD, 0);
+			handler_done(lp, (t_conn *)job);
+		}
+		job = next;
+	}
+}
+
+int	http_loop(int listen_fd, volatile sig_atomic_t *stop, int nworkers, size_t zerocopy_min,
+	t_rlimit *rl)
+{
+	t_loop				lp = {.ep = -1, .lfd = listen_fd, .zc_min = zerocopy_min};
+	struct epoll_event	ev[EPOLL_BATCH];
+	int					rc = 0;
+
+	if ((lp.ep = epoll_create1(EPOLL_CLOEXEC)) < 0)
+		return perror("epoll_create1"), -1;
+	if (nworkers > 0)
+	{
+		if (wpool_start(&lp.pool, nworkers) != 0)
+			return close(lp.ep), -1;
+		lp.pooled = 1;
+		ev[0] = (struct epoll_event){.events = EPOLLIN, .data.ptr = &lp.pool};
+		epoll_ctl(lp.ep, EPOLL_CTL_ADD, wpool_fd(&lp.pool), &ev[0]);
+	}
+	g_rl = rl;
+	fcntl(listen_fd, F_SETFL, fcntl(listen_fd, F_GETFL) | O_NONBLOCK);
+	ev[0] = (struct epoll_event){.events = EPOLLIN, .data.ptr = &lp.lfd};
+	epoll_ctl(lp.ep, EPOLL_CTL_ADD, listen_fd, &ev[0]);
+	while (!*stop)
+	{
+		int n = epoll_wait(lp.ep, ev, EPOLL_BATCH, -1);
+
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			perror("epoll_wait");
+			rc = -1;
+			break;
+		}
+		for (int i = 0; i < n; i++)
+		{
+			void	*p = ev[i].data.ptr;
+			t_conn	*c = p;
+
+			if (p == &lp.lfd)
+				accept_all(&lp);
+			else if (p == &lp.pool)
+				collect_done(&lp);
+			else if (c->st == C_CLOSED)
+				continue;
+			else if (c->st == C_READ)
+				conn_read(&lp, c);
+			else if (c->st == C_WRITE)
+			{
+				// EPOLLERR はエラーキューに通知が溜まっても立つ（読まないと level-triggered で回り続ける）
+				if (ev[i].events & EPOLLERR)
+					zc_drain(c);
+				conn_write(&lp, c);
+			}
+			else if (c->st == C_H2)
+			{
+				if (ev[i].events & (EPOLLERR | EPOLLHUP))
+					conn_close(&lp, c);
+				else if (ev[i].events & EPOLLIN)
+					conn_h2_read(&lp, c);
+				else
+					conn_h2_flush(&lp, c);
+			}
+			else if (c->st == C_ZCWAIT)
+			{
+				// 通知が 1 つも読めないのに EPOLLERR / EPOLLHUP が立つのはソケット自体のエラー
+				if (zc_drain(c) == 0 && (ev[i].events & (EPOLLERR | EPOLLHUP)))
+					conn_close(&lp, c);
+				else
+					zc_wait(&lp, c);
+			}
+		}
+		free_closed(&lp);
+	}
+	// ワーカーが持っている接続もあるので、先にプールを止めてから全部閉じる。
+	// 受け取っていなかった h2 のストリームは、ここで返しておけば接続を閉じるときに t_h2 ごと消える
+	// （HTTP/1.1 の接続は lp.conns にいるので、下でそのまま閉じる）
+	if (lp.pooled)
+	{
+		t_job *job = wpool_stop(&lp.pool);
+
+		while (job)
+		{
+			t_job *next = job->next;
+
+			if (job->run == run_stream)
+				h2_respond((t_h2stream *)job);
+			job = next;
+		}
+	}
+	while (lp.conns)
+		conn_close(&lp, lp.conns);
+	free_closed(&lp);
+	close(lp.ep);
+	g_rl = NULL;
+	return rc;
+}
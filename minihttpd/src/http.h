@@ -0,0 +1,135 @@
+#ifndef HTTP_H
+#define HTTP_H
+
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "ratelimit.h"
+#include "router.h"
+
+/*
+ * HTTP/1.1 と h2c のサーバ本体（epoll の I/O ループ 1 本 + ブロックするハンドラ用のワーカープール）
+ *
+ * 接続はすべてノンブロッキングで、I/O ループが読み・振り分け・書きを状態ごとに進める。keep-alive
+ * （HTTP/1.1 の既定、HTTP/1.0 は "Connection: keep-alive" のとき）なら応答のあと同じ接続で次を読む。
+ * HTTP_POOL で登録したハンドラ（ディスク I/O や重い計算をするもの）はワーカープール（wpool.h）で動かし、
+ * 終わったら eventfd 経由で I/O ループに戻って書く。その間も I/O ループはほかの接続を回し続ける。
+ * 接続の最初のバイト列が HTTP/2 の connection preface なら、その接続は h2c（h2.h）で多重化し、
+ * ストリームごとに同じハンドラを呼ぶ。
+ *
+ * ハンドラは起動時に http_route で登録し、http_routes_compile で router（完全ハッシュ + radix trie）に
+ * 組み直す。リクエストごとの振り分けはメモリを確保しない。
+ * パスは見つかったがメソッドが違えば 405（Allow 付き）、パスが無ければ 404。HEAD は GET のハンドラを
+ * 呼んでヘッダだけ返す。
+ *
+ * ハンドラは t_resp の status / ctype と、本文（resp->buf に書くか、よそのメモリを body で指すか、
+ * file_fd で開いたファイル）を埋めて 0 を返す。-1 を返すと 500。
+ *
+ * zerocopy_min を 0 より大きくすると、それ以上の大きさのメモリ上の本文は MSG_ZEROCOPY で送る
+ * （カーネルはページを参照したまま送るので、エラーキューの完了通知が揃うまで本文を手放さない）。
+ * それより小さいものや、カーネルが結局コピーしたと通知してきた接続はふつうにコピーして送る。
+ */
+
+#define HTTP_GET    0x01u
+#define HTTP_HEAD   0x02u
+#define HTTP_POST   0x04u
+#define HTTP_PUT    0x08u
+#define HTTP_DELETE 0x10u
+
+// http_route の flags
+#define HTTP_INLINE 0x0u    // I/O ループの中で呼ぶ（すぐ終わるもの）
+#define HTTP_POOL   0x1u    // ワーカープールで呼ぶ（ブロックする・重いもの）
+
+#define HTTP_REQ_MAX  8192    // リクエスト行 + ヘッダ
+#define HTTP_BUF_MAX  16384   // ハンドラが resp->buf に書ける本文
+
+typedef struct s_req
+{
+	int			fd;
+	unsigned	method;
+	const char	*path;
+	size_t		path_len;
+	const char	*query;        // '?' の後ろ（無ければ長さ 0）
+	size_t		query_len;
+	const char	*head;         // ヘッダ行の並び（http_header で引く）
+	size_t		head_len;
+	const char	*body;         // ヘッダと一緒に読めた本文の先頭
+	size_t		body_len;
+	size_t		content_length;
+	size_t		body_read;     // http_read_body で渡し終えた量
+	int			keepalive;
+}	t_req;
+
+typedef struct s_resp
+{
+	int			status;
+	const char	*ctype;
+	const char	*extra;        // 追加のヘッダ行（"\r\n" 終わり）
+	const char	*body;
+	size_t		body_len;
+	int			file_fd;       // 0 以上なら body の代わりにこのファイルの先頭 file_len バイトを送る
+	size_t		file_len;
+	void		(*body_free)(void *);   // 送り終えたら（MSG_ZEROCOPY なら完了通知のあとで）body_owner を渡して呼ぶ
+	void		*body_owner;
+	char		buf[HTTP_BUF_MAX];
+}	t_resp;
+
+// MSG_ZEROCOPY の数（I/O ループからだけ更新する）
+typedef struct s_zc_stats
+{
+	uint64_t	sends;         // MSG_ZEROCOPY を付けて送れた sendmsg
+	uint64_t	bytes;
+	uint64_t	copied;        // 完了通知のうち、カーネルがコピーに倒していたもの
+	uint64_t	fallbacks;     // ENOBUFS などでコピーで送り直したもの
+}	t_zc_stats;
+
+typedef int	(*t_handler)(t_req *req, t_resp *resp, void *arg);
+
+typedef struct s_route
+{
+	const char	*path;
+	int			kind;          // ROUTE_EXACT / ROUTE_PREFIX
+	unsigned	methods;
+	unsigned	flags;
+	t_handler	fn;
+	void		*arg;
+	uint64_t	hits;
+	char		allow[48];     // 405 で返す "Allow: ...\r\n"
+}	t_route;
+
+// 0 / -1。http_routes_compile より前に呼ぶ
+int				http_route(unsigned methods, const char *path, int kind, unsigned flags, t_handler fn, void *arg);
+int				http_routes_compile(void);
+void			http_routes_free(void);
+const t_route	*const *http_routes(size_t *n);
+// レスポンスのステータスクラス（1xx..5xx）ごとの数。index は status / 100
+const uint64_t	*http_status_counts(void);
+const t_zc_stats	*http_zerocopy_stats(void);
+// http_loop に渡した流量制限（無ければ NULL）
+const t_rlimit	*http_ratelimit(void);
+
+// listen_fd で待ち受け、*stop が立つ（シグナルで epoll_wait が EINTR で返る）まで回す。
+// nworkers が 0 なら HTTP_POOL のハンドラも I/O ループの中で呼ぶ。
+// zerocopy_min が 0 なら MSG_ZEROCOPY は使わない。rl が NULL でなければ、リクエストごとに接続元の
+// バケツから 1 つ取り、取れなければ 429 を返す。0 / -1
+int				http_loop(int listen_fd, volatile sig_atomic_t *stop, int nworkers, size_t zerocopy_min,
+					t_rlimit *rl);
+
+// ヘッダの値（前後の空白を除く）。無ければ NULL
+const char		*http_header(const t_req *req, const char *name, size_t *len);
+// 本文を最大 n バイト読む。読み終えたら 0、エラーなら -1。
+// ソケットはノンブロッキングなので、届くまで poll で待つ（HTTP_POOL のハンドラから呼ぶ）
+ssize_t			http_read_body(t_req *req, void *buf, size_t n);
+// resp->buf に printf で本文を書き、text/plain で status を返す形にする（0 / -1: 入りきらない）
+int				resp_printf(t_resp *resp, int status, const char *fmt, ...)
+	__attribute__((format(printf, 3, 4)));
+// 空の 200 に戻す（本文は手放さない）/ 本文のファイルとメモリを手放す
+void			resp_reset(t_resp *resp);
+void			resp_release(t_resp *resp);
+const char		*http_reason(int status);
+// "GET" などを HTTP_GET などに。知らないものは 0
+unsigned		http_parse_method(const char *s, size_t n);
+
+#endif
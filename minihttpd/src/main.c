@@ -1,7 +1,11 @@
+#define _GNU_SOURCE
 #include <arpa/inet.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
+#include <math.h>
 #include <netinet/in.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -11,11 +15,28 @@
 #include <time.h>
 #include <unistd.h>
 
+#include "focus.h"
+#include "handlers.h"
+#include "http.h"
+#include "livetrace.h"
+#include "profile.h"
+#include "summary.h"
+
 #define LISTEN_PORT 8080
-#define BACKLOG 10
-#define READ_BUF_SIZE 4096
+#define BACKLOG 128
+#define STATIC_DIR "./static"
 #define STRACE_PATH "/usr/bin/strace"
 #define ENV_PATH    "/usr/bin/env"
+#define ZEROCOPY_MIN_DEFAULT (64 * 1024)   // --zerocopy だけのときのしきい値（これより小さいとコピーの方が安い）
+
+// SIGINT / SIGTERM では I/O ループを抜けてふつうに終わる（--profile の profile.folded、PGO=gen の .gcda を書くため）
+static volatile sig_atomic_t	g_stop;
+
+static void	on_stop_signal(int sig)
+{
+	(void)sig;
+	g_stop = 1;
+}
 
 static int setup_listen_socket(void)
 {
@@ -118,8 +139,65 @@ static int wait_to_status(pid_t pid)
 	return 1;
 }
 
-static int run_traced(const char *self_path)
+/*
+ * --trace-live: strace -o の出力をパイプで受け、livetrace のスレッドがそのまま stderr へ流す。
+ * trace.txt は作らない（サーバは止まらないので、ファイルが際限なく育つのを避ける）。
+ * --trace-raw-max N を付けたときだけ生の行を trace.live.txt に N バイトで回しながら残す。
+ * 書き端は O_CLOEXEC のまま親が持ち、strace には -o の先（argv が指す out_path）として
+ * 親の /proc/PID/fd/N を開き直させる。strace は開いた出力に FD_CLOEXEC を付けるので、
+ * サーバ側には書き端が渡らない（fd の番号もずれない）
+ */
+static int run_traced_live(const char *dir, char *const argv[], char *out_path, size_t out_sz,
+	long raw_max)
+{
+	char raw[PATH_MAX + 64];
+	int pfd[2];
+	// サーバ側の trace= で絞ってあるので include は使わず、ld.so やロケールの読み込みだけ落として並べ替える
+	t_focus_live fx = {.include = 0, .from_strace = 1, .root = -1};
+	t_live lv = {.out = stderr, .fmt = focus_live_fmt, .ctx = &fx};
+
+	if (pipe2(pfd, O_CLOEXEC) != 0)
+		return 1;
+	lv.fd = pfd[0];
+	snprintf(out_path, out_sz, "/proc/%ld/fd/%d", (long)getpid(), pfd[1]);
+	if (raw_max > 0)
+	{
+		snprintf(raw, sizeof(raw), "%s/trace.live.txt", dir);
+		lv.raw_path = raw;
+		lv.raw_max = raw_max;
+	}
+	if (live_start(&lv) != 0)
+	{
+		close(pfd[0]);
+		close(pfd[1]);
+		return 1;
+	}
+
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		execv(STRACE_PATH, argv);
+		_exit(127);
+	}
+	// strace が抜けるまで書き端を持っておく（strace が開き直す先）
+	int status = (pid < 0) ? 1 : wait_to_status(pid);
+	close(pfd[1]);
+	live_join(&lv);
+	close(pfd[0]);
+	fprintf(stderr, "[trace] live: %llu lines, %llu shown", lv.lines, lv.kept);
+	if (lv.raw_path)
+		fprintf(stderr, ", raw %s (%llu rotations)", lv.raw_path, lv.rotations);
+	fprintf(stderr, "\n");
+	return status;
+}
+
+static int run_traced(const char *self_path, const char *static_dir, int workers, long zc_min,
+	double rl_rate, unsigned rl_burst,
+	int live, long raw_max)
 {
+	char workers_arg[16];
+	char zc_arg[32];
+	char rl_arg[64];
 	char root[PATH_MAX];
 	char dir[PATH_MAX];
 	char trace_txt[PATH_MAX + 64];
@@ -136,12 +214,55 @@ static int run_traced(const char *self_path)
 	}
 
 	snprintf(trace_txt, sizeof(trace_txt), "%s/trace.txt", dir);
+	snprintf(workers_arg, sizeof(workers_arg), "%d", workers);
+	snprintf(zc_arg, sizeof(zc_arg), "--zerocopy=%ld", zc_min);
+	snprintf(rl_arg, sizeof(rl_arg), "--rate-limit=%g,%u", rl_rate, rl_burst);
 
 	const char *trace_set =
-		"trace=socket,bind,listen,accept,accept4,read,write,close,fcntl";
+		"trace=socket,bind,listen,accept,accept4,read,write,writev,sendfile,close,fcntl,epoll_wait,epoll_ctl,"
+		"sendmsg,recvmsg";
+
+	// summary.txt は meta.txt が同じ run どうしで run 間のばらつきを出す
+	{
+		char meta[PATH_MAX + 64];
+		snprintf(meta, sizeof(meta), "%s/meta.txt", dir);
+		FILE *mf = fopen(meta, "w");
+		if (mf)
+		{
+			fprintf(mf, "minihttpd_path=%s\ntrace=%s\n%s", self_path, trace_set,
+				live ? "live=on\n" : "");
+			fclose(mf);
+		}
+	}
+
+	if (live)
+	{
+		char out_path[64];
+		char *const argv_live[] = {
+			(char *)STRACE_PATH,
+			"-f",
+			"-qq",
+			"-yy",
+			"-tt",
+			"-T",
+			"-s", "128",
+			"-e", (char *)trace_set,
+			"-o", out_path,
+			(char *)ENV_PATH, "-i", "PATH=/usr/bin:/bin",
+			(char *)self_path,
+			(char *)"--no-trace",
+			(char *)"--static-dir", (char *)static_dir,
+			(char *)"--workers", workers_arg,
+			zc_arg,
+			rl_arg,
+			NULL
+		};
+		return run_traced_live(dir, argv_live, out_path, sizeof(out_path), raw_max);
+	}
 
 	char *const argv[] = {
 		(char *)STRACE_PATH,
+		"-f",
 		"-qq",
 		"-yy",
 		"-tt",
@@ -151,6 +272,10 @@ static int run_traced(const char *self_path)
 		(char *)ENV_PATH, "-i", "PATH=/usr/bin:/bin",
 		(char *)self_path,
 		(char *)"--no-trace",
+		(char *)"--static-dir", (char *)static_dir,
+		(char *)"--workers", workers_arg,
+		zc_arg,
+		rl_arg,
 		NULL
 	};
 
@@ -188,79 +313,197 @@ static int run_traced(const char *self_path)
 	fclose(out);
 	close(pfd[0]);
 
-	return wait_to_status(pid);
+	int status = wait_to_status(pid);
+	if (trace_summary_write(dir) == 0)
+		fprintf(stderr, "[trace] %s/summary.txt\n", dir);
+	else
+		fprintf(stderr, "minihttpd(trace): summary failed (dir=%s)\n", dir);
+	return status;
 }
 
-static int serve_once(int listen_fd)
+// "64K" / "1M" のような大きさ。読めない・負・後ろに余計な文字があるときは -1
+static long parse_size(const char *s)
 {
-	int client_fd;
-	char buf[READ_BUF_SIZE];
-	const char *body = "hello, world!\n";
-	char resp[512];
-	int body_len;
-	int resp_len;
-	ssize_t n;
+	char *end;
+	long v;
 
-	client_fd = accept(listen_fd, NULL, NULL);
-	if (client_fd < 0)
-	{
-		perror("accept");
+	errno = 0;
+	v = strtol(s, &end, 10);
+	if (end == s || v < 0 || errno == ERANGE)
 		return -1;
+	if (*end == 'K' || *end == 'k')
+	{
+		v = (v > LONG_MAX / 1024) ? -1 : v * 1024;
+		end++;
 	}
+	else if (*end == 'M' || *end == 'm')
+	{
+		v = (v > LONG_MAX / (1024 * 1024)) ? -1 : v * 1024 * 1024;
+		end++;
+	}
+	return *end ? -1 : v;
+}
 
-	n = read(client_fd, buf, sizeof(buf) - 1);
-	if (n < 0)
-		perror("read");
-	else if (n >= 0)
-		buf[n] = '\0';
-
-	body_len = (int)strlen(body);
-	resp_len = snprintf(resp, sizeof(resp),
-		"HTTP/1.1 200 OK\r\n"
-		"Content-Type: text/plain\r\n"
-		"Content-Length: %d\r\n"
-		"Connection: close\r\n"
-		"\r\n"
-		"%s",
-		body_len, body);
-
-	if (resp_len < 0)
-		resp_len = 0;
-	if (write(client_fd, resp, (size_t)resp_len) < 0)
-		perror("write");
-
-	close(client_fd);
+// --rate-limit=RATE[,BURST]（BURST を省けば 0: rl_new が RATE 分にする）。
+// 読めない・負・後ろに余計な文字があるときは -1
+static int parse_rate(const char *s, double *rate, unsigned *burst)
+{
+	char *end;
+	unsigned long b = 0;
+
+	errno = 0;
+	*rate = strtod(s, &end);
+	if (end == s || errno == ERANGE || !isfinite(*rate) || *rate < 0)
+		return -1;
+	if (*end == ',')
+	{
+		s = end + 1;
+		if (*s < '0' || *s > '9')   // strtoul は空白や '-' も読んでしまう
+			return -1;
+		b = strtoul(s, &end, 10);
+		if (errno == ERANGE || b > UINT_MAX)
+			return -1;
+	}
+	if (*end)
+		return -1;
+	*burst = (unsigned)b;
 	return 0;
 }
 
+// --workers の既定: オンラインの CPU 数（I/O ループの分は数えない。ワーカーはほとんど寝ているか I/O 待ち）
+static int default_workers(void)
+{
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (n < 1)
+		return 1;
+	return (n > 64) ? 64 : (int)n;
+}
+
 int main(int argc, char **argv)
 {
 	int listen_fd;
 	int ret;
 	int do_trace = 0;
 	int no_trace = 0;
+	int live = 0;
+	long raw_max = 0;
+	int prof_hz = 0;
+	const char *static_dir = STATIC_DIR;
+	int workers = default_workers();
+	long zc_min = 0;
+	double rl_rate = 0;
+	unsigned rl_burst = 0;
+	t_rlimit *rl = NULL;
 
 	for (int i = 1; i < argc; i++)
 	{
 		if (strcmp(argv[i], "--trace") == 0)
 			do_trace = 1;
+		else if (strcmp(argv[i], "--trace-live") == 0)
+			do_trace = live = 1;
+		else if (strcmp(argv[i], "--trace-raw-max") == 0 && i + 1 < argc)
+		{
+			if ((raw_max = parse_size(argv[++i])) < 0)
+			{
+				fprintf(stderr, "minihttpd: --trace-raw-max expects N[K|M] (N >= 0)\n");
+				return 2;
+			}
+		}
 		else if (strcmp(argv[i], "--no-trace") == 0)
 			no_trace = 1;
+		else if (strcmp(argv[i], "--static-dir") == 0 && i + 1 < argc)
+			static_dir = argv[++i];
+		else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc)
+			workers = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--zerocopy") == 0)
+			zc_min = ZEROCOPY_MIN_DEFAULT;
+		else if (strncmp(argv[i], "--zerocopy=", 11) == 0)
+		{
+			if ((zc_min = parse_size(argv[i] + 11)) < 0)   // 0 なら使わない
+			{
+				fprintf(stderr, "minihttpd: --zerocopy expects MIN as N[K|M] (N >= 0)\n");
+				return 2;
+			}
+		}
+		else if (strncmp(argv[i], "--rate-limit=", 13) == 0)
+		{
+			if (parse_rate(argv[i] + 13, &rl_rate, &rl_burst) != 0)   // 0 なら制限しない
+			{
+				fprintf(stderr, "minihttpd: --rate-limit expects RATE[,BURST] (RATE >= 0)\n");
+				return 2;
+			}
+		}
+		else if (prof_parse_flag(argv[i], &prof_hz))
+			continue;
+	}
+	if (do_trace && !no_trace && prof_hz > 0)
+	{
+		// ptrace の停止がサンプルに混ざるので、同時には使わない
+		fprintf(stderr, "minihttpd: --profile cannot be combined with --trace\n");
+		return 2;
 	}
 	if (do_trace && !no_trace)
-		return run_traced(argv[0]);
+		return run_traced(argv[0], static_dir, workers, zc_min, rl_rate, rl_burst, live, raw_max);
+	{
+		struct sigaction sa;
+
+		memset(&sa, 0, sizeof(sa));
+		sa.sa_handler = on_stop_signal;   // SA_RESTART なし: epoll_wait が EINTR で返る
+		sigemptyset(&sa.sa_mask);
+		sigaction(SIGINT, &sa, NULL);
+		sigaction(SIGTERM, &sa, NULL);
+	}
+	if (prof_hz > 0)
+	{
+		char root[PATH_MAX];
+		char dir[PATH_MAX];
+
+		if (ensure_log_root(root, sizeof(root)) != 0 || make_run_dir(dir, sizeof(dir), root) != 0)
+		{
+			fprintf(stderr, "minihttpd(profile): cannot create run dir under ./logs/minihttpd\n");
+			return 1;
+		}
+		if (prof_start(dir, prof_hz) != 0)
+			prof_hz = 0;
+	}
 
+	if (handlers_register(static_dir) != 0 || http_routes_compile() != 0)
+	{
+		fprintf(stderr, "minihttpd: cannot set up routes\n");
+		prof_stop();
+		return 1;
+	}
+	if (rl_rate > 0 && (rl = rl_new(rl_rate, rl_burst)) == NULL)
+	{
+		perror("minihttpd: rate limit");
+		http_routes_free();
+		prof_stop();
+		return 1;
+	}
 	listen_fd = setup_listen_socket();
 	if (listen_fd < 0)
-		return 1;
-
-	fprintf(stderr, "minihttpd: listening on http://localhost:%d\n", LISTEN_PORT);
-	while (1)
 	{
-		ret = serve_once(listen_fd);
-		if (ret < 0)
-			break;
+		rl_free(rl);
+		http_routes_free();
+		prof_stop();
+		return 1;
 	}
+
+	if (zc_min < 0)
+		zc_min = 0;
+	fprintf(stderr, "minihttpd: listening on http://localhost:%d (%d workers", LISTEN_PORT,
+		workers > 0 ? workers : 0);
+	if (zc_min > 0)
+		fprintf(stderr, ", MSG_ZEROCOPY for bodies >= %ld bytes", zc_min);
+	if (rl)
+		fprintf(stderr, ", %g req/s per client, burst %u", rl->rate, rl->burst);
+	fprintf(stderr, ")\n");
+	ret = http_loop(listen_fd, &g_stop, workers, (size_t)zc_min, rl);
 	close(listen_fd);
+	rl_free(rl);
+	http_routes_free();
+	if (prof_hz > 0)
+		prof_stop();
 	return (ret < 0);
 }
@@ -0,0 +1,144 @@
+#define _GNU_SOURCE
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+
+#include "ratelimit.h"
+
+// 鍵の上位 8 ビットに種類を入れて、アドレスどうし・UID どうしだけがぶつかるようにする（0 にもならない）
+#define KEY_INET   (1ull << 56)
+#define KEY_INET6  (2ull << 56)
+#define KEY_UNIX   (3ull << 56)
+#define KEY_OTHER  (4ull << 56)
+
+t_rlimit	*rl_new(double rate, uint32_t burst)
+{
+	t_rlimit	*rl;
+	double		iv;
+
+	if (rate <= 0 || posix_memalign((void **)&rl, 64, sizeof(t_rlimit)) != 0)
+		return NULL;
+	memset(rl, 0, sizeof(*rl));
+	if (burst == 0)
+		burst = rate < 1 ? 1 : (uint32_t)rate;
+	iv = 1e9 / rate;
+	rl->interval = iv < 1 ? 1 : (uint64_t)iv;
+	rl->window = rl->interval * burst;
+	rl->rate = rate;
+	rl->burst = burst;
+	return rl;
+}
+
+void	rl_free(t_rlimit *rl)
+{
+	free(rl);
+}
+
+uint64_t	rl_key(int fd, const struct sockaddr *sa, socklen_t len)
+{
+	if (sa->sa_family == AF_INET && len >= sizeof(struct sockaddr_in))
+		return KEY_INET | ((const struct sockaddr_in *)sa)->sin_addr.s_addr;
+	if (sa->sa_family == AF_INET6 && len >= sizeof(struct sockaddr_in6))
+	{
+		const unsigned char	*a = ((const struct sockaddr_in6 *)sa)->sin6_addr.s6_addr;
+		uint64_t			p;
+
+		// IPv4-mapped（::ffff:a.b.c.d）は IPv4 と同じ鍵に
+		if (IN6_IS_ADDR_V4MAPPED(&((const struct sockaddr_in6 *)sa)->sin6_addr))
+		{
+			uint32_t v4;
+			memcpy(&v4, a + 12, 4);
+			return KEY_INET | v4;
+		}
+		// 1 台には /64 がまるごと割り当てられるのがふつうなので、上位 64 ビットで数える
+		memcpy(&p, a, 8);
+		p ^= p >> 33;
+		p *= 0xff51afd7ed558ccdull;
+		p ^= p >> 33;
+		return KEY_INET6 | (p & (KEY_INET - 1));
+	}
+	if (sa->sa_family == AF_UNIX)
+	{
+		struct ucred	cr;
+		socklen_t		n = sizeof(cr);
+
+		if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cr, &n) == 0)
+			return KEY_UNIX | (uint32_t)cr.uid;
+	}
+	return KEY_OTHER;
+}
+
+static uint64_t	now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// tat を interval 進められれば（バケツから 1 つ取れれば）1。tat が過去なら満杯なので now から数える
+static int	take(t_rlimit *rl, t_rlslot *s, uint64_t now)
+{
+	uint64_t tat = __atomic_load_n(&s->tat, __ATOMIC_RELAXED);
+	uint64_t next;
+
+	do
+	{
+		next = (tat > now ? tat : now) + rl->interval;
+		if (next - now > rl->window)
+		{
+			__atomic_fetch_add(&rl->limited, 1, __ATOMIC_RELAXED);
+			return 0;
+		}
+	} while (!__atomic_compare_exchange_n(&s->tat, &tat, next, 1,
+			__ATOMIC_RELAXED, __ATOMIC_RELAXED));
+	return 1;
+}
+
+int	rl_allow(t_rlimit *rl, uint64_t key)
+{
+	uint64_t	now = now_ns();
+	uint64_t	h = key * 0x9e3779b97f4a7c15ull;
+	size_t		i0 = (size_t)(h >> 32);
+	t_rlslot	*s;
+	uint64_t	k;
+
+	for (size_t i = 0; i < RL_PROBE; i++)
+	{
+		s = &rl->slot[(i0 + i) & (RL_SLOTS - 1)];
+		k = __atomic_load_n(&s->key, __ATOMIC_ACQUIRE);
+		if (k == 0)
+		{
+			if (__atomic_compare_exchange_n(&s->key, &k, key, 0,
+					__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			{
+				__atomic_fetch_add(&rl->clients, 1, __ATOMIC_RELAXED);
+				return take(rl, s, now);   // tat は 0（満杯）のまま
+			}
+			// ほかのスレッドが先に取った。k はその鍵（同じクライアントかもしれない）
+		}
+		if (k == key)
+			return take(rl, s, now);
+	}
+	/*
+	 * 窓が埋まっている。満杯に戻った枠（tat が過去）なら、前の持ち主が次に来ても満杯から始まるだけなので
+	 * 譲ってもらう。譲る瞬間に前の持ち主が take していれば 1 回分ずれるが、それ以上は崩れない
+	 */
+	for (size_t i = 0; i < RL_PROBE; i++)
+	{
+		s = &rl->slot[(i0 + i) & (RL_SLOTS - 1)];
+		k = __atomic_load_n(&s->key, __ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&s->tat, __ATOMIC_RELAXED) <= now
+			&& __atomic_compare_exchange_n(&s->key, &k, key, 0,
+				__ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+		{
+			__atomic_fetch_add(&rl->reused, 1, __ATOMIC_RELAXED);
+			return take(rl, s, now);
+		}
+	}
+	__atomic_fetch_add(&rl->overflow, 1, __ATOMIC_RELAXED);
+	return 1;
+}
@@ -0,0 +1,50 @@
+#ifndef RATELIMIT_H
+#define RATELIMIT_H
+
+#include <stdint.h>
+#include <sys/socket.h>
+
+/*
+ * クライアントごとの流量制限（token bucket）
+ *
+ * 鍵は接続元: IPv4 / IPv6 のアドレス（ポートは見ない）、Unix ソケットなら相手の UID（SO_PEERCRED）。
+ * 表は固定の大きさの open addressing（線形探査を RL_PROBE 個まで）で、1 つの枠は鍵と状態の 2 語だけ。
+ * 空き枠は鍵を CAS で書いて取り、状態は CAS 1 回で進めるので、ロックなしにどのスレッドからでも呼べる。
+ *
+ * 状態は GCRA（virtual scheduling）の形で持つ: 「バケツが満杯に戻る時刻」tat（ns）が 1 つあれば、
+ * 残りのトークンは (now + burst * interval - tat) / interval と決まる。補充はこの 1 語の CAS で済み、
+ * 時刻を別に持って 2 語をそろえて書き換える必要がない。tat が過去の枠はバケツが満杯なので、
+ * 探査の窓が埋まっていればそういう枠を別のクライアントに回す。それも無ければ通す（数えておく）。
+ */
+
+#define RL_SLOTS  16384   // 2 冪
+#define RL_PROBE  16
+
+typedef struct s_rlslot
+{
+	uint64_t	key;    // 0: 空き
+	uint64_t	tat;
+}	t_rlslot;
+
+typedef struct s_rlimit
+{
+	uint64_t	interval;   // 1 リクエストあたりの ns（1e9 / rate）
+	uint64_t	window;     // burst * interval
+	double		rate;
+	uint32_t	burst;
+	uint64_t	limited __attribute__((aligned(64)));   // 429 にした数
+	uint64_t	clients;    // 使っている枠
+	uint64_t	reused;     // 満杯に戻った枠を別のクライアントに回した数
+	uint64_t	overflow;   // 枠が取れずに通した数
+	t_rlslot	slot[RL_SLOTS] __attribute__((aligned(64)));
+}	t_rlimit;
+
+// rate: 1 クライアントの 1 秒あたりのリクエスト数、burst: 続けて受けられる数（0 なら rate 分、最低 1）。NULL: 確保できない
+t_rlimit	*rl_new(double rate, uint32_t burst);
+void		rl_free(t_rlimit *rl);
+// accept で受けたアドレスから鍵を作る（0 にはならない）。Unix ソケットは fd の SO_PEERCRED を見る
+uint64_t	rl_key(int fd, const struct sockaddr *sa, socklen_t len);
+// 1 リクエスト分のトークンを取れたら 1、取れなければ 0
+int			rl_allow(t_rlimit *rl, uint64_t key);
+
+#endif
@@ -0,0 +1,336 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "router.h"
+
+// 1 バケットあたりのキーの数の目安。大きいほど disp は小さく、作るのに時間がかかる
+#define PHF_LAMBDA   4
+#define PHF_DISP_MAX (1u << 20)
+#define PHF_TRIES    64
+
+int	router_add(t_router *r, const char *path, int kind, void *data)
+{
+	size_t	len = strlen(path);
+
+	if (r->compiled || len > UINT32_MAX)
+		return -1;
+	if (r->n == r->cap)
+	{
+		size_t	ncap = r->cap ? r->cap * 2 : 16;
+		t_rent	*ne = realloc(r->ent, ncap * sizeof(t_rent));
+		if (!ne)
+			return -1;
+		r->ent = ne;
+		r->cap = ncap;
+	}
+	if ((r->ent[r->n].path = strdup(path)) == NULL)
+		return -1;
+	r->ent[r->n].len = (uint32_t)len;
+	r->ent[r->n].kind = kind;
+	r->ent[r->n].data = data;
+	r->n++;
+	return 0;
+}
+
+// [0, n) に詰める（剰余の代わりに掛け算とシフト）
+static inline uint32_t	reduce(uint32_t x, uint32_t n)
+{
+	return (uint32_t)(((uint64_t)x * n) >> 32);
+}
+
+static inline uint64_t	phf_hash(const char *s, size_t n, uint64_t seed)
+{
+	uint64_t h = 1469598103934665603ull ^ seed;
+
+	for (size_t i = 0; i < n; i++)
+		h = (h ^ (unsigned char)s[i]) * 1099511628211ull;
+	// FNV は下位ビットの散りが弱いので、上下を混ぜてから bucket（上位）と slot の元（下位）に分ける
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdull;
+	h ^= h >> 33;
+	return h;
+}
+
+static inline uint32_t	phf_slot(uint32_t f, uint32_t d, uint32_t n)
+{
+	uint32_t x = f ^ (d * 0x9e3779b9u);
+
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return reduce(x, n);
+}
+
+static int	cmp_ent_ptr(const void *a, const void *b)
+{
+	return strcmp((*(const t_rent *const *)a)->path, (*(const t_rent *const *)b)->path);
+}
+
+static int	cmp_bucket_size(const void *a, const void *b, void *arg)
+{
+	const uint32_t	*cnt = arg;
+	uint32_t		x = cnt[*(const uint32_t *)a];
+	uint32_t		y = cnt[*(const uint32_t *)b];
+
+	return (x < y) - (x > y);
+}
+
+/*
+ * hash and displace: キーをバケットに分け、大きいバケットから順に「バケット内のキーが全部空きスロットに
+ * 落ちる d」を 0 から探す。見つからないバケットがあれば seed を変えてやり直す
+ */
+static int	phf_build(t_router *r, t_rent **ex, uint32_t n)
+{
+	uint32_t	nb = (n + PHF_LAMBDA - 1) / PHF_LAMBDA;
+	uint64_t	*h = malloc(n * sizeof(uint64_t));
+	uint32_t	*cnt = malloc(nb * sizeof(uint32_t));
+	uint32_t	*start = malloc((nb + 1) * sizeof(uint32_t));
+	uint32_t	*keys = malloc(n * sizeof(uint32_t));
+	uint32_t	*order = malloc(nb * sizeof(uint32_t));
+	uint32_t	*tmp = malloc(n * sizeof(uint32_t));
+	uint8_t		*taken = malloc(n);
+	int			ok = 0;
+
+	r->disp = calloc(nb, sizeof(uint32_t));
+	r->slot = malloc(n * sizeof(uint32_t));
+	if (!h || !cnt || !start || !keys || !order || !tmp || !taken || !r->disp || !r->slot)
+		goto out;
+	for (uint32_t t = 0; t < PHF_TRIES && !ok; t++)
+	{
+		uint64_t seed = (uint64_t)(t + 1) * 0x9e3779b97f4a7c15ull;
+
+		memset(cnt, 0, nb * sizeof(uint32_t));
+		for (uint32_t i = 0; i < n; i++)
+		{
+			h[i] = phf_hash(ex[i]->path, ex[i]->len, seed);
+			cnt[reduce((uint32_t)(h[i] >> 32), nb)]++;
+		}
+		start[0] = 0;
+		for (uint32_t b = 0; b < nb; b++)
+			start[b + 1] = start[b] + cnt[b];
+		memcpy(tmp, start, nb * sizeof(uint32_t));
+		for (uint32_t i = 0; i < n; i++)
+			keys[tmp[reduce((uint32_t)(h[i] >> 32), nb)]++] = i;
+		for (uint32_t b = 0; b < nb; b++)
+			order[b] = b;
+		qsort_r(order, nb, sizeof(uint32_t), cmp_bucket_size, cnt);
+		memset(taken, 0, n);
+		ok = 1;
+		for (uint32_t oi = 0; oi < nb && ok; oi++)
+		{
+			uint32_t	b = order[oi];
+			uint32_t	d;
+
+			if (cnt[b] == 0)
+				break;
+			for (d = 0; d < PHF_DISP_MAX; d++)
+			{
+				uint32_t k;
+
+				for (k = 0; k < cnt[b]; k++)
+				{
+					uint32_t s = phf_slot((uint32_t)h[keys[start[b] + k]], d, n);
+					if (taken[s])
+						break;
+					taken[s] = 1;
+					tmp[k] = s;
+				}
+				if (k == cnt[b])
+					break;
+				while (k-- > 0)
+					taken[tmp[k]] = 0;
+			}
+			if (d == PHF_DISP_MAX)
+			{
+				ok = 0;
+				break;
+			}
+			r->disp[b] = d;
+			for (uint32_t k = 0; k < cnt[b]; k++)
+				r->slot[tmp[k]] = (uint32_t)(ex[keys[start[b] + k]] - r->ent);
+		}
+		if (ok)
+			r->seed = seed;
+	}
+	if (!ok)
+		fprintf(stderr, "router: cannot build a perfect hash for %u routes\n", n);
+	r->nexact = n;
+	r->nbucket = nb;
+out:
+	free(h);
+	free(cnt);
+	free(start);
+	free(keys);
+	free(order);
+	free(tmp);
+	free(taken);
+	return ok ? 0 : -1;
+}
+
+/*
+ * 並べたプレフィックス px[lo, hi) はどれも先頭 depth バイトが同じ。次の 1 バイトで分け、
+ * 分けた組ごとに共通部分（= 組の最初と最後の共通部分）を 1 本の辺にする
+ */
+static void	trie_build(t_router *r, t_rent **px, const uint32_t *poff, size_t lo, size_t hi,
+	uint32_t depth, size_t ni)
+{
+	size_t	c;
+
+	r->nodes[ni].ent = -1;
+	if (lo < hi && px[lo]->len == depth)
+		r->nodes[ni].ent = (int32_t)(px[lo++] - r->ent);
+	r->nodes[ni].child = (uint32_t)r->nnodes;
+	r->nodes[ni].nchild = 0;
+	for (size_t a = lo; a < hi; )
+	{
+		size_t b = a + 1;
+		while (b < hi && px[b]->path[depth] == px[a]->path[depth])
+			b++;
+		r->nodes[ni].nchild++;
+		a = b;
+	}
+	r->nnodes += r->nodes[ni].nchild;
+	c = r->nodes[ni].child;
+	for (size_t a = lo; a < hi; c++)
+	{
+		size_t		b = a + 1;
+		uint32_t	lcp = depth + 1;
+
+		while (b < hi && px[b]->path[depth] == px[a]->path[depth])
+			b++;
+		while (lcp < px[a]->len && lcp < px[b - 1]->len && px[a]->path[lcp] == px[b - 1]->path[lcp])
+			lcp++;
+		r->nodes[c].label = poff[a] + depth;
+		r->nodes[c].label_len = lcp - depth;
+		r->first[c] = (uint8_t)px[a]->path[depth];
+		trie_build(r, px, poff, a, b, lcp, c);
+		a = b;
+	}
+}
+
+static int	has_dup(t_rent **v, size_t n)
+{
+	for (size_t i = 1; i < n; i++)
+	{
+		if (strcmp(v[i - 1]->path, v[i]->path) == 0)
+		{
+			fprintf(stderr, "router: duplicate %s route %s\n",
+				v[i]->kind == ROUTE_PREFIX ? "prefix" : "exact", v[i]->path);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int	router_compile(t_router *r)
+{
+	t_rent		**ex = malloc((r->n + 1) * sizeof(t_rent *));
+	t_rent		**px = malloc((r->n + 1) * sizeof(t_rent *));
+	uint32_t	*poff = malloc((r->n + 1) * sizeof(uint32_t));
+	size_t		nex = 0;
+	size_t		npx = 0;
+	size_t		plen = 0;
+	int			rc = -1;
+
+	if (r->compiled || !ex || !px || !poff)
+		goto out;
+	for (size_t i = 0; i < r->n; i++)
+	{
+		if (r->ent[i].kind == ROUTE_PREFIX)
+			px[npx++] = &r->ent[i];
+		else
+			ex[nex++] = &r->ent[i];
+	}
+	qsort(ex, nex, sizeof(t_rent *), cmp_ent_ptr);
+	qsort(px, npx, sizeof(t_rent *), cmp_ent_ptr);
+	if (has_dup(ex, nex) || has_dup(px, npx))
+		goto out;
+	if (nex > 0 && phf_build(r, ex, (uint32_t)nex) != 0)
+		goto out;
+	if (npx > 0)
+	{
+		for (size_t i = 0; i < npx; i++)
+		{
+			poff[i] = (uint32_t)plen;
+			plen += px[i]->len;
+		}
+		// 節は多くても「プレフィックスごとに葉と分かれ目を 1 つずつ」+ 根
+		r->nodes = malloc((2 * npx + 1) * sizeof(t_rnode));
+		r->first = malloc(2 * npx + 1);
+		r->pool = malloc(plen + 1);
+		if (!r->nodes || !r->first || !r->pool)
+			goto out;
+		for (size_t i = 0; i < npx; i++)
+			memcpy(r->pool + poff[i], px[i]->path, px[i]->len);
+		r->nodes[0].label = 0;
+		r->nodes[0].label_len = 0;
+		r->first[0] = 0;
+		r->nnodes = 1;
+		trie_build(r, px, poff, 0, npx, 0, 0);
+	}
+	r->compiled = 1;
+	rc = 0;
+out:
+	free(ex);
+	free(px);
+	free(poff);
+	return rc;
+}
+
+void	*router_match(const t_router *r, const char *path, size_t len)
+{
+	if (r->nexact > 0)
+	{
+		uint64_t		h = phf_hash(path, len, r->seed);
+		uint32_t		b = reduce((uint32_t)(h >> 32), r->nbucket);
+		const t_rent	*e = &r->ent[r->slot[phf_slot((uint32_t)h, r->disp[b], r->nexact)]];
+
+		if (e->len == len && memcmp(e->path, path, len) == 0)
+			return e->data;
+	}
+	if (r->nnodes == 0)
+		return NULL;
+
+	const t_rnode	*nd = &r->nodes[0];
+	int32_t			best = nd->ent;
+	size_t			pos = 0;
+
+	while (pos < len && nd->nchild > 0)
+	{
+		const t_rnode	*next = NULL;
+		uint8_t			c = (uint8_t)path[pos];
+
+		for (uint32_t i = nd->child; i < nd->child + nd->nchild && r->first[i] <= c; i++)
+		{
+			if (r->first[i] == c)
+			{
+				next = &r->nodes[i];
+				break;
+			}
+		}
+		if (!next || next->label_len > len - pos || memcmp(r->pool + next->label, path + pos, next->label_len) != 0)
+			break;
+		pos += next->label_len;
+		nd = next;
+		if (nd->ent >= 0)
+			best = nd->ent;
+	}
+	return best >= 0 ? r->ent[best].data : NULL;
+}
+
+void	router_free(t_router *r)
+{
+	for (size_t i = 0; i < r->n; i++)
+		free(r->ent[i].path);
+	free(r->ent);
+	free(r->disp);
+	free(r->slot);
+	free(r->nodes);
+	free(r->first);
+	free(r->pool);
+	memset(r, 0, sizeof(*r));
+}
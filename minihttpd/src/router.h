@@ -0,0 +1,70 @@
+#ifndef ROUTER_H
+#define ROUTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * パス -> ルート（呼び出し側のポインタ 1 つ）の振り分け
+ *
+ * router_add で登録し、router_compile で 1 回だけ引くための形に組み直す。引くとき（router_match）は
+ * メモリを確保せず、パスの長さ以外にはほぼ依存しない時間で終わる。
+ *
+ * - ROUTE_EXACT: パス全体が一致するもの。最小完全ハッシュ（hash and displace）に入れる。
+ *   パスを 1 回ハッシュし、バケットの displacement を 1 つ引いてスロットを決め、そのスロットの
+ *   1 本とだけ比べる（スロット数 = ルート数）
+ * - ROUTE_PREFIX: パスの先頭が一致するもの（"/static/" なら "/static/a.txt" も）。
+ *   path compression した radix trie を配列に平らにしたものをたどり、いちばん長く一致したものを返す
+ *
+ * EXACT が先で、一致しなければ PREFIX を見る。同じ種類で同じパスを 2 回登録すると router_compile が失敗する。
+ */
+
+#define ROUTE_EXACT  0
+#define ROUTE_PREFIX 1
+
+typedef struct s_rent
+{
+	char		*path;
+	uint32_t	len;
+	int			kind;
+	void		*data;
+}	t_rent;
+
+// trie の節。子は nodes[child .. child + nchild) に first の昇順で並ぶ
+typedef struct s_rnode
+{
+	uint32_t	label;      // 辺のラベル（pool の中のオフセット）
+	uint32_t	label_len;
+	uint32_t	child;
+	uint32_t	nchild;
+	int32_t		ent;        // ここで終わるプレフィックスの ent の番号（無ければ -1）
+}	t_rnode;
+
+typedef struct s_router
+{
+	t_rent		*ent;
+	size_t		n;
+	size_t		cap;
+	int			compiled;
+	// 完全ハッシュ: slot = hash(path, seed) から bucket -> disp[bucket] -> slot -> ent の番号
+	uint64_t	seed;
+	uint32_t	nexact;
+	uint32_t	nbucket;
+	uint32_t	*disp;
+	uint32_t	*slot;
+	// radix trie（nodes[0] が根）
+	t_rnode		*nodes;
+	uint8_t		*first;     // first[i] は nodes[i] のラベルの先頭バイト（子を探すときこれだけ舐める）
+	size_t		nnodes;
+	char		*pool;
+}	t_router;
+
+// 0 / -1（メモリ不足、router_compile のあと）。path はコピーする
+int		router_add(t_router *r, const char *path, int kind, void *data);
+// 0 / -1（重複したパスは stderr に出す）
+int		router_compile(t_router *r);
+// 一致したルートの data。無ければ NULL
+void	*router_match(const t_router *r, const char *path, size_t len);
+void	router_free(t_router *r);
+
+#endif
@@ -0,0 +1,231 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "wpool.h"
+
+typedef struct s_wpool_arg
+{
+	t_wpool	*p;
+	int		self;
+}	t_wpool_arg;
+
+// このスレッドの deque の番号（0: I/O ループ）
+static __thread int	t_self;
+
+/*
+ * Chase-Lev deque（Lê, Pop, Cohen, Zappa Nardelli 2013 の C11 版を __atomic で）。
+ * 大きさは固定で、あふれたら積まない
+ */
+static int	dq_push(t_wsdeque *d, t_job *job)
+{
+	int64_t b = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED);
+	int64_t t = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+
+	if (b - t >= WPOOL_DEQUE_CAP)
+		return -1;
+	__atomic_store_n(&d->buf[b & (WPOOL_DEQUE_CAP - 1)], job, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+	return 0;
+}
+
+static t_job	*dq_take(t_wsdeque *d)
+{
+	int64_t	b = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED) - 1;
+	int64_t	t;
+	t_job	*job = NULL;
+
+	__atomic_store_n(&d->bottom, b, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	t = __atomic_load_n(&d->top, __ATOMIC_RELAXED);
+	if (t <= b)
+	{
+		job = __atomic_load_n(&d->buf[b & (WPOOL_DEQUE_CAP - 1)], __ATOMIC_RELAXED);
+		if (t == b)
+		{
+			// 最後の 1 つは盗む側と取り合いになる
+			if (!__atomic_compare_exchange_n(&d->top, &t, t + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+				job = NULL;
+			__atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+		}
+	}
+	else
+		__atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+	return job;
+}
+
+static t_job	*dq_steal(t_wsdeque *d)
+{
+	int64_t	t = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+	int64_t	b;
+	t_job	*job;
+
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	b = __atomic_load_n(&d->bottom, __ATOMIC_ACQUIRE);
+	if (t >= b)
+		return NULL;
+	job = __atomic_load_n(&d->buf[t & (WPOOL_DEQUE_CAP - 1)], __ATOMIC_RELAXED);
+	if (!__atomic_compare_exchange_n(&d->top, &t, t + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+		return NULL;
+	return job;
+}
+
+// 自分の deque、I/O ループの deque、ほかのワーカーの順に見る（ほかは毎回ずらした位置から）
+static t_job	*find_job(t_wpool *p, int self, unsigned *rot)
+{
+	t_job *job;
+
+	if ((job = dq_take(&p->dq[self])) != NULL || (job = dq_steal(&p->dq[0])) != NULL)
+		return job;
+	for (int k = 0; k < p->nthreads; k++)
+	{
+		int v = 1 + (int)((*rot + (unsigned)k) % (unsigned)p->nthreads);
+		if (v != self && (job = dq_steal(&p->dq[v])) != NULL)
+			return job;
+	}
+	(*rot)++;
+	return NULL;
+}
+
+static void	complete(t_wpool *p, t_job *job)
+{
+	t_job		*head = __atomic_load_n(&p->done, __ATOMIC_RELAXED);
+	uint64_t	one = 1;
+
+	do
+		job->next = head;
+	while (!__atomic_compare_exchange_n(&p->done, &head, job, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+	// 空だったときだけ起こす。I/O ループは eventfd を読んでから exchange するので取りこぼさない
+	if (head == NULL && write(p->efd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+		perror("wpool: eventfd");
+}
+
+static void	*worker(void *arg)
+{
+	t_wpool_arg	*a = arg;
+	t_wpool		*p = a->p;
+	unsigned	rot = (unsigned)a->self;
+	t_job		*job;
+
+	t_self = a->self;
+	for (;;)
+	{
+		if ((job = find_job(p, a->self, &rot)) == NULL)
+		{
+			// 寝ると宣言してからもう一度見る（積む側は「積む → 寝ている数を見る」の順なので取りこぼさない）
+			__atomic_fetch_add(&p->nidle, 1, __ATOMIC_SEQ_CST);
+			if ((job = find_job(p, a->self, &rot)) == NULL)
+			{
+				if (__atomic_load_n(&p->stop, __ATOMIC_ACQUIRE))
+				{
+					__atomic_fetch_sub(&p->nidle, 1, __ATOMIC_SEQ_CST);
+					break;
+				}
+				while (sem_wait(&p->idle) != 0 && errno == EINTR)
+					;
+			}
+			__atomic_fetch_sub(&p->nidle, 1, __ATOMIC_SEQ_CST);
+			if (!job)
+				continue;
+		}
+		job->run(job);
+		complete(p, job);
+	}
+	return NULL;
+}
+
+int	wpool_start(t_wpool *p, int nthreads)
+{
+	memset(p, 0, sizeof(*p));
+	p->efd = -1;
+	sem_init(&p->idle, 0, 0);
+	if (nthreads < 1)
+		return -1;
+	p->nthreads = nthreads;
+	p->th = calloc((size_t)nthreads, sizeof(pthread_t));
+	p->args = calloc((size_t)nthreads, sizeof(t_wpool_arg));
+	if (!p->th || !p->args
+		|| posix_memalign((void **)&p->dq, 64, (size_t)(nthreads + 1) * sizeof(t_wsdeque)) != 0)
+		goto fail;
+	memset(p->dq, 0, (size_t)(nthreads + 1) * sizeof(t_wsdeque));
+	for (int i = 0; i <= nthreads; i++)
+		if ((p->dq[i].buf = calloc(WPOOL_DEQUE_CAP, sizeof(t_job *))) == NULL)
+			goto fail;
+	if ((p->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+		goto fail;
+	t_self = 0;
+	for (; p->nrun < nthreads; p->nrun++)
+	{
+		p->args[p->nrun] = (t_wpool_arg){p, p->nrun + 1};
+		if (pthread_create(&p->th[p->nrun], NULL, worker, &p->args[p->nrun]) != 0)
+			goto fail;
+	}
+	return 0;
+fail:
+	perror("wpool");
+	wpool_stop(p);
+	return -1;
+}
+
+int	wpool_submit(t_wpool *p, t_job *job)
+{
+	if (dq_push(&p->dq[t_self], job) != 0)
+		return -1;
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&p->nidle, __ATOMIC_SEQ_CST) > 0)
+		sem_post(&p->idle);
+	return 0;
+}
+
+int	wpool_fd(const t_wpool *p)
+{
+	return p->efd;
+}
+
+t_job	*wpool_done(t_wpool *p)
+{
+	uint64_t	v;
+	t_job		*list;
+	t_job		*rev = NULL;
+
+	if (read(p->efd, &v, sizeof(v)) < 0 && errno != EAGAIN)
+		perror("wpool: eventfd");
+	list = __atomic_exchange_n(&p->done, NULL, __ATOMIC_ACQUIRE);
+	// スタックなので新しい順。積んだ順に直して返す
+	while (list)
+	{
+		t_job *next = list->next;
+		list->next = rev;
+		rev = list;
+		list = next;
+	}
+	return rev;
+}
+
+t_job	*wpool_stop(t_wpool *p)
+{
+	t_job *left;
+
+	__atomic_store_n(&p->stop, 1, __ATOMIC_RELEASE);
+	for (int i = 0; i < p->nrun; i++)
+		sem_post(&p->idle);
+	for (int i = 0; i < p->nrun; i++)
+		pthread_join(p->th[i], NULL);
+	left = (p->efd >= 0) ? wpool_done(p) : NULL;
+	for (int i = 0; p->dq && i <= p->nthreads; i++)
+		free(p->dq[i].buf);
+	free(p->dq);
+	free(p->th);
+	free(p->args);
+	if (p->efd >= 0)
+		close(p->efd);
+	sem_destroy(&p->idle);
+	memset(p, 0, sizeof(*p));
+	p->efd = -1;
+	return left;
+}
@@ -0,0 +1,62 @@
+#ifndef WPOOL_H
+#define WPOOL_H
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdint.h>
+
+/*
+ * ブロックするハンドラ用の work-stealing スレッドプール
+ *
+ * - 仕事は Chase-Lev の deque に積む。deque は 1 本につき持ち主が 1 スレッドで、持ち主だけが
+ *   下（bottom）に積み・下から取り、ほかのスレッドは上（top）から CAS で盗む
+ * - deque[0] は wpool_start を呼んだスレッド（I/O ループ）のもの。I/O ループは積むだけで、
+ *   ワーカーが盗んでいく。ワーカーが仕事の中から wpool_submit すると自分の deque に積まれ、
+ *   空いたワーカーがそれも盗む
+ * - 終わった仕事は lock-free の MPSC スタック（CAS で積み、I/O ループが exchange でまとめて取る）に返し、
+ *   空から積んだときだけ eventfd を 1 回書く。I/O ループは wpool_fd を epoll で待つので、ロックも
+ *   ブロックもしない
+ * - 仕事の無いワーカーはセマフォで寝る。積む側は寝ている数が 0 のときは sem_post も呼ばない
+ */
+
+#define WPOOL_DEQUE_CAP 4096   // 2 冪。I/O ループの deque があふれたら wpool_submit は -1
+
+typedef struct s_job
+{
+	void			(*run)(struct s_job *job);
+	struct s_job	*next;     // 完了スタックのつなぎ
+}	t_job;
+
+typedef struct s_wsdeque
+{
+	int64_t	top __attribute__((aligned(64)));
+	int64_t	bottom __attribute__((aligned(64)));
+	t_job	**buf;
+}	t_wsdeque;
+
+typedef struct s_wpool
+{
+	int					nthreads;
+	int					nrun;      // 起動できたワーカーの数
+	pthread_t			*th;
+	t_wsdeque			*dq;       // [0] は I/O ループ、[1..nthreads] はワーカー
+	sem_t				idle;
+	int					nidle;
+	int					stop;
+	int					efd;
+	struct s_wpool_arg	*args;
+	t_job				*done __attribute__((aligned(64)));
+}	t_wpool;
+
+// 0 / -1。nthreads は 1 以上
+int		wpool_start(t_wpool *p, int nthreads);
+// job->run をどれかのワーカーで呼ぶ。wpool_start したスレッドかワーカーの中からだけ呼ぶ。0 / -1（満杯）
+int		wpool_submit(t_wpool *p, t_job *job);
+// 完了が返ってくると読めるようになる eventfd
+int		wpool_fd(const t_wpool *p);
+// 返ってきた完了を積んだ順につないで返す（I/O ループから）。無ければ NULL
+t_job	*wpool_done(t_wpool *p);
+// 積まれている仕事を全部実行し終えてから止める。まだ wpool_done で受け取っていない完了を返す
+t_job	*wpool_stop(t_wpool *p);
+
+#endif
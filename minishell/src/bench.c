@@ -0,0 +1,209 @@
+#define _GNU_SOURCE
+#include "bench.h"
+
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "exec.h"
+#include "parse.h"
+#include "util.h"
+
+/*
+ * --- perf_event カウンタ（あれば使う） ---
+ * inherit=1 にしておくと、この後 fork した子（実行されるコマンド）の分も合算される。
+ */
+typedef struct s_counters
+{
+	int	syscalls_fd;   // tracepoint raw_syscalls:sys_enter（-1 なら無し）
+	int	cs_fd;         // PERF_COUNT_SW_CONTEXT_SWITCHES（-1 なら無し）
+}	t_counters;
+
+static int	perf_open(uint32_t type, uint64_t config)
+{
+	struct perf_event_attr	attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.disabled = 1;
+	attr.inherit = 1;
+	attr.exclude_hv = 1;
+	return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static long long	tracepoint_id(const char *event)
+{
+	const char	*roots[] = {"/sys/kernel/tracing/events", "/sys/kernel/debug/tracing/events"};
+	char		path[256];
+	long long	id = -1;
+
+	for (size_t i = 0; i < sizeof(roots) / sizeof(roots[0]) && id < 0; i++)
+	{
+		snprintf(path, sizeof(path), "%s/%s/id", roots[i], event);
+		FILE *fp = fopen(path, "r");
+		if (!fp)
+			continue;
+		if (fscanf(fp, "%lld", &id) != 1)
+			id = -1;
+		fclose(fp);
+	}
+	return id;
+}
+
+static void	counters_open(t_counters *c)
+{
+	long long id = tracepoint_id("raw_syscalls/sys_enter");
+
+	c->syscalls_fd = (id >= 0) ? perf_open(PERF_TYPE_TRACEPOINT, (uint64_t)id) : -1;
+	c->cs_fd = perf_open(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES);
+}
+
+static void	counters_ctl(const t_counters *c, unsigned long req)
+{
+	if (c->syscalls_fd >= 0)
+		ioctl(c->syscalls_fd, req, 0);
+	if (c->cs_fd >= 0)
+		ioctl(c->cs_fd, req, 0);
+}
+
+static long long	counter_read(int fd)
+{
+	uint64_t v;
+
+	if (fd < 0 || read(fd, &v, sizeof(v)) != (ssize_t)sizeof(v))
+		return -1;
+	return (long long)v;
+}
+
+static void	counters_close(t_counters *c)
+{
+	if (c->syscalls_fd >= 0)
+		close(c->syscalls_fd);
+	if (c->cs_fd >= 0)
+		close(c->cs_fd);
+}
+
+/*
+ * --- 統計 ---
+ */
+static int	cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+// nearest-rank 法（p は 0..100）
+static double	percentile(const double *sorted, long n, double p)
+{
+	long rank = (long)((p / 100.0) * (double)n + 0.999999);
+	if (rank < 1)
+		rank = 1;
+	if (rank > n)
+		rank = n;
+	return sorted[rank - 1];
+}
+
+static double	now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+int	bench_run_line(const char *input, const t_bench_opts *opt)
+{
+	t_cmdline	cl;
+	t_counters	ctr;
+	double		*lat;
+	int			code;
+	int			failed = 0;
+
+	if (!input || is_blank_line(input) || opt->iters <= 0)
+		return 2;
+	code = parse_command_line(input, &cl);
+	if (code != 0)
+		return code;
+
+	lat = calloc((size_t)opt->iters, sizeof(double));
+	if (!lat)
+	{
+		free_command_line(&cl);
+		fprintf(stderr, "minishell: out of memory\n");
+		return 1;
+	}
+
+	for (int i = 0; i < opt->warmup; i++)
+		exec_cmdline(&cl);
+
+	counters_open(&ctr);
+	counters_ctl(&ctr, PERF_EVENT_IOC_RESET);
+	counters_ctl(&ctr, PERF_EVENT_IOC_ENABLE);
+
+	double t0 = now_us();
+	for (long i = 0; i < opt->iters; i++)
+	{
+		double s = now_us();
+		code = exec_cmdline(&cl);
+		lat[i] = now_us() - s;
+		if (code != 0)
+			failed++;
+	}
+	double wall_us = now_us() - t0;
+
+	counters_ctl(&ctr, PERF_EVENT_IOC_DISABLE);
+	long long nsys = counter_read(ctr.syscalls_fd);
+	long long ncs = counter_read(ctr.cs_fd);
+	counters_close(&ctr);
+
+	qsort(lat, (size_t)opt->iters, sizeof(double), cmp_double);
+	double sum = 0;
+	for (long i = 0; i < opt->iters; i++)
+		sum += lat[i];
+	double per_sec = (wall_us > 0) ? (double)opt->iters * 1e6 / wall_us : 0;
+
+	fflush(stdout);
+	if (opt->json)
+	{
+		printf("{\"line\":");
+		json_str(stdout, input);
+		printf(",\"iters\":%ld,\"warmup\":%d,\"failed\":%d,"
+			"\"min_us\":%.1f,\"p50_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.1f,\"mean_us\":%.1f,"
+			"\"cmds_per_sec\":%.1f",
+			opt->iters, opt->warmup, failed,
+			lat[0], percentile(lat, opt->iters, 50), percentile(lat, opt->iters, 99),
+			lat[opt->iters - 1], sum / (double)opt->iters, per_sec);
+		if (nsys >= 0)
+			printf(",\"syscalls_per_iter\":%.1f", (double)nsys / (double)opt->iters);
+		if (ncs >= 0)
+			printf(",\"ctxsw_per_iter\":%.1f", (double)ncs / (double)opt->iters);
+		printf("}\n");
+	}
+	else
+	{
+		printf("bench: %.*s\n", (int)strcspn(input, "\n"), input);   // heredoc の本文は出さない
+		printf("  iters %ld (warmup %d), failed %d\n", opt->iters, opt->warmup, failed);
+		printf("  min %.1f us  p50 %.1f us  p99 %.1f us  max %.1f us  mean %.1f us\n",
+			lat[0], percentile(lat, opt->iters, 50), percentile(lat, opt->iters, 99),
+			lat[opt->iters - 1], sum / (double)opt->iters);
+		printf("  %.1f cmds/sec\n", per_sec);
+		if (nsys >= 0)
+			printf("  syscalls/iter %.1f\n", (double)nsys / (double)opt->iters);
+		if (ncs >= 0)
+			printf("  ctxsw/iter %.1f\n", (double)ncs / (double)opt->iters);
+	}
+	fflush(stdout);
+
+	free(lat);
+	free_command_line(&cl);
+	return code;
+}
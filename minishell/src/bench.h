@@ -0,0 +1,25 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+/*
+ * :bench [-j] [-w W] N <line>
+ *
+ * line を 1 回だけパースし、exec_cmdline（run_command_line と同じ実行経路）で
+ * W 回の warm-up の後に N 回実行する。
+ * min / p50 / p99 / max の latency と commands/sec を出す。
+ * perf_event が使えれば（root か perf_event_paranoid 次第）syscall 数と
+ * コンテキストスイッチ数も子プロセス込みで数える。
+ * - json: 人間向けの表ではなく JSON 1 行を stdout に出す（ビルド間の diff 用）
+ *
+ * 返り値: 最後の実行の exit status
+ */
+typedef struct s_bench_opts
+{
+	int		json;
+	int		warmup;
+	long	iters;
+}	t_bench_opts;
+
+int	bench_run_line(const char *input, const t_bench_opts *opt);
+
+#endif
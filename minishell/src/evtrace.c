@@ -0,0 +1,177 @@
+#define _GNU_SOURCE
+#include "evtrace.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#define EV_RING_CAP 1024   // 2 冪。1 行でこれを超えたら古い方から上書きされる
+
+typedef struct s_ev
+{
+	uint64_t	ns;
+	int32_t		pid;
+	int16_t		type;
+	int16_t		stage;   // 段番号（-1 なら段に属さない）
+	int64_t		a;
+	int64_t		b;
+	uint64_t	seq;     // 書き終わったら「通し番号 + 1」。途中のスロットを読み飛ばすため
+}	t_ev;
+
+typedef struct s_ev_ring
+{
+	int			enabled;
+	uint64_t	head;    // 次に書く通し番号
+	uint64_t	base;    // evtrace_begin した時点の head
+	t_ev		ev[EV_RING_CAP];
+}	t_ev_ring;
+
+static t_ev_ring	*g_ring;
+
+static const char	*g_names[] = {
+	"line", "parse", "pipe", "fork", "spawn", "dup2", "exec", "exec-fail", "exit", "done",
+};
+
+static uint64_t	now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+int	evtrace_init(void)
+{
+	void	*p;
+
+	if (g_ring)
+		return 0;
+	p = mmap(NULL, sizeof(t_ev_ring), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		return -1;
+	g_ring = p;
+	return 0;
+}
+
+void	evtrace_enable(int on)
+{
+	if (g_ring)
+		__atomic_store_n(&g_ring->enabled, on, __ATOMIC_RELAXED);
+}
+
+int	evtrace_enabled(void)
+{
+	return g_ring && __atomic_load_n(&g_ring->enabled, __ATOMIC_RELAXED);
+}
+
+void	evtrace_rec(t_ev_type type, int stage, long a, long b)
+{
+	if (!evtrace_enabled())
+		return;
+
+	uint64_t	i = __atomic_fetch_add(&g_ring->head, 1, __ATOMIC_RELAXED);
+	t_ev		*e = &g_ring->ev[i & (EV_RING_CAP - 1)];
+
+	e->ns = now_ns();
+	e->pid = (int32_t)getpid();
+	e->type = (int16_t)type;
+	e->stage = (int16_t)stage;
+	e->a = a;
+	e->b = b;
+	__atomic_store_n(&e->seq, i + 1, __ATOMIC_RELEASE);
+}
+
+void	evtrace_begin(void)
+{
+	if (!evtrace_enabled())
+		return;
+	g_ring->base = __atomic_load_n(&g_ring->head, __ATOMIC_ACQUIRE);
+	evtrace_rec(EV_LINE, -1, 0, 0);
+}
+
+static int	cmp_ev(const void *x, const void *y)
+{
+	const t_ev *a = x;
+	const t_ev *b = y;
+
+	if (a->ns != b->ns)
+		return (a->ns > b->ns) - (a->ns < b->ns);
+	return (a->seq > b->seq) - (a->seq < b->seq);
+}
+
+static int	format_args(char *buf, size_t sz, const t_ev *e)
+{
+	long long a = (long long)e->a;
+	long long b = (long long)e->b;
+
+	switch (e->type)
+	{
+	case EV_PARSE:
+		return snprintf(buf, sz, "ncmd=%lld", a);
+	case EV_PIPE:
+		return snprintf(buf, sz, "r=%lld w=%lld", a, b);
+	case EV_FORK:
+	case EV_SPAWN:
+		return snprintf(buf, sz, "child=%lld", a);
+	case EV_DUP2:
+		return snprintf(buf, sz, "%lld -> %lld", a, b);
+	case EV_EXIT:
+		return snprintf(buf, sz, "child=%lld code=%lld", a, b);
+	case EV_DONE:
+		return snprintf(buf, sz, "code=%lld", a);
+	default:
+		buf[0] = '\0';
+		return 0;
+	}
+}
+
+void	evtrace_dump(FILE *fp, const char *line)
+{
+	t_ev		*evs;
+	uint64_t	head;
+	uint64_t	first;
+	size_t		n = 0;
+
+	if (!evtrace_enabled())
+		return;
+	head = __atomic_load_n(&g_ring->head, __ATOMIC_ACQUIRE);
+	first = g_ring->base;
+	if (head - first > EV_RING_CAP)
+		first = head - EV_RING_CAP;
+
+	// 並べ替えのためにコピーする（その間も子が書き込んでいるかもしれない）
+	evs = malloc((size_t)(head - first) * sizeof(t_ev) + 1);
+	if (!evs)
+		return;
+	for (uint64_t i = first; i < head; i++)
+	{
+		const t_ev *e = &g_ring->ev[i & (EV_RING_CAP - 1)];
+		if (__atomic_load_n(&e->seq, __ATOMIC_ACQUIRE) == i + 1)
+			evs[n++] = *e;
+	}
+	qsort(evs, n, sizeof(t_ev), cmp_ev);
+
+	fprintf(fp, "trace lite: %s  (%zu events, %llu dropped)\n",
+		line, n, (unsigned long long)(first - g_ring->base));
+	for (size_t i = 0; i < n; i++)
+	{
+		const t_ev	*e = &evs[i];
+		char		stage[16] = "";
+		char		args[64];
+
+		if (e->stage >= 0)
+			snprintf(stage, sizeof(stage), "stage %d", e->stage);
+		if (format_args(args, sizeof(args), e) > 0)
+			fprintf(fp, "  +%10.1f us  pid %-7d %-9s %-8s %s\n",
+				(double)(e->ns - evs[0].ns) / 1e3, e->pid, g_names[e->type], stage, args);
+		else if (stage[0])
+			fprintf(fp, "  +%10.1f us  pid %-7d %-9s %s\n",
+				(double)(e->ns - evs[0].ns) / 1e3, e->pid, g_names[e->type], stage);
+		else
+			fprintf(fp, "  +%10.1f us  pid %-7d %s\n",
+				(double)(e->ns - evs[0].ns) / 1e3, e->pid, g_names[e->type]);
+	}
+	free(evs);
+}
@@ -0,0 +1,43 @@
+#ifndef EVTRACE_H
+#define EVTRACE_H
+
+#include <stdio.h>
+#include <sys/types.h>
+
+/*
+ * :trace lite 用の軽量イベント記録
+ *
+ * strace で包む :trace on と違い、実行系（parse / pipe / fork / dup2 / exec / 回収）が
+ * 自分でイベントを CLOCK_MONOTONIC の時刻つきでリングバッファに書く。
+ * リングは起動時に MAP_SHARED で 1 回だけ確保するので、fork した子（zygote の子も）が
+ * 書いた dup2 / exec もそのまま親から読める。
+ * 1 イベントは clock_gettime（vDSO）+ getpid + atomic 加算 1 回で、数百 ns に収まる。
+ *
+ * - evtrace_init   : リングを確保する（zygote より先に呼ぶこと）
+ * - evtrace_enable : 記録の on/off（共有領域のフラグなので子にも効く）
+ * - evtrace_rec    : イベントを 1 つ書く（off なら何もしない）
+ * - evtrace_begin  : 1 行分の記録を始める（前の行のイベントは捨てる）
+ * - evtrace_dump   : evtrace_begin 以降のイベントを時刻順のタイムラインとして出す
+ */
+typedef enum e_ev_type
+{
+	EV_LINE = 0,    // 行の受け付け
+	EV_PARSE,       // パース完了（a = 段数）
+	EV_PIPE,        // pipe 作成（a = 読み端, b = 書き端）
+	EV_FORK,        // fork した（a = 子の pid）
+	EV_SPAWN,       // zygote に spawn を頼んだ（a = 子の pid）
+	EV_DUP2,        // 子で dup2（a = 元の fd, b = 先の fd）
+	EV_EXEC,        // 子が exec する直前
+	EV_EXEC_FAIL,   // exec 失敗
+	EV_EXIT,        // 子を回収した（a = 子の pid, b = exit code）
+	EV_DONE         // 行の実行が終わった（a = exit status）
+}	t_ev_type;
+
+int		evtrace_init(void);
+void	evtrace_enable(int on);
+int		evtrace_enabled(void);
+void	evtrace_rec(t_ev_type type, int stage, long a, long b);
+void	evtrace_begin(void);
+void	evtrace_dump(FILE *fp, const char *line);
+
+#endif
@@ -5,7 +5,13 @@
 #include <unistd.h>
 #include <string.h>
 
+#include "evtrace.h"
+#include "exec.h"
+#include "jobs.h"
+#include "zygote.h"
+
 int redir_stdout_trunc(const char *path);
+int make_heredoc_fd(const char *data, size_t len);
 
 static void	die_perror(const char *msg)
 {
@@ -16,14 +22,23 @@ static void	die_perror(const char *msg)
 int exec_argv_redir(char *const argv[], const char *out_path)
 {
 	pid_t	pid;
-	int		status = 0;
+	t_proc	proc;
 
 	if (!argv || !argv[0])
 		return 0;
 
+	// zygote があれば spawn は zygote に任せる（1 段のパイプラインとして扱う）
+	if (zygote_active())
+	{
+		char **argvv[1] = {(char **)argv};
+		return exec_pipeline_redir(argvv, 1, out_path);
+	}
+
 	pid = fork();
 	if (pid < 0)
 		die_perror("fork");
+	if (pid > 0)
+		evtrace_rec(EV_FORK, 0, pid, 0);
 
 	if (pid == 0)
 	{
@@ -35,24 +50,76 @@ int exec_argv_redir(char *const argv[], const char *out_path)
 		}
 
 		// 子プロセス：argv[0] をPATH解決して実行
+		evtrace_rec(EV_EXEC, 0, 0, 0);
 		execvp(argv[0], (char *const *)argv);
+		evtrace_rec(EV_EXEC_FAIL, 0, 0, 0);
 		// exec 失敗時のみここに来る
 		fprintf(stderr, "minishell: exec failed: %s\n", argv[0]);
 		_exit(127);
 	}
 
-	// 親：子の終了を待つ
-	if (waitpid(pid, &status, 0) < 0)
-		return 1;
-
-	if (WIFEXITED(status))
-		return WEXITSTATUS(status);
-	if (WIFSIGNALED(status))
-		return 128 + WTERMSIG(status);
-	return 1;
+	// 親：子の終了を待つ（pidfd + poll。パイプラインと同じ待ち方にそろえる）
+	procs_open(&proc, &pid, 1);
+	procs_wait(&proc, 1, -1);
+	procs_close(&proc, 1);
+	return status_to_code(proc.status);
 }
 
 int exec_argv(char *const argv[])
 {
 	return exec_argv_redir(argv, NULL);
 }
+
+static int	g_pipe_size;
+
+void	exec_set_pipe_size(int bytes)
+{
+	g_pipe_size = bytes > 0 ? bytes : 0;
+}
+
+int	exec_pipe_size(void)
+{
+	return g_pipe_size;
+}
+
+int spawn_opts_from_cmdline(const t_cmdline *cl, t_spawn *sp)
+{
+	int	tmp_fd = -1;
+
+	*sp = (t_spawn){.out_fd = -1, .in_fd = -1, .pipe_sz = g_pipe_size};
+	sp->out_path = cl->out_path;
+	if (cl->in_kind == IN_FILE)
+		sp->in_path = cl->in_path;
+	else if (cl->in_kind == IN_DATA)
+	{
+		tmp_fd = make_heredoc_fd(cl->in_data, cl->in_len);
+		if (tmp_fd < 0)
+			perror("minishell: heredoc");
+		sp->in_fd = tmp_fd;
+	}
+	return tmp_fd;
+}
+
+int exec_cmdline(const t_cmdline *cl)
+{
+	if (cl->in_kind == IN_NONE)
+	{
+		if (cl->ncmd == 1)
+		{
+			// 単発コマンドでも「最後だけ >」を適用する
+			return exec_argv_redir(cl->argvv[0], cl->out_path);
+		}
+		// パイプライン全体の「最後だけ >」を適用する
+		return exec_pipeline_redir(cl->argvv, cl->ncmd, cl->out_path);
+	}
+
+	// 入力リダイレクトがあるときは t_spawn で「最初の段の stdin」も指定する
+	t_spawn sp;
+	int tmp_fd = spawn_opts_from_cmdline(cl, &sp);
+	if (cl->in_kind == IN_DATA && tmp_fd < 0)
+		return 1;
+	int code = exec_spawn_wait(cl->argvv, cl->ncmd, &sp);
+	if (tmp_fd >= 0)
+		close(tmp_fd);
+	return code;
+}
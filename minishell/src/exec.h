@@ -0,0 +1,75 @@
+#ifndef EXEC_H
+#define EXEC_H
+
+#include <sys/types.h>
+#include <time.h>
+
+#include "parse.h"
+
+/*
+ * 実行系（exec.c / pipe.c）
+ *
+ * - exec_argv_redir:
+ *     argv で与えた単発コマンドを実行する。
+ *     out_path が非NULLなら、stdout を out_path にリダイレクトして実行する。
+ *
+ * - exec_pipeline_redir:
+ *     argvv[0..n-1]（各要素は argv 配列）からなるパイプラインを実行する。
+ *     out_path が非NULLなら、パイプライン全体の「最後のコマンドの stdout」を out_path にリダイレクトする。
+ *
+ * - exec_cmdline:
+ *     parse_command_line 済みの 1 行を前景で実行する（run_command_line と :bench が使う）。
+ *     バックグラウンド指定は見ない。
+ *
+ * - spawn_opts_from_cmdline:
+ *     cl の入出力リダイレクトを sp に写す（heredoc なら memfd をここで作る）。
+ *     返り値の fd（-1 でなければ）は spawn の後で呼び出し側が close する。
+ *
+ * - exec_spawn_wait:
+ *     t_spawn の指定つきでパイプラインを実行し、終わるまで待つ。
+ *
+ * - exec_set_pipe_size / exec_pipe_size:
+ *     以後のパイプラインで使うパイプ容量（0 なら既定のまま）。:pipesz が設定する。
+ *
+ * - spawn_pipeline:
+ *     パイプラインを fork/exec するだけで待たない（pids[0..n-1] に子の pid を入れる）。
+ *     待ち合わせは jobs.h の procs_* で行う（バックグラウンド job や :parallel もこれを使う）。
+ */
+
+/*
+ * spawn_pipeline に渡す指定（使わない項目は 0 / NULL、out_fd は -1）
+ * - out_path    : 最後の段の stdout を O_TRUNC で開く（"> file"）
+ * - out_fd      : -1 以外なら最後の段の stdout をこの fd にする（out_path が優先）
+ * - in_path     : 最初の段の stdin を O_RDONLY で開く（"< file"）
+ * - in_fd       : -1 以外なら最初の段の stdin をこの fd にする（heredoc の memfd など）
+ * - fork_ts     : 非NULLなら各段を fork した時刻を fork_ts[0..n-1] に記録する（:time 用）
+ * - cgroup_procs: 非NULLなら子は exec 前にこの cgroup.procs に自分を書き込む
+ * - pipe_sz     : 0 より大きければ段の間のパイプ容量を F_SETPIPE_SZ で広げる
+ */
+typedef struct s_spawn
+{
+	const char		*out_path;
+	int				out_fd;
+	const char		*in_path;
+	int				in_fd;
+	struct timespec	*fork_ts;
+	const char		*cgroup_procs;
+	int				pipe_sz;
+}	t_spawn;
+
+int exec_argv(char *const argv[]);
+int exec_argv_redir(char *const argv[], const char *out_path);
+
+int exec_pipeline(char ***argvv, int n);
+int exec_pipeline_redir(char ***argvv, int n, const char *out_path);
+
+int exec_cmdline(const t_cmdline *cl);
+int spawn_opts_from_cmdline(const t_cmdline *cl, t_spawn *sp);
+int exec_spawn_wait(char ***argvv, int n, const t_spawn *sp);
+
+void exec_set_pipe_size(int bytes);
+int exec_pipe_size(void);
+
+int spawn_pipeline(char ***argvv, int n, const t_spawn *sp, pid_t *pids);
+
+#endif
@@ -0,0 +1,194 @@
+#include "focus.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * - include（TRACE_ALL のみ。PIPE は追跡側で絞り込み済み）:
+ *     行中の '(' を memchr で拾い、直前の識別子が空白に続いていれば名前表（ハッシュ）を引く。
+ *     " name(" がどこかにあれば採用（grep と同じく引数の文字列の中でもよい）
+ * - noise / exclude: '/' を memchr で拾って先頭一致、"locale-archive" は '-' を拾って前後を比べる
+ */
+// ALL は scripts/observe/strace_focus.sh、PIPE は strace_focus_pipe.sh の include と同じ組
+static const struct s_focus_sys
+{
+	const char	*name;
+	int			mask;
+}	g_focus_sys[] = {
+	{"execve", FOCUS_M_ALL | FOCUS_M_PIPE}, {"pipe", FOCUS_M_ALL | FOCUS_M_PIPE},
+	{"pipe2", FOCUS_M_ALL | FOCUS_M_PIPE}, {"dup", FOCUS_M_ALL | FOCUS_M_PIPE},
+	{"dup2", FOCUS_M_ALL | FOCUS_M_PIPE}, {"clone", FOCUS_M_ALL | FOCUS_M_PIPE},
+	{"fork", FOCUS_M_ALL | FOCUS_M_PIPE}, {"vfork", FOCUS_M_ALL | FOCUS_M_PIPE},
+	{"wait4", FOCUS_M_ALL | FOCUS_M_PIPE}, {"waitid", FOCUS_M_ALL | FOCUS_M_PIPE},
+	{"exit_group", FOCUS_M_ALL | FOCUS_M_PIPE},
+	{"openat", FOCUS_M_ALL | FOCUS_M_PIPE}, {"close", FOCUS_M_ALL | FOCUS_M_PIPE},
+	{"fcntl", FOCUS_M_ALL | FOCUS_M_PIPE},
+	{"read", FOCUS_M_ALL | FOCUS_M_PIPE}, {"write", FOCUS_M_ALL | FOCUS_M_PIPE},
+	{"readv", FOCUS_M_ALL | FOCUS_M_PIPE}, {"writev", FOCUS_M_ALL | FOCUS_M_PIPE},
+	{"pread64", FOCUS_M_ALL}, {"pwrite64", FOCUS_M_ALL},
+	{"chdir", FOCUS_M_ALL}, {"getcwd", FOCUS_M_ALL},
+	{"setpgid", FOCUS_M_ALL}, {"setsid", FOCUS_M_ALL}, {"tcsetpgrp", FOCUS_M_ALL}, {"ioctl", FOCUS_M_ALL},
+	{"sigaction", FOCUS_M_ALL}, {"rt_sigaction", FOCUS_M_ALL}, {"rt_sigprocmask", FOCUS_M_ALL},
+	{"kill", FOCUS_M_ALL},
+};
+
+#define FOCUS_HASH_SZ 128   // 2 冪。名前の数の 4 倍ほど取っておく
+#define FOCUS_NAME_MAX 16
+
+static const struct s_focus_sys	*g_focus_tab[FOCUS_HASH_SZ];
+static int						g_focus_tab_ready;
+
+// 長さと先頭・末尾の 3 文字だけで散らす（名前の数が少ないので衝突は線形探査で足りる）
+static uint32_t	focus_hash(const char *s, size_t n)
+{
+	return (uint32_t)n * 37u + (unsigned char)s[0] * 5u + (unsigned char)s[n - 1];
+}
+
+void	focus_tab_init(void)
+{
+	if (g_focus_tab_ready)
+		return;
+	g_focus_tab_ready = 1;
+	for (size_t i = 0; i < sizeof(g_focus_sys) / sizeof(g_focus_sys[0]); i++)
+	{
+		uint32_t h = focus_hash(g_focus_sys[i].name, strlen(g_focus_sys[i].name));
+		while (g_focus_tab[h & (FOCUS_HASH_SZ - 1)])
+			h++;
+		g_focus_tab[h & (FOCUS_HASH_SZ - 1)] = &g_focus_sys[i];
+	}
+}
+
+static int	focus_sys_mask(const char *s, size_t n)
+{
+	uint32_t h = focus_hash(s, n);
+
+	for (const struct s_focus_sys *e; (e = g_focus_tab[h & (FOCUS_HASH_SZ - 1)]) != NULL; h++)
+		if (strncmp(e->name, s, n) == 0 && e->name[n] == '\0')
+			return e->mask;
+	return 0;
+}
+
+static int	is_ident_char(unsigned char c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+// want のビットが揃うまで '(' を拾っていく
+static int	focus_scan(const char *s, size_t n, int want)
+{
+	const char	*end = s + n;
+	const char	*p = s;
+	int			mask = 0;
+
+	while ((mask & want) != want && (p = memchr(p, '(', (size_t)(end - p))) != NULL)
+	{
+		const char *q = p;
+		while (q > s && p - q < FOCUS_NAME_MAX && is_ident_char((unsigned char)q[-1]))
+			q--;
+		if (q < p && q > s && q[-1] == ' ')
+			mask |= focus_sys_mask(q, (size_t)(p - q));
+		p++;
+	}
+	return mask;
+}
+
+int	focus_include(const char *s, size_t n)
+{
+	return focus_scan(s, n, FOCUS_M_ALL) != 0;
+}
+
+int	focus_include_mask(const char *s, size_t n)
+{
+	return focus_scan(s, n, FOCUS_M_ALL | FOCUS_M_PIPE);
+}
+
+static int	has_prefix(const char *p, const char *end, const char *lit, size_t k)
+{
+	return (size_t)(end - p) >= k && memcmp(p, lit, k) == 0;
+}
+
+int	focus_noise(const char *s, size_t n)
+{
+	const char *end = s + n;
+	const char *p;
+
+	for (p = s; (p = memchr(p, '/', (size_t)(end - p))) != NULL; p++)
+	{
+		// 次の 1 文字で候補を絞ってから比べる（"/usr/lib/" は "/lib/" を含むので不要）
+		if (p + 1 >= end)
+			break;
+		if ((p[1] == 'l' && has_prefix(p, end, "/lib/", 5))
+			|| (p[1] == 'e' && has_prefix(p, end, "/etc/ld.so.cache", 16))
+			|| (p[1] == 'u' && has_prefix(p, end, "/usr/share/locale", 17)))
+			return 1;
+	}
+	// "locale-archive" は '-' を手がかりに前後を確かめる
+	for (p = s; (p = memchr(p, '-', (size_t)(end - p))) != NULL; p++)
+		if (p - s >= 6 && memcmp(p - 6, "locale", 6) == 0 && has_prefix(p, end, "-archive", 8))
+			return 1;
+	return 0;
+}
+
+int	focus_exclude(const char *s, size_t n)
+{
+	const char *end = s + n;
+	const char *p;
+
+	if (focus_noise(s, n))
+		return 1;
+	for (p = s; (p = memchr(p, '/', (size_t)(end - p))) != NULL; p++)
+	{
+		if (p + 1 < end && p[1] == 'e' && has_prefix(p, end, "/etc/", 5))
+		{
+			const char *q = p + 5;
+			if (has_prefix(q, end, "locale", 6) || has_prefix(q, end, "nsswitch.conf", 13)
+				|| has_prefix(q, end, "passwd", 6) || has_prefix(q, end, "group", 5))
+				return 1;
+		}
+	}
+	return 0;
+}
+
+size_t	focus_live_fmt(const char *s, size_t n, char *out, size_t cap, void *ctx)
+{
+	t_focus_live	*fx = ctx;
+	int				m;
+
+	if ((fx->include && !focus_include(s, n)) || focus_exclude(s, n))
+		return 0;
+	if (!fx->from_strace)
+		m = snprintf(out, cap, "%.*s\n", (int)n, s);
+	else
+	{
+		const char	*end = s + n;
+		const char	*p = s;
+		const char	*ts;
+		long		pid = 0;
+
+		while (p < end && *p >= '0' && *p <= '9')
+			pid = pid * 10 + (*p++ - '0');
+		if (p == s)
+			return 0;
+		while (p < end && *p == ' ')
+			p++;
+		ts = p;
+		while (p < end && *p != ' ')
+			p++;
+		if (p >= end)
+			return 0;
+		if (fx->root < 0)
+			fx->root = pid;
+		if (fx->root_keep && pid == fx->root && !fx->root_keep(p, (size_t)(end - p)))
+			return 0;
+		m = snprintf(out, cap, "%.*s %ld%.*s\n", (int)(p - ts), ts, pid, (int)(end - p), p);
+	}
+	if (m < 0)
+		return 0;
+	if ((size_t)m >= cap)
+	{
+		out[cap - 2] = '\n';
+		return cap - 1;
+	}
+	return (size_t)m;
+}
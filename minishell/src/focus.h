@@ -0,0 +1,40 @@
+#ifndef FOCUS_H
+#define FOCUS_H
+
+#include <stddef.h>
+
+/*
+ * focus の行選び（trace.txt → focus_pipe.txt、live トレースの絞り込み、tracetool focus で共通）
+ * - focus_include: 行中に " name(" で見る syscall（execve / pipe / dup2 / read / write ...）があれば 1
+ * - focus_include_mask: 同じく。当たった組を FOCUS_M_ALL（strace_focus.sh の include）/
+ *   FOCUS_M_PIPE（strace_focus_pipe.sh の include。ALL の部分集合）のビットで返す
+ * - focus_noise: スクリプトの grep -v と同じ（/lib/, /etc/ld.so.cache, /usr/share/locale, locale-archive）なら 1
+ * - focus_exclude: focus_noise に加えて /etc のロケール・NSS の読み込み（nsswitch.conf, passwd ...）なら 1
+ * focus_include の前に focus_tab_init を 1 度呼ぶ（スレッドから使うなら start の前に）。
+ */
+#define FOCUS_M_ALL  1
+#define FOCUS_M_PIPE 2
+
+void	focus_tab_init(void);
+int		focus_include(const char *s, size_t n);
+int		focus_include_mask(const char *s, size_t n);
+int		focus_noise(const char *s, size_t n);
+int		focus_exclude(const char *s, size_t n);
+
+/*
+ * live トレースの整形（livetrace.h の t_live_fmt。ctx は t_focus_live）
+ * - include なら focus_include で絞り、どの行も focus_exclude に当たれば捨てる
+ * - from_strace なら strace -f -o の "PID  TS rest" を "TS PID rest" に並べ替える。
+ *   root_keep があれば最初に見た PID の行は root_keep(rest) が 1 のものだけ残す
+ */
+typedef struct s_focus_live
+{
+	int		include;
+	int		from_strace;
+	int		(*root_keep)(const char *rest, size_t n);
+	long	root;   // -1 で始める
+}	t_focus_live;
+
+size_t	focus_live_fmt(const char *s, size_t n, char *out, size_t cap, void *ctx);
+
+#endif
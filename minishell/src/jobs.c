@@ -0,0 +1,381 @@
+#define _GNU_SOURCE
+#include "jobs.h"
+#include "evtrace.h"
+#include "zygote.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define MAX_JOBS 64
+
+typedef struct s_job
+{
+	int		id;      // 0 なら空きスロット
+	char	*line;   // 表示用（strdup）
+	t_proc	*procs;
+	int		n;
+}	t_job;
+
+static t_job	g_jobs[MAX_JOBS];
+
+/*
+ * glibc 2.36 には <sys/pidfd.h> が無い環境もあるので syscall で直接呼ぶ。
+ */
+static int	pidfd_open_compat(pid_t pid)
+{
+#ifdef SYS_pidfd_open
+	return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+	(void)pid;
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+int	status_to_code(int status)
+{
+	if (WIFEXITED(status))
+		return WEXITSTATUS(status);
+	if (WIFSIGNALED(status))
+		return 128 + WTERMSIG(status);
+	return 1;
+}
+
+int	procs_open(t_proc *procs, const pid_t *pids, int n)
+{
+	for (int i = 0; i < n; i++)
+	{
+		procs[i].pid = pids[i];
+		procs[i].remote = zygote_owns(pids[i]);
+		procs[i].pidfd = procs[i].remote ? -1 : pidfd_open_compat(pids[i]);
+		procs[i].status = 0;
+		procs[i].done = 0;
+		memset(&procs[i].ru, 0, sizeof(procs[i].ru));
+	}
+	return 0;
+}
+
+void	procs_close(t_proc *procs, int n)
+{
+	for (int i = 0; i < n; i++)
+	{
+		if (procs[i].pidfd >= 0)
+			close(procs[i].pidfd);
+		procs[i].pidfd = -1;
+	}
+}
+
+static int	reap_one(t_proc *p, int flags)
+{
+	int	st = 0;
+	pid_t r;
+
+	// waitpid の代わりに wait4 で rusage も一緒に受け取る
+	do
+		r = wait4(p->pid, &st, flags, &p->ru);
+	while (r < 0 && errno == EINTR);
+
+	if (r == 0)
+		return 0;
+	if (r < 0)
+	{
+		static int	warned;
+
+		// ECHILD 等で終了状態が取れない。成功とは見なさず 127 で閉じる
+		if (!warned)
+		{
+			warned = 1;
+			perror("wait4");
+		}
+		st = 127 << 8;
+		memset(&p->ru, 0, sizeof(p->ru));
+	}
+	clock_gettime(CLOCK_MONOTONIC, &p->t_end);
+	p->status = st;
+	p->done = 1;
+	evtrace_rec(EV_EXIT, -1, p->pid, status_to_code(st));
+	return 1;
+}
+
+/*
+ * zygote の子: 終了通知が届いていれば取り出す
+ */
+static int	reap_remote(t_proc *p)
+{
+	if (zygote_take_exit(p->pid, &p->status, &p->ru) == 0)
+		return 0;
+	clock_gettime(CLOCK_MONOTONIC, &p->t_end);
+	p->done = 1;
+	evtrace_rec(EV_EXIT, -1, p->pid, status_to_code(p->status));
+	return 1;
+}
+
+/*
+ * pidfd が使えないときの待ち方（従来どおり段の順に waitpid）
+ */
+static int	procs_wait_fallback(t_proc *procs, int n, int timeout_ms)
+{
+	int	live = 0;
+
+	for (int i = 0; i < n; i++)
+	{
+		if (procs[i].done)
+			continue;
+		if (procs[i].remote)
+		{
+			while (!reap_remote(&procs[i]) && timeout_ms < 0)
+			{
+				struct pollfd pf = {zygote_fd(), POLLIN, 0};
+				poll(&pf, 1, -1);
+				zygote_pump();
+			}
+			if (!procs[i].done)
+				live++;
+			continue;
+		}
+		if (!reap_one(&procs[i], (timeout_ms < 0) ? 0 : WNOHANG))
+			live++;
+	}
+	return live;
+}
+
+/*
+ * procs[0..n-1] を終わった順に回収する。
+ *
+ * timeout_ms:
+ *  - -1: 全部終わるまでブロック
+ *  -  0: 既に終わっているものだけ回収して戻る
+ *  - >0: 最大 timeout_ms 待って、その間に終わったものを回収する
+ *
+ * 返り値: まだ終わっていない子の数
+ */
+int	procs_wait(t_proc *procs, int n, int timeout_ms)
+{
+	struct pollfd	*pfds;
+	int				*idx;
+	int				live;
+
+	pfds = calloc((size_t)n + 1, sizeof(*pfds));
+	idx = calloc((size_t)n + 1, sizeof(*idx));
+	if (!pfds || !idx)
+	{
+		free(pfds);
+		free(idx);
+		return procs_wait_fallback(procs, n, timeout_ms);
+	}
+
+	while (1)
+	{
+		int np = 0;
+		int need_zygote = 0;
+
+		live = 0;
+		for (int i = 0; i < n; i++)
+		{
+			if (procs[i].done)
+				continue;
+			if (procs[i].remote)
+			{
+				// zygote の子は zygote ソケットに届く終了通知を待つ
+				if (!reap_remote(&procs[i]))
+				{
+					need_zygote = 1;
+					live++;
+				}
+				continue;
+			}
+			if (procs[i].pidfd < 0)
+			{
+				// pidfd が無い子だけは waitpid で待つ
+				if (!reap_one(&procs[i], (timeout_ms < 0) ? 0 : WNOHANG))
+					live++;
+				continue;
+			}
+			pfds[np].fd = procs[i].pidfd;
+			pfds[np].events = POLLIN;
+			idx[np] = i;
+			np++;
+			live++;
+		}
+		if (need_zygote && zygote_fd() >= 0)
+		{
+			pfds[np].fd = zygote_fd();
+			pfds[np].events = POLLIN;
+			idx[np] = -1;
+			np++;
+		}
+		if (np == 0)
+			break;
+
+		int r = poll(pfds, (nfds_t)np, timeout_ms);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r < 0)
+			break;
+
+		for (int k = 0; k < np; k++)
+		{
+			if (!(pfds[k].revents & (POLLIN | POLLHUP | POLLERR)))
+				continue;
+			if (idx[k] < 0)
+			{
+				zygote_pump();
+				for (int i = 0; i < n; i++)
+					if (!procs[i].done && procs[i].remote && reap_remote(&procs[i]))
+						live--;
+			}
+			else if (reap_one(&procs[idx[k]], WNOHANG))
+				live--;
+		}
+		if (timeout_ms >= 0 || live == 0)
+			break;
+	}
+
+	free(pfds);
+	free(idx);
+	return live;
+}
+
+/*
+ * --- バックグラウンド job ---
+ */
+
+/*
+ * 登録できなかった job を走らせっぱなしにしない: 全段を SIGKILL してから 1 つずつ回収する
+ * （ここに来るのはメモリ不足のときもあるので、procs の配列は取らない）
+ */
+static void	abandon(const pid_t *pids, int n)
+{
+	t_proc	p;
+
+	for (int i = 0; i < n; i++)
+		kill(pids[i], SIGKILL);
+	for (int i = 0; i < n; i++)
+	{
+		procs_open(&p, &pids[i], 1);
+		procs_wait(&p, 1, -1);
+		procs_close(&p, 1);
+	}
+}
+
+int	jobs_add(const char *line, const pid_t *pids, int n)
+{
+	int	slot = -1;
+	int	next_id = 1;
+
+	for (int i = 0; i < MAX_JOBS; i++)
+	{
+		if (g_jobs[i].id == 0 && slot < 0)
+			slot = i;
+		if (g_jobs[i].id >= next_id)
+			next_id = g_jobs[i].id + 1;
+	}
+	if (slot < 0)
+	{
+		fprintf(stderr, "minishell: too many jobs (max %d), killed: %s\n", MAX_JOBS, line ? line : "");
+		abandon(pids, n);
+		return -1;
+	}
+
+	t_job *j = &g_jobs[slot];
+	j->procs = calloc((size_t)n, sizeof(t_proc));
+	j->line = strdup(line ? line : "");
+	if (!j->procs || !j->line)
+	{
+		free(j->procs);
+		free(j->line);
+		*j = (t_job){0};
+		fprintf(stderr, "minishell: out of memory\n");
+		abandon(pids, n);
+		return -1;
+	}
+	procs_open(j->procs, pids, n);
+	j->n = n;
+	j->id = next_id;
+
+	printf("[%d] %ld\n", j->id, (long)pids[n - 1]);
+	fflush(stdout);
+	return j->id;
+}
+
+static void	job_free(t_job *j)
+{
+	procs_close(j->procs, j->n);
+	free(j->procs);
+	free(j->line);
+	*j = (t_job){0};
+}
+
+static void	job_report_done(const t_job *j)
+{
+	int code = status_to_code(j->procs[j->n - 1].status);
+
+	if (code == 0)
+		printf("[%d]+ Done\t%s\n", j->id, j->line);
+	else
+		printf("[%d]+ Exit %d\t%s\n", j->id, code, j->line);
+}
+
+void	jobs_reap(void)
+{
+	for (int i = 0; i < MAX_JOBS; i++)
+	{
+		t_job *j = &g_jobs[i];
+		if (j->id == 0)
+			continue;
+		if (procs_wait(j->procs, j->n, 0) != 0)
+			continue;
+		job_report_done(j);
+		job_free(j);
+	}
+	fflush(stdout);
+}
+
+void	jobs_print(void)
+{
+	for (int i = 0; i < MAX_JOBS; i++)
+	{
+		t_job *j = &g_jobs[i];
+		if (j->id == 0)
+			continue;
+
+		int running = procs_wait(j->procs, j->n, 0);
+		if (running)
+			printf("[%d] Running (%d/%d)\t%s\n", j->id, running, j->n, j->line);
+		else
+			printf("[%d] Done\t%s\n", j->id, j->line);
+	}
+	fflush(stdout);
+}
+
+/*
+ * builtin "wait":
+ *  - id > 0: その job が終わるまで待つ
+ *  - id <= 0: 全 job を待つ
+ * 返り値: 最後に待った job の exit status（見つからなければ 127）
+ */
+int	jobs_wait(int id)
+{
+	int	code = (id > 0) ? 127 : 0;
+
+	for (int i = 0; i < MAX_JOBS; i++)
+	{
+		t_job *j = &g_jobs[i];
+		if (j->id == 0 || (id > 0 && j->id != id))
+			continue;
+
+		procs_wait(j->procs, j->n, -1);
+		code = status_to_code(j->procs[j->n - 1].status);
+		job_report_done(j);
+		job_free(j);
+	}
+	fflush(stdout);
+	return code;
+}
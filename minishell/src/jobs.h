@@ -0,0 +1,46 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <time.h>
+
+/*
+ * 子プロセスの待ち合わせ（pidfd + poll）
+ *
+ * waitpid を「段の順番に」ブロックして待つのではなく、
+ * 各子の pidfd を poll して「終わった順」に回収する。
+ * pidfd_open が使えない環境では waitpid にフォールバックする。
+ * zygote 経由で起動した子（remote）は zygote からの終了通知で回収する。
+ */
+typedef struct s_proc
+{
+	pid_t			pid;
+	int				pidfd;   // pidfd_open の結果（-1 なら waitpid フォールバック）
+	int				status;  // waitpid の生 status
+	int				done;    // 回収済みなら 1
+	int				remote;  // zygote の子なら 1（waitpid できない）
+	struct rusage	ru;      // wait4 で受け取った子の資源使用量（:time 用）
+	struct timespec	t_end;   // 回収した時刻（CLOCK_MONOTONIC）
+}	t_proc;
+
+int		procs_open(t_proc *procs, const pid_t *pids, int n);
+int		procs_wait(t_proc *procs, int n, int timeout_ms);
+void	procs_close(t_proc *procs, int n);
+int		status_to_code(int status);
+
+/*
+ * バックグラウンド job（"cmd &"）
+ *
+ * - jobs_add  : spawn 済みの pids を job として登録し "[id] pid" を表示。
+ *               登録できなければ（表が一杯・メモリ不足）理由を出し、pids を止めて回収して -1
+ * - jobs_reap : 非ブロッキングで回収し、終わった job を "[id]+ Done" で報告
+ * - jobs_print: builtin "jobs"
+ * - jobs_wait : builtin "wait"（id <= 0 なら全 job）
+ */
+int		jobs_add(const char *line, const pid_t *pids, int n);
+void	jobs_reap(void);
+void	jobs_print(void);
+int		jobs_wait(int id);
+
+#endif
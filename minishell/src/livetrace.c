@@ -0,0 +1,135 @@
+#include "livetrace.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define LIVE_BUF (1 << 16)   // 1 行はこれより短い前提（超えたらそこで区切る）
+#define LIVE_OUT 8192        // fmt の出力 1 行分
+
+typedef struct s_raw
+{
+	FILE	*fp;
+	long	size;
+}	t_raw;
+
+static void	raw_open(t_live *lv, t_raw *raw)
+{
+	raw->fp = fopen(lv->raw_path, "w");
+	raw->size = 0;
+}
+
+static void	raw_write(t_live *lv, t_raw *raw, const char *s, size_t n)
+{
+	if (!raw->fp)
+		return;
+	if (lv->raw_max > 0 && raw->size + (long)n + 1 > lv->raw_max && raw->size > 0)
+	{
+		char old[PATH_MAX];
+
+		fclose(raw->fp);
+		snprintf(old, sizeof(old), "%s.1", lv->raw_path);
+		rename(lv->raw_path, old);
+		lv->rotations++;
+		raw_open(lv, raw);
+		if (!raw->fp)
+			return;
+	}
+	fwrite(s, 1, n, raw->fp);
+	fputc('\n', raw->fp);
+	raw->size += (long)n + 1;
+}
+
+static void	live_line(t_live *lv, t_raw *raw, char *out, const char *s, size_t n)
+{
+	size_t	m;
+
+	lv->lines++;
+	raw_write(lv, raw, s, n);
+	if (!lv->fmt)
+	{
+		fwrite(s, 1, n, lv->out);
+		fputc('\n', lv->out);
+		lv->kept++;
+		return;
+	}
+	m = lv->fmt(s, n, out, LIVE_OUT, lv->ctx);
+	if (m == 0)
+		return;
+	fwrite(out, 1, m, lv->out);
+	lv->kept++;
+}
+
+static void	*live_main(void *arg)
+{
+	t_live	*lv = arg;
+	t_raw	raw = {0};
+	char	*buf = malloc(LIVE_BUF + LIVE_OUT);
+	char	*out;
+	size_t	len = 0;
+	ssize_t	n;
+
+	if (!buf)
+	{
+		// 読まずに抜けると tracer がパイプで詰まるので、捨てながら EOF まで読む
+		char sink[4096];
+		while ((n = read(lv->fd, sink, sizeof(sink))) != 0)
+			if (n < 0 && errno != EINTR)
+				break;
+		return NULL;
+	}
+	out = buf + LIVE_BUF;
+	if (lv->raw_path)
+		raw_open(lv, &raw);
+	for (;;)
+	{
+		n = read(lv->fd, buf + len, LIVE_BUF - len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		len += (size_t)n;
+
+		// 揃った行だけ処理し、途中の行は先頭へ寄せて次の read を待つ
+		char *s = buf;
+		char *end = buf + len;
+		char *nl;
+		while ((nl = memchr(s, '\n', (size_t)(end - s))) != NULL)
+		{
+			live_line(lv, &raw, out, s, (size_t)(nl - s));
+			s = nl + 1;
+		}
+		if (s == buf && len == LIVE_BUF)
+		{
+			live_line(lv, &raw, out, buf, len);
+			s = end;
+		}
+		len = (size_t)(end - s);
+		memmove(buf, s, len);
+		fflush(lv->out);
+	}
+	if (len > 0)
+		live_line(lv, &raw, out, buf, len);
+	fflush(lv->out);
+	if (raw.fp)
+		fclose(raw.fp);
+	free(buf);
+	return NULL;
+}
+
+int	live_start(t_live *lv)
+{
+	lv->lines = 0;
+	lv->kept = 0;
+	lv->rotations = 0;
+	if (pthread_create(&lv->th, NULL, live_main, lv) != 0)
+		return -1;
+	return 0;
+}
+
+void	live_join(t_live *lv)
+{
+	pthread_join(lv->th, NULL);
+}
@@ -0,0 +1,43 @@
+#ifndef LIVETRACE_H
+#define LIVETRACE_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+ * live トレース: tracer（strace / 組み込み tracer）の出力をパイプで受け、
+ * 別スレッドで 1 行ずつ整形・絞り込みしてすぐに出す。
+ *
+ * - 追跡が終わるのを待ってからファイルを読み直す post-hoc の流れと違い、
+ *   PID ごとのファイルもマージも作らない（パイプの中身は最初から時刻順）
+ * - read(2) で受け取った分を処理し終えるたびに out を fflush するので、
+ *   遅れは「tracer が 1 行書いてから次の read が返るまで」に収まる
+ * - raw_path を与えたときだけ生の行も残す。raw_max バイトを超えたら raw_path.1 へ回して
+ *   書き直すので、ディスクは最大で 2 * raw_max しか使わない
+ *
+ * fmt は 1 行（改行なし）を受け取り、出す内容を out に書いてその長さを返す。0 なら捨てる。
+ * fmt が NULL なら全行をそのまま出す。
+ */
+typedef size_t	(*t_live_fmt)(const char *line, size_t n, char *out, size_t cap, void *ctx);
+
+typedef struct s_live
+{
+	int					fd;         // 読む側（EOF まで読む。閉じるのは呼び出し側）
+	FILE				*out;       // 残した行の出力先
+	const char			*raw_path;  // NULL なら生の行は残さない
+	long				raw_max;
+	t_live_fmt			fmt;
+	void				*ctx;
+
+	// 以下は live_start / スレッドが使う
+	pthread_t			th;
+	unsigned long long	lines;
+	unsigned long long	kept;
+	unsigned long long	rotations;
+}	t_live;
+
+int		live_start(t_live *lv);
+void	live_join(t_live *lv);
+
+#endif
@@ -1,279 +1,389 @@
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>  // isatty, STDIN_FILENO
 
+#include "bench.h"
+#include "evtrace.h"
+#include "exec.h"
+#include "jobs.h"
+#include "ntrace.h"
 #include "observe.h"
+#include "parallel.h"
+#include "parse.h"
+#include "profile.h"
+#include "relay.h"
+#include "timing.h"
+#include "zygote.h"
 
 /*
- * 外部実装（すでに別ファイルに存在する想定）
+ * 入力 1 行をパースして実行する。
  *
- * - exec_argv_redir:
- *     argv で与えた単発コマンドを実行する。
- *     out_path が非NULLなら、stdout を out_path にリダイレクトして実行する。
+ * - exec_cmdline で前景実行（単発なら exec_argv_redir、パイプラインなら exec_pipeline_redir）
+ * - 行末に '&' があれば spawn_pipeline して待たずに jobs_add
  *
- * - exec_pipeline_redir:
- *     argvv[0..n-1]（各要素は argv 配列）からなるパイプラインを実行する。
- *     out_path が非NULLなら、パイプライン全体の「最後のコマンドの stdout」を out_path にリダイレクトする。
+ * 返り値:
+ *  - 実行結果の exit status（exec_* が返す code。バックグラウンドなら 0、起動・登録できなければ 1）
  */
-int exec_argv(char *const argv[]);
-int exec_argv_redir(char *const argv[], const char *out_path);
+static int	run_command_line(const char *input)
+{
+	t_cmdline	cl;
+	int			code;
+
+	if (!input || is_blank_line(input))
+		return 0;
 
-int exec_pipeline(char ***argvv, int n);
-int exec_pipeline_redir(char ***argvv, int n, const char *out_path);
+	code = parse_command_line(input, &cl);
+	if (code != 0)
+		return code;
+
+	if (cl.background)
+	{
+		pid_t *pids = calloc((size_t)cl.ncmd, sizeof(pid_t));
+		t_spawn sp;
+		int tmp_fd = spawn_opts_from_cmdline(&cl, &sp);
+		if (!pids || spawn_pipeline(cl.argvv, cl.ncmd, &sp, pids) != 0)
+			code = 1;
+		else if (jobs_add(input, pids, cl.ncmd) < 0)
+			code = 1;   // 登録できなかった job は jobs_add が止めて回収済み
+		if (tmp_fd >= 0)
+			close(tmp_fd);
+		free(pids);
+	}
+	else
+		code = exec_cmdline(&cl);
+
+	free_command_line(&cl);
+	return code;
+}
 
 /*
- * split_spaces() の返り値：
- * - argv: exec に渡す argv 配列（NULL終端）
- * - buf : argv の各要素が指す「元のバッファ先頭」。free すべき領域。
+ * job 制御 builtin:
+ *   jobs
+ *   wait [%n]
  *
- * 重要:
- *  - argv[i] は buf の内部（ヌル終端に置換して分割）を指すだけで、個別に free しない。
- *  - free するのは buf と argv 配列そのものだけ。
+ * 返り値: builtin として処理したら 1（status は *status に入れる）
  */
-typedef struct s_words
+static int	handle_job_builtin(const char *line, int *status)
 {
-	char	**argv;  // exec に渡す配列（buf 内を指す）
-	char	*buf;    // free すべき strdup の先頭
-}	t_words;
+	if (strcmp(line, "jobs") == 0)
+	{
+		jobs_print();
+		*status = 0;
+		return 1;
+	}
+	if (strncmp(line, "wait", 4) != 0 || (line[4] != '\0' && line[4] != ' ' && line[4] != '\t'))
+		return 0;
+
+	const char *p = line + 4;
+	while (*p == ' ' || *p == '\t')
+		p++;
+	if (*p == '%')
+		p++;
+	*status = jobs_wait(*p ? atoi(p) : 0);
+	return 1;
+}
 
 /*
- * 超雑：空白（space/tab）区切りのみのトークナイズ。
- * - クォート、エスケープ、変数展開、連結、リダイレクト演算子などは未対応。
- * - 学習用の最小実装として「argv を作る」ことにだけ集中している。
+ * REPL builtin:
+ *   :parallel [-k] N [file]
+ *
+ * file を省略したら、続く行を ":end"（または EOF）まで読んで N 並列で流す。
+ * -k を付けると出力を入力順にそろえる。
  */
-static t_words	split_spaces(const char *s)
+static int	handle_parallel_builtin(const char *line, int *status)
 {
-	t_words	w = (t_words){0};
-	size_t	i = 0, n = 0;
-	char	*buf;
-	char	**argv;
+	t_parallel_opts	opt = {0};
+	const char		*p;
+	char			*end;
 
-	if (!s)
-		return w;
-
-	buf = strdup(s);
-	if (!buf)
-		return w;
+	if (strncmp(line, ":parallel", 9) != 0)
+		return 0;
 
-	// 単語数を数える（連続空白は飛ばす）
-	for (i = 0; buf[i];)
+	p = line + 9;
+	while (*p == ' ' || *p == '\t')
+		p++;
+	if (strncmp(p, "-k", 2) == 0 && (p[2] == ' ' || p[2] == '\t'))
 	{
-		while (buf[i] == ' ' || buf[i] == '\t')
-			i++;
-		if (!buf[i])
-			break;
-		n++;
-		while (buf[i] && buf[i] != ' ' && buf[i] != '\t')
-			i++;
+		opt.keep_order = 1;
+		p += 2;
+		while (*p == ' ' || *p == '\t')
+			p++;
 	}
 
-	argv = calloc(n + 1, sizeof(char *));
-	if (!argv)
+	long n = strtol(p, &end, 10);
+	if (end == p || n <= 0 || n > 4096)
 	{
-		free(buf);
-		return (t_words){0};
+		fprintf(stderr, "usage: :parallel [-k] N [file]\n");
+		*status = 2;
+		return 1;
 	}
+	opt.jobs = (int)n;
+	p = end;
+	while (*p == ' ' || *p == '\t')
+		p++;
 
-	// 分割して argv に詰める（buf を破壊的に利用）
-	size_t ai = 0;
-	for (i = 0; buf[i];)
+	if (*p == '\0')
 	{
-		while (buf[i] == ' ' || buf[i] == '\t')
-			buf[i++] = '\0';
-		if (!buf[i])
-			break;
-		argv[ai++] = &buf[i];
-		while (buf[i] && buf[i] != ' ' && buf[i] != '\t')
-			i++;
+		opt.stop_line = ":end";
+		*status = parallel_run(stdin, &opt);
+		return 1;
 	}
 
-	argv[ai] = NULL;
-	w.argv = argv;
-	w.buf = buf;
-	return w;
+	FILE *fp = fopen(p, "r");
+	if (!fp)
+	{
+		perror(p);
+		*status = 1;
+		return 1;
+	}
+	*status = parallel_run(fp, &opt);
+	fclose(fp);
+	return 1;
 }
 
 /*
- * split_spaces の後始末。
- * argv[i] は buf 内を指すだけなので、free するのは buf と argv だけ。
+ * REPL builtin:
+ *   :time [-j] [-c] <line>   (1 回だけ段ごとの rusage を出す)
+ *   :time on|off             (常時モード)
+ *   :time table|json         (出力形式)
+ *   :time cgroup on|off      (パイプラインごとに一時 cgroup v2 を作る)
+ *   :time                    (status表示)
  */
-static void	free_words(t_words w)
+static int	handle_time_builtin(const char *line, int *time_enabled, t_timing_opts *topt, int *status)
 {
-	free(w.buf);
-	free(w.argv);
-}
+	if (strncmp(line, ":time", 5) != 0 || (line[5] != '\0' && line[5] != ' ' && line[5] != '\t'))
+		return 0;
 
-/*
- * 末尾の改行を落とす（getline 用）
- * - "\n" または "\r\n" を想定
- */
-static void	chomp_newline(char *s)
-{
-	size_t len;
+	const char *p = line + 5;
+	while (*p == ' ' || *p == '\t')
+		p++;
 
-	if (!s)
-		return;
-	len = strlen(s);
-	while (len > 0 && (s[len - 1] == '\n' || s[len - 1] == '\r'))
+	if (*p == '\0')
 	{
-		s[len - 1] = '\0';
-		len--;
+		printf("time: %s (%s%s)\n",
+			(*time_enabled ? "on" : "off"),
+			(topt->json ? "json" : "table"),
+			(topt->cgroup ? ", cgroup" : ""));
+		*status = 0;
+		return 1;
 	}
-}
-
-/*
- * 空行判定（space/tab のみも空とみなす）
- */
-static int	is_blank_line(const char *s)
-{
-	if (!s)
+	if (strcmp(p, "on") == 0 || strcmp(p, "off") == 0)
+	{
+		*time_enabled = (strcmp(p, "on") == 0);
+		printf("time: %s\n", p);
+		*status = 0;
 		return 1;
-	while (*s)
+	}
+	if (strcmp(p, "json") == 0 || strcmp(p, "table") == 0)
 	{
-		if (*s != ' ' && *s != '\t')
-			return 0;
-		s++;
+		topt->json = (strcmp(p, "json") == 0);
+		printf("time format: %s\n", p);
+		*status = 0;
+		return 1;
 	}
+	if (strcmp(p, "cgroup on") == 0 || strcmp(p, "cgroup off") == 0)
+	{
+		topt->cgroup = (strcmp(p, "cgroup on") == 0);
+		printf("time cgroup: %s\n", topt->cgroup ? "on" : "off");
+		*status = 0;
+		return 1;
+	}
+
+	// 1 回だけのフラグ（常時モードの設定は変えない）
+	t_timing_opts once = *topt;
+	while (p[0] == '-' && (p[1] == 'j' || p[1] == 'c') && (p[2] == ' ' || p[2] == '\t'))
+	{
+		if (p[1] == 'j')
+			once.json = 1;
+		else
+			once.cgroup = 1;
+		p += 2;
+		while (*p == ' ' || *p == '\t')
+			p++;
+	}
+	*status = timing_run_line(p, &once);
 	return 1;
 }
 
 /*
- * 入力 1 行を「実行できる形」にして実行する。
- *
- * やっていること（高レベル）:
- *  1) 入力を strdup して「破壊的に」パースできるようにする
- *  2) 行末の「> file」だけを抜き取る（この minishell の仕様）
- *  3) '|' で分割して各コマンド断片を split_spaces
- *  4) 単発なら exec_argv_redir、パイプラインなら exec_pipeline_redir
+ * REPL builtin:
+ *   :bench [-j] [-w W] N <line>
  *
- * 返り値:
- *  - 実行結果の exit status（exec_* が返す code）
+ * line を N 回（事前に W 回 warm-up）実行して latency 分布を出す。
  */
-static int	run_command_line(const char *input)
+static int	handle_bench_builtin(const char *line, int *status)
 {
-	char	*line;
-	int		code = 0;
+	t_bench_opts	opt = {.warmup = 3};
+	const char		*p;
+	char			*end;
 
-	if (!input || is_blank_line(input))
+	if (strncmp(line, ":bench", 6) != 0 || (line[6] != ' ' && line[6] != '\t'))
 		return 0;
 
-	line = strdup(input);
-	if (!line)
+	p = line + 6;
+	while (1)
 	{
-		fprintf(stderr, "minishell: out of memory\n");
-		return 1;
+		while (*p == ' ' || *p == '\t')
+			p++;
+		if (strncmp(p, "-j", 2) == 0 && (p[2] == ' ' || p[2] == '\t'))
+		{
+			opt.json = 1;
+			p += 2;
+		}
+		else if (strncmp(p, "-w", 2) == 0 && (p[2] == ' ' || p[2] == '\t'))
+		{
+			opt.warmup = (int)strtol(p + 2, &end, 10);
+			p = end;
+		}
+		else
+			break;
 	}
 
-	/*
-	 * 方針: 「最後だけリダイレクト」
-	 * - 行末の '>' だけを見る（strrchr で最後の '>' を取る）
-	 * - ここは学習を進めるための割り切り仕様
-	 */
-	char *out_path = NULL;
-	char *gt = strrchr(line, '>');
-	if (gt)
+	opt.iters = strtol(p, &end, 10);
+	if (end == p || opt.iters <= 0 || opt.warmup < 0 || is_blank_line(end))
 	{
-		*gt = '\0';   // コマンド部分をここで切る
-		gt++;
-		while (*gt == ' ' || *gt == '\t')
-			gt++;
+		fprintf(stderr, "usage: :bench [-j] [-w W] N <line>\n");
+		*status = 2;
+		return 1;
+	}
+	while (*end == ' ' || *end == '\t')
+		end++;
+	*status = bench_run_line(end, &opt);
+	return 1;
+}
 
-		if (!*gt)
-		{
-			fprintf(stderr, "minishell: redirection: missing file\n");
-			free(line);
-			return 2;
-		}
+// "N", "NK", "NM" を読む（K/M は 1024 倍）。end は読み終えた位置
+static long	parse_size(const char *p, char **end)
+{
+	long bytes = strtol(p, end, 10);
 
-		out_path = gt; // out_path は line の内部を指す
-		while (*gt && *gt != ' ' && *gt != '\t')
-			gt++;
-		*gt = '\0';    // ファイル名を終端
+	if (**end == 'K' || **end == 'k')
+	{
+		bytes *= 1024;
+		(*end)++;
 	}
+	else if (**end == 'M' || **end == 'm')
+	{
+		bytes *= 1024 * 1024;
+		(*end)++;
+	}
+	return bytes;
+}
+
+/*
+ * REPL builtin:
+ *   :pipesz            現在の設定を表示
+ *   :pipesz N|off      以後のパイプラインの段間パイプ容量（N バイト。K/M 接尾辞可）
+ *   :pipesz N <line>   その 1 行だけ N で実行する
+ */
+static int	handle_pipesz_builtin(const char *line, int *status)
+{
+	if (strncmp(line, ":pipesz", 7) != 0 || (line[7] != '\0' && line[7] != ' ' && line[7] != '\t'))
+		return 0;
 
-	// '|' の数を数える
-	int pipes = 0;
-	for (int i = 0; line[i]; i++)
-		if (line[i] == '|')
-			pipes++;
-	int ncmd = pipes + 1;
+	const char *p = line + 7;
+	while (*p == ' ' || *p == '\t')
+		p++;
 
-	// コマンド配列（各要素は split_spaces の結果）
-	char ***argvv = calloc((size_t)ncmd, sizeof(char **));
-	t_words *words = calloc((size_t)ncmd, sizeof(t_words));
-	if (!argvv || !words)
+	if (*p == '\0')
 	{
-		free(argvv);
-		free(words);
-		free(line);
-		fprintf(stderr, "minishell: out of memory\n");
+		if (exec_pipe_size() > 0)
+			printf("pipesz: %d\n", exec_pipe_size());
+		else
+			printf("pipesz: default\n");
+		*status = 0;
 		return 1;
 	}
-
-	/*
-	 * line を '|' で分割して各セグメントを split
-	 * - line はすでに strdup 済みなので、破壊してOK
-	 */
-	int idx = 0;
-	char *seg = line;
-	for (int i = 0; ; i++)
+	if (strcmp(p, "off") == 0)
 	{
-		if (line[i] == '|' || line[i] == '\0')
-		{
-			char saved = line[i];
-			line[i] = '\0';
+		exec_set_pipe_size(0);
+		printf("pipesz: default\n");
+		*status = 0;
+		return 1;
+	}
 
-			words[idx] = split_spaces(seg);
-			if (!words[idx].argv || !words[idx].argv[0])
-			{
-				// 空コマンドはエラー扱い
-				fprintf(stderr, "minishell: parse error near '|'\n");
-				code = 2;
-				line[i] = saved;
-				break;
-			}
-			argvv[idx] = words[idx].argv;
-			idx++;
+	char *end;
+	long bytes = parse_size(p, &end);
+	if (end == p || bytes <= 0 || bytes > INT_MAX || (*end && *end != ' ' && *end != '\t'))
+	{
+		fprintf(stderr, "usage: :pipesz [N[K|M]|off] [line]\n");
+		*status = 2;
+		return 1;
+	}
+	// カーネルはページの 2 冪に切り上げる。pipe-max-size を超えると root 以外は EPERM
+	int got = pipe_size_probe((int)bytes);
+	if (got < 0)
+	{
+		perror("minishell: pipesz");
+		*status = 1;
+		return 1;
+	}
+	while (*end == ' ' || *end == '\t')
+		end++;
+	if (*end == '\0')
+	{
+		exec_set_pipe_size(got);
+		printf("pipesz: %d\n", got);
+		*status = 0;
+		return 1;
+	}
+	int saved = exec_pipe_size();
+	exec_set_pipe_size(got);
+	*status = run_command_line(end);
+	exec_set_pipe_size(saved);
+	return 1;
+}
 
-			if (saved == '\0')
-				break;
+/*
+ * REPL builtin:
+ *   :zygote on|off
+ *   :zygote        (status表示)
+ */
+static int	handle_zygote_builtin(const char *line, int *status)
+{
+	if (strncmp(line, ":zygote", 7) != 0)
+		return 0;
 
-			seg = &line[i + 1];
-			line[i] = saved;
-		}
-	}
+	const char *p = line + 7;
+	while (*p == ' ' || *p == '\t')
+		p++;
 
-	if (code == 0)
+	*status = 0;
+	if (*p == '\0')
+		printf("zygote: %s\n", zygote_active() ? "on" : "off");
+	else if (strcmp(p, "on") == 0)
 	{
-		if (ncmd == 1)
+		if (zygote_start() != 0)
 		{
-			// 単発コマンドでも「最後だけ >」を適用する
-			code = exec_argv_redir(argvv[0], out_path);
-		}
-		else
-		{
-			// パイプライン全体の「最後だけ >」を適用する
-			code = exec_pipeline_redir(argvv, ncmd, out_path);
+			perror("minishell: zygote");
+			*status = 1;
 		}
+		printf("zygote: %s\n", zygote_active() ? "on" : "off");
 	}
-
-	// 後始末
-	for (int i = 0; i < idx; i++)
-		free_words(words[i]);
-	free(argvv);
-	free(words);
-	free(line);
-	return code;
+	else if (strcmp(p, "off") == 0)
+	{
+		zygote_stop();
+		printf("zygote: off\n");
+	}
+	else
+	{
+		fprintf(stderr, "usage: :zygote [on|off]\n");
+		*status = 2;
+	}
+	return 1;
 }
 
 /*
  * REPL builtin:
  *   :trace on|off
  *   :trace pipe|all
+ *   :trace live [N[K|M]] | live off   (その場で絞って出す。N を付けると生の行を N バイトで回して残す)
  *   :trace        (status表示)
  */
-static int	handle_repl_builtin(const char *line, int *trace_enabled, t_trace_mode *mode)
+static int	handle_repl_builtin(const char *line, int *trace_enabled, t_trace_mode *mode,
+	t_trace_backend *backend)
 {
 	if (strncmp(line, ":trace", 6) != 0)
 		return 0;
@@ -284,41 +394,148 @@ static int	handle_repl_builtin(const char *line, int *trace_enabled, t_trace_mod
 
 	if (*p == '\0')
 	{
-		printf("trace: %s (%s)\n",
+		long raw_max;
+		int live = observe_live(&raw_max);
+		printf("trace: %s (%s, %s%s)\n",
 			(*trace_enabled ? "on" : "off"),
-			(*mode == TRACE_PIPE ? "pipe" : "all"));
+			(*mode == TRACE_PIPE ? "pipe" : *mode == TRACE_ALL ? "all" : "lite"),
+			(*backend == TRACE_NATIVE ? "native" : "strace"),
+			live ? ", live" : "");
+		return 1;
+	}
+	if (strncmp(p, "live", 4) == 0 && (p[4] == '\0' || p[4] == ' ' || p[4] == '\t'))
+	{
+		char *end;
+		long raw_max = 0;
+
+		p += 4;
+		while (*p == ' ' || *p == '\t')
+			p++;
+		if (strcmp(p, "off") == 0)
+		{
+			observe_set_live(0, 0);
+			printf("trace live: off\n");
+			return 1;
+		}
+		if (*p)
+		{
+			raw_max = parse_size(p, &end);
+			if (end == p || raw_max <= 0 || *end)
+			{
+				fprintf(stderr, "usage: :trace live [N[K|M]|off]\n");
+				return 1;
+			}
+		}
+		observe_set_live(1, raw_max);
+		*trace_enabled = 1;
+		if (*mode == TRACE_LITE)
+			*mode = TRACE_PIPE;
+		evtrace_enable(0);
+		if (raw_max > 0)
+			printf("trace: on (live, raw %ld bytes)\n", raw_max);
+		else
+			printf("trace: on (live)\n");
 		return 1;
 	}
 
 	if (strcmp(p, "on") == 0)
 	{
 		*trace_enabled = 1;
+		evtrace_enable(*mode == TRACE_LITE);
 		printf("trace: on\n");
 		return 1;
 	}
 	if (strcmp(p, "off") == 0)
 	{
 		*trace_enabled = 0;
+		evtrace_enable(0);
 		printf("trace: off\n");
 		return 1;
 	}
 	if (strcmp(p, "pipe") == 0)
 	{
 		*mode = TRACE_PIPE;
+		evtrace_enable(0);
 		printf("trace mode: pipe\n");
 		return 1;
 	}
 	if (strcmp(p, "all") == 0)
 	{
 		*mode = TRACE_ALL;
+		evtrace_enable(0);
 		printf("trace mode: all\n");
 		return 1;
 	}
+	if (strcmp(p, "native") == 0 || strcmp(p, "strace") == 0)
+	{
+		if (strcmp(p, "native") == 0 && !NTRACE_SUPPORTED)
+		{
+			fprintf(stderr, "minishell: trace native: x86_64 only (backend stays strace)\n");
+			return 1;
+		}
+		*backend = (strcmp(p, "native") == 0) ? TRACE_NATIVE : TRACE_STRACE;
+		printf("trace backend: %s\n", p);
+		return 1;
+	}
+	if (strcmp(p, "lite") == 0)
+	{
+		// lite は strace を使わないので、モード切り替えと同時に有効にする
+		if (evtrace_init() != 0)
+		{
+			perror("minishell: trace lite");
+			return 1;
+		}
+		*mode = TRACE_LITE;
+		*trace_enabled = 1;
+		evtrace_enable(1);
+		printf("trace: on (lite)\n");
+		return 1;
+	}
 
-	fprintf(stderr, "usage: :trace [on|off|pipe|all]\n");
+	fprintf(stderr, "usage: :trace [on|off|pipe|all|lite|live|native|strace]\n");
 	return 1;
 }
 
+// "cmd <<EOF" の続きを区切り行（か EOF）まで読み、line の後ろに '\n' 区切りで足す（本文として parse_command_line に渡る）
+static int	read_heredoc_body(char **line, size_t *cap, const char *delim)
+{
+	char	*more = NULL;
+	size_t	more_cap = 0;
+	size_t	len = strlen(*line);
+
+	while (1)
+	{
+		if (isatty(STDIN_FILENO))
+		{
+			printf("> ");
+			fflush(stdout);
+		}
+		ssize_t nread = getline(&more, &more_cap, stdin);
+		if (nread < 0)
+			break;
+		if (len + (size_t)nread + 2 > *cap)
+		{
+			size_t ncap = (len + (size_t)nread + 2) * 2;
+			char *p = realloc(*line, ncap);
+			if (!p)
+			{
+				free(more);
+				return -1;
+			}
+			*line = p;
+			*cap = ncap;
+		}
+		chomp_newline(more);
+		(*line)[len++] = '\n';
+		memcpy(*line + len, more, strlen(more) + 1);
+		len += strlen(more);
+		if (strcmp(more, delim) == 0)
+			break;
+	}
+	free(more);
+	return 0;
+}
+
 /*
  * 対話モード（REPL）
  * - ./minishell    -> REPL
@@ -327,7 +544,10 @@ static int	handle_repl_builtin(const char *line, int *trace_enabled, t_trace_mod
  * 仕様（いまは最小）:
  * - 空行は無視
  * - "exit" または "quit" で終了
+ * - "jobs" / "wait" でバックグラウンド job を扱う
+ * - ":parallel N" で続く行を N 並列で流す
  * - TTY のときだけプロンプトを出す
+ * - プロンプトの前に終わった job を回収して報告する
  *
  * 返り値:
  * - 最後に実行したコマンドの exit status（習慣的にそうする）
@@ -341,9 +561,14 @@ static int	repl_loop(const char *argv0)
 
 	int trace_enabled = 0;
 	t_trace_mode mode = TRACE_PIPE;
+	t_trace_backend backend = NTRACE_SUPPORTED ? TRACE_NATIVE : TRACE_STRACE;
+
+	int time_enabled = 0;
+	t_timing_opts topt = {0};
 
 	while (1)
 	{
+		jobs_reap();
 		if (interactive)
 		{
 			// プロンプトは stdout に出す（一般的なシェル挙動）
@@ -363,17 +588,56 @@ static int	repl_loop(const char *argv0)
 		if (strcmp(line, "exit") == 0 || strcmp(line, "quit") == 0)
 			break;
 
-		if (handle_repl_builtin(line, &trace_enabled, &mode))
+		// heredoc の本文は builtin より先に集める（:time / :bench / :pipesz に渡る行にも本文が要る）
+		char delim[256];
+		if (heredoc_delimiter(line, delim, sizeof(delim)) && read_heredoc_body(&line, &cap, delim) != 0)
+		{
+			fprintf(stderr, "minishell: out of memory\n");
+			last_status = 1;
 			continue;
+		}
 
-		if (!trace_enabled)
+		if (handle_job_builtin(line, &last_status))
+			continue;
+
+		if (handle_parallel_builtin(line, &last_status))
+			continue;
+
+		if (handle_time_builtin(line, &time_enabled, &topt, &last_status))
+			continue;
+
+		if (handle_bench_builtin(line, &last_status))
+			continue;
+
+		if (handle_zygote_builtin(line, &last_status))
+			continue;
+
+		if (handle_pipesz_builtin(line, &last_status))
+			continue;
+
+		if (handle_repl_builtin(line, &trace_enabled, &mode, &backend))
+			continue;
+
+		if (!trace_enabled && time_enabled)
+		{
+			last_status = timing_run_line(line, &topt);
+		}
+		else if (!trace_enabled)
 		{
 			last_status = run_command_line(line);
 		}
+		else if (mode == TRACE_LITE)
+		{
+			// 同じプロセスで実行し、記録したイベントを行ごとに stderr へ出す
+			evtrace_begin();
+			last_status = run_command_line(line);
+			evtrace_rec(EV_DONE, -1, last_status, 0);
+			evtrace_dump(stderr, line);
+		}
 		else
 		{
 			// trace on のときだけ "一発実行 minishell" を strace で包む（スクリプト無し）
-			last_status = observe_run_traced(argv0, line, mode);
+			last_status = observe_run_traced(argv0, line, mode, backend);
 		}
 	}
 
@@ -381,21 +645,96 @@ static int	repl_loop(const char *argv0)
 	return last_status;
 }
 
+/*
+ * -j N [-k] -f file : file（"-" なら stdin）の各行を N 並列で実行する
+ *
+ * 返り値: 解釈できなければ -1、そうでなければ parallel_run の結果
+ */
+static int	run_parallel_args(int argc, char **argv)
+{
+	t_parallel_opts	opt = {0};
+	const char		*path = NULL;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+			opt.jobs = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-k") == 0)
+			opt.keep_order = 1;
+		else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+			path = argv[++i];
+		else
+			return -1;
+	}
+	if (opt.jobs <= 0 || !path)
+		return -1;
+
+	if (strcmp(path, "-") == 0)
+		return parallel_run(stdin, &opt);
+
+	FILE *fp = fopen(path, "r");
+	if (!fp)
+	{
+		perror(path);
+		return 1;
+	}
+	int code = parallel_run(fp, &opt);
+	fclose(fp);
+	return code;
+}
+
 int	main(int argc, char **argv)
 {
 	/*
 	 * 使い分け:
 	 * - argc == 1: REPL
 	 * - argc == 2: 一発実行（観測ツールから呼ぶのにも便利）
+	 * - -j N -f file: 並列バッチ実行
+	 * - 先頭の -z: 何よりも先に zygote を起動して、以降の spawn を任せる
 	 */
+	// :trace lite のリングは zygote より先に確保して共有させる（失敗したら lite が使えないだけ）
+	evtrace_init();
+
+	// 先頭の -z / --profile[=HZ] は順不同。プロファイラは zygote より先に始めて zygote にも継がせる
+	int use_zygote = 0;
+	int prof_hz = 0;
+	while (argc >= 2 && (strcmp(argv[1], "-z") == 0 || prof_parse_flag(argv[1], &prof_hz)))
+	{
+		if (argv[1][1] == 'z')
+			use_zygote = 1;
+		argv[1] = argv[0];
+		argv++;
+		argc--;
+	}
+	if (prof_hz > 0)
+	{
+		char dir[PATH_MAX];
+
+		// REPL・一発実行・-j のどれで終わっても profile.folded を書けるように atexit で止める
+		if (observe_new_run_dir(dir, sizeof(dir)) == 0 && prof_start(dir, prof_hz) == 0)
+			atexit(prof_stop);
+	}
+	if (use_zygote && zygote_start() != 0)
+		perror("minishell: zygote");
+
 	if (argc == 1)
 		return repl_loop(argv[0]);
 
-	if (argc == 2)
+	if (argc == 2 && argv[1][0] != '-')
 		return run_command_line(argv[1]);
 
+	if (argv[1][0] == '-')
+	{
+		int code = run_parallel_args(argc, argv);
+		if (code >= 0)
+			return code;
+	}
+
 	fprintf(stderr, "Usage:\n");
-	fprintf(stderr, "  %s            # REPL\n", argv[0]);
-	fprintf(stderr, "  %s '<line>'   # run once\n", argv[0]);
+	fprintf(stderr, "  (any form may be prefixed with -z to spawn via a zygote)\n");
+	fprintf(stderr, "  (and with --profile[=HZ] to sample CPU stacks into logs/minishell/<TS-PID>/profile.folded)\n");
+	fprintf(stderr, "  %s                      # REPL\n", argv[0]);
+	fprintf(stderr, "  %s '<line>'             # run once\n", argv[0]);
+	fprintf(stderr, "  %s -j N [-k] -f <file>  # run each line, N at a time\n", argv[0]);
 	return 2;
 }
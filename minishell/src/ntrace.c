@@ -0,0 +1,809 @@
+#define _GNU_SOURCE
+#include "ntrace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/ptrace.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <linux/audit.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+
+#include "exec.h"
+#include "parse.h"
+#include "zygote.h"
+
+#if defined(__x86_64__)
+# include <sys/user.h>
+#endif
+
+// 追跡の本体は x86_64 だけ（レジスタの読み方がほかに無い）。ほかでは ntrace_start が拒むだけ
+#if defined(__x86_64__)
+
+#define NT_STRLEN  128   // strace -s 128 と同じ
+#define NT_MAXARGV 32
+#define NT_LINEMAX 4096
+
+/*
+ * --- 追跡する syscall ---
+ * pipe : TRACE_PIPE でも止める（strace 版の -e trace=... と同じ集合 + clone3 / dup3）
+ * skel : root（line を実行する minishell 自身）で残す「配線の骨格」
+ * TRACE_ALL はこの表の全部（focus_pipe.txt の include と同じ範囲）
+ */
+typedef enum e_sc_kind
+{
+	SC_GENERIC = 0,
+	SC_EXECVE,
+	SC_CLONE,
+	SC_CLONE3,
+	SC_NOARG,
+	SC_WAIT4,
+	SC_EXIT,
+	SC_PIPE,
+	SC_DUP,
+	SC_OPENAT,
+	SC_FD,
+	SC_WRITE,
+	SC_READ
+}	t_sc_kind;
+
+typedef struct s_sc
+{
+	long		nr;
+	const char	*name;
+	t_sc_kind	kind;
+	int			pipe;
+	int			skel;
+}	t_sc;
+
+static const t_sc	g_sc[] = {
+	{SYS_execve, "execve", SC_EXECVE, 1, 0},
+	{SYS_clone, "clone", SC_CLONE, 1, 1},
+#ifdef SYS_clone3
+	{SYS_clone3, "clone3", SC_CLONE3, 1, 1},
+#endif
+#ifdef SYS_fork
+	{SYS_fork, "fork", SC_NOARG, 1, 1},
+#endif
+#ifdef SYS_vfork
+	{SYS_vfork, "vfork", SC_NOARG, 1, 1},
+#endif
+	{SYS_wait4, "wait4", SC_WAIT4, 1, 1},
+	{SYS_waitid, "waitid", SC_GENERIC, 1, 1},
+	{SYS_exit_group, "exit_group", SC_EXIT, 1, 0},
+#ifdef SYS_pipe
+	{SYS_pipe, "pipe", SC_PIPE, 1, 1},
+#endif
+	{SYS_pipe2, "pipe2", SC_PIPE, 1, 1},
+#ifdef SYS_dup2
+	{SYS_dup2, "dup2", SC_DUP, 1, 0},
+#endif
+	{SYS_dup3, "dup3", SC_DUP, 1, 0},
+	{SYS_openat, "openat", SC_OPENAT, 1, 0},
+	{SYS_close, "close", SC_FD, 1, 0},
+	{SYS_write, "write", SC_WRITE, 1, 0},
+	{SYS_dup, "dup", SC_DUP, 0, 0},
+	{SYS_fcntl, "fcntl", SC_FD, 0, 0},
+	{SYS_read, "read", SC_READ, 0, 0},
+	{SYS_pread64, "pread64", SC_READ, 0, 0},
+	{SYS_pwrite64, "pwrite64", SC_WRITE, 0, 0},
+	{SYS_readv, "readv", SC_FD, 0, 0},
+	{SYS_writev, "writev", SC_FD, 0, 0},
+	{SYS_chdir, "chdir", SC_GENERIC, 0, 0},
+	{SYS_getcwd, "getcwd", SC_GENERIC, 0, 0},
+	{SYS_setpgid, "setpgid", SC_GENERIC, 0, 0},
+	{SYS_setsid, "setsid", SC_NOARG, 0, 0},
+	{SYS_ioctl, "ioctl", SC_FD, 0, 0},
+	{SYS_rt_sigaction, "rt_sigaction", SC_GENERIC, 0, 0},
+	{SYS_rt_sigprocmask, "rt_sigprocmask", SC_GENERIC, 0, 0},
+	{SYS_kill, "kill", SC_GENERIC, 0, 0},
+};
+
+#define NSC ((int)(sizeof(g_sc) / sizeof(g_sc[0])))
+
+static int	sc_wanted(const t_sc *sc, t_trace_mode mode)
+{
+	return mode == TRACE_ALL || sc->pipe;
+}
+
+static const t_sc	*sc_find(long nr)
+{
+	for (int i = 0; i < NSC; i++)
+		if (g_sc[i].nr == nr)
+			return &g_sc[i];
+	return NULL;
+}
+
+/*
+ * --- root 側: seccomp フィルタ ---
+ * arch を確認 → nr が集合に入っていれば RET_TRACE、それ以外は RET_ALLOW
+ */
+static int	install_filter(t_trace_mode mode)
+{
+	struct sock_filter	prog[4 + 2 * NSC + 1];
+	int					n = 0;
+
+	prog[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, arch));
+	prog[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, AUDIT_ARCH_X86_64, 1, 0);
+	prog[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW);
+	prog[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, nr));
+	for (int i = 0; i < NSC; i++)
+	{
+		if (!sc_wanted(&g_sc[i], mode))
+			continue;
+		prog[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (uint32_t)g_sc[i].nr, 0, 1);
+		prog[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_TRACE);
+	}
+	prog[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW);
+
+	struct sock_fprog fprog = {.len = (unsigned short)n, .filter = prog};
+	if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) != 0)
+		return -1;
+	return (int)syscall(SYS_seccomp, SECCOMP_SET_MODE_FILTER, 0, &fprog);
+}
+
+static void	tracee_main(const char *line, t_trace_mode mode)
+{
+	t_cmdline	cl;
+	int			code;
+
+	// zygote の子は zygote の子なので追えない。この子では自分で fork させる
+	zygote_stop();
+
+	if (ptrace(PTRACE_TRACEME, 0, NULL, NULL) != 0)
+		_exit(126);
+	raise(SIGSTOP); // tracer が PTRACE_SETOPTIONS するのを待つ
+	if (install_filter(mode) != 0)
+	{
+		perror("minishell(trace): seccomp");
+		_exit(126);
+	}
+
+	code = parse_command_line(line, &cl);
+	if (code != 0)
+		_exit(code);
+	code = exec_cmdline(&cl);
+	free_command_line(&cl);
+	fflush(NULL);
+	_exit(code);
+}
+
+/*
+ * --- tracer 側: 文字列組み立て ---
+ */
+typedef struct s_sb
+{
+	char	buf[NT_LINEMAX];
+	size_t	len;
+}	t_sb;
+
+static void	sb_printf(t_sb *sb, const char *fmt, ...)
+{
+	va_list	ap;
+	int		n;
+
+	if (sb->len >= sizeof(sb->buf) - 1)
+		return;
+	va_start(ap, fmt);
+	n = vsnprintf(sb->buf + sb->len, sizeof(sb->buf) - sb->len, fmt, ap);
+	va_end(ap);
+	if (n > 0)
+		sb->len += (size_t)n;
+	if (sb->len >= sizeof(sb->buf))
+		sb->len = sizeof(sb->buf) - 1;
+}
+
+// tracee のメモリを読む（ページ境界で区切って、読めたところまで）
+static size_t	read_mem(pid_t pid, unsigned long addr, void *buf, size_t len)
+{
+	size_t	got = 0;
+
+	while (got < len)
+	{
+		size_t page_left = 4096 - ((addr + got) & 4095);
+		size_t n = (len - got < page_left) ? len - got : page_left;
+		struct iovec l = {(char *)buf + got, n};
+		struct iovec r = {(void *)(addr + got), n};
+		ssize_t m = process_vm_readv(pid, &l, 1, &r, 1, 0);
+		if (m <= 0)
+			break;
+		got += (size_t)m;
+	}
+	return got;
+}
+
+static void	put_quoted(t_sb *sb, const unsigned char *s, size_t n, int more)
+{
+	sb_printf(sb, "\"");
+	for (size_t i = 0; i < n; i++)
+	{
+		unsigned char c = s[i];
+		if (c == '\n')
+			sb_printf(sb, "\\n");
+		else if (c == '\t')
+			sb_printf(sb, "\\t");
+		else if (c == '\r')
+			sb_printf(sb, "\\r");
+		else if (c == '"' || c == '\\')
+			sb_printf(sb, "\\%c", c);
+		else if (c >= 0x20 && c < 0x7f)
+			sb_printf(sb, "%c", c);
+		else
+			sb_printf(sb, "\\%o", c);
+	}
+	sb_printf(sb, more ? "\"..." : "\"");
+}
+
+static void	put_str(t_sb *sb, pid_t pid, unsigned long addr)
+{
+	unsigned char	buf[NT_STRLEN + 1];
+	size_t			got;
+	size_t			n;
+
+	if (addr == 0)
+	{
+		sb_printf(sb, "NULL");
+		return;
+	}
+	got = read_mem(pid, addr, buf, sizeof(buf));
+	for (n = 0; n < got && buf[n]; n++)
+		;
+	if (got == 0)
+		sb_printf(sb, "%#lx", addr);
+	else
+		put_quoted(sb, buf, n > NT_STRLEN ? NT_STRLEN : n, n >= NT_STRLEN);
+}
+
+static void	put_buf(t_sb *sb, pid_t pid, unsigned long addr, long len)
+{
+	unsigned char	buf[NT_STRLEN];
+	size_t			want = (len > NT_STRLEN) ? NT_STRLEN : (size_t)(len > 0 ? len : 0);
+	size_t			got = read_mem(pid, addr, buf, want);
+
+	if (want > 0 && got == 0)
+		sb_printf(sb, "%#lx", addr);
+	else
+		put_quoted(sb, buf, got, len > NT_STRLEN);
+}
+
+// -yy 相当: fd の後ろに <pipe:[123]> / </tmp/out> を付ける
+static void	put_fd(t_sb *sb, pid_t pid, long fd)
+{
+	char	link[64];
+	char	target[PATH_MAX];
+
+	if ((int)fd == AT_FDCWD)
+	{
+		sb_printf(sb, "AT_FDCWD");
+		return;
+	}
+	snprintf(link, sizeof(link), "/proc/%d/fd/%d", (int)pid, (int)fd);
+	ssize_t n = readlink(link, target, sizeof(target) - 1);
+	if (n <= 0)
+	{
+		sb_printf(sb, "%d", (int)fd);
+		return;
+	}
+	target[n] = '\0';
+	sb_printf(sb, "%d<%s>", (int)fd, target);
+}
+
+static void	put_argv(t_sb *sb, pid_t pid, unsigned long addr)
+{
+	unsigned long	ptrs[NT_MAXARGV + 1];
+	size_t			got = read_mem(pid, addr, ptrs, sizeof(ptrs)) / sizeof(ptrs[0]);
+
+	sb_printf(sb, "[");
+	for (size_t i = 0; i < got && ptrs[i]; i++)
+	{
+		if (i == NT_MAXARGV)
+		{
+			sb_printf(sb, ", ...");
+			break;
+		}
+		sb_printf(sb, i ? ", " : "");
+		put_str(sb, pid, ptrs[i]);
+	}
+	sb_printf(sb, "]");
+}
+
+static void	put_envp(t_sb *sb, pid_t pid, unsigned long addr)
+{
+	unsigned long	p;
+	int				n = 0;
+
+	while (n < 4096 && read_mem(pid, addr + (unsigned long)n * sizeof(p), &p, sizeof(p)) == sizeof(p) && p)
+		n++;
+	sb_printf(sb, "%#lx /* %d var%s */", addr, n, n == 1 ? "" : "s");
+}
+
+static void	put_open_flags(t_sb *sb, long flags, long mode)
+{
+	static const struct { long bit; const char *name; } names[] = {
+		{O_CREAT, "O_CREAT"}, {O_EXCL, "O_EXCL"}, {O_NOCTTY, "O_NOCTTY"},
+		{O_TRUNC, "O_TRUNC"}, {O_APPEND, "O_APPEND"}, {O_NONBLOCK, "O_NONBLOCK"},
+		{O_DIRECTORY, "O_DIRECTORY"}, {O_NOFOLLOW, "O_NOFOLLOW"}, {O_CLOEXEC, "O_CLOEXEC"},
+	};
+	int acc = (int)(flags & O_ACCMODE);
+
+	sb_printf(sb, "%s", acc == O_RDONLY ? "O_RDONLY" : acc == O_WRONLY ? "O_WRONLY" : "O_RDWR");
+	for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+		if (flags & names[i].bit)
+			sb_printf(sb, "|%s", names[i].name);
+	if (flags & O_CREAT)
+		sb_printf(sb, ", %#lo", mode);
+}
+
+static void	put_clone_flags(t_sb *sb, unsigned long flags)
+{
+	static const struct { unsigned long bit; const char *name; } names[] = {
+		{CLONE_VM, "CLONE_VM"}, {CLONE_VFORK, "CLONE_VFORK"}, {CLONE_PIDFD, "CLONE_PIDFD"},
+		{CLONE_CHILD_CLEARTID, "CLONE_CHILD_CLEARTID"}, {CLONE_CHILD_SETTID, "CLONE_CHILD_SETTID"},
+		{CLONE_PARENT_SETTID, "CLONE_PARENT_SETTID"}, {CLONE_THREAD, "CLONE_THREAD"},
+	};
+	int sep = 0;
+
+	for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+	{
+		if (!(flags & names[i].bit))
+			continue;
+		sb_printf(sb, "%s%s", sep ? "|" : "", names[i].name);
+		flags &= ~names[i].bit;
+		sep = 1;
+	}
+	if ((flags & 0xff) == SIGCHLD)
+	{
+		sb_printf(sb, "%sSIGCHLD", sep ? "|" : "");
+		flags &= ~0xffUL;
+		sep = 1;
+	}
+	if (flags || !sep)
+		sb_printf(sb, "%s%#lx", sep ? "|" : "", flags);
+}
+
+static void	put_wait_status(t_sb *sb, pid_t pid, unsigned long addr, long ret)
+{
+	int	st;
+
+	if (addr == 0)
+	{
+		sb_printf(sb, "NULL");
+		return;
+	}
+	if (ret <= 0 || read_mem(pid, addr, &st, sizeof(st)) != sizeof(st))
+	{
+		sb_printf(sb, "%#lx", addr);
+		return;
+	}
+	if (WIFEXITED(st))
+		sb_printf(sb, "[{WIFEXITED(s) && WEXITSTATUS(s) == %d}]", WEXITSTATUS(st));
+	else if (WIFSIGNALED(st))
+		sb_printf(sb, "[{WIFSIGNALED(s) && WTERMSIG(s) == SIG%s}]",
+			sigabbrev_np(WTERMSIG(st)) ? sigabbrev_np(WTERMSIG(st)) : "?");
+	else
+		sb_printf(sb, "[%#x]", st);
+}
+
+/*
+ * --- tracer 側: tracee ごとの状態 ---
+ */
+typedef struct s_tracee
+{
+	pid_t			pid;
+	int				started;   // 最初の SIGSTOP を受け取ったか
+	int				in_sys;    // 入口を見て出口待ち
+	const t_sc		*sc;
+	unsigned long	args[6];
+	struct timespec	t_mono;    // 入口の時刻（-T 用）
+	struct timespec	t_real;    // 入口の時刻（-tt 用）
+	t_sb			text;      // 入口で組み立てた "name(args"
+}	t_tracee;
+
+typedef struct s_tracer
+{
+	t_tracee	*t;
+	int			n;
+	int			cap;
+	pid_t		root;
+	FILE		*out;
+}	t_tracer;
+
+static t_tracee	*tracee_get(t_tracer *tr, pid_t pid)
+{
+	for (int i = 0; i < tr->n; i++)
+		if (tr->t[i].pid == pid)
+			return &tr->t[i];
+	if (tr->n == tr->cap)
+	{
+		int ncap = tr->cap ? tr->cap * 2 : 16;
+		t_tracee *nt = realloc(tr->t, (size_t)ncap * sizeof(t_tracee));
+		if (!nt)
+			return NULL;
+		tr->t = nt;
+		tr->cap = ncap;
+	}
+	tr->t[tr->n] = (t_tracee){.pid = pid};
+	return &tr->t[tr->n++];
+}
+
+static void	tracee_drop(t_tracer *tr, pid_t pid)
+{
+	for (int i = 0; i < tr->n; i++)
+	{
+		if (tr->t[i].pid == pid)
+		{
+			tr->t[i] = tr->t[--tr->n];
+			return;
+		}
+	}
+}
+
+static int	get_regs(pid_t pid, unsigned long *nr, unsigned long args[6], long *ret)
+{
+	struct user_regs_struct	r;
+
+	if (ptrace(PTRACE_GETREGS, pid, NULL, &r) != 0)
+		return -1;
+	*nr = r.orig_rax;
+	args[0] = r.rdi;
+	args[1] = r.rsi;
+	args[2] = r.rdx;
+	args[3] = r.r10;
+	args[4] = r.r8;
+	args[5] = r.r9;
+	*ret = (long)r.rax;
+	return 0;
+}
+
+// 入口で読めるものはここで読んでおく（exec 後や close 後には読めない）
+static void	format_entry(t_tracee *t)
+{
+	t_sb			*sb = &t->text;
+	unsigned long	*a = t->args;
+
+	sb->len = 0;
+	sb_printf(sb, "%s(", t->sc->name);
+	switch (t->sc->kind)
+	{
+	case SC_EXECVE:
+		put_str(sb, t->pid, a[0]);
+		sb_printf(sb, ", ");
+		put_argv(sb, t->pid, a[1]);
+		sb_printf(sb, ", ");
+		put_envp(sb, t->pid, a[2]);
+		break;
+	case SC_CLONE:
+		if (a[1])
+			sb_printf(sb, "child_stack=%#lx, flags=", a[1]);
+		else
+			sb_printf(sb, "child_stack=NULL, flags=");
+		put_clone_flags(sb, a[0]);
+		break;
+	case SC_CLONE3:
+	{
+		unsigned long ca[5] = {0};
+		read_mem(t->pid, a[0], ca, sizeof(ca));
+		sb_printf(sb, "{flags=");
+		put_clone_flags(sb, ca[0]);
+		sb_printf(sb, ", exit_signal=%s}, %lu", ca[4] == SIGCHLD ? "SIGCHLD" : "0", a[1]);
+		break;
+	}
+	case SC_EXIT:
+		sb_printf(sb, "%d", (int)a[0]);
+		break;
+	case SC_DUP:
+		put_fd(sb, t->pid, (long)a[0]);
+		if (t->sc->nr != SYS_dup)
+		{
+			sb_printf(sb, ", ");
+			put_fd(sb, t->pid, (long)a[1]);
+		}
+		if (t->sc->nr == SYS_dup3)
+			sb_printf(sb, ", %s", (a[2] & O_CLOEXEC) ? "O_CLOEXEC" : "0");
+		break;
+	case SC_OPENAT:
+		put_fd(sb, t->pid, (long)(int)a[0]);
+		sb_printf(sb, ", ");
+		put_str(sb, t->pid, a[1]);
+		sb_printf(sb, ", ");
+		put_open_flags(sb, (long)a[2], (long)a[3]);
+		break;
+	case SC_FD:
+		put_fd(sb, t->pid, (long)(int)a[0]);
+		if (t->sc->nr != SYS_close)
+			sb_printf(sb, ", %#lx, %#lx", a[1], a[2]);
+		break;
+	case SC_WRITE:
+		put_fd(sb, t->pid, (long)(int)a[0]);
+		sb_printf(sb, ", ");
+		put_buf(sb, t->pid, a[1], (long)a[2]);
+		sb_printf(sb, ", %lu", a[2]);
+		if (t->sc->nr == SYS_pwrite64)
+			sb_printf(sb, ", %ld", (long)a[3]);
+		break;
+	case SC_NOARG:
+	case SC_WAIT4:
+	case SC_PIPE:
+	case SC_READ:
+		break;
+	default:
+		sb_printf(sb, "%#lx, %#lx, %#lx", a[0], a[1], a[2]);
+		break;
+	}
+}
+
+// 出口でしか分からない引数（pipe の fd、wait の status、read の中身）と返り値
+static void	format_exit(t_tracee *t, long ret, t_sb *sb)
+{
+	unsigned long	*a = t->args;
+
+	switch (t->sc->kind)
+	{
+	case SC_WAIT4:
+		sb_printf(sb, "%d, ", (int)a[0]);
+		put_wait_status(sb, t->pid, a[1], ret);
+		sb_printf(sb, ", %s, %s", a[2] ? (a[2] == WNOHANG ? "WNOHANG" : "__WALL") : "0",
+			a[3] ? "{...}" : "NULL");
+		break;
+	case SC_PIPE:
+	{
+		int fds[2];
+		if (ret == 0 && read_mem(t->pid, a[0], fds, sizeof(fds)) == sizeof(fds))
+		{
+			sb_printf(sb, "[");
+			put_fd(sb, t->pid, fds[0]);
+			sb_printf(sb, ", ");
+			put_fd(sb, t->pid, fds[1]);
+			sb_printf(sb, "]");
+		}
+		else
+			sb_printf(sb, "%#lx", a[0]);
+		if (t->sc->nr == SYS_pipe2)
+			sb_printf(sb, ", %s", (a[1] & O_CLOEXEC) ? "O_CLOEXEC" : "0");
+		break;
+	}
+	case SC_READ:
+		put_fd(sb, t->pid, (long)(int)a[0]);
+		sb_printf(sb, ", ");
+		if (ret >= 0)
+			put_buf(sb, t->pid, a[1], ret);
+		else
+			sb_printf(sb, "%#lx", a[1]);
+		sb_printf(sb, ", %lu", a[2]);
+		break;
+	default:
+		break;
+	}
+	sb_printf(sb, ")");
+
+	if (ret < 0 && ret > -4096)
+		sb_printf(sb, " = -1 %s (%s)", strerrorname_np((int)-ret) ? strerrorname_np((int)-ret) : "E?",
+			strerror((int)-ret));
+	else if (t->sc->kind == SC_OPENAT || t->sc->kind == SC_DUP)
+	{
+		sb_printf(sb, " = ");
+		put_fd(sb, t->pid, ret);
+	}
+	else
+		sb_printf(sb, " = %ld", ret);
+}
+
+static void	emit(t_tracer *tr, t_tracee *t, const t_sb *sb, const struct timespec *dur)
+{
+	struct tm	tmv;
+	char		hms[16];
+
+	// root は配線の骨格だけ（strace 版と同じ）
+	if (t->pid == tr->root && !t->sc->skel)
+		return;
+	localtime_r(&t->t_real.tv_sec, &tmv);
+	strftime(hms, sizeof(hms), "%H:%M:%S", &tmv);
+	fprintf(tr->out, "%s.%06ld %d %.*s", hms, t->t_real.tv_nsec / 1000, (int)t->pid,
+		(int)sb->len, sb->buf);
+	if (dur)
+		fprintf(tr->out, " <%ld.%06ld>", (long)dur->tv_sec, dur->tv_nsec / 1000);
+	fputc('\n', tr->out);
+}
+
+static void	on_entry(t_tracer *tr, t_tracee *t)
+{
+	unsigned long	nr;
+	long			ret;
+
+	clock_gettime(CLOCK_MONOTONIC, &t->t_mono);
+	clock_gettime(CLOCK_REALTIME, &t->t_real);
+	if (get_regs(t->pid, &nr, t->args, &ret) != 0)
+		return;
+	t->sc = sc_find((long)nr);
+	if (!t->sc)
+		return;
+	format_entry(t);
+	t->in_sys = 1;
+
+	// exit_group は戻ってこない
+	if (t->sc->kind == SC_EXIT)
+	{
+		sb_printf(&t->text, ") = ?");
+		emit(tr, t, &t->text, NULL);
+		t->in_sys = 0;
+	}
+}
+
+static void	on_exit_stop(t_tracer *tr, t_tracee *t)
+{
+	unsigned long	nr;
+	unsigned long	args[6];
+	long			ret;
+	struct timespec	now;
+	struct timespec	dur;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	t->in_sys = 0;
+	if (!t->sc || get_regs(t->pid, &nr, args, &ret) != 0)
+		return;
+	dur.tv_sec = now.tv_sec - t->t_mono.tv_sec;
+	dur.tv_nsec = now.tv_nsec - t->t_mono.tv_nsec;
+	if (dur.tv_nsec < 0)
+	{
+		dur.tv_sec--;
+		dur.tv_nsec += 1000000000L;
+	}
+	format_exit(t, ret, &t->text);
+	emit(tr, t, &t->text, &dur);
+}
+
+static void	resume(t_tracee *t, int sig)
+{
+	// 入口を見た syscall は出口でもう 1 回止める。それ以外は seccomp で止まるまで走らせる
+	ptrace(t && t->in_sys ? PTRACE_SYSCALL : PTRACE_CONT, t ? t->pid : 0, NULL, (void *)(long)sig);
+}
+
+static int	trace_loop(t_tracer *tr)
+{
+	int	code = 1;
+	int	st;
+
+	while (tr->n > 0)
+	{
+		pid_t pid = waitpid(-1, &st, __WALL);
+		if (pid < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		if (WIFEXITED(st) || WIFSIGNALED(st))
+		{
+			if (pid == tr->root)
+				code = WIFEXITED(st) ? WEXITSTATUS(st) : 128 + WTERMSIG(st);
+			tracee_drop(tr, pid);
+			continue;
+		}
+		if (!WIFSTOPPED(st))
+			continue;
+
+		t_tracee *t = tracee_get(tr, pid);
+		int event = st >> 16;
+		int sig = WSTOPSIG(st);
+		if (!t)
+		{
+			ptrace(PTRACE_CONT, pid, NULL, NULL);
+			continue;
+		}
+
+		if (event == PTRACE_EVENT_SECCOMP)
+			on_entry(tr, t);
+		else if (sig == (SIGTRAP | 0x80))
+		{
+			if (t->in_sys)
+				on_exit_stop(tr, t);
+		}
+		else if (event == PTRACE_EVENT_FORK || event == PTRACE_EVENT_VFORK || event == PTRACE_EVENT_CLONE)
+		{
+			unsigned long child;
+			if (ptrace(PTRACE_GETEVENTMSG, pid, NULL, &child) == 0)
+				tracee_get(tr, (pid_t)child);
+			t = tracee_get(tr, pid); // realloc で動いているかもしれない
+		}
+		else if (event == 0 && sig == SIGSTOP && !t->started)
+			t->started = 1; // 自動アタッチされた子の最初の停止
+		else if (event == 0)
+		{
+			resume(t, sig); // 普通のシグナルはそのまま届ける
+			continue;
+		}
+		t->started = 1;
+		resume(t, 0);
+	}
+	return code;
+}
+
+#endif
+
+// out_fd >= 0 ならそこへ行ごとに書く（live）。そうでなければ trace_txt を作る
+static int	ntrace_start(const char *trace_txt, int out_fd, const char *line, t_trace_mode mode)
+{
+#if !defined(__x86_64__)
+	(void)trace_txt;
+	(void)out_fd;
+	(void)line;
+	(void)mode;
+	fprintf(stderr, "minishell(trace): native tracer supports x86_64 only\n");
+	return 1;
+#else
+	int	st;
+
+	fflush(NULL);
+	pid_t tracer = fork();
+	if (tracer < 0)
+		return 1;
+	if (tracer == 0)
+	{
+		t_tracer tr = {0};
+
+		tr.root = fork();
+		if (tr.root < 0)
+			_exit(1);
+		if (tr.root == 0)
+		{
+			if (out_fd >= 0)
+				close(out_fd);
+			tracee_main(line, mode);
+		}
+
+		// root は raise(SIGSTOP) で止まって待っている
+		if (waitpid(tr.root, &st, __WALL) < 0 || !WIFSTOPPED(st))
+			_exit(1);
+		tr.out = (out_fd >= 0) ? fdopen(out_fd, "w") : fopen(trace_txt, "we");
+		if (tr.out && out_fd >= 0)
+			setvbuf(tr.out, NULL, _IOLBF, 0);
+		if (!tr.out || ptrace(PTRACE_SETOPTIONS, tr.root, NULL,
+				(void *)(long)(PTRACE_O_TRACESECCOMP | PTRACE_O_TRACESYSGOOD
+				| PTRACE_O_TRACEFORK | PTRACE_O_TRACEVFORK | PTRACE_O_TRACECLONE
+				| PTRACE_O_TRACEEXEC | PTRACE_O_EXITKILL)) != 0)
+		{
+			perror("minishell(trace): ptrace");
+			kill(tr.root, SIGKILL);
+			_exit(1);
+		}
+		tracee_get(&tr, tr.root)->started = 1;
+		ptrace(PTRACE_CONT, tr.root, NULL, NULL);
+
+		int code = trace_loop(&tr);
+		fclose(tr.out);
+		_exit(code);
+	}
+
+	while (waitpid(tracer, &st, 0) < 0)
+		if (errno != EINTR)
+			return 1;
+	if (WIFEXITED(st))
+		return WEXITSTATUS(st);
+	return 128 + (WIFSIGNALED(st) ? WTERMSIG(st) : 0);
+#endif
+}
+
+int	ntrace_run(const char *trace_txt, const char *line, t_trace_mode mode)
+{
+	return ntrace_start(trace_txt, -1, line, mode);
+}
+
+int	ntrace_run_fd(int out_fd, const char *line, t_trace_mode mode)
+{
+	return ntrace_start(NULL, out_fd, line, mode);
+}
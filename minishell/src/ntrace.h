@@ -0,0 +1,37 @@
+#ifndef NTRACE_H
+#define NTRACE_H
+
+#include "observe.h"
+
+/*
+ * strace を使わない組み込みトレーサ（:trace native）
+ *
+ * - 追跡用の子（tracer）がさらに子（root）を fork し、root は PTRACE_TRACEME の後に
+ *   seccomp フィルタを入れてから line を自分で実行する（exec_cmdline）。
+ * - フィルタは対象の syscall（mode ごとの集合）だけ SECCOMP_RET_TRACE を返し、
+ *   それ以外は素通し（RET_ALLOW）なので、対象外の syscall は止まらない。
+ * - PTRACE_O_TRACESECCOMP + TRACEFORK/VFORK/CLONE で孫まで追い、
+ *   入口（seccomp 停止）と出口（PTRACE_SYSCALL）の 2 回だけ止めて 1 行を書く。
+ * - 出力は strace -tt -T -yy -s 128 を PID つきで合成した trace.txt と同じ形:
+ *     HH:MM:SS.uuuuuu PID name(args) = ret <秒>
+ *   root は「配線の骨格」（pipe/clone/fork/wait）だけを残す。
+ *
+ * 返り値: line の exit status（追跡を始められなければ 1）
+ *
+ * ntrace_run_fd はファイルの代わりに out_fd（パイプの書き端など）へ行バッファで書く（live 用）。
+ * out_fd は tracer の子だけが使い、追跡される側には渡らない。閉じるのは呼び出し側。
+ */
+/*
+ * レジスタの読み方（orig_rax ...）と seccomp フィルタの arch 確認が x86_64 決め打ちなので、
+ * ほかのアーキテクチャでは使えない（REPL の既定は strace になり、:trace native は断る）
+ */
+#if defined(__x86_64__)
+# define NTRACE_SUPPORTED 1
+#else
+# define NTRACE_SUPPORTED 0
+#endif
+
+int	ntrace_run(const char *trace_txt, const char *line, t_trace_mode mode);
+int	ntrace_run_fd(int out_fd, const char *line, t_trace_mode mode);
+
+#endif
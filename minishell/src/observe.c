@@ -1,13 +1,19 @@
 #define _GNU_SOURCE
 #include "observe.h"
+#include "focus.h"
+#include "livetrace.h"
+#include "ntrace.h"
+#include "summary.h"
 
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <time.h>
@@ -15,7 +21,6 @@
 #include <ctype.h>
 
 #define STRACE_PATH "/usr/bin/strace"
-#define GREP_PATH   "/usr/bin/grep"
 #define ENV_PATH    "/usr/bin/env"
 
 static int mkdir_if_needed(const char *path, mode_t mode)
@@ -66,10 +71,14 @@ static int make_run_dir(char *out_dir, size_t out_sz, const char *root)
 	char ts[32];
 	strftime(ts, sizeof(ts), "%Y%m%d-%H%M%S", &tmv);
 
-	// root/TS-PID
+	// root/TS-PID（同じ秒に同じシェルから繰り返したら root/TS-PID-2, -3, ...）
 	snprintf(out_dir, out_sz, "%s/%s-%ld", root, ts, (long)getpid());
-	if (mkdir(out_dir, 0755) != 0)
-		return -1;
+	for (int i = 2; mkdir(out_dir, 0755) != 0; i++)
+	{
+		if (errno != EEXIST || i > 999)
+			return -1;
+		snprintf(out_dir, out_sz, "%s/%s-%ld-%d", root, ts, (long)getpid(), i);
+	}
 	return 0;
 }
 
@@ -112,6 +121,255 @@ static int wait_to_status(pid_t pid)
 	return 1;
 }
 
+/*
+ * --- trace_all.<pid> の k-way マージ ---
+ *
+ * strace -ff の出力は PID ごとのファイルで、各ファイルの中は時刻順に並んでいる。
+ * 全部を読み込んで sort する代わりに、各ファイルを mmap してカーソルを 1 本ずつ持ち、
+ * 先頭行の -tt 時刻をキーにした min-heap で「いちばん古い行」を順に書き出す。
+ * - 計算量 O(N log k)（N: 行数, k: ファイル数）
+ * - 使うメモリはカーソル k 本分だけ。読み終えた範囲は MADV_DONTNEED で手放す
+ * - 最小 PID を root とみなし、root は「配線の骨格」の行だけ残す（従来どおり）
+ */
+#define MERGE_DROP_BYTES (256UL << 10)  // カーソルごとに、これだけ進むたびに読み終えたページを捨てる
+
+typedef struct s_cursor
+{
+	long		pid;
+	int			is_root;
+	const char	*base;
+	size_t		len;
+	size_t		pos;        // 次の行の先頭
+	size_t		dropped;    // MADV_DONTNEED 済みの範囲
+	const char	*line;      // 現在の行（改行を含まない）
+	size_t		line_len;
+	int64_t		ts;         // 現在の行の時刻（us。日付をまたいだら 24h 足す）
+	int64_t		day;        // 日付またぎの補正
+}	t_cursor;
+
+// "HH:MM:SS.uuuuuu " を us に。形が違えば -1
+static int64_t parse_tt(const char *p, size_t n)
+{
+	if (n < 15 || p[2] != ':' || p[5] != ':' || p[8] != '.')
+		return -1;
+	int64_t v[4] = {0};
+	const int pos[4][2] = {{0, 2}, {3, 2}, {6, 2}, {9, 6}};
+	for (int i = 0; i < 4; i++)
+	{
+		for (int j = 0; j < pos[i][1]; j++)
+		{
+			char c = p[pos[i][0] + j];
+			if (c < '0' || c > '9')
+				return -1;
+			v[i] = v[i] * 10 + (c - '0');
+		}
+	}
+	return ((v[0] * 60 + v[1]) * 60 + v[2]) * 1000000 + v[3];
+}
+
+static int is_skeleton_line(const char *line, size_t n)
+{
+	static const char *const keep[] = {
+		" pipe2(", " pipe(", " clone(", " clone3(", " fork(", " vfork(", " wait4(", " waitid(",
+	};
+
+	for (size_t i = 0; i < sizeof(keep) / sizeof(keep[0]); i++)
+		if (memmem(line, n, keep[i], strlen(keep[i])))
+			return 1;
+	return 0;
+}
+
+// 次に出す行までカーソルを進める。ファイルの終わりなら 0
+static int cursor_next(t_cursor *c)
+{
+	while (c->pos < c->len)
+	{
+		const char *p = c->base + c->pos;
+		const char *nl = memchr(p, '\n', c->len - c->pos);
+		size_t n = nl ? (size_t)(nl - p) : c->len - c->pos;
+
+		c->pos += n + (nl ? 1 : 0);
+		if (n == 0)
+			continue;
+		if (c->is_root && !is_skeleton_line(p, n))
+			continue;
+
+		// 時刻が読めない行（続きの行など）は直前の行と同じ時刻として扱う
+		int64_t t = parse_tt(p, n);
+		if (t >= 0)
+		{
+			if (t + c->day < c->ts - 12LL * 3600 * 1000000)
+				c->day += 24LL * 3600 * 1000000;
+			c->ts = t + c->day;
+		}
+		c->line = p;
+		c->line_len = n;
+
+		if (c->pos - c->dropped >= MERGE_DROP_BYTES)
+		{
+			size_t upto = (size_t)(p - c->base) & ~(size_t)(sysconf(_SC_PAGESIZE) - 1);
+			if (upto > c->dropped)
+			{
+				madvise((void *)(c->base + c->dropped), upto - c->dropped, MADV_DONTNEED);
+				c->dropped = upto;
+			}
+		}
+		return 1;
+	}
+	return 0;
+}
+
+static int cursor_less(const t_cursor *a, const t_cursor *b)
+{
+	if (a->ts != b->ts)
+		return a->ts < b->ts;
+	return a->pid < b->pid;
+}
+
+static void heap_down(t_cursor **h, size_t n, size_t i)
+{
+	while (1)
+	{
+		size_t l = 2 * i + 1;
+		size_t m = i;
+		if (l < n && cursor_less(h[l], h[m]))
+			m = l;
+		if (l + 1 < n && cursor_less(h[l + 1], h[m]))
+			m = l + 1;
+		if (m == i)
+			return;
+		t_cursor *tmp = h[i];
+		h[i] = h[m];
+		h[m] = tmp;
+		i = m;
+	}
+}
+
+// "13:17:00.762722 execve(...)" → "13:17:00.762722 <pid> execve(...)"
+static void write_merged_line(FILE *out, const t_cursor *c)
+{
+	const char *sp = memchr(c->line, ' ', c->line_len);
+
+	if (sp)
+	{
+		size_t head = (size_t)(sp - c->line) + 1;
+		fwrite(c->line, 1, head, out);
+		fprintf(out, "%ld ", c->pid);
+		fwrite(c->line + head, 1, c->line_len - head, out);
+	}
+	else
+	{
+		fprintf(out, "%ld ", c->pid);
+		fwrite(c->line, 1, c->line_len, out);
+	}
+	fputc('\n', out);
+}
+
+static long trace_file_pid(const char *name)
+{
+	const char *prefix = "trace_all.";
+	size_t plen = strlen(prefix);
+
+	if (strncmp(name, prefix, plen) != 0 || !name[plen])
+		return -1;
+	for (const char *t = name + plen; *t; t++)
+		if (!isdigit((unsigned char)*t))
+			return -1;
+	return strtol(name + plen, NULL, 10);
+}
+
+static int merge_trace_files(const char *dir, const char *trace_txt, const char *trace_tmp)
+{
+	t_cursor	*cur = NULL;
+	t_cursor	**heap = NULL;
+	size_t		n = 0;
+	size_t		cap = 0;
+	long		root_pid = 0;
+	int			rc = -1;
+
+	// --- 1 回だけ列挙して、各ファイルを mmap する ---
+	DIR *dp = opendir(dir);
+	if (!dp)
+		return -1;
+	struct dirent *de;
+	while ((de = readdir(dp)) != NULL)
+	{
+		long p = trace_file_pid(de->d_name);
+		if (p <= 0)
+			continue;
+		if (n == cap)
+		{
+			size_t ncap = cap ? cap * 2 : 64;
+			t_cursor *nc = realloc(cur, ncap * sizeof(t_cursor));
+			if (!nc)
+				goto out;
+			cur = nc;
+			cap = ncap;
+		}
+
+		char path[PATH_MAX + 512];
+		snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+		int fd = open(path, O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+			continue;
+		struct stat sb;
+		void *m = MAP_FAILED;
+		if (fstat(fd, &sb) == 0 && sb.st_size > 0)
+			m = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd); // mapping は fd を閉じても残る（ファイル数が多くても fd を食わない）
+		if (m == MAP_FAILED)
+			continue;
+		madvise(m, (size_t)sb.st_size, MADV_SEQUENTIAL);
+
+		cur[n] = (t_cursor){.pid = p, .base = m, .len = (size_t)sb.st_size};
+		if (root_pid == 0 || p < root_pid)
+			root_pid = p;
+		n++;
+	}
+	closedir(dp);
+	dp = NULL;
+	if (root_pid <= 0)
+		goto out;
+
+	heap = malloc((n ? n : 1) * sizeof(t_cursor *));
+	if (!heap)
+		goto out;
+	size_t hn = 0;
+	for (size_t i = 0; i < n; i++)
+	{
+		cur[i].is_root = (cur[i].pid == root_pid);
+		if (cursor_next(&cur[i]))
+			heap[hn++] = &cur[i];
+	}
+	for (size_t i = hn / 2; i-- > 0; )
+		heap_down(heap, hn, i);
+
+	// --- いちばん古い行を出しては、そのカーソルを進めて沈める ---
+	FILE *out = fopen(trace_tmp, "w");
+	if (!out)
+		goto out;
+	static char obuf[1 << 20];
+	setvbuf(out, obuf, _IOFBF, sizeof(obuf));
+	while (hn > 0)
+	{
+		write_merged_line(out, heap[0]);
+		if (!cursor_next(heap[0]))
+			heap[0] = heap[--hn];
+		heap_down(heap, hn, 0);
+	}
+	if (fclose(out) == 0 && rename(trace_tmp, trace_txt) == 0)
+		rc = 0;
+
+out:
+	if (dp)
+		closedir(dp);
+	for (size_t i = 0; i < n; i++)
+		munmap((void *)cur[i].base, cur[i].len);
+	free(heap);
+	free(cur);
+	return rc;
+}
+
 /*
  * strace を “外部コマンドとして” 実行する。
  * - traced 対象は: env -i PATH=/usr/bin:/bin minishell_path "<line>"
@@ -176,244 +434,189 @@ static int run_strace(const char *dir, const char *minishell_path, const char *l
 
 	int st = wait_to_status(pid);
 
-	// --- trace_all.<pid> を列挙して root pid（最小 pid）を決める ---
-	DIR *dp = opendir(dir);
-	if (!dp)
+	if (merge_trace_files(dir, trace_txt, trace_tmp) != 0)
 		return (st != 0) ? st : 1;
+	return st;
+}
 
-	long root_pid = 0;
-
-	struct dirent *de;
-	while ((de = readdir(dp)) != NULL)
-	{
-		// "trace_all." から始まるファイルだけ
-		const char *name = de->d_name;
-		const char *prefix = "trace_all.";
-		size_t plen = strlen(prefix);
-		if (strncmp(name, prefix, plen) != 0)
-			continue;
-
-		const char *s = name + plen;
-		if (!*s)
-			continue;
-		for (const char *t = s; *t; t++)
-			if (!isdigit((unsigned char)*t))
-				goto next_entry;
-
-		long p = strtol(s, NULL, 10);
-		if (p > 0 && (root_pid == 0 || p < root_pid))
-			root_pid = p;
-
-	next_entry:
-		;
-	}
-	closedir(dp);
-
-	if (root_pid <= 0)
-		return (st != 0) ? st : 1;
+/*
+ * focus 抽出:
+ *   grep -E " (execve|pipe2?|...)\(" trace.txt | grep -v -E "/etc/ld\.so\.cache|..." > focus_pipe.txt
+ * と同じ行を、grep を fork せずに trace.txt の mmap 1 パスで選ぶ（規則は focus.h）。
+ * 最後の行に改行が無ければ grep と同じく補って書く。
+ */
+static int make_focus_pipe(const char *dir, t_trace_mode mode, char *out_path, size_t out_sz)
+{
+	char in_path[PATH_MAX + 32];
+	snprintf(in_path, sizeof(in_path), "%s/trace.txt", dir);
 
-	// --- root_pid 以外の trace_all.<pid> を trace.txt に合成（PIDプレフィックス付） ---
-	dp = opendir(dir);
-	if (!dp)
-		return (st != 0) ? st : 1;
+	snprintf(out_path, out_sz, "%s/focus_pipe.txt", dir);
 
-	FILE *out = fopen(trace_tmp, "w");
+	FILE *out = fopen(out_path, "w");
 	if (!out)
-	{
-		closedir(dp);
-		return (st != 0) ? st : 1;
-	}
-
-	char path[PATH_MAX + 128];
-	char linebuf[8192];
+		return -1;
 
-	while ((de = readdir(dp)) != NULL)
+	// trace.txt が無い / 空なら空の focus を作って終わる
+	int infd = open(in_path, O_RDONLY | O_CLOEXEC);
+	struct stat sb;
+	const char *m = MAP_FAILED;
+	if (infd >= 0 && fstat(infd, &sb) == 0 && sb.st_size > 0)
+		m = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, infd, 0);
+	if (infd >= 0)
+		close(infd);
+	if (m == MAP_FAILED)
+		return (fclose(out) == 0) ? 0 : -1;
+	madvise((void *)m, (size_t)sb.st_size, MADV_SEQUENTIAL);
+
+	focus_tab_init();
+	static char obuf[1 << 20];
+	setvbuf(out, obuf, _IOFBF, sizeof(obuf));
+
+	const char *end = m + sb.st_size;
+	for (const char *s = m; s < end; )
 	{
-		const char *name = de->d_name;
-		const char *prefix = "trace_all.";
-		size_t plen = strlen(prefix);
-		if (strncmp(name, prefix, plen) != 0)
-			continue;
-
-		const char *s = name + plen;
-		if (!*s)
-			continue;
-		for (const char *t = s; *t; t++)
-			if (!isdigit((unsigned char)*t))
-				goto next_entry2;
-
-		long p = strtol(s, NULL, 10);
-		if (p <= 0)
-			goto next_entry2;
-
-		snprintf(path, sizeof(path), "%s/%s", dir, name);
-		FILE *in = fopen(path, "r");
-		if (!in)
-			goto next_entry2;
+		const char *nl = memchr(s, '\n', (size_t)(end - s));
+		size_t n = nl ? (size_t)(nl - s) : (size_t)(end - s);
 
-		while (fgets(linebuf, sizeof(linebuf), in))
+		if ((mode != TRACE_ALL || focus_include(s, n)) && !focus_exclude(s, n))
 		{
-            // root(pid最小)は “配線の骨格” だけ残す（env/minishell の execve ノイズを落とす）
-            if (p == root_pid)
-            {
-                if (!(strstr(linebuf, " pipe2(") ||
-                    strstr(linebuf, " pipe(")  ||
-                    strstr(linebuf, " clone(") ||
-                    strstr(linebuf, " fork(")  ||
-                    strstr(linebuf, " vfork(") ||
-                    strstr(linebuf, " wait4(") ||
-                    strstr(linebuf, " waitid(")))
-                {
-                    continue;
-                }
-            }
-
-			// 例: "13:17:00.762722 execve(...)" なので時刻の次に pid を挿入
-            char *p_time = strchr(linebuf, ' ');
-            if (p_time)
-            {
-                p_time++;
-                fprintf(out, "%.*s%ld %s", (int)(p_time - linebuf), linebuf, p, p_time);
-            }
-            else
-            {
-                fprintf(out, "%ld %s", p, linebuf);
-            }
-			if (linebuf[strlen(linebuf) - 1] != '\n')
-				fputc('\n', out);
+			fwrite(s, 1, n, out);
+			putc('\n', out);
 		}
-		fclose(in);
-
-	next_entry2:
-		;
+		s += n + 1;
 	}
+	munmap((void *)m, (size_t)sb.st_size);
+	return (fclose(out) == 0) ? 0 : -1;
+}
 
-    // out を sort しておく（時刻順）
-    while (fflush(out), fsync(fileno(out)), 0)
-    {
-        fclose(out);
-        char sort_cmd[PATH_MAX + 128];
-        snprintf(sort_cmd, sizeof(sort_cmd), "sort -k2 %s -o %s", trace_tmp, trace_tmp);
-        int rc = system(sort_cmd);
-        out = fopen(trace_tmp, "a");
-        if (rc != 0 || !out)
-            break;
-        break;
-    }
-
-	fclose(out);
-	closedir(dp);
+/*
+ * live モード（:trace live）:
+ *   tracer の出力をパイプで受け、livetrace のスレッドが focus と同じ規則でその場で絞って stdout へ出す。
+ *   trace_all.<pid> も trace.txt も作らない。生の行は :trace live N のときだけ trace.live.txt に
+ *   N バイトで回しながら残す。
+ */
+static int	g_live;
+static long	g_live_raw_max;
 
-	(void)rename(trace_tmp, trace_txt);
-	return st;
+void	observe_set_live(int on, long raw_max)
+{
+	g_live = on;
+	g_live_raw_max = raw_max;
+}
+
+int	observe_live(long *raw_max)
+{
+	if (raw_max)
+		*raw_max = g_live_raw_max;
+	return g_live;
 }
 
 /*
- * focus 抽出:
- *   grep (include) trace.* | grep -v (exclude) > focus_pipe.txt
- *
- * “シェルスクリプト無し”でやるために、
- *   - pipe()
- *   - fork() x2
- *   - dup2()
- * で grep のパイプラインを minishell 自身が組み立てる。
+ * strace -f -o で 1 本のパイプに時刻順で書かせる（-ff のファイル分割もマージも無し）。
+ * 書き端は O_CLOEXEC のまま親が持ち、strace には親の /proc/PID/fd/N を開き直させる。
+ * strace は開いた出力に FD_CLOEXEC を付けるので、追跡される側には書き端が 1 本も渡らない
+ * （fd の番号がずれず、後ろに残った子が書き端を持ったまま live_join を止めることもない）
  */
-static int make_focus_pipe(const char *dir, t_trace_mode mode, char *out_path, size_t out_sz)
+static int	run_strace_live(int out_fd, const char *minishell_path, const char *line, t_trace_mode mode)
 {
-	char in_path[PATH_MAX];
-	snprintf(in_path, sizeof(in_path), "%s/trace.txt", dir);
+	char out_path[64];
 
-	snprintf(out_path, out_sz, "%s/focus_pipe.txt", dir);
+	snprintf(out_path, sizeof(out_path), "/proc/%ld/fd/%d", (long)getpid(), out_fd);
+	const char *pipe_trace =
+		"trace=execve,clone,fork,vfork,wait4,waitid,exit_group,"
+		"pipe,pipe2,dup2,openat,close,write";
 
-	int infd = open(in_path, O_RDONLY);
-	if (infd < 0)
-	{
-		// trace.txt が無いなら空を作って終わる
-		int fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-		if (fd >= 0) close(fd);
-		return 0;
-	}
-	close(infd);
-
-	// include: TRACE_ALL のときだけ使う（PIPE は strace 側で -e trace=... 済み）
-	const char *inc_all =
-		" (execve|pipe2?|dup2?|clone|fork|vfork|wait4|waitid|exit_group)\\("
-		"| (openat|close|fcntl)\\("
-		"| (read|write|readv|writev|pread64|pwrite64)\\("
-		"| (chdir|getcwd)\\("
-		"| (setpgid|setsid|tcsetpgrp|ioctl)\\("
-		"| (sigaction|rt_sigaction|rt_sigprocmask|kill)\\(";
-
-	const char *exc =
-		"/etc/ld\\.so\\.cache|/usr/lib/|/lib/|locale-archive|/etc/locale|/etc/nsswitch\\.conf|/etc/passwd|/etc/group";
-
-	int pfd[2];
-	if (pipe(pfd) != 0)
-		return -1;
+	char *const argv_pipe[] = {
+		(char *)STRACE_PATH, "-f", "-qq", "-yy", "-tt", "-T", "-s", "128",
+		"-e", (char *)pipe_trace,
+		"-o", out_path,
+		(char *)ENV_PATH, "-i", "PATH=/usr/bin:/bin",
+		(char *)minishell_path, (char *)line,
+		NULL
+	};
+	char *const argv_all[] = {
+		(char *)STRACE_PATH, "-f", "-qq", "-yy", "-tt", "-T", "-s", "128",
+		"-o", out_path,
+		(char *)ENV_PATH, "-i", "PATH=/usr/bin:/bin",
+		(char *)minishell_path, (char *)line,
+		NULL
+	};
 
-	int outfd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-	if (outfd < 0)
+	pid_t pid = fork();
+	if (pid < 0)
+		return 1;
+	if (pid == 0)
 	{
-		close(pfd[0]);
-		close(pfd[1]);
-		return -1;
+		execv(STRACE_PATH, (mode == TRACE_PIPE) ? argv_pipe : argv_all);
+		_exit(127);
 	}
+	return wait_to_status(pid);
+}
 
-	// 子1: (TRACE_ALL) grep -E inc_all trace.txt  /  (TRACE_PIPE) cat trace.txt
-	pid_t c1 = fork();
-	if (c1 < 0)
-		return -1;
-	if (c1 == 0)
+static int	run_live(const char *dir, const char *minishell_path, const char *line,
+	t_trace_mode mode, t_trace_backend backend)
+{
+	char			raw[PATH_MAX + 64];
+	int				pfd[2];
+	t_focus_live	fx = {.include = (mode == TRACE_ALL), .from_strace = (backend == TRACE_STRACE),
+		.root_keep = is_skeleton_line, .root = -1};
+	t_live			lv = {.out = stdout, .fmt = focus_live_fmt, .ctx = &fx};
+	int				st;
+
+	if (pipe2(pfd, O_CLOEXEC) != 0)
+		return 1;
+	lv.fd = pfd[0];
+	if (g_live_raw_max > 0)
 	{
-		dup2(pfd[1], STDOUT_FILENO);
-		close(pfd[0]);
-		close(pfd[1]);
-		close(outfd);
-
-		if (mode == TRACE_ALL)
-		{
-			char *const argv[] = {(char *)GREP_PATH, "-E", (char *)inc_all, in_path, NULL};
-			execv(GREP_PATH, argv);
-			_exit(127);
-		}
-		else
-		{
-			// cat 相当（/bin/cat を呼ばずに、ここでは grep を使わず素直に exec したいなら /usr/bin/cat を許可してもOK）
-			char *const argv[] = {(char *)GREP_PATH, ".*", in_path, NULL}; // “全行マッチ”で疑似cat
-			execv(GREP_PATH, argv);
-			_exit(127);
-		}
+		snprintf(raw, sizeof(raw), "%s/trace.live.txt", dir);
+		lv.raw_path = raw;
+		lv.raw_max = g_live_raw_max;
 	}
-
-	// 子2: grep -v -E exc > focus
-	pid_t c2 = fork();
-	if (c2 < 0)
-		return -1;
-	if (c2 == 0)
+	focus_tab_init();
+	printf("[trace] live %s\n", dir);
+	fflush(stdout);
+	if (live_start(&lv) != 0)
 	{
-		dup2(pfd[0], STDIN_FILENO);
-		dup2(outfd, STDOUT_FILENO);
 		close(pfd[0]);
 		close(pfd[1]);
-		close(outfd);
-
-		char *const argv[] = {(char *)GREP_PATH, "-v", "-E", (char *)exc, NULL};
-		execv(GREP_PATH, argv);
-		_exit(127);
+		return 1;
 	}
 
-	close(pfd[0]);
+	if (backend == TRACE_NATIVE)
+		st = ntrace_run_fd(pfd[1], line, mode);
+	else
+		st = run_strace_live(pfd[1], minishell_path, line, mode);
+
+	// 書き端を全部閉じればスレッドが EOF を見て抜ける
 	close(pfd[1]);
-	close(outfd);
+	live_join(&lv);
+	close(pfd[0]);
+	printf("[trace] live: %llu lines, %llu shown", lv.lines, lv.kept);
+	if (lv.raw_path)
+		printf(", raw %s (%llu rotations)", lv.raw_path, lv.rotations);
+	printf("\n");
+	return st;
+}
+
+int	observe_new_run_dir(char *out, size_t out_sz)
+{
+	char root[PATH_MAX];
 
-	int s1 = wait_to_status(c1);
-	int s2 = wait_to_status(c2);
-	if (s1 == 127 || s2 == 127)
+	if (ensure_log_root(root, sizeof(root)) != 0)
+	{
+		fprintf(stderr, "minishell: cannot create ./logs/minishell or ./tmp/minishell\n");
 		return -1;
+	}
+	if (make_run_dir(out, out_sz, root) != 0)
+	{
+		fprintf(stderr, "minishell: cannot create run dir under %s\n", root);
+		return -1;
+	}
 	return 0;
 }
 
-int observe_run_traced(const char *minishell_path, const char *line, t_trace_mode mode)
+int observe_run_traced(const char *minishell_path, const char *line, t_trace_mode mode,
+	t_trace_backend backend)
 {
 	char root[PATH_MAX];
 	if (ensure_log_root(root, sizeof(root)) != 0)
@@ -438,16 +641,31 @@ int observe_run_traced(const char *minishell_path, const char *line, t_trace_mod
 		snprintf(buf, sizeof(buf),
 			"minishell_path=%s\n"
 			"line=%s\n"
-			"mode=%s\n",
-			minishell_path, line, (mode == TRACE_PIPE) ? "pipe" : "all");
+			"mode=%s\n"
+			"backend=%s\n",
+			minishell_path, line, (mode == TRACE_PIPE) ? "pipe" : "all",
+			(backend == TRACE_NATIVE) ? "native" : "strace");
+		if (g_live)
+			snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "live=on\n");
 		(void)write_text_file(meta, buf);
 	}
 
-	// 1) strace 実行
-	int status = run_strace(dir, minishell_path, line, mode);
+	if (g_live)
+		return run_live(dir, minishell_path, line, mode, backend);
+
+	// 1) 追跡して trace.txt を作る
+	int status;
+	if (backend == TRACE_NATIVE)
+	{
+		char trace_txt[PATH_MAX + 64];
+		snprintf(trace_txt, sizeof(trace_txt), "%s/trace.txt", dir);
+		status = ntrace_run(trace_txt, line, mode);
+	}
+	else
+		status = run_strace(dir, minishell_path, line, mode);
 
 	// 2) focus 抽出
-	char focus[PATH_MAX];
+	char focus[PATH_MAX + 32];
 	if (make_focus_pipe(dir, mode, focus, sizeof(focus)) == 0)
 	{
 		printf("[trace] %s\n", focus);
@@ -458,5 +676,11 @@ int observe_run_traced(const char *minishell_path, const char *line, t_trace_mod
 		fprintf(stderr, "minishell(trace): focus extraction failed (dir=%s)\n", dir);
 	}
 
+	// 3) -T の時間を集計（同じ meta.txt の過去 run があれば run 間のばらつきも）
+	if (trace_summary_write(dir) == 0)
+		printf("[trace] %s/summary.txt\n", dir);
+	else
+		fprintf(stderr, "minishell(trace): summary failed (dir=%s)\n", dir);
+
 	return status;
 }
@@ -1,21 +1,47 @@
 #ifndef OBSERVE_H
 #define OBSERVE_H
 
+#include <stddef.h>
+
 typedef enum e_trace_mode
 {
 	TRACE_PIPE = 0, // パイプ/リダイレクト中心にフォーカス（ノイズ除去あり）
-	TRACE_ALL  = 1  // 広め（必要なら後で調整）
+	TRACE_ALL  = 1, // 広め（必要なら後で調整）
+	TRACE_LITE = 2  // strace を使わず、実行系が自分でイベントを記録する（evtrace.h）
 }	t_trace_mode;
 
+typedef enum e_trace_backend
+{
+	TRACE_NATIVE = 0, // 組み込みの ptrace + seccomp トレーサ（ntrace.h）
+	TRACE_STRACE = 1  // 外部の strace で包む
+}	t_trace_backend;
+
 /*
- * trace を “外部コマンドとしての strace/grep” で行う。
- * - minishell_path: 実行中の minishell 実体パス（例: "./minishell"）
+ * trace を行い、trace.txt と focus_pipe.txt、summary.txt / summary.json を logs/minishell/<TS-PID>/ に作る。
+ * - minishell_path: 実行中の minishell 実体パス（例: "./minishell"。strace 版で使う）
  * - line: 実行したいコマンドライン（例: "echo hi | wc -c > /tmp/out"）
  * - mode: TRACE_PIPE / TRACE_ALL
+ * - backend: TRACE_NATIVE なら自前の tracer、TRACE_STRACE なら外部の strace
  *
  * 戻り値:
  *   - traced な minishell（一発実行）の exit status を返す（通常のシェルと同じ）
  */
-int observe_run_traced(const char *minishell_path, const char *line, t_trace_mode mode);
+int observe_run_traced(const char *minishell_path, const char *line, t_trace_mode mode,
+	t_trace_backend backend);
+
+/*
+ * live モードの切り替え（:trace live [N] / :trace live off）
+ * - on の間 observe_run_traced は trace.txt を作らず、tracer の出力をパイプから受けて
+ *   focus と同じ規則で絞った行をその場で stdout に出す
+ * - raw_max > 0 なら生の行を run ディレクトリの trace.live.txt に残す（raw_max バイトで .1 へ回す）
+ */
+void	observe_set_live(int on, long raw_max);
+int		observe_live(long *raw_max);
+
+/*
+ * logs/minishell/<TS-PID>/ を作って out に入れる（trace 以外の記録、--profile などが使う）
+ * 戻り値: 0 / 作れなければ -1（理由は stderr に出す）
+ */
+int		observe_new_run_dir(char *out, size_t out_sz);
 
 #endif
@@ -0,0 +1,398 @@
+#define _GNU_SOURCE
+#include "parallel.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/sendfile.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "exec.h"
+#include "jobs.h"
+#include "parse.h"
+#include "zygote.h"
+
+/*
+ * job 1 本分の記録
+ * - 終わった後も latency 表示のために残す（procs は終わったら解放）
+ */
+typedef struct s_pjob
+{
+	long			seq;
+	char			*line;
+	t_proc			*procs;
+	int				n;
+	int				out_fd;   // keep_order のときの一時ファイル（-1 なら直接 stdout）
+	struct timespec	start;
+	double			latency_ms;
+	int				code;
+	int				done;
+}	t_pjob;
+
+typedef struct s_sched
+{
+	const t_parallel_opts	*opt;
+	t_pjob					*jobs;     // 入力順の全 job
+	long					njobs;
+	long					cap;
+	long					*slots;    // 実行中 job の index（最大 opt->jobs 個）
+	int						nactive;
+	long					next_flush; // keep_order: 次に stdout へ出す seq
+	long					window;     // keep_order: 始めてまだ出していない job（一時ファイル）の上限
+}	t_sched;
+
+#define SPILL_AHEAD 4   // keep_order: 先頭の job を待つ間、slot 数の何倍まで先の job を始めておくか
+
+static double	elapsed_ms(const struct timespec *a, const struct timespec *b)
+{
+	return (double)(b->tv_sec - a->tv_sec) * 1e3
+		+ (double)(b->tv_nsec - a->tv_nsec) / 1e6;
+}
+
+/*
+ * 出力を溜める一時ファイル。名前は要らないので O_TMPFILE を優先する。
+ */
+static int	open_spill_file(void)
+{
+	int fd = open(P_tmpdir, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+	if (fd >= 0)
+		return fd;
+
+	char path[] = P_tmpdir "/minishell-par.XXXXXX";
+	fd = mkostemp(path, O_CLOEXEC);
+	if (fd >= 0)
+		unlink(path);
+	return fd;
+}
+
+/*
+ * keep_order の window: 終わっても先頭が終わるまで出せない job は一時ファイルの fd を持ち続けるので、
+ * その数を slot 数の SPILL_AHEAD 倍、かつ RLIMIT_NOFILE の半分（pidfd とパイプの分を残す）までに抑える
+ */
+static long	spill_window(int jobs)
+{
+	struct rlimit	rl;
+	long			w = (long)jobs * SPILL_AHEAD;
+
+	if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY
+		&& w > (long)(rl.rlim_cur / 2))
+		w = (long)(rl.rlim_cur / 2);
+	return (w < jobs) ? jobs : w;
+}
+
+static void	copy_fd_to_stdout(int fd)
+{
+	off_t	off = 0;
+	char	buf[8192];
+	ssize_t	n;
+
+	fflush(stdout);
+	while ((n = sendfile(STDOUT_FILENO, fd, &off, 1 << 20)) > 0)
+		;
+	if (n == 0)
+		return;
+
+	// stdout が sendfile 非対応（古いカーネルの tty など）なら素直にコピー
+	if (lseek(fd, off, SEEK_SET) < 0)
+		return;
+	while ((n = read(fd, buf, sizeof(buf))) > 0)
+	{
+		if (write(STDOUT_FILENO, buf, (size_t)n) != n)
+			break;
+	}
+}
+
+static t_pjob	*sched_push(t_sched *s, const char *line)
+{
+	if (s->njobs == s->cap)
+	{
+		long ncap = s->cap ? s->cap * 2 : 64;
+		t_pjob *nj = realloc(s->jobs, (size_t)ncap * sizeof(t_pjob));
+		if (!nj)
+			return NULL;
+		s->jobs = nj;
+		s->cap = ncap;
+	}
+	t_pjob *j = &s->jobs[s->njobs];
+	*j = (t_pjob){0};
+	j->seq = s->njobs;
+	j->out_fd = -1;
+	j->line = strdup(line);
+	if (!j->line)
+		return NULL;
+	s->njobs++;
+	return j;
+}
+
+static void	job_finish(t_pjob *j)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	j->latency_ms = elapsed_ms(&j->start, &now);
+	if (j->procs)
+	{
+		j->code = status_to_code(j->procs[j->n - 1].status);
+		procs_close(j->procs, j->n);
+		free(j->procs);
+		j->procs = NULL;
+	}
+	j->done = 1;
+}
+
+/*
+ * 1 行をパースして spawn する（待たない）。
+ * パースや spawn に失敗した job はその場で done にする。
+ */
+static int	job_start(t_sched *s, t_pjob *j)
+{
+	t_cmdline	cl;
+	pid_t		*pids;
+
+	clock_gettime(CLOCK_MONOTONIC, &j->start);
+
+	j->code = parse_command_line(j->line, &cl);
+	if (j->code != 0)
+	{
+		job_finish(j);
+		return 0;
+	}
+
+	// 一時ファイルが無いまま stdout に書かせると順番が崩れるので、その job は走らせずに失敗にする
+	if (s->opt->keep_order && (j->out_fd = open_spill_file()) < 0)
+	{
+		fprintf(stderr, "minishell: parallel: #%ld: cannot open spill file: %s\n",
+			j->seq + 1, strerror(errno));
+		j->code = 1;
+		free_command_line(&cl);
+		job_finish(j);
+		return 0;
+	}
+
+	pids = calloc((size_t)cl.ncmd, sizeof(pid_t));
+	j->procs = calloc((size_t)cl.ncmd, sizeof(t_proc));
+	t_spawn sp;
+	int tmp_fd = spawn_opts_from_cmdline(&cl, &sp);
+	sp.out_fd = j->out_fd;
+	int rc = (pids && j->procs) ? spawn_pipeline(cl.argvv, cl.ncmd, &sp, pids) : -1;
+	if (tmp_fd >= 0)
+		close(tmp_fd);
+	if (rc != 0)
+	{
+		free(pids);
+		free(j->procs);
+		j->procs = NULL;
+		j->code = 1;
+		free_command_line(&cl);
+		job_finish(j);
+		return 0;
+	}
+	procs_open(j->procs, pids, cl.ncmd);
+	j->n = cl.ncmd;
+	free(pids);
+	free_command_line(&cl);
+	return 1;
+}
+
+/*
+ * keep_order: 先頭から連続して終わっている job の出力だけを吐き出す
+ */
+static void	flush_in_order(t_sched *s)
+{
+	while (s->next_flush < s->njobs && s->jobs[s->next_flush].done)
+	{
+		t_pjob *j = &s->jobs[s->next_flush];
+		if (j->out_fd >= 0)
+		{
+			copy_fd_to_stdout(j->out_fd);
+			close(j->out_fd);
+			j->out_fd = -1;
+		}
+		s->next_flush++;
+	}
+}
+
+/*
+ * 終わっている job を slot から外す。返り値: 外した数
+ */
+static int	reap_finished(t_sched *s, int timeout_ms)
+{
+	int	finished = 0;
+
+	for (int k = 0; k < s->nactive; )
+	{
+		t_pjob *j = &s->jobs[s->slots[k]];
+		if (procs_wait(j->procs, j->n, timeout_ms) != 0)
+		{
+			k++;
+			continue;
+		}
+		job_finish(j);
+		s->slots[k] = s->slots[--s->nactive];
+		finished++;
+	}
+	return finished;
+}
+
+/*
+ * 実行中のどれかの子が終わるまで待ち、終わった job を slot から外す。
+ * 全 slot の pidfd をまとめて poll するので、空いた slot はすぐ埋め直せる。
+ */
+static void	wait_any(t_sched *s)
+{
+	struct pollfd	*pfds;
+	int				np = 0;
+	int				total = 0;
+
+	// 既に終わっているもの（zygote から届いて溜まっている終了通知を含む）を先に拾う
+	if (reap_finished(s, 0) > 0)
+		return;
+
+	for (int k = 0; k < s->nactive; k++)
+		total += s->jobs[s->slots[k]].n;
+	pfds = calloc((size_t)total + 2, sizeof(*pfds));
+	if (!pfds)
+	{
+		// poll できないので先頭 slot をブロックして待つ
+		reap_finished(s, -1);
+		return;
+	}
+
+	int timeout = -1;
+	int need_zygote = 0;
+	for (int k = 0; k < s->nactive; k++)
+	{
+		t_pjob *j = &s->jobs[s->slots[k]];
+		for (int i = 0; i < j->n; i++)
+		{
+			if (j->procs[i].done)
+				continue;
+			if (j->procs[i].remote)
+			{
+				need_zygote = 1; // 終了通知は zygote ソケットに来る
+				continue;
+			}
+			if (j->procs[i].pidfd < 0)
+			{
+				timeout = 10; // pidfd が無い子は短い間隔で覗きに行く
+				continue;
+			}
+			pfds[np].fd = j->procs[i].pidfd;
+			pfds[np].events = POLLIN;
+			np++;
+		}
+	}
+	if (need_zygote && zygote_fd() >= 0)
+	{
+		pfds[np].fd = zygote_fd();
+		pfds[np].events = POLLIN;
+		np++;
+	}
+	if (np > 0 || timeout >= 0)
+	{
+		while (poll(pfds, (nfds_t)np, timeout) < 0 && errno == EINTR)
+			;
+	}
+	free(pfds);
+	reap_finished(s, 0);
+}
+
+static int	read_next_line(FILE *in, const char *stop_line, char **buf, size_t *cap)
+{
+	while (getline(buf, cap, in) >= 0)
+	{
+		chomp_newline(*buf);
+		if (stop_line && strcmp(*buf, stop_line) == 0)
+			return 0;
+		if (!is_blank_line(*buf))
+			return 1;
+	}
+	return 0;
+}
+
+static int	report(const t_sched *s, const struct timespec *t0)
+{
+	struct timespec	t1;
+	int				failed = 0;
+	double			sum = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	for (long i = 0; i < s->njobs; i++)
+	{
+		const t_pjob *j = &s->jobs[i];
+		fprintf(stderr, "  #%-4ld %10.3f ms  exit %-3d %s\n",
+			j->seq + 1, j->latency_ms, j->code, j->line);
+		sum += j->latency_ms;
+		if (j->code != 0)
+			failed++;
+	}
+	fprintf(stderr, "parallel: %ld jobs, %d slots, wall %.3f ms, sum %.3f ms, failed %d\n",
+		s->njobs, s->opt->jobs, elapsed_ms(t0, &t1), sum, failed);
+	return (failed > 0);
+}
+
+int	parallel_run(FILE *in, const t_parallel_opts *opt)
+{
+	t_sched			s = {0};
+	struct timespec	t0;
+	char			*buf = NULL;
+	size_t			cap = 0;
+	int				eof = 0;
+	int				code;
+
+	if (!opt || opt->jobs <= 0)
+		return 2;
+	s.opt = opt;
+	s.slots = calloc((size_t)opt->jobs, sizeof(long));
+	if (!s.slots)
+		return 1;
+
+	s.window = spill_window(opt->jobs);
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	while (1)
+	{
+		if (opt->keep_order)
+			flush_in_order(&s);
+		// 空いている slot を埋める。keep_order で window が一杯なら、先頭が終わって出せるまで始めない
+		while (!eof && s.nactive < opt->jobs
+			&& (!opt->keep_order || s.njobs - s.next_flush < s.window))
+		{
+			if (!read_next_line(in, opt->stop_line, &buf, &cap))
+			{
+				eof = 1;
+				break;
+			}
+			t_pjob *j = sched_push(&s, buf);
+			if (!j)
+			{
+				fprintf(stderr, "minishell: out of memory\n");
+				eof = 1;
+				break;
+			}
+			if (job_start(&s, j))
+				s.slots[s.nactive++] = j->seq;
+		}
+		if (opt->keep_order)
+			flush_in_order(&s);
+		if (s.nactive == 0 && eof)
+			break;
+		if (s.nactive > 0)
+			wait_any(&s);
+	}
+	if (opt->keep_order)
+		flush_in_order(&s);
+	fflush(stdout);
+
+	code = report(&s, &t0);
+	for (long i = 0; i < s.njobs; i++)
+		free(s.jobs[i].line);
+	free(s.jobs);
+	free(s.slots);
+	free(buf);
+	return code;
+}
@@ -0,0 +1,27 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stdio.h>
+
+/*
+ * :parallel / -j N -f file
+ *
+ * in から 1 行 1 コマンドで読み、最大 jobs 本のパイプラインを同時に走らせる。
+ * - keep_order: 出力を入力順に並べる（各 job の stdout を一時ファイルに逃がしておく）。
+ *               始めてまだ出していない job は slot 数の数倍（RLIMIT_NOFILE の半分まで）に抑え、
+ *               それを超えたら先頭の job が終わるまで次を始めない
+ * - stop_line : この行が来たら入力終わり（REPL から読むとき用。NULL なら EOF まで）
+ *
+ * 最後に全体の wall time と job ごとの latency を stderr に出す。
+ * 返り値: 失敗した job があれば 1、全部成功なら 0
+ */
+typedef struct s_parallel_opts
+{
+	int			jobs;
+	int			keep_order;
+	const char	*stop_line;
+}	t_parallel_opts;
+
+int	parallel_run(FILE *in, const t_parallel_opts *opt);
+
+#endif
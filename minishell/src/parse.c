@@ -0,0 +1,446 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "evtrace.h"
+#include "parse.h"
+#include "relay.h"
+
+/*
+ * 超雑：空白（space/tab）区切りのみのトークナイズ。
+ * - クォート、エスケープ、変数展開、連結、リダイレクト演算子などは未対応。
+ * - 学習用の最小実装として「argv を作る」ことにだけ集中している。
+ */
+static t_words	split_spaces(const char *s)
+{
+	t_words	w = (t_words){0};
+	size_t	i = 0, n = 0;
+	char	*buf;
+	char	**argv;
+
+	if (!s)
+		return w;
+
+	buf = strdup(s);
+	if (!buf)
+		return w;
+
+	// 単語数を数える（連続空白は飛ばす）
+	for (i = 0; buf[i];)
+	{
+		while (buf[i] == ' ' || buf[i] == '\t')
+			i++;
+		if (!buf[i])
+			break;
+		n++;
+		while (buf[i] && buf[i] != ' ' && buf[i] != '\t')
+			i++;
+	}
+
+	argv = calloc(n + 1, sizeof(char *));
+	if (!argv)
+	{
+		free(buf);
+		return (t_words){0};
+	}
+
+	// 分割して argv に詰める（buf を破壊的に利用）
+	size_t ai = 0;
+	for (i = 0; buf[i];)
+	{
+		while (buf[i] == ' ' || buf[i] == '\t')
+			buf[i++] = '\0';
+		if (!buf[i])
+			break;
+		argv[ai++] = &buf[i];
+		while (buf[i] && buf[i] != ' ' && buf[i] != '\t')
+			i++;
+	}
+
+	argv[ai] = NULL;
+	w.argv = argv;
+	w.buf = buf;
+	return w;
+}
+
+/*
+ * split_spaces の後始末。
+ * argv[i] は buf 内を指すだけなので、free するのは buf と argv だけ。
+ */
+static void	free_words(t_words w)
+{
+	free(w.buf);
+	free(w.argv);
+}
+
+/*
+ * 末尾の改行を落とす（getline 用）
+ * - "\n" または "\r\n" を想定
+ */
+void	chomp_newline(char *s)
+{
+	size_t len;
+
+	if (!s)
+		return;
+	len = strlen(s);
+	while (len > 0 && (s[len - 1] == '\n' || s[len - 1] == '\r'))
+	{
+		s[len - 1] = '\0';
+		len--;
+	}
+}
+
+/*
+ * 空行判定（space/tab のみも空とみなす）
+ */
+int	is_blank_line(const char *s)
+{
+	if (!s)
+		return 1;
+	while (*s)
+	{
+		if (*s != ' ' && *s != '\t')
+			return 0;
+		s++;
+	}
+	return 1;
+}
+
+/*
+ * "<<" / "<<<" / "<" の直後の 1 語を切り出す。
+ * - 空白 / '|' / '<' / '>' / 改行で終わる。"..." か '...' で囲めば空白も含められる（here-string 用）
+ * - 引用符は外す（heredoc の区切りも <<"EOF" / <<'EOF' なら EOF になる）
+ * - 切り出した語は strndup して返し、*endp に（閉じ引用符を含めた）語の直後を入れる
+ * - 語が無ければ NULL
+ */
+static char	*take_word(const char *p, const char **endp)
+{
+	const char	*w;
+	size_t		n;
+
+	while (*p == ' ' || *p == '\t')
+		p++;
+	if (*p == '"' || *p == '\'')
+	{
+		w = p + 1;
+		n = strcspn(w, (*p == '"') ? "\"\n" : "'\n");
+		*endp = w + n + (w[n] == *p);
+	}
+	else
+	{
+		w = p;
+		n = strcspn(w, " \t|<>\n");
+		*endp = w + n;
+	}
+	if (n == 0)
+		return NULL;
+	return strndup(w, n);
+}
+
+/*
+ * 行中の "<<DELIM"（"<<<" ではないもの）を探し、DELIM を out にコピーする。
+ * REPL が続きの行（heredoc 本文）を読むかどうかの判定に使う。
+ * 区切りは take_word と同じ規則で切り出すので、引用符付きでも parse_command_line と同じ語になる。
+ * minishell は本文を展開しないので、引用符の有無で本文の扱いは変わらない（bash の <<'EOF' と同じ）。
+ * 返り値: heredoc があれば 1
+ */
+int	heredoc_delimiter(const char *line, char *out, size_t out_sz)
+{
+	const char	*p = line;
+	const char	*end;
+	char		*w;
+	size_t		n;
+
+	while ((p = strstr(p, "<<")) != NULL)
+	{
+		if (p[2] == '<')
+		{
+			p += 3;
+			continue;
+		}
+		w = take_word(p + 2, &end);
+		if (!w)
+			return 0;
+		n = strlen(w);
+		if (n < out_sz)
+			memcpy(out, w, n + 1);
+		free(w);
+		return n < out_sz;
+	}
+	return 0;
+}
+
+/*
+ * heredoc 本文を集める。
+ * body は 1 行目の後ろ（"\n" 区切り）。DELIM だけの行で終わる。
+ */
+static char	*collect_heredoc(const char *body, const char *delim, size_t *out_len)
+{
+	size_t		cap = strlen(body ? body : "") + 1;
+	char		*data = malloc(cap);
+	size_t		len = 0;
+	const char	*p = body;
+	int			closed = 0;
+
+	if (!data)
+		return NULL;
+	while (p && *p)
+	{
+		const char *nl = strchr(p, '\n');
+		size_t n = nl ? (size_t)(nl - p) : strlen(p);
+		if (n == strlen(delim) && strncmp(p, delim, n) == 0)
+		{
+			closed = 1;
+			break;
+		}
+		memcpy(data + len, p, n);
+		len += n;
+		data[len++] = '\n';
+		p = nl ? nl + 1 : p + n;
+	}
+	if (!closed)
+		fprintf(stderr, "minishell: warning: here-document delimited by end-of-file (wanted `%s')\n", delim);
+	*out_len = len;
+	return data;
+}
+
+/*
+ * 入力リダイレクト（最初の段だけ）を抜き取る。
+ * - "<<<" here-string / "<<" heredoc / "<" file のどれか 1 つ
+ * - 抜き取った部分は空白で塗りつぶす（後段の '>' / '|' の解析に影響させない）
+ * 返り値: 0 成功 / 1 メモリ不足 / 2 構文エラー
+ */
+static int	take_input_redir(char *line, const char *body, t_cmdline *cl)
+{
+	char		*lt = strchr(line, '<');
+	const char	*end;
+	char		*w;
+	int			ops;
+
+	if (!lt)
+		return 0;
+	if (memchr(line, '|', (size_t)(lt - line)))
+	{
+		fprintf(stderr, "minishell: input redirection is only supported on the first command\n");
+		return 2;
+	}
+
+	ops = (lt[1] == '<') ? ((lt[2] == '<') ? 3 : 2) : 1;
+	w = take_word(lt + ops, &end);
+	if (!w)
+	{
+		fprintf(stderr, "minishell: redirection: missing %s\n",
+			ops == 1 ? "file" : (ops == 2 ? "delimiter" : "word"));
+		return 2;
+	}
+	memset(lt, ' ', (size_t)(end - lt));
+
+	if (ops == 1)
+	{
+		cl->in_kind = IN_FILE;
+		cl->in_path = w;
+		return 0;
+	}
+
+	cl->in_kind = IN_DATA;
+	if (ops == 3)
+	{
+		// strndup 済みの NUL を改行に置き換える（bash と同じく改行を 1 つ付ける）
+		size_t n = strlen(w);
+		w[n] = '\n';
+		cl->in_data = w;
+		cl->in_len = n + 1;
+		return 0;
+	}
+	cl->in_data = collect_heredoc(body, w, &cl->in_len);
+	free(w);
+	return cl->in_data ? 0 : 1;
+}
+
+/*
+ * 入力 1 行を「実行できる形」にパースする。
+ *
+ * やっていること（高レベル）:
+ *  1) 入力を strdup して「破壊的に」パースできるようにする
+ *     （2 行目以降は heredoc 本文として 1 行目から切り離す）
+ *  2) 行末の「&」があればバックグラウンド指定として落とす
+ *  3) 最初の段の「< file」「<<DELIM」「<<< word」を抜き取る
+ *  4) 行末の「> file」だけを抜き取る（この minishell の仕様）
+ *  5) '|' で分割して各コマンド断片を split_spaces（"|&tee file" は中継段になる）
+ *
+ * 返り値:
+ *  - 0: 成功（cl を free_command_line で後始末すること）
+ *  - 1: メモリ不足 / 2: 構文エラー（cl は後始末済み）
+ */
+int	parse_command_line(const char *input, t_cmdline *cl)
+{
+	char	*line;
+	int		code = 0;
+
+	*cl = (t_cmdline){0};
+
+	line = strdup(input);
+	if (!line)
+	{
+		fprintf(stderr, "minishell: out of memory\n");
+		return 1;
+	}
+
+	// 2 行目以降は heredoc 本文（line の中に残したまま 1 行目だけを解析する）
+	char *body = strchr(line, '\n');
+	if (body)
+		*body++ = '\0';
+
+	/*
+	 * 行末の '&' はバックグラウンド実行
+	 * - 末尾の空白を落としてから最後の 1 文字だけを見る
+	 */
+	{
+		size_t len = strlen(line);
+		while (len > 0 && (line[len - 1] == ' ' || line[len - 1] == '\t'))
+			line[--len] = '\0';
+		if (len > 0 && line[len - 1] == '&')
+		{
+			line[--len] = '\0';
+			cl->background = 1;
+		}
+	}
+
+	code = take_input_redir(line, body, cl);
+	if (code != 0)
+	{
+		if (code == 1)
+			fprintf(stderr, "minishell: out of memory\n");
+		free(cl->in_data);
+		free(cl->in_path);
+		free(line);
+		*cl = (t_cmdline){0};
+		return code;
+	}
+
+	/*
+	 * 方針: 「最後だけリダイレクト」
+	 * - 行末の '>' だけを見る（strrchr で最後の '>' を取る）
+	 * - ここは学習を進めるための割り切り仕様
+	 */
+	char *out_path = NULL;
+	char *gt = strrchr(line, '>');
+	if (gt)
+	{
+		*gt = '\0';   // コマンド部分をここで切る
+		gt++;
+		while (*gt == ' ' || *gt == '\t')
+			gt++;
+
+		if (!*gt)
+		{
+			fprintf(stderr, "minishell: redirection: missing file\n");
+			free(cl->in_data);
+			free(cl->in_path);
+			free(line);
+			*cl = (t_cmdline){0};
+			return 2;
+		}
+
+		out_path = gt; // out_path は line の内部を指す
+		while (*gt && *gt != ' ' && *gt != '\t')
+			gt++;
+		*gt = '\0';    // ファイル名を終端
+	}
+
+	// '|' の数を数える
+	int pipes = 0;
+	for (int i = 0; line[i]; i++)
+		if (line[i] == '|')
+			pipes++;
+	int ncmd = pipes + 1;
+
+	// コマンド配列（各要素は split_spaces の結果）
+	char ***argvv = calloc((size_t)ncmd, sizeof(char **));
+	t_words *words = calloc((size_t)ncmd, sizeof(t_words));
+	if (!argvv || !words)
+	{
+		free(argvv);
+		free(words);
+		free(cl->in_data);
+		free(cl->in_path);
+		free(line);
+		*cl = (t_cmdline){0};
+		fprintf(stderr, "minishell: out of memory\n");
+		return 1;
+	}
+
+	/*
+	 * line を '|' で分割して各セグメントを split
+	 * - line はすでに strdup 済みなので、破壊してOK
+	 */
+	int idx = 0;
+	char *seg = line;
+	for (int i = 0; ; i++)
+	{
+		if (line[i] == '|' || line[i] == '\0')
+		{
+			char saved = line[i];
+			line[i] = '\0';
+
+			words[idx] = split_spaces(seg);
+			if (!words[idx].argv || !words[idx].argv[0])
+			{
+				// 空コマンドはエラー扱い
+				fprintf(stderr, "minishell: parse error near '|'\n");
+				free_words(words[idx]);
+				code = 2;
+				line[i] = saved;
+				break;
+			}
+			argvv[idx] = words[idx].argv;
+			idx++;
+
+			if (saved == '\0')
+				break;
+
+			seg = &line[i + 1];
+			line[i] = saved;
+		}
+	}
+
+	/*
+	 * "|&tee file" は「&tee file」という段として残し、spawn_pipeline が中継段として扱う
+	 * - 先頭には置けない / 引数はファイル名 1 つだけ
+	 */
+	for (int i = 0; code == 0 && i < idx; i++)
+	{
+		if (argvv[i][0][0] != '&')
+			continue;
+		if (i == 0 || !is_tee_stage(argvv[i]) || !argvv[i][1] || argvv[i][2])
+		{
+			fprintf(stderr, "minishell: parse error near '|&'\n");
+			code = 2;
+		}
+	}
+
+	cl->line = line;
+	cl->argvv = argvv;
+	cl->words = words;
+	cl->ncmd = ncmd;
+	cl->nwords = idx;
+	cl->out_path = out_path;
+	if (code != 0)
+		free_command_line(cl);
+	else
+		evtrace_rec(EV_PARSE, -1, ncmd, 0);
+	return code;
+}
+
+void	free_command_line(t_cmdline *cl)
+{
+	for (int i = 0; i < cl->nwords; i++)
+		free_words(cl->words[i]);
+	free(cl->argvv);
+	free(cl->words);
+	free(cl->in_data);
+	free(cl->in_path);
+	free(cl->line);
+	*cl = (t_cmdline){0};
+}
@@ -0,0 +1,63 @@
+#ifndef PARSE_H
+#define PARSE_H
+
+#include <stddef.h>
+
+/*
+ * split_spaces() の返り値：
+ * - argv: exec に渡す argv 配列（NULL終端）
+ * - buf : argv の各要素が指す「元のバッファ先頭」。free すべき領域。
+ *
+ * 重要:
+ *  - argv[i] は buf の内部（ヌル終端に置換して分割）を指すだけで、個別に free しない。
+ *  - free するのは buf と argv 配列そのものだけ。
+ */
+typedef struct s_words
+{
+	char	**argv;  // exec に渡す配列（buf 内を指す）
+	char	*buf;    // free すべき strdup の先頭
+}	t_words;
+
+/*
+ * 最初の段の stdin の指定
+ * - IN_FILE: "< file"
+ * - IN_DATA: "<<DELIM" の heredoc 本文 / "<<< word" の here-string
+ */
+typedef enum e_in_kind
+{
+	IN_NONE = 0,
+	IN_FILE = 1,
+	IN_DATA = 2
+}	t_in_kind;
+
+/*
+ * parse_command_line() の結果（1 行分）
+ * - argvv[0..ncmd-1]: 各段の argv（words[i].argv と同じもの）
+ * - out_path        : 行末の「> file」（line の内部を指す。無ければ NULL）
+ * - in_path         : 「< file」（strndup 済み）
+ * - in_data/in_len  : heredoc / here-string の中身（malloc 済み。NUL 終端ではない）
+ * - background      : 行末に '&' があれば 1
+ */
+typedef struct s_cmdline
+{
+	char		*line;       // strdup した入力（破壊的に分割済み）
+	char		***argvv;
+	t_words		*words;
+	int			ncmd;
+	int			nwords;      // words のうち後始末が必要な数
+	char		*out_path;
+	t_in_kind	in_kind;
+	char		*in_path;
+	char		*in_data;
+	size_t		in_len;
+	int			background;
+}	t_cmdline;
+
+int		parse_command_line(const char *input, t_cmdline *cl);
+void	free_command_line(t_cmdline *cl);
+int		heredoc_delimiter(const char *line, char *out, size_t out_sz);
+
+void	chomp_newline(char *s);
+int		is_blank_line(const char *s);
+
+#endif
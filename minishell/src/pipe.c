@@ -1,28 +1,48 @@
+#define _GNU_SOURCE
 #include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include "evtrace.h"
+#include "exec.h"
+#include "jobs.h"
+#include "relay.h"
+#include "zygote.h"
+
 int redir_stdout_trunc(const char *path);
+int redir_stdin_file(const char *path);
 
+/*
+ * 段の順に waitpid でブロックすると、先頭の段が先に失敗しても
+ * 最後の段が終わるまで気づけない。pidfd を poll して終わった順に回収する。
+ */
 static int	wait_all(pid_t *pids, int n)
 {
-	int	status;
-	int	last_status = 0;
-	int	i;
+	t_proc	*procs;
+	int		code;
 
-	for (i = 0; i < n; i++)
-	{
-		if (waitpid(pids[i], &status, 0) < 0)
-			continue;
-		last_status = status;
-	}
-	if (WIFEXITED(last_status))
-		return WEXITSTATUS(last_status);
-	if (WIFSIGNALED(last_status))
-		return 128 + WTERMSIG(last_status);
-	return 1;
+	procs = calloc((size_t)n, sizeof(t_proc));
+	if (!procs)
+		return 1;
+	procs_open(procs, pids, n);
+	procs_wait(procs, n, -1);
+	code = status_to_code(procs[n - 1].status);
+	procs_close(procs, n);
+	free(procs);
+	return code;
+}
+
+static void	join_cgroup(const char *procs_path)
+{
+	int fd = open(procs_path, O_WRONLY | O_CLOEXEC);
+	if (fd < 0)
+		return;
+	ssize_t w = write(fd, "0", 1);
+	(void)w;
+	close(fd);
 }
 
 static void	die_perror(const char *msg)
@@ -31,31 +51,100 @@ static void	die_perror(const char *msg)
 	exit(1);
 }
 
-int	exec_pipeline_redir(char ***argvv, int n, const char *out_path)
+/*
+ * zygote 経由のとき、最後の段の stdout に渡す fd を親側で用意する。
+ * （"> file" は子の中で open できないので、ここで開いて SCM_RIGHTS で渡す）
+ * 返り値: 渡す fd（-1 なら zygote の stdout のまま）。*opened が 1 なら後で close する
+ */
+static int	zygote_last_out(const t_spawn *sp, int *opened)
+{
+	*opened = 0;
+	if (sp && sp->out_path)
+	{
+		int fd = open(sp->out_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+		if (fd >= 0)
+			*opened = 1;
+		return fd;
+	}
+	if (sp && sp->out_fd >= 0)
+		return sp->out_fd;
+	return -1;
+}
+
+// 同様に最初の段の stdin（"< file" は親で開いて渡す）
+static int	zygote_first_in(const t_spawn *sp, int *opened)
+{
+	*opened = 0;
+	if (sp && sp->in_path)
+	{
+		int fd = open(sp->in_path, O_RDONLY | O_CLOEXEC);
+		if (fd >= 0)
+			*opened = 1;
+		return fd;
+	}
+	if (sp && sp->in_fd >= 0)
+		return sp->in_fd;
+	return -1;
+}
+
+/*
+ * パイプラインを fork/exec するだけで待たない。
+ * pids[0..n-1] は呼び出し側が用意する。
+ */
+int	spawn_pipeline(char ***argvv, int n, const t_spawn *sp, pid_t *pids)
 {
 	int		prev_read = -1;
-	pid_t	*pids;
 	int		i;
+	int		use_zygote;
+	int		last_out = -1;
+	int		last_out_opened = 0;
+	int		first_in = -1;
+	int		first_in_opened = 0;
 
 	if (!argvv || n <= 0)
-		return 0;
+		return -1;
 
-	pids = calloc((size_t)n, sizeof(pid_t));
-	if (!pids)
-		die_perror("calloc");
+	// cgroup に入れる指定があるときは子の中で書き込む必要があるので自前で fork する
+	use_zygote = zygote_active() && !(sp && sp->cgroup_procs);
+	if (use_zygote)
+	{
+		last_out = zygote_last_out(sp, &last_out_opened);
+		first_in = zygote_first_in(sp, &first_in_opened);
+		if ((sp && sp->out_path && last_out < 0) || (sp && sp->in_path && first_in < 0))
+			use_zygote = 0; // open 失敗は子の中で同じように失敗させる
+	}
 
 	for (i = 0; i < n; i++)
 	{
 		int next_pipe[2] = {-1, -1};
 		int is_last = (i == n - 1);
+		int is_tee = is_tee_stage(argvv[i]);
 
 		if (!is_last)
 		{
 			if (pipe(next_pipe) < 0)
 				die_perror("pipe");
+			evtrace_rec(EV_PIPE, i, next_pipe[0], next_pipe[1]);
+			// 大きいパイプは段の切り替え（書き手が詰まって寝る回数）を減らす。失敗しても既定容量で続ける
+			if (sp && sp->pipe_sz > 0)
+				fcntl(next_pipe[1], F_SETPIPE_SZ, sp->pipe_sz);
 		}
 
-		pids[i] = fork();
+		if (sp && sp->fork_ts)
+			clock_gettime(CLOCK_MONOTONIC, &sp->fork_ts[i]);
+
+		pids[i] = -1;
+		if (use_zygote && !is_tee)
+			pids[i] = zygote_spawn(argvv[i], (i == 0) ? first_in : prev_read,
+				is_last ? last_out : next_pipe[1]);
+		if (pids[i] > 0)
+			evtrace_rec(EV_SPAWN, i, pids[i], 0);
+		else
+		{
+			pids[i] = fork();
+			if (pids[i] > 0)
+				evtrace_rec(EV_FORK, i, pids[i], 0);
+		}
 		if (pids[i] < 0)
 			die_perror("fork");
 
@@ -63,11 +152,32 @@ int	exec_pipeline_redir(char ***argvv, int n, const char *out_path)
 		{
 			// 子プロセス
 
+			// 計測用 cgroup に入る（失敗しても実行は続ける）
+			if (sp && sp->cgroup_procs)
+				join_cgroup(sp->cgroup_procs);
+
 			// stdin <- prev_read（最初以外）
 			if (prev_read != -1)
 			{
 				if (dup2(prev_read, STDIN_FILENO) < 0)
 					_exit(1);
+				evtrace_rec(EV_DUP2, i, prev_read, STDIN_FILENO);
+			}
+			else if (sp && sp->in_path)
+			{
+				// 最初の段だけ "< file"
+				if (redir_stdin_file(sp->in_path) < 0)
+				{
+					fprintf(stderr, "minishell: %s: cannot open\n", sp->in_path);
+					_exit(1);
+				}
+			}
+			else if (sp && sp->in_fd >= 0 && sp->in_fd != STDIN_FILENO)
+			{
+				// heredoc / here-string の memfd
+				if (dup2(sp->in_fd, STDIN_FILENO) < 0)
+					_exit(1);
+				evtrace_rec(EV_DUP2, i, sp->in_fd, STDIN_FILENO);
 			}
 
 			// stdout -> next_pipe[1]（最後以外）
@@ -75,15 +185,23 @@ int	exec_pipeline_redir(char ***argvv, int n, const char *out_path)
 			{
 				if (dup2(next_pipe[1], STDOUT_FILENO) < 0)
 					_exit(1);
+				evtrace_rec(EV_DUP2, i, next_pipe[1], STDOUT_FILENO);
 			}
 			else
 			{
 				// 最後のコマンドだけリダイレクト適用
-				if (out_path)
+				if (sp && sp->out_path)
 				{
-					if (redir_stdout_trunc(out_path) < 0)
+					if (redir_stdout_trunc(sp->out_path) < 0)
 						_exit(1);
 				}
+				else if (sp && sp->out_fd >= 0 && sp->out_fd != STDOUT_FILENO)
+				{
+					if (dup2(sp->out_fd, STDOUT_FILENO) < 0)
+						_exit(1);
+					evtrace_rec(EV_DUP2, i, sp->out_fd, STDOUT_FILENO);
+					close(sp->out_fd);
+				}
 			}
 
 			// 使わないfdを全部閉じる
@@ -95,7 +213,13 @@ int	exec_pipeline_redir(char ***argvv, int n, const char *out_path)
 				close(next_pipe[1]);
 			}
 
+			// "|&tee file" の中継段は exec せずにこのプロセスで tee/splice する
+			if (is_tee)
+				_exit(tee_relay(argvv[i][1]));
+
+			evtrace_rec(EV_EXEC, i, 0, 0);
 			execvp(argvv[i][0], argvv[i]);
+			evtrace_rec(EV_EXEC_FAIL, i, 0, 0);
 			fprintf(stderr, "minishell: exec failed: %s\n", argvv[i][0]);
 			_exit(127);
 		}
@@ -117,12 +241,36 @@ int	exec_pipeline_redir(char ***argvv, int n, const char *out_path)
 
 	if (prev_read != -1)
 		close(prev_read);
+	if (last_out_opened)
+		close(last_out);
+	if (first_in_opened)
+		close(first_in);
+	return 0;
+}
 
-	{
-		int code = wait_all(pids, n);
-		free(pids);
-		return code;
-	}
+int	exec_spawn_wait(char ***argvv, int n, const t_spawn *sp)
+{
+	pid_t	*pids;
+	int		code;
+
+	if (!argvv || n <= 0)
+		return 0;
+
+	pids = calloc((size_t)n, sizeof(pid_t));
+	if (!pids)
+		die_perror("calloc");
+
+	spawn_pipeline(argvv, n, sp, pids);
+	code = wait_all(pids, n);
+	free(pids);
+	return code;
+}
+
+int	exec_pipeline_redir(char ***argvv, int n, const char *out_path)
+{
+	t_spawn sp = {.out_path = out_path, .out_fd = -1, .in_fd = -1, .pipe_sz = exec_pipe_size()};
+
+	return exec_spawn_wait(argvv, n, &sp);
 }
 
 int	exec_pipeline(char ***argvv, int n)
@@ -0,0 +1,832 @@
+#define _GNU_SOURCE
+#include "profile.h"
+
+#include <elf.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/perf_event.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define PROF_PAGES    16       // CPU ごとのリングのデータ部（ページ数。2 の冪）
+#define PROF_DEPTH    64       // たどるフレーム数の上限
+#define PROF_MAX_CPU  256
+#define PROF_REC_MAX  (8 + 8 + 8 + 8 + 8 * (PROF_DEPTH + 8) + PATH_MAX)
+
+/*
+ * フレームは「ファイル番号 + 1」を上位 24 ビット、ファイル内のオフセットを下位 40 ビットに詰める。
+ * 0 はどのマッピングにも入らなかったアドレス（JIT、vdso など）。
+ */
+#define FRAME_OFF_BITS 40
+#define FRAME_OFF_MASK ((1ull << FRAME_OFF_BITS) - 1)
+
+typedef struct s_pmap
+{
+	uint64_t	start;
+	uint64_t	end;
+	uint64_t	pgoff;
+	int			file;
+}	t_pmap;
+
+// プロセスごとのマッピング。exec するまでは親（fork 元）のものを使う
+typedef struct s_ptask
+{
+	int			pid;
+	int			ppid;
+	int			own;
+	char		comm[16];
+	t_pmap		*m;
+	size_t		n;
+	size_t		cap;
+}	t_ptask;
+
+typedef struct s_pstack
+{
+	uint64_t	hash;
+	uint64_t	count;
+	uint32_t	off;      // g_prof.pool の中の位置（0 = 空きスロット）
+	uint32_t	nf;
+	char		comm[16];
+}	t_pstack;
+
+typedef struct s_prof
+{
+	pid_t		owner;
+	int			running;
+	char		dir[PATH_MAX];
+	int			ncpu;
+	int			fd[PROF_MAX_CPU];
+	char		*ring[PROF_MAX_CPU];
+	size_t		page;
+	int			stop[2];
+	pthread_t	th;
+
+	// ここから下はリーダースレッドだけが触る（prof_stop は join のあとに触る）
+	t_ptask		*t;
+	size_t		nt;
+	size_t		tcap;
+	size_t		tlast;
+	char		**files;
+	size_t		nfiles;
+	t_pstack	*st;
+	size_t		nst;
+	size_t		stcap;
+	uint64_t	*pool;
+	size_t		npool;
+	size_t		poolcap;
+	uint64_t	samples;
+	uint64_t	lost;
+	char		rec[PROF_REC_MAX];
+}	t_prof;
+
+static t_prof	g_prof = {.stop = {-1, -1}};
+
+int	prof_parse_flag(const char *arg, int *hz)
+{
+	char *end;
+
+	if (strcmp(arg, "--profile") == 0)
+	{
+		*hz = PROF_DEFAULT_HZ;
+		return 1;
+	}
+	if (strncmp(arg, "--profile=", 10) != 0)
+		return 0;
+	*hz = (int)strtol(arg + 10, &end, 10);
+	if (*end || *hz <= 0 || *hz > 10000)
+		return 0;
+	return 1;
+}
+
+/* --- プロセスとマッピング --- */
+
+static t_ptask	*task_find(int pid)
+{
+	if (g_prof.tlast < g_prof.nt && g_prof.t[g_prof.tlast].pid == pid)
+		return &g_prof.t[g_prof.tlast];
+	for (size_t i = g_prof.nt; i-- > 0;)
+		if (g_prof.t[i].pid == pid)
+		{
+			g_prof.tlast = i;
+			return &g_prof.t[i];
+		}
+	return NULL;
+}
+
+static t_ptask	*task_get(int pid)
+{
+	t_ptask *t = task_find(pid);
+
+	if (t)
+		return t;
+	if (g_prof.nt == g_prof.tcap)
+	{
+		size_t	ncap = g_prof.tcap ? g_prof.tcap * 2 : 32;
+		t_ptask	*nt = realloc(g_prof.t, ncap * sizeof(t_ptask));
+		if (!nt)
+			return NULL;
+		g_prof.t = nt;
+		g_prof.tcap = ncap;
+	}
+	g_prof.t[g_prof.nt] = (t_ptask){.pid = pid};
+	return &g_prof.t[g_prof.nt++];
+}
+
+static int	file_id(const char *path)
+{
+	for (size_t i = 0; i < g_prof.nfiles; i++)
+		if (strcmp(g_prof.files[i], path) == 0)
+			return (int)i;
+	char **nf = realloc(g_prof.files, (g_prof.nfiles + 1) * sizeof(char *));
+	if (!nf)
+		return -1;
+	g_prof.files = nf;
+	if ((nf[g_prof.nfiles] = strdup(path)) == NULL)
+		return -1;
+	return (int)g_prof.nfiles++;
+}
+
+static void	map_add(t_ptask *t, uint64_t start, uint64_t len, uint64_t pgoff, const char *path)
+{
+	int f;
+
+	if (!t || path[0] != '/' || (f = file_id(path)) < 0)
+		return;
+	if (t->n == t->cap)
+	{
+		size_t	ncap = t->cap ? t->cap * 2 : 16;
+		t_pmap	*nm = realloc(t->m, ncap * sizeof(t_pmap));
+		if (!nm)
+			return;
+		t->m = nm;
+		t->cap = ncap;
+	}
+	t->m[t->n++] = (t_pmap){start, start + len, pgoff, f};
+}
+
+static void	load_self_maps(t_ptask *t)
+{
+	FILE	*fp = fopen("/proc/self/maps", "r");
+	char	line[PATH_MAX + 128];
+
+	if (!fp)
+		return;
+	while (fgets(line, sizeof(line), fp))
+	{
+		unsigned long long	start;
+		unsigned long long	end;
+		unsigned long long	off;
+		char				perm[8];
+		int					pos = 0;
+
+		if (sscanf(line, "%llx-%llx %7s %llx %*s %*s %n", &start, &end, perm, &off, &pos) < 4
+			|| perm[2] != 'x' || pos == 0)
+			continue;
+		line[strcspn(line, "\n")] = '\0';
+		map_add(t, start, end - start, off, line + pos);
+	}
+	fclose(fp);
+}
+
+static uint64_t	frame_of(const t_ptask *t, uint64_t ip)
+{
+	// exec していないプロセスは fork 元と同じ中身
+	while (t && !t->own)
+		t = (t->ppid && t->ppid != t->pid) ? task_find(t->ppid) : NULL;
+	if (!t)
+		t = task_find(g_prof.owner);
+	if (!t)
+		return 0;
+	for (size_t i = t->n; i-- > 0;)
+		if (ip >= t->m[i].start && ip < t->m[i].end)
+			return ((uint64_t)(t->m[i].file + 1) << FRAME_OFF_BITS)
+				| ((ip - t->m[i].start + t->m[i].pgoff) & FRAME_OFF_MASK);
+	return 0;
+}
+
+/* --- スタックの集計 --- */
+
+static int	stack_grow(void)
+{
+	size_t		ncap = g_prof.stcap ? g_prof.stcap * 2 : 1024;
+	t_pstack	*ns = calloc(ncap, sizeof(t_pstack));
+
+	if (!ns)
+		return -1;
+	for (size_t i = 0; i < g_prof.stcap; i++)
+	{
+		size_t j;
+
+		if (g_prof.st[i].off == 0)
+			continue;
+		for (j = g_prof.st[i].hash & (ncap - 1); ns[j].off; j = (j + 1) & (ncap - 1))
+			;
+		ns[j] = g_prof.st[i];
+	}
+	free(g_prof.st);
+	g_prof.st = ns;
+	g_prof.stcap = ncap;
+	return 0;
+}
+
+static void	stack_add(const char *comm, const uint64_t *f, uint32_t nf)
+{
+	uint64_t	h = 1469598103934665603ull;
+	size_t		j;
+
+	for (size_t i = 0; i < 16 && comm[i]; i++)
+		h = (h ^ (unsigned char)comm[i]) * 1099511628211ull;
+	for (uint32_t i = 0; i < nf; i++)
+		h = (h ^ f[i]) * 1099511628211ull;
+	if ((g_prof.nst + 1) * 2 > g_prof.stcap && stack_grow() != 0)
+		return;
+	for (j = h & (g_prof.stcap - 1); g_prof.st[j].off; j = (j + 1) & (g_prof.stcap - 1))
+	{
+		t_pstack *s = &g_prof.st[j];
+		if (s->hash == h && s->nf == nf && strncmp(s->comm, comm, 15) == 0
+			&& memcmp(g_prof.pool + s->off, f, nf * sizeof(uint64_t)) == 0)
+		{
+			s->count++;
+			return;
+		}
+	}
+	// pool[0] は使わない（off == 0 を空きスロットの印にする）
+	if (g_prof.npool + nf + 1 > g_prof.poolcap)
+	{
+		size_t		ncap = g_prof.poolcap ? g_prof.poolcap * 2 : 16384;
+		uint64_t	*np;
+
+		while (ncap < g_prof.npool + nf + 1)
+			ncap *= 2;
+		if (ncap > UINT32_MAX || (np = realloc(g_prof.pool, ncap * sizeof(uint64_t))) == NULL)
+			return;
+		g_prof.pool = np;
+		g_prof.poolcap = ncap;
+		if (g_prof.npool == 0)
+			g_prof.npool = 1;
+	}
+	memcpy(g_prof.pool + g_prof.npool, f, nf * sizeof(uint64_t));
+	g_prof.st[j] = (t_pstack){h, 1, (uint32_t)g_prof.npool, nf, ""};
+	snprintf(g_prof.st[j].comm, sizeof(g_prof.st[j].comm), "%.15s", comm);
+	g_prof.npool += nf;
+	g_prof.nst++;
+}
+
+/* --- リングを読む --- */
+
+static uint32_t	rd32(const char *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static uint64_t	rd64(const char *p)
+{
+	uint64_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static void	on_sample(const char *r, size_t len)
+{
+	// header のあとに PERF_SAMPLE_IP | TID | CALLCHAIN: ip, pid, tid, nr, ips[nr]（葉が先頭）
+	uint64_t		f[PROF_DEPTH];
+	uint32_t		nf = 0;
+	uint64_t		nr;
+	const t_ptask	*t;
+	const char		*comm;
+
+	if (len < 32)
+		return;
+	nr = rd64(r + 24);
+	if (32 + nr * 8 > len)
+		return;
+	g_prof.samples++;
+	t = task_find((int)rd32(r + 16));
+	comm = (t && t->comm[0]) ? t->comm : "?";
+	for (uint64_t i = 0; i < nr && nf < PROF_DEPTH; i++)
+	{
+		uint64_t ip = rd64(r + 32 + i * 8);
+		if (ip >= (uint64_t)PERF_CONTEXT_MAX)   // PERF_CONTEXT_USER などの区切り
+			continue;
+		f[nf++] = frame_of(t, ip);
+	}
+	if (nf > 0)
+		stack_add(comm, f, nf);
+}
+
+static void	on_record(const struct perf_event_header *h, const char *r)
+{
+	t_ptask *t;
+
+	switch (h->type)
+	{
+	case PERF_RECORD_SAMPLE:
+		on_sample(r, h->size);
+		break;
+	case PERF_RECORD_MMAP2:
+		// pid, tid, addr, len, pgoff, maj/min(ino), ino, ino_generation, prot, flags, filename
+		if (h->size > 80)
+		{
+			g_prof.rec[h->size - 1] = '\0';
+			map_add(task_get((int)rd32(r + 8)), rd64(r + 16), rd64(r + 24), rd64(r + 32), r + 72);
+		}
+		break;
+	case PERF_RECORD_COMM:
+		if (h->size >= 24 && rd32(r + 8) == rd32(r + 12) && (t = task_get((int)rd32(r + 8))) != NULL)
+		{
+			snprintf(t->comm, sizeof(t->comm), "%.15s", r + 16);
+			// 1 回目の exec より前の MMAP2 は別の CPU から先に届いた exec 後のものなので残す
+			if (h->misc & PERF_RECORD_MISC_COMM_EXEC)
+			{
+				if (t->own)
+					t->n = 0;
+				t->own = 1;
+			}
+		}
+		break;
+	case PERF_RECORD_FORK:
+		// pid, ppid, tid, ptid, time。スレッド（pid != tid）は同じプロセスの中なので記録しない。
+		// リングは CPU ごとで時刻順に混ぜていないので、FORK は子の COMM_EXEC / MMAP2（別の CPU）より
+		// 後に届くことがある。exec 済み（own）の中身と comm はそのままにして、親だけ覚える
+		if (h->size >= 32 && rd32(r + 8) == rd32(r + 16) && (t = task_get((int)rd32(r + 8))) != NULL)
+		{
+			const t_ptask *par;
+
+			t->ppid = (int)rd32(r + 12);
+			if (!t->comm[0] && (par = task_find(t->ppid)) != NULL)
+				memcpy(t->comm, par->comm, sizeof(t->comm));
+		}
+		break;
+	case PERF_RECORD_LOST:
+		if (h->size >= 24)
+			g_prof.lost += rd64(r + 16);
+		break;
+	}
+}
+
+static void	ring_copy(const char *data, uint64_t size, uint64_t pos, char *dst, size_t n)
+{
+	size_t at = (size_t)(pos & (size - 1));
+	size_t k = (n < size - at) ? n : size - at;
+
+	memcpy(dst, data + at, k);
+	memcpy(dst + k, data, n - k);
+}
+
+static void	ring_drain(int i)
+{
+	struct perf_event_mmap_page	*mp = (struct perf_event_mmap_page *)g_prof.ring[i];
+	const char					*data = g_prof.ring[i] + g_prof.page;
+	uint64_t					size = (uint64_t)PROF_PAGES * g_prof.page;
+	uint64_t					head = __atomic_load_n(&mp->data_head, __ATOMIC_ACQUIRE);
+	uint64_t					tail = mp->data_tail;
+
+	while (tail < head)
+	{
+		struct perf_event_header h;
+
+		ring_copy(data, size, tail, (char *)&h, sizeof(h));
+		if (h.size < sizeof(h) || tail + h.size > head)
+			break;
+		if (h.size <= sizeof(g_prof.rec))
+		{
+			ring_copy(data, size, tail, g_prof.rec, h.size);
+			on_record(&h, g_prof.rec);
+		}
+		tail += h.size;
+	}
+	__atomic_store_n(&mp->data_tail, head, __ATOMIC_RELEASE);
+}
+
+static void	*prof_thread(void *arg)
+{
+	struct pollfd	pfd[PROF_MAX_CPU + 1];
+	int				n = g_prof.ncpu;
+
+	(void)arg;
+	pthread_setname_np(pthread_self(), "prof");
+	for (int i = 0; i < n; i++)
+		pfd[i] = (struct pollfd){g_prof.fd[i], POLLIN, 0};
+	pfd[n] = (struct pollfd){g_prof.stop[0], POLLIN, 0};
+	for (;;)
+	{
+		poll(pfd, (nfds_t)n + 1, 200);
+		for (int i = 0; i < n; i++)
+			ring_drain(i);
+		if (pfd[n].revents)
+			break;
+	}
+	return NULL;
+}
+
+/* --- 開始・停止 --- */
+
+static void	close_events(void)
+{
+	size_t len = (size_t)(PROF_PAGES + 1) * g_prof.page;
+
+	for (int i = 0; i < g_prof.ncpu; i++)
+	{
+		if (g_prof.ring[i])
+			munmap(g_prof.ring[i], len);
+		close(g_prof.fd[i]);
+	}
+	g_prof.ncpu = 0;
+	for (int i = 0; i < 2; i++)
+		if (g_prof.stop[i] >= 0)
+		{
+			close(g_prof.stop[i]);
+			g_prof.stop[i] = -1;
+		}
+}
+
+static int	open_events(int hz)
+{
+	struct perf_event_attr	a;
+	long					ncpu = sysconf(_SC_NPROCESSORS_CONF);
+	size_t					len = (size_t)(PROF_PAGES + 1) * g_prof.page;
+	int						err = 0;
+
+	memset(&a, 0, sizeof(a));
+	a.size = sizeof(a);
+	a.type = PERF_TYPE_SOFTWARE;
+	a.config = PERF_COUNT_SW_CPU_CLOCK;
+	a.freq = 1;
+	a.sample_freq = (uint64_t)hz;
+	a.sample_type = PERF_SAMPLE_IP | PERF_SAMPLE_TID | PERF_SAMPLE_CALLCHAIN;
+	a.disabled = 1;
+	a.inherit = 1;            // fork した子・スレッドにも付く
+	a.exclude_kernel = 1;
+	a.exclude_hv = 1;
+	a.exclude_callchain_kernel = 1;
+	a.sample_max_stack = PROF_DEPTH;
+	a.mmap = 1;               // 子が exec したあとのマッピングを知るため
+	a.mmap2 = 1;
+	a.comm = 1;
+	a.comm_exec = 1;
+	a.task = 1;
+	a.watermark = 1;          // リングが 1/4 たまるまで起こさない
+	a.wakeup_watermark = (uint32_t)(PROF_PAGES * g_prof.page / 4);
+
+	// inherit 付きのイベントは CPU ごとでないと mmap できない
+	for (long cpu = 0; cpu < ncpu && g_prof.ncpu < PROF_MAX_CPU; cpu++)
+	{
+		int fd = (int)syscall(SYS_perf_event_open, &a, 0, (int)cpu, -1, PERF_FLAG_FD_CLOEXEC);
+		if (fd < 0)
+		{
+			if (errno != ENODEV && errno != EINVAL)   // オフラインの CPU は飛ばす
+				err = errno;
+			continue;
+		}
+		void *r = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (r == MAP_FAILED)
+		{
+			err = errno;
+			close(fd);
+			continue;
+		}
+		g_prof.fd[g_prof.ncpu] = fd;
+		g_prof.ring[g_prof.ncpu++] = r;
+	}
+	if (g_prof.ncpu == 0)
+	{
+		FILE	*fp = fopen("/proc/sys/kernel/perf_event_paranoid", "r");
+		int		level = -9;
+
+		if (fp)
+		{
+			if (fscanf(fp, "%d", &level) != 1)
+				level = -9;
+			fclose(fp);
+		}
+		errno = err ? err : ENODEV;
+		if (level != -9)
+			fprintf(stderr, "profile: perf_event_open: %s (kernel.perf_event_paranoid=%d)\n",
+				strerror(errno), level);
+		else
+			perror("profile: perf_event_open");
+		return -1;
+	}
+	return 0;
+}
+
+int	prof_start(const char *dir, int hz)
+{
+	t_ptask *self;
+
+	if (g_prof.running)
+		return 0;
+	g_prof.owner = getpid();
+	g_prof.page = (size_t)sysconf(_SC_PAGESIZE);
+	snprintf(g_prof.dir, sizeof(g_prof.dir), "%s", dir);
+#ifndef PROFILE_BUILD
+	fprintf(stderr, "profile: not built with PROFILE=1; stacks may stop early (libc, -O2 code)\n");
+#endif
+	if ((self = task_get(g_prof.owner)) == NULL)
+		return -1;
+	self->own = 1;
+	{
+		FILE *fp = fopen("/proc/self/comm", "r");
+		if (fp)
+		{
+			if (fgets(self->comm, sizeof(self->comm), fp))
+				self->comm[strcspn(self->comm, "\n")] = '\0';
+			fclose(fp);
+		}
+	}
+	load_self_maps(self);
+	if (open_events(hz) != 0)
+		return -1;
+	if (pipe2(g_prof.stop, O_CLOEXEC) != 0 || pthread_create(&g_prof.th, NULL, prof_thread, NULL) != 0)
+	{
+		perror("profile");
+		close_events();
+		return -1;
+	}
+	for (int i = 0; i < g_prof.ncpu; i++)
+		ioctl(g_prof.fd[i], PERF_EVENT_IOC_ENABLE, 0);
+	g_prof.running = 1;
+	return 0;
+}
+
+/* --- シンボル化 --- */
+
+typedef struct s_esym
+{
+	uint64_t	addr;
+	uint64_t	size;
+	const char	*name;
+}	t_esym;
+
+typedef struct s_elf
+{
+	int			tried;
+	char		*base;
+	size_t		len;
+	t_esym		*sym;
+	size_t		nsym;
+	Elf64_Phdr	*ph;
+	int			nph;
+}	t_elf;
+
+static int	cmp_esym(const void *x, const void *y)
+{
+	const t_esym *a = x;
+	const t_esym *b = y;
+
+	return (a->addr > b->addr) - (a->addr < b->addr);
+}
+
+// .symtab（なければ .dynsym）の関数だけを拾う
+static void	elf_load(t_elf *e, const char *path)
+{
+	int			fd = open(path, O_RDONLY | O_CLOEXEC);
+	struct stat	st;
+	Elf64_Ehdr	*eh;
+	Elf64_Shdr	*sh;
+	int			pick = -1;
+
+	e->tried = 1;
+	if (fd < 0)
+		return;
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Elf64_Ehdr)
+		|| (e->base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+	{
+		e->base = NULL;
+		close(fd);
+		return;
+	}
+	close(fd);
+	e->len = (size_t)st.st_size;
+	eh = (Elf64_Ehdr *)e->base;
+	if (memcmp(eh->e_ident, ELFMAG, SELFMAG) != 0 || eh->e_ident[EI_CLASS] != ELFCLASS64
+		|| eh->e_shoff + (uint64_t)eh->e_shnum * sizeof(Elf64_Shdr) > e->len
+		|| eh->e_phoff + (uint64_t)eh->e_phnum * sizeof(Elf64_Phdr) > e->len)
+		return;
+	e->ph = (Elf64_Phdr *)(e->base + eh->e_phoff);
+	e->nph = eh->e_phnum;
+	sh = (Elf64_Shdr *)(e->base + eh->e_shoff);
+	for (int i = 0; i < eh->e_shnum; i++)
+		if (sh[i].sh_type == SHT_SYMTAB || (sh[i].sh_type == SHT_DYNSYM && pick < 0))
+			pick = i;
+	if (pick < 0 || sh[pick].sh_link >= eh->e_shnum
+		|| sh[pick].sh_offset + sh[pick].sh_size > e->len
+		|| sh[sh[pick].sh_link].sh_offset + sh[sh[pick].sh_link].sh_size > e->len)
+		return;
+
+	const Elf64_Sym	*sy = (const Elf64_Sym *)(e->base + sh[pick].sh_offset);
+	size_t			n = sh[pick].sh_size / sizeof(Elf64_Sym);
+	const char		*str = e->base + sh[sh[pick].sh_link].sh_offset;
+	size_t			strsz = sh[sh[pick].sh_link].sh_size;
+
+	if ((e->sym = malloc((n ? n : 1) * sizeof(t_esym))) == NULL)
+		return;
+	for (size_t i = 0; i < n; i++)
+	{
+		int type = ELF64_ST_TYPE(sy[i].st_info);
+		if ((type != STT_FUNC && type != STT_GNU_IFUNC) || sy[i].st_value == 0
+			|| sy[i].st_shndx == SHN_UNDEF || sy[i].st_name >= strsz)
+			continue;
+		e->sym[e->nsym++] = (t_esym){sy[i].st_value, sy[i].st_size, str + sy[i].st_name};
+	}
+	qsort(e->sym, e->nsym, sizeof(t_esym), cmp_esym);
+}
+
+static const char	*elf_lookup(const t_elf *e, uint64_t off)
+{
+	uint64_t	va = 0;
+	int			found = 0;
+	size_t		lo = 0;
+	size_t		hi = e->nsym;
+
+	// ファイル内のオフセット -> リンク時のアドレス（PT_LOAD の対応から）
+	for (int i = 0; i < e->nph && !found; i++)
+		if (e->ph[i].p_type == PT_LOAD && off >= e->ph[i].p_offset
+			&& off < e->ph[i].p_offset + e->ph[i].p_filesz)
+		{
+			va = off - e->ph[i].p_offset + e->ph[i].p_vaddr;
+			found = 1;
+		}
+	if (!found)
+		return NULL;
+	while (lo < hi)
+	{
+		size_t mid = (lo + hi) / 2;
+		if (e->sym[mid].addr <= va)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == 0)
+		return NULL;
+	const t_esym *s = &e->sym[lo - 1];
+	if (s->size && va >= s->addr + s->size)
+		return NULL;
+	return s->name;
+}
+
+static void	frame_name(t_elf *elf, uint64_t f, int leaf, FILE *out)
+{
+	int			file;
+	uint64_t	off;
+	const char	*name;
+	const char	*slash;
+
+	if (f == 0)
+	{
+		fputs("[unknown]", out);
+		return;
+	}
+	file = (int)(f >> FRAME_OFF_BITS) - 1;
+	off = f & FRAME_OFF_MASK;
+	if (!elf[file].tried)
+		elf_load(&elf[file], g_prof.files[file]);
+	// 葉以外は戻り先のアドレスなので、call 命令の中に戻してから引く
+	if ((name = elf_lookup(&elf[file], (leaf || off == 0) ? off : off - 1)) != NULL)
+	{
+		fputs(name, out);
+		return;
+	}
+	slash = strrchr(g_prof.files[file], '/');
+	fprintf(out, "[%s]", slash ? slash + 1 : g_prof.files[file]);
+}
+
+typedef struct s_fline
+{
+	char		*s;
+	uint64_t	count;
+}	t_fline;
+
+static int	cmp_fline_str(const void *x, const void *y)
+{
+	return strcmp(((const t_fline *)x)->s, ((const t_fline *)y)->s);
+}
+
+static int	cmp_fline_count(const void *x, const void *y)
+{
+	const t_fline *a = x;
+	const t_fline *b = y;
+
+	if (a->count != b->count)
+		return (a->count < b->count) ? 1 : -1;
+	return strcmp(a->s, b->s);
+}
+
+// アドレスが違っても同じ関数の並びになるスタックは、シンボル化したあとで 1 行にまとめる
+static int	write_folded(const char *path)
+{
+	FILE	*out;
+	t_elf	*elf = calloc(g_prof.nfiles + 1, sizeof(t_elf));
+	t_fline	*v = calloc(g_prof.nst + 1, sizeof(t_fline));
+	size_t	n = 0;
+	size_t	m = 0;
+	int		rc = 0;
+
+	for (size_t i = 0; elf && v && i < g_prof.stcap; i++)
+	{
+		const t_pstack	*st = &g_prof.st[i];
+		const uint64_t	*f = g_prof.pool + st->off;
+		size_t			len = 0;
+		FILE			*mem;
+
+		if (st->off == 0 || (mem = open_memstream(&v[n].s, &len)) == NULL)
+			continue;
+		// flamegraph.pl は最後の空白で回数を切り、";" でフレームを分ける
+		for (size_t k = 0; k < sizeof(st->comm) && st->comm[k]; k++)
+			fputc((st->comm[k] == ' ' || st->comm[k] == ';') ? '_' : st->comm[k], mem);
+		for (uint32_t k = st->nf; k-- > 0;)
+		{
+			fputc(';', mem);
+			frame_name(elf, f[k], k == 0, mem);
+		}
+		fclose(mem);
+		v[n++].count = st->count;
+	}
+	if (v)
+	{
+		qsort(v, n, sizeof(t_fline), cmp_fline_str);
+		for (size_t i = 0; i < n; i++)
+		{
+			if (m > 0 && strcmp(v[m - 1].s, v[i].s) == 0)
+			{
+				v[m - 1].count += v[i].count;
+				free(v[i].s);
+				continue;
+			}
+			v[m++] = v[i];
+		}
+		qsort(v, m, sizeof(t_fline), cmp_fline_count);
+	}
+	if (!elf || !v || (out = fopen(path, "w")) == NULL)
+		rc = -1;
+	else
+	{
+		for (size_t i = 0; i < m; i++)
+			fprintf(out, "%s %llu\n", v[i].s, (unsigned long long)v[i].count);
+		if (fclose(out) != 0)
+			rc = -1;
+	}
+	for (size_t i = 0; i < m; i++)
+		free(v[i].s);
+	for (size_t i = 0; elf && i < g_prof.nfiles; i++)
+	{
+		if (elf[i].base)
+			munmap(elf[i].base, elf[i].len);
+		free(elf[i].sym);
+	}
+	free(elf);
+	free(v);
+	return rc;
+}
+
+void	prof_stop(void)
+{
+	char path[PATH_MAX + 32];
+
+	if (!g_prof.running || getpid() != g_prof.owner)
+		return;
+	g_prof.running = 0;
+	for (int i = 0; i < g_prof.ncpu; i++)
+		ioctl(g_prof.fd[i], PERF_EVENT_IOC_DISABLE, 0);
+	if (write(g_prof.stop[1], "x", 1) < 0)
+		perror("profile");
+	pthread_join(g_prof.th, NULL);
+	for (int i = 0; i < g_prof.ncpu; i++)
+		ring_drain(i);
+	close_events();
+
+	snprintf(path, sizeof(path), "%s/profile.folded", g_prof.dir);
+	if (write_folded(path) == 0)
+		fprintf(stderr, "[profile] %s (%llu samples, %zu stacks, %llu lost)\n", path,
+			(unsigned long long)g_prof.samples, g_prof.nst, (unsigned long long)g_prof.lost);
+	else
+		fprintf(stderr, "profile: cannot write %s\n", path);
+
+	for (size_t i = 0; i < g_prof.nt; i++)
+		free(g_prof.t[i].m);
+	for (size_t i = 0; i < g_prof.nfiles; i++)
+		free(g_prof.files[i]);
+	free(g_prof.t);
+	free(g_prof.files);
+	free(g_prof.st);
+	free(g_prof.pool);
+	g_prof.t = NULL;
+	g_prof.files = NULL;
+	g_prof.st = NULL;
+	g_prof.pool = NULL;
+	g_prof.nt = g_prof.tcap = g_prof.nfiles = g_prof.nst = g_prof.stcap = g_prof.npool = g_prof.poolcap = 0;
+}
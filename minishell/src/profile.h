@@ -0,0 +1,28 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+/*
+ * --profile: perf_event_open の CPU クロックでサンプリングする組み込みプロファイラ
+ *
+ * - 自分自身（pid 0）に CPU ごとのイベントを inherit 付きで開くので、あとから作ったスレッドと
+ *   fork / exec した子（パイプラインの各段など）も同じリングに入る
+ * - user のスタックはカーネルが frame pointer でたどる（PERF_SAMPLE_CALLCHAIN）。
+ *   途中で切れないように make PROFILE=1（-fno-omit-frame-pointer）でビルドしておく
+ * - リングは別スレッドが読み、スタックごとの回数だけを数える。シンボル化は prof_stop で 1 回だけ
+ *   （アドレスは「どのファイルの何バイト目か」で持ち、ELF の .symtab / .dynsym を引く）
+ * - 既定は 99 Hz。負荷をかけている間もつけっぱなしにできる程度の重さ
+ *
+ * 結果は dir/profile.folded（"comm;main;f;g 12" の形。flamegraph.pl にそのまま渡せる）。
+ * カーネルの中にいた時間は数えない（exclude_kernel。perf_event_paranoid 2 でも使える）。
+ */
+#define PROF_DEFAULT_HZ 99
+
+// 0 成功 / -1（理由は stderr に出す。呼び出し側はプロファイルなしで続けてよい）
+int		prof_start(const char *dir, int hz);
+// 止めて profile.folded を書く。prof_start したプロセス以外（fork した子）では何もしない
+void	prof_stop(void);
+
+// "--profile" / "--profile=HZ" なら hz を入れて 1、違えば 0
+int		prof_parse_flag(const char *arg, int *hz);
+
+#endif
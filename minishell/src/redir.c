@@ -1,7 +1,11 @@
+#define _GNU_SOURCE
 #include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include "evtrace.h"
+
 // stdout を file にリダイレクトする（O_TRUNC）
 int	redir_stdout_trunc(const char *path)
 {
@@ -19,6 +23,63 @@ int	redir_stdout_trunc(const char *path)
 		close(fd);
 		return (-1);
 	}
+	evtrace_rec(EV_DUP2, -1, fd, STDOUT_FILENO);
+	close(fd);
+	return (0);
+}
+
+// stdin を file にリダイレクトする（"< file"）
+int	redir_stdin_file(const char *path)
+{
+	int	fd;
+
+	if (!path || !*path)
+		return (-1);
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return (-1);
+
+	if (dup2(fd, STDIN_FILENO) < 0)
+	{
+		close(fd);
+		return (-1);
+	}
+	evtrace_rec(EV_DUP2, -1, fd, STDIN_FILENO);
 	close(fd);
 	return (0);
 }
+
+/*
+ * heredoc / here-string の本文を memfd に 1 回だけ書いて封印（seal）する。
+ * - 給餌用のプロセス（echo ... |）もパイプも要らない
+ * - 読む側からは普通のファイルに見えるので mmap / sendfile もできる
+ * - 書き込み・伸縮を封じるので、子が複数いても中身は変わらない
+ * 返り値: 先頭に seek 済みの fd（O_CLOEXEC。dup2 した先では外れる）
+ */
+int	make_heredoc_fd(const char *data, size_t len)
+{
+	int		fd;
+	size_t	off = 0;
+
+	fd = memfd_create("minishell-heredoc", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fd < 0)
+		return (-1);
+	while (off < len)
+	{
+		ssize_t n = write(fd, data + off, len - off);
+		if (n <= 0)
+		{
+			close(fd);
+			return (-1);
+		}
+		off += (size_t)n;
+	}
+	fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+	if (lseek(fd, 0, SEEK_SET) < 0)
+	{
+		close(fd);
+		return (-1);
+	}
+	return (fd);
+}
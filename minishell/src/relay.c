@@ -0,0 +1,156 @@
+#define _GNU_SOURCE
+#include "relay.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define RELAY_CHUNK (1 << 20)   // tee / splice 1 回あたりの上限（実際はパイプ容量で頭打ち）
+
+int	is_tee_stage(char *const argv[])
+{
+	return argv && argv[0] && strcmp(argv[0], TEE_STAGE) == 0;
+}
+
+static int	write_all(int fd, const char *buf, size_t len)
+{
+	while (len > 0)
+	{
+		ssize_t n = write(fd, buf, len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -1;
+		buf += n;
+		len -= (size_t)n;
+	}
+	return 0;
+}
+
+/*
+ * パイプ from から n バイトを to へ流し切る。
+ * splice を受け付けない相手（EINVAL）ならその分だけ read/write で運ぶ。
+ */
+static int	drain(int from, int to, size_t n)
+{
+	char	buf[65536];
+
+	while (n > 0)
+	{
+		ssize_t m = splice(from, NULL, to, NULL, n, SPLICE_F_MOVE);
+		if (m < 0 && errno == EINTR)
+			continue;
+		if (m < 0 && errno == EINVAL)
+		{
+			ssize_t r = read(from, buf, n < sizeof(buf) ? n : sizeof(buf));
+			if (r <= 0 || write_all(to, buf, (size_t)r) < 0)
+				return -1;
+			m = r;
+		}
+		if (m <= 0)
+			return -1;
+		n -= (size_t)m;
+	}
+	return 0;
+}
+
+// stdin がパイプでないなど tee(2) が使えないときの素朴なコピー
+static int	copy_loop(int file)
+{
+	char	buf[65536];
+	ssize_t	n;
+
+	while ((n = read(STDIN_FILENO, buf, sizeof(buf))) != 0)
+	{
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+			return 1;
+		if (write_all(STDOUT_FILENO, buf, (size_t)n) < 0
+			|| write_all(file, buf, (size_t)n) < 0)
+			return 1;
+	}
+	return 0;
+}
+
+int	tee_relay(const char *path)
+{
+	struct stat	st;
+	int			mid[2] = {-1, -1};
+	int			out = STDOUT_FILENO;
+	int			file;
+	int			code = 0;
+	int			first = 1;
+
+	file = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+	if (file < 0)
+	{
+		fprintf(stderr, "minishell: %s: cannot open\n", path);
+		return 1;
+	}
+
+	// tee(2) の複製先はパイプでないといけないので、端末やファイルなら中間パイプを使う
+	if (fstat(STDOUT_FILENO, &st) == 0 && !S_ISFIFO(st.st_mode))
+	{
+		if (pipe2(mid, O_CLOEXEC) == 0)
+		{
+			int sz = fcntl(STDIN_FILENO, F_GETPIPE_SZ);
+			if (sz > 0)
+				fcntl(mid[1], F_SETPIPE_SZ, sz);
+			out = mid[1];
+		}
+		else
+			out = -1;
+	}
+
+	while (out >= 0)
+	{
+		ssize_t n = tee(STDIN_FILENO, out, RELAY_CHUNK, 0);
+		if (n == 0)
+			break;
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+		{
+			if (first && errno == EINVAL)
+				out = -1;
+			else
+				code = 1;
+			break;
+		}
+		first = 0;
+		// tee した分は stdin にまだ残っているので、それを file へ「移す」
+		if (drain(STDIN_FILENO, file, (size_t)n) < 0
+			|| (mid[0] >= 0 && drain(mid[0], STDOUT_FILENO, (size_t)n) < 0))
+		{
+			code = 1;
+			break;
+		}
+	}
+	if (out < 0 && code == 0)
+		code = copy_loop(file);
+
+	if (mid[0] >= 0)
+	{
+		close(mid[0]);
+		close(mid[1]);
+	}
+	close(file);
+	return code;
+}
+
+int	pipe_size_probe(int bytes)
+{
+	int	fds[2];
+	int	got;
+
+	if (pipe(fds) < 0)
+		return -1;
+	got = fcntl(fds[1], F_SETPIPE_SZ, bytes);
+	close(fds[0]);
+	close(fds[1]);
+	return got;
+}
@@ -0,0 +1,27 @@
+#ifndef RELAY_H
+#define RELAY_H
+
+/*
+ * "|&tee file" の中継段（外部の tee コマンドは起動しない）
+ *
+ * パイプラインの途中に「&tee file」という段があれば、spawn_pipeline は exec せずに
+ * fork した子で tee_relay を呼ぶ。stdin（前段のパイプ）の中身を
+ * - tee(2)   で stdout 側のパイプへ複製し（ページ参照を増やすだけでコピーしない）
+ * - splice(2) で同じ分を file へ流す
+ * stdout がパイプでなければ（端末 / "> file"）中間パイプを 1 本はさむ。
+ * splice できない相手には read/write で落とす。
+ *
+ * 返り値: 子の exit status（0 成功 / 1 失敗）
+ */
+#define TEE_STAGE "&tee"
+
+int	is_tee_stage(char *const argv[]);
+int	tee_relay(const char *path);
+
+/*
+ * パイプ容量（F_SETPIPE_SZ）
+ * - pipe_size_probe: bytes で作れるか試し、カーネルが実際に割り当てる容量を返す（失敗は -1）
+ */
+int	pipe_size_probe(int bytes);
+
+#endif
@@ -0,0 +1,678 @@
+#define _GNU_SOURCE
+#include "summary.h"
+#include "traceline.h"
+#include "util.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define LAT_NB   28   // バケット数。0: <1us、b: [2^(b-1), 2^b) us、最後のバケットは上限なし
+#define NAME_MAX_LEN 32
+#define SUM_DROP_BYTES (1L << 20)
+
+// 出す順は pipe, file, socket, anon, other, none（FDT_NONE は 0 なので k % FDT_N で最後に回す）
+static const char	*g_fdt_names[FDT_N] = {"none", "pipe", "file", "socket", "anon", "other"};
+
+typedef struct s_lat
+{
+	uint64_t	calls;
+	uint64_t	timed;      // <秒> がついていた回数（exit_group などは無い）
+	uint64_t	total_us;
+	uint64_t	max_us;
+	uint64_t	hist[LAT_NB];
+}	t_lat;
+
+typedef struct s_ent
+{
+	char	key[NAME_MAX_LEN];   // syscall 名、または PID の 10 進表記。空ならスロットは空き
+	t_lat	lat;
+	double	run_sum;    // run 間の集計用（合計時間 us の和と二乗和、回数の和）
+	double	run_sq;
+	double	run_calls;
+}	t_ent;
+
+// 文字列キーの open addressing 表（cap は 2 冪）
+typedef struct s_tab
+{
+	t_ent	*e;
+	size_t	cap;
+	size_t	n;
+}	t_tab;
+
+typedef struct s_sum
+{
+	t_tab	sys;
+	t_tab	pid;
+	t_lat	fdt[FDT_N];
+	t_lat	all;
+}	t_sum;
+
+typedef struct s_sc_line
+{
+	const char	*name;
+	size_t		name_len;
+	long		pid;        // 不明なら -1
+	t_fdt		fdt;
+	int			has_dur;
+	uint64_t	us;
+}	t_sc_line;
+
+static uint64_t	hash_key(const char *s, size_t n)
+{
+	uint64_t h = 1469598103934665603ull;
+
+	for (size_t i = 0; i < n; i++)
+		h = (h ^ (unsigned char)s[i]) * 1099511628211ull;
+	return h;
+}
+
+static t_ent	*tab_slot(t_ent *e, size_t cap, const char *k, size_t kn)
+{
+	for (uint64_t h = hash_key(k, kn); ; h++)
+	{
+		t_ent *x = &e[h & (cap - 1)];
+		if (x->key[0] == '\0' || (strncmp(x->key, k, kn) == 0 && x->key[kn] == '\0'))
+			return x;
+	}
+}
+
+static int	tab_grow(t_tab *t)
+{
+	size_t	ncap = t->cap ? t->cap * 2 : 64;
+	t_ent	*ne = calloc(ncap, sizeof(t_ent));
+
+	if (!ne)
+		return -1;
+	for (size_t i = 0; i < t->cap; i++)
+		if (t->e[i].key[0])
+			*tab_slot(ne, ncap, t->e[i].key, strlen(t->e[i].key)) = t->e[i];
+	free(t->e);
+	t->e = ne;
+	t->cap = ncap;
+	return 0;
+}
+
+static t_ent	*tab_get(t_tab *t, const char *k, size_t kn)
+{
+	t_ent *x;
+
+	if (kn == 0 || kn >= NAME_MAX_LEN)
+		return NULL;
+	if ((t->n + 1) * 2 > t->cap && tab_grow(t) != 0)
+		return NULL;
+	x = tab_slot(t->e, t->cap, k, kn);
+	if (x->key[0] == '\0')
+	{
+		memcpy(x->key, k, kn);
+		x->key[kn] = '\0';
+		t->n++;
+	}
+	return x;
+}
+
+static int	lat_bucket(uint64_t us)
+{
+	int b;
+
+	if (us == 0)
+		return 0;
+	b = 64 - __builtin_clzll(us);
+	return (b < LAT_NB) ? b : LAT_NB - 1;
+}
+
+static void	lat_add(t_lat *l, const t_sc_line *sc)
+{
+	l->calls++;
+	if (!sc->has_dur)
+		return;
+	l->timed++;
+	l->total_us += sc->us;
+	if (sc->us > l->max_us)
+		l->max_us = sc->us;
+	l->hist[lat_bucket(sc->us)]++;
+}
+
+// バケットから見積もった百分位（そのバケットの上限。最大値を超えないように丸める）
+static uint64_t	lat_pct(const t_lat *l, int permille)
+{
+	uint64_t need = (l->timed * (uint64_t)permille + 999) / 1000;
+	uint64_t acc = 0;
+
+	if (l->timed == 0)
+		return 0;
+	for (int b = 0; b < LAT_NB; b++)
+	{
+		acc += l->hist[b];
+		if (acc >= need)
+		{
+			uint64_t up = (b == 0) ? 1 : (1ull << b);
+			return (up < l->max_us) ? up : l->max_us;
+		}
+	}
+	return l->max_us;
+}
+
+static int	is_digit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static int	starts(const char *p, const char *end, const char *lit)
+{
+	size_t k = strlen(lit);
+
+	return (size_t)(end - p) >= k && memcmp(p, lit, k) == 0;
+}
+
+static int	parse_dur(const char *p, const char *end, uint64_t *us)
+{
+	uint64_t	sec = 0;
+	uint64_t	frac = 0;
+	int			nd = 0;
+
+	if (p >= end || !is_digit(*p))
+		return 0;
+	while (p < end && is_digit(*p))
+		sec = sec * 10 + (uint64_t)(*p++ - '0');
+	if (p < end && *p == '.')
+		for (p++; p < end && is_digit(*p); p++)
+			if (nd < 6)
+			{
+				frac = frac * 10 + (uint64_t)(*p - '0');
+				nd++;
+			}
+	if (p != end)
+		return 0;
+	while (nd++ < 6)
+		frac *= 10;
+	*us = sec * 1000000 + frac;
+	return 1;
+}
+
+/*
+ * 1 行を読む。syscall の行でなければ 0。
+ *   [印 ]name(args) = ret <秒>
+ *   [印 ]<... name resumed>...) = ret <秒>
+ */
+static int	parse_line(const char *s, size_t n, t_sc_line *o)
+{
+	const char	*end = s + n;
+	const char	*p;
+	int			resumed = 0;
+
+	*o = (t_sc_line){.pid = -1, .fdt = FDT_NONE};
+	if ((p = trace_line_prefix(s, end, NULL, NULL, &o->pid)) == NULL)
+		return 0;
+	if (starts(p, end, "<... "))
+	{
+		p += 5;
+		resumed = 1;
+	}
+	o->name = p;
+	while (p < end && ((*p >= 'a' && *p <= 'z') || is_digit(*p) || *p == '_'))
+		p++;
+	o->name_len = (size_t)(p - o->name);
+	if (o->name_len == 0 || p >= end)
+		return 0;
+	if (resumed ? !starts(p, end, " resumed>") : (*p != '('))
+		return 0;
+	if (n >= 16 && memcmp(end - 16, "<unfinished ...>", 16) == 0)
+		return 0;
+
+	// 末尾の <秒>
+	const char *ret_end = end;
+	if (end[-1] == '>')
+	{
+		const char *lt = memrchr(p, '<', (size_t)(end - p));
+		if (lt && parse_dur(lt + 1, end - 1, &o->us))
+		{
+			o->has_dur = 1;
+			ret_end = lt;
+		}
+	}
+
+	// fd の種類: 第 1 引数、だめなら返り値の -yy 注釈
+	const char *a = resumed ? NULL : trace_fd_annot(p + 1, end, NULL);
+	if (!a)
+	{
+		const char *eq = memmem(p, (size_t)(ret_end - p), ") = ", 4);
+		for (const char *x = eq; x; x = memmem(x + 1, (size_t)(ret_end - x - 1), ") = ", 4))
+			eq = x;
+		if (eq)
+			a = trace_fd_annot(eq + 4, ret_end, NULL);
+	}
+	if (a)
+		o->fdt = trace_fd_class(a, end);
+	return 1;
+}
+
+static void	sum_free(t_sum *sm)
+{
+	free(sm->sys.e);
+	free(sm->pid.e);
+}
+
+static int	sum_trace(t_sum *sm, const char *path)
+{
+	int			fd = open(path, O_RDONLY | O_CLOEXEC);
+	struct stat	sb;
+	const char	*m = MAP_FAILED;
+
+	if (fd < 0)
+		return 0;
+	if (fstat(fd, &sb) == 0 && sb.st_size > 0)
+		m = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (m == MAP_FAILED)
+		return 0;
+	madvise((void *)m, (size_t)sb.st_size, MADV_SEQUENTIAL);
+
+	const char	*end = m + sb.st_size;
+	const char	*dropped = m;
+	long		pg = sysconf(_SC_PAGESIZE);
+	int			rc = 0;
+	for (const char *s = m; s < end && rc == 0; )
+	{
+		// 読み終えたページは捨てて、常駐量をファイルの大きさに比例させない
+		if (s - dropped >= SUM_DROP_BYTES)
+		{
+			size_t len = (size_t)(s - dropped) & ~((size_t)pg - 1);
+			madvise((void *)dropped, len, MADV_DONTNEED);
+			dropped += len;
+		}
+		const char	*nl = memchr(s, '\n', (size_t)(end - s));
+		size_t		n = nl ? (size_t)(nl - s) : (size_t)(end - s);
+		t_sc_line	sc;
+
+		if (parse_line(s, n, &sc))
+		{
+			t_ent *e = tab_get(&sm->sys, sc.name, sc.name_len);
+			if (!e)
+				rc = -1;
+			else
+				lat_add(&e->lat, &sc);
+			if (sc.pid >= 0)
+			{
+				char k[24];
+				int kn = snprintf(k, sizeof(k), "%ld", sc.pid);
+				if ((e = tab_get(&sm->pid, k, (size_t)kn)) == NULL)
+					rc = -1;
+				else
+					lat_add(&e->lat, &sc);
+			}
+			lat_add(&sm->fdt[sc.fdt], &sc);
+			lat_add(&sm->all, &sc);
+		}
+		s += n + 1;
+	}
+	munmap((void *)m, (size_t)sb.st_size);
+	return rc;
+}
+
+static int	cmp_ent_total(const void *x, const void *y)
+{
+	const t_ent *a = *(t_ent *const *)x;
+	const t_ent *b = *(t_ent *const *)y;
+
+	if (a->lat.total_us != b->lat.total_us)
+		return (a->lat.total_us < b->lat.total_us) - (a->lat.total_us > b->lat.total_us);
+	return strcmp(a->key, b->key);
+}
+
+// 合計時間の多い順に並べたポインタ配列（呼び出し側で free）
+static t_ent	**tab_sorted(const t_tab *t)
+{
+	t_ent	**v = malloc((t->n ? t->n : 1) * sizeof(t_ent *));
+	size_t	k = 0;
+
+	if (!v)
+		return NULL;
+	for (size_t i = 0; i < t->cap; i++)
+		if (t->e[i].key[0])
+			v[k++] = &t->e[i];
+	qsort(v, k, sizeof(t_ent *), cmp_ent_total);
+	return v;
+}
+
+/* --- run 間の集計 --- */
+
+typedef struct s_runs
+{
+	int		n;          // この run を含めた run 数
+	double	sum;        // run ごとの syscall 合計時間（us）
+	double	sq;
+	double	min;
+	double	max;
+	t_tab	sys;        // syscall ごとの run_sum / run_sq / run_calls
+}	t_runs;
+
+static char	*slurp(const char *path)
+{
+	FILE	*fp = fopen(path, "r");
+	char	*buf;
+	long	len;
+
+	if (!fp)
+		return NULL;
+	if (fseek(fp, 0, SEEK_END) != 0 || (len = ftell(fp)) < 0 || fseek(fp, 0, SEEK_SET) != 0
+		|| (buf = malloc((size_t)len + 1)) == NULL)
+	{
+		fclose(fp);
+		return NULL;
+	}
+	len = (long)fread(buf, 1, (size_t)len, fp);
+	buf[len] = '\0';
+	fclose(fp);
+	return buf;
+}
+
+static void	runs_add_total(t_runs *r, double total)
+{
+	if (r->n == 0 || total < r->min)
+		r->min = total;
+	if (r->n == 0 || total > r->max)
+		r->max = total;
+	r->sum += total;
+	r->sq += total * total;
+	r->n++;
+}
+
+static int	runs_add_row(t_runs *r, const char *name, double calls, double total_us)
+{
+	t_ent *e = tab_get(&r->sys, name, strlen(name));
+
+	if (!e)
+		return -1;
+	e->run_sum += total_us;
+	e->run_sq += total_us * total_us;
+	e->run_calls += calls;
+	return 0;
+}
+
+// 他の run の summary.txt の [syscall] 表を 1 run 分として足す
+static void	runs_add_file(t_runs *r, const char *path)
+{
+	char	*buf = slurp(path);
+	char	*p;
+	double	total = 0;
+
+	if (!buf)
+		return;
+	p = strstr(buf, "\n[syscall]\n");
+	if (!p)
+	{
+		free(buf);
+		return;
+	}
+	p = strchr(p + 1, '\n');
+	while (p && *++p && *p != '\n')
+	{
+		char				name[NAME_MAX_LEN];
+		unsigned long long	calls;
+		double				tot_s;
+
+		if (*p != '#' && sscanf(p, "%31s %llu %lf", name, &calls, &tot_s) == 3)
+		{
+			runs_add_row(r, name, (double)calls, tot_s * 1e6);
+			total += tot_s * 1e6;
+		}
+		p = strchr(p, '\n');
+	}
+	runs_add_total(r, total);
+	free(buf);
+}
+
+static void	collect_runs(t_runs *r, const char *dir, const t_sum *sm)
+{
+	char		path[PATH_MAX + 300];
+	char		parent[PATH_MAX];
+	const char	*self;
+	char		*meta;
+	DIR			*dp;
+	struct dirent	*de;
+
+	snprintf(path, sizeof(path), "%s/meta.txt", dir);
+	if ((meta = slurp(path)) == NULL)
+		return;
+	snprintf(parent, sizeof(parent), "%s", dir);
+	char *slash = strrchr(parent, '/');
+	self = slash ? dir + (slash - parent) + 1 : dir;
+	if (slash)
+		*slash = '\0';
+	else
+		snprintf(parent, sizeof(parent), ".");
+
+	// この run の分
+	for (size_t i = 0; i < sm->sys.cap; i++)
+		if (sm->sys.e[i].key[0])
+			runs_add_row(r, sm->sys.e[i].key, (double)sm->sys.e[i].lat.calls,
+				(double)sm->sys.e[i].lat.total_us);
+	runs_add_total(r, (double)sm->all.total_us);
+
+	if ((dp = opendir(parent)) != NULL)
+	{
+		while ((de = readdir(dp)) != NULL)
+		{
+			if (de->d_name[0] == '.' || strcmp(de->d_name, self) == 0)
+				continue;
+			snprintf(path, sizeof(path), "%s/%s/meta.txt", parent, de->d_name);
+			char *other = slurp(path);
+			if (other && strcmp(other, meta) == 0)
+			{
+				snprintf(path, sizeof(path), "%s/%s/summary.txt", parent, de->d_name);
+				runs_add_file(r, path);
+			}
+			free(other);
+		}
+		closedir(dp);
+	}
+	free(meta);
+}
+
+static double	sd_of(double sum, double sq, int n)
+{
+	double v;
+
+	if (n < 2)
+		return 0;
+	v = (sq - sum * sum / n) / (n - 1);
+	return (v > 0) ? sqrt(v) : 0;
+}
+
+/* --- 出力 --- */
+
+static void	txt_row(FILE *fp, const char *key, const t_lat *l)
+{
+	fprintf(fp, "%-20s %10llu %12.6f %10.1f %8llu %8llu %8llu\n",
+		key, (unsigned long long)l->calls, (double)l->total_us / 1e6,
+		l->timed ? (double)l->total_us / (double)l->timed : 0.0,
+		(unsigned long long)lat_pct(l, 500), (unsigned long long)lat_pct(l, 990),
+		(unsigned long long)l->max_us);
+}
+
+static const char	*g_row_head =
+	"# %-18s %10s %12s %10s %8s %8s %8s\n";
+
+static void	txt_hist(FILE *fp, const char *key, const t_lat *l)
+{
+	fprintf(fp, "%-20s", key);
+	for (int b = 0; b < LAT_NB; b++)
+	{
+		if (l->hist[b] == 0)
+			continue;
+		if (b == 0)
+			fprintf(fp, " <1:%llu", (unsigned long long)l->hist[b]);
+		else
+			fprintf(fp, " %llu:%llu", 1ull << (b - 1), (unsigned long long)l->hist[b]);
+	}
+	fputc('\n', fp);
+}
+
+static void	write_txt(FILE *fp, const char *dir, const t_sum *sm, t_ent **sys, t_ent **pid,
+	const t_runs *r)
+{
+	fprintf(fp, "trace: %s/trace.txt\n", dir);
+	fprintf(fp, "calls: %llu (timed %llu)  syscall time: %.6f s  pids: %zu\n",
+		(unsigned long long)sm->all.calls, (unsigned long long)sm->all.timed,
+		(double)sm->all.total_us / 1e6, sm->pid.n);
+
+	fprintf(fp, "\n[syscall]\n");
+	fprintf(fp, g_row_head, "name", "calls", "total_s", "avg_us", "p50_us", "p99_us", "max_us");
+	for (size_t i = 0; i < sm->sys.n; i++)
+		txt_row(fp, sys[i]->key, &sys[i]->lat);
+
+	fprintf(fp, "\n[pid]\n");
+	fprintf(fp, g_row_head, "pid", "calls", "total_s", "avg_us", "p50_us", "p99_us", "max_us");
+	for (size_t i = 0; i < sm->pid.n; i++)
+		txt_row(fp, pid[i]->key, &pid[i]->lat);
+
+	fprintf(fp, "\n[fd]\n");
+	fprintf(fp, g_row_head, "type", "calls", "total_s", "avg_us", "p50_us", "p99_us", "max_us");
+	for (int k = 1; k <= FDT_N; k++)
+	{
+		int t = k % FDT_N;
+		if (sm->fdt[t].calls)
+			txt_row(fp, g_fdt_names[t], &sm->fdt[t]);
+	}
+
+	fprintf(fp, "\n[hist]\n");
+	fprintf(fp, "# バケット下限 us:回数（<1 は 1us 未満。p50/p99 はバケット上限で見積もった値）\n");
+	for (size_t i = 0; i < sm->sys.n; i++)
+		if (sys[i]->lat.timed)
+			txt_hist(fp, sys[i]->key, &sys[i]->lat);
+
+	if (r->n < 2)
+		return;
+	double mean = r->sum / r->n;
+	double sd = sd_of(r->sum, r->sq, r->n);
+	fprintf(fp, "\n[runs]\n");
+	fprintf(fp, "# %d runs with the same meta.txt (this one included)\n", r->n);
+	fprintf(fp, "# total_s  mean=%.6f  sd=%.6f  cv=%.1f%%  min=%.6f  max=%.6f\n",
+		mean / 1e6, sd / 1e6, mean > 0 ? sd / mean * 100 : 0.0, r->min / 1e6, r->max / 1e6);
+	fprintf(fp, "# %-18s %12s %14s %12s %7s\n", "name", "calls_mean", "total_mean_us", "total_sd_us", "cv%");
+	for (size_t i = 0; i < sm->sys.n; i++)
+	{
+		t_ent	*e = tab_slot(r->sys.e, r->sys.cap, sys[i]->key, strlen(sys[i]->key));
+		double	m = e->run_sum / r->n;
+		double	s = sd_of(e->run_sum, e->run_sq, r->n);
+
+		fprintf(fp, "%-20s %12.1f %14.1f %12.1f %7.1f\n",
+			sys[i]->key, e->run_calls / r->n, m, s, m > 0 ? s / m * 100 : 0.0);
+	}
+}
+
+static void	json_lat(FILE *fp, const char *kname, const char *key, const t_lat *l)
+{
+	fprintf(fp, "{\"%s\":", kname);
+	json_str(fp, key);
+	fprintf(fp, ",\"calls\":%llu,\"timed\":%llu,\"total_us\":%llu,\"max_us\":%llu,"
+		"\"p50_us\":%llu,\"p99_us\":%llu,\"hist\":[",
+		(unsigned long long)l->calls, (unsigned long long)l->timed,
+		(unsigned long long)l->total_us, (unsigned long long)l->max_us,
+		(unsigned long long)lat_pct(l, 500), (unsigned long long)lat_pct(l, 990));
+	for (int b = 0; b < LAT_NB; b++)
+		fprintf(fp, "%s%llu", b ? "," : "", (unsigned long long)l->hist[b]);
+	fprintf(fp, "]}");
+}
+
+static void	write_json(FILE *fp, const char *dir, const t_sum *sm, t_ent **sys, t_ent **pid,
+	const t_runs *r)
+{
+	char trace[PATH_MAX + 16];
+
+	snprintf(trace, sizeof(trace), "%s/trace.txt", dir);
+	fprintf(fp, "{\"trace\":");
+	json_str(fp, trace);
+	fprintf(fp, ",\"calls\":%llu,\"timed\":%llu,\"total_us\":%llu,\"hist_lower_us\":[0",
+		(unsigned long long)sm->all.calls, (unsigned long long)sm->all.timed,
+		(unsigned long long)sm->all.total_us);
+	for (int b = 1; b < LAT_NB; b++)
+		fprintf(fp, ",%llu", 1ull << (b - 1));
+	fprintf(fp, "],\n\"syscalls\":[");
+	for (size_t i = 0; i < sm->sys.n; i++)
+	{
+		fprintf(fp, "%s\n", i ? "," : "");
+		json_lat(fp, "name", sys[i]->key, &sys[i]->lat);
+	}
+	fprintf(fp, "],\n\"pids\":[");
+	for (size_t i = 0; i < sm->pid.n; i++)
+	{
+		fprintf(fp, "%s\n", i ? "," : "");
+		json_lat(fp, "pid", pid[i]->key, &pid[i]->lat);
+	}
+	fprintf(fp, "],\n\"fd_types\":[");
+	int first = 1;
+	for (int k = 1; k <= FDT_N; k++)
+	{
+		int t = k % FDT_N;
+		if (!sm->fdt[t].calls)
+			continue;
+		fprintf(fp, "%s\n", first ? "" : ",");
+		json_lat(fp, "type", g_fdt_names[t], &sm->fdt[t]);
+		first = 0;
+	}
+	fprintf(fp, "]");
+
+	if (r->n >= 2)
+	{
+		fprintf(fp, ",\n\"runs\":{\"n\":%d,\"total_us\":{\"mean\":%.1f,\"sd\":%.1f,\"min\":%.1f,\"max\":%.1f},"
+			"\"syscalls\":[", r->n, r->sum / r->n, sd_of(r->sum, r->sq, r->n), r->min, r->max);
+		for (size_t i = 0; i < sm->sys.n; i++)
+		{
+			t_ent *e = tab_slot(r->sys.e, r->sys.cap, sys[i]->key, strlen(sys[i]->key));
+			fprintf(fp, "%s\n{\"name\":", i ? "," : "");
+			json_str(fp, sys[i]->key);
+			fprintf(fp, ",\"calls_mean\":%.1f,\"total_mean_us\":%.1f,\"total_sd_us\":%.1f}",
+				e->run_calls / r->n, e->run_sum / r->n, sd_of(e->run_sum, e->run_sq, r->n));
+		}
+		fprintf(fp, "]}");
+	}
+	fprintf(fp, "}\n");
+}
+
+int	trace_summary_write(const char *dir)
+{
+	t_sum	sm = {0};
+	t_runs	runs = {0};
+	t_ent	**sys = NULL;
+	t_ent	**pid = NULL;
+	char	path[PATH_MAX + 32];
+	int		rc = -1;
+
+	snprintf(path, sizeof(path), "%s/trace.txt", dir);
+	if (sum_trace(&sm, path) != 0
+		|| (sys = tab_sorted(&sm.sys)) == NULL || (pid = tab_sorted(&sm.pid)) == NULL)
+		goto out;
+	collect_runs(&runs, dir, &sm);
+
+	snprintf(path, sizeof(path), "%s/summary.txt", dir);
+	FILE *fp = fopen(path, "w");
+	if (!fp)
+		goto out;
+	write_txt(fp, dir, &sm, sys, pid, &runs);
+	if (fclose(fp) != 0)
+		goto out;
+
+	snprintf(path, sizeof(path), "%s/summary.json", dir);
+	if ((fp = fopen(path, "w")) == NULL)
+		goto out;
+	write_json(fp, dir, &sm, sys, pid, &runs);
+	if (fclose(fp) == 0)
+		rc = 0;
+
+out:
+	free(sys);
+	free(pid);
+	free(runs.sys.e);
+	sum_free(&sm);
+	return rc;
+}
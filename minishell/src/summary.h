@@ -0,0 +1,22 @@
+#ifndef SUMMARY_H
+#define SUMMARY_H
+
+/*
+ * trace.txt の -T 時間（<0.000012>）の集計
+ *
+ * dir/trace.txt を mmap して 1 パスで読み、
+ *   - syscall ごと / PID ごと / fd の種類ごと（-yy の注釈から pipe / file / socket / anon / other / none）
+ * に呼び出し回数・合計時間・最大値と、2 冪のバケットで取った latency ヒストグラムを作る。
+ * 結果は dir/summary.txt と dir/summary.json に書く。
+ *
+ * さらに同じ親ディレクトリにある他の run のうち、meta.txt の中身が同じもの（同じ行を同じ mode /
+ * backend で追跡したもの）の summary.txt を読み、run 間の平均・標準偏差・変動係数も添える。
+ *
+ * 形式は strace -tt -T -yy の行（PID 列・"[pid N]" 前置はあってもなくてもよい）。
+ * "<unfinished ...>" は数えず、対応する "<... name resumed>" の行を 1 回と数える。
+ *
+ * 戻り値: 0（trace.txt が無ければ空の集計を書く）/ 書けなければ -1
+ */
+int	trace_summary_write(const char *dir);
+
+#endif
@@ -0,0 +1,280 @@
+#define _GNU_SOURCE
+#include "timing.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "exec.h"
+#include "jobs.h"
+#include "parse.h"
+#include "util.h"
+
+typedef struct s_cg_stat
+{
+	int			ok;
+	long long	usage_usec;
+	long long	user_usec;
+	long long	system_usec;
+	long long	memory_peak;   // 読めなければ -1
+}	t_cg_stat;
+
+static double	ts_diff_ms(const struct timespec *a, const struct timespec *b)
+{
+	return (double)(b->tv_sec - a->tv_sec) * 1e3
+		+ (double)(b->tv_nsec - a->tv_nsec) / 1e6;
+}
+
+static double	tv_ms(const struct timeval *tv)
+{
+	return (double)tv->tv_sec * 1e3 + (double)tv->tv_usec / 1e3;
+}
+
+/*
+ * --- cgroup v2 ---
+ * /proc/self/mounts から cgroup2 のマウント先を、/proc/self/cgroup の "0::" 行から
+ * 自分の cgroup を引いて、その下に minishell-time-<pid>-<seq> を作る。
+ */
+static int	find_cgroup2_dir(char *out, size_t out_sz)
+{
+	char	mnt[PATH_MAX] = "";
+	char	self[PATH_MAX + 128] = "";
+	char	buf[PATH_MAX + 128];
+	FILE	*fp;
+
+	fp = fopen("/proc/self/mounts", "r");
+	if (!fp)
+		return -1;
+	while (fgets(buf, sizeof(buf), fp))
+	{
+		char dev[64], dir[PATH_MAX], type[64];
+		if (sscanf(buf, "%63s %4095s %63s", dev, dir, type) == 3 && strcmp(type, "cgroup2") == 0)
+		{
+			snprintf(mnt, sizeof(mnt), "%s", dir);
+			break;
+		}
+	}
+	fclose(fp);
+
+	fp = fopen("/proc/self/cgroup", "r");
+	if (!fp)
+		return -1;
+	while (fgets(buf, sizeof(buf), fp))
+	{
+		if (strncmp(buf, "0::", 3) == 0)
+		{
+			buf[strcspn(buf, "\n")] = '\0';
+			snprintf(self, sizeof(self), "%s", buf + 3);
+			break;
+		}
+	}
+	fclose(fp);
+
+	if (!mnt[0])
+		return -1;
+	if (snprintf(out, out_sz, "%s%s", mnt, strcmp(self, "/") == 0 ? "" : self) >= (int)out_sz)
+		return -1;
+	return 0;
+}
+
+static int	cgroup_create(char *dir, size_t dir_sz)
+{
+	static int	seq;
+	char		base[PATH_MAX];
+
+	if (find_cgroup2_dir(base, sizeof(base)) != 0)
+		return -1;
+	if (snprintf(dir, dir_sz, "%s/minishell-time-%ld-%d", base, (long)getpid(), seq++) >= (int)dir_sz)
+		return -1;
+	if (mkdir(dir, 0755) != 0)
+		return -1;
+	return 0;
+}
+
+static long long	read_ll_file(const char *dir, const char *name)
+{
+	char		path[PATH_MAX + 64];
+	long long	v = -1;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	FILE *fp = fopen(path, "r");
+	if (!fp)
+		return -1;
+	if (fscanf(fp, "%lld", &v) != 1)
+		v = -1;
+	fclose(fp);
+	return v;
+}
+
+static void	cgroup_collect(const char *dir, t_cg_stat *cs)
+{
+	char	path[PATH_MAX + 64];
+	char	key[64];
+	long long v;
+
+	*cs = (t_cg_stat){0};
+	cs->memory_peak = read_ll_file(dir, "memory.peak");
+
+	snprintf(path, sizeof(path), "%s/cpu.stat", dir);
+	FILE *fp = fopen(path, "r");
+	if (!fp)
+		return;
+	while (fscanf(fp, "%63s %lld", key, &v) == 2)
+	{
+		if (strcmp(key, "usage_usec") == 0)
+			cs->usage_usec = v;
+		else if (strcmp(key, "user_usec") == 0)
+			cs->user_usec = v;
+		else if (strcmp(key, "system_usec") == 0)
+			cs->system_usec = v;
+	}
+	fclose(fp);
+	cs->ok = 1;
+}
+
+/*
+ * --- 出力 ---
+ */
+static void	print_table(const t_cmdline *cl, const t_proc *procs,
+	const struct timespec *fork_ts, double total_ms, const t_cg_stat *cs)
+{
+	fprintf(stderr, "%-5s %-8s %10s %10s %10s %10s %6s %6s %8s %6s %4s  %s\n",
+		"stage", "pid", "wall_ms", "user_ms", "sys_ms", "maxrss_kb",
+		"vcsw", "ivcsw", "minflt", "majflt", "exit", "cmd");
+	for (int i = 0; i < cl->ncmd; i++)
+	{
+		const t_proc *p = &procs[i];
+		fprintf(stderr, "%-5d %-8ld %10.3f %10.3f %10.3f %10ld %6ld %6ld %8ld %6ld %4d  %s\n",
+			i, (long)p->pid, ts_diff_ms(&fork_ts[i], &p->t_end),
+			tv_ms(&p->ru.ru_utime), tv_ms(&p->ru.ru_stime), p->ru.ru_maxrss,
+			p->ru.ru_nvcsw, p->ru.ru_nivcsw, p->ru.ru_minflt, p->ru.ru_majflt,
+			status_to_code(p->status), cl->argvv[i][0]);
+	}
+	fprintf(stderr, "total %-8s %10.3f\n", "", total_ms);
+	if (cs && cs->ok)
+	{
+		fprintf(stderr, "cgroup: usage_usec=%lld user_usec=%lld system_usec=%lld",
+			cs->usage_usec, cs->user_usec, cs->system_usec);
+		if (cs->memory_peak >= 0)
+			fprintf(stderr, " memory.peak=%lld", cs->memory_peak);
+		fputc('\n', stderr);
+	}
+}
+
+static void	print_json(const char *input, const t_cmdline *cl, const t_proc *procs,
+	const struct timespec *fork_ts, double total_ms, const t_cg_stat *cs)
+{
+	fprintf(stderr, "{\"line\":");
+	json_str(stderr, input);
+	fprintf(stderr, ",\"wall_ms\":%.3f,\"exit\":%d,\"stages\":[",
+		total_ms, status_to_code(procs[cl->ncmd - 1].status));
+	for (int i = 0; i < cl->ncmd; i++)
+	{
+		const t_proc *p = &procs[i];
+		fprintf(stderr, "%s{\"cmd\":", i ? "," : "");
+		json_str(stderr, cl->argvv[i][0]);
+		fprintf(stderr, ",\"pid\":%ld,\"wall_ms\":%.3f,\"user_ms\":%.3f,\"sys_ms\":%.3f,"
+			"\"maxrss_kb\":%ld,\"nvcsw\":%ld,\"nivcsw\":%ld,\"minflt\":%ld,\"majflt\":%ld,\"exit\":%d}",
+			(long)p->pid, ts_diff_ms(&fork_ts[i], &p->t_end),
+			tv_ms(&p->ru.ru_utime), tv_ms(&p->ru.ru_stime), p->ru.ru_maxrss,
+			p->ru.ru_nvcsw, p->ru.ru_nivcsw, p->ru.ru_minflt, p->ru.ru_majflt,
+			status_to_code(p->status));
+	}
+	fputc(']', stderr);
+	if (cs && cs->ok)
+	{
+		fprintf(stderr, ",\"cgroup\":{\"usage_usec\":%lld,\"user_usec\":%lld,\"system_usec\":%lld",
+			cs->usage_usec, cs->user_usec, cs->system_usec);
+		if (cs->memory_peak >= 0)
+			fprintf(stderr, ",\"memory_peak\":%lld", cs->memory_peak);
+		fputc('}', stderr);
+	}
+	fprintf(stderr, "}\n");
+}
+
+int	timing_run_line(const char *input, const t_timing_opts *opt)
+{
+	t_cmdline		cl;
+	pid_t			*pids;
+	t_proc			*procs;
+	struct timespec	*fork_ts;
+	char			cg_dir[PATH_MAX];
+	char			cg_procs[PATH_MAX + 16];
+	t_cg_stat		cs = {0};
+	int				use_cg = 0;
+	int				code;
+
+	if (!input || is_blank_line(input))
+		return 0;
+	code = parse_command_line(input, &cl);
+	if (code != 0)
+		return code;
+
+	pids = calloc((size_t)cl.ncmd, sizeof(pid_t));
+	procs = calloc((size_t)cl.ncmd, sizeof(t_proc));
+	fork_ts = calloc((size_t)cl.ncmd, sizeof(struct timespec));
+	if (!pids || !procs || !fork_ts)
+	{
+		fprintf(stderr, "minishell: out of memory\n");
+		code = 1;
+		goto out;
+	}
+
+	if (opt->cgroup)
+	{
+		if (cgroup_create(cg_dir, sizeof(cg_dir)) == 0)
+		{
+			snprintf(cg_procs, sizeof(cg_procs), "%s/cgroup.procs", cg_dir);
+			use_cg = 1;
+		}
+		else
+			fprintf(stderr, "minishell(time): cannot create cgroup v2 dir: %s\n", strerror(errno));
+	}
+
+	// :time はバックグラウンド指定を無視して前景で測る
+	t_spawn sp;
+	int tmp_fd = spawn_opts_from_cmdline(&cl, &sp);
+	sp.fork_ts = fork_ts;
+	sp.cgroup_procs = use_cg ? cg_procs : NULL;
+	int rc = spawn_pipeline(cl.argvv, cl.ncmd, &sp, pids);
+	if (tmp_fd >= 0)
+		close(tmp_fd);
+	if (rc != 0)
+	{
+		code = 1;
+		goto out;
+	}
+	procs_open(procs, pids, cl.ncmd);
+	procs_wait(procs, cl.ncmd, -1);
+	procs_close(procs, cl.ncmd);
+
+	// パイプライン全体: 最初の fork から最後に回収した子まで
+	struct timespec last = procs[0].t_end;
+	for (int i = 1; i < cl.ncmd; i++)
+		if (ts_diff_ms(&last, &procs[i].t_end) > 0)
+			last = procs[i].t_end;
+	double total_ms = ts_diff_ms(&fork_ts[0], &last);
+
+	if (use_cg)
+	{
+		cgroup_collect(cg_dir, &cs);
+		rmdir(cg_dir);
+	}
+
+	if (opt->json)
+		print_json(input, &cl, procs, fork_ts, total_ms, use_cg ? &cs : NULL);
+	else
+		print_table(&cl, procs, fork_ts, total_ms, use_cg ? &cs : NULL);
+	code = status_to_code(procs[cl.ncmd - 1].status);
+
+out:
+	free(pids);
+	free(procs);
+	free(fork_ts);
+	free_command_line(&cl);
+	return code;
+}
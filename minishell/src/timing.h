@@ -0,0 +1,22 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+/*
+ * :time <pipeline>
+ *
+ * パイプラインの各段について wall time / user・sys CPU / max RSS /
+ * コンテキストスイッチ / ページフォルトを wait4 の rusage から集めて stderr に出す。
+ * - json  : 表ではなく JSON 1 行で出す
+ * - cgroup: パイプラインごとに一時 cgroup (v2) を作って入れ、cpu.stat / memory.peak も読む
+ *
+ * 返り値: パイプラインの exit status（最後の段）
+ */
+typedef struct s_timing_opts
+{
+	int	json;
+	int	cgroup;
+}	t_timing_opts;
+
+int	timing_run_line(const char *input, const t_timing_opts *opt);
+
+#endif
@@ -0,0 +1,93 @@
+#include "traceline.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static int	is_digit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static int	starts(const char *p, const char *end, const char *lit)
+{
+	size_t k = strlen(lit);
+
+	return (size_t)(end - p) >= k && memcmp(p, lit, k) == 0;
+}
+
+const char	*trace_line_prefix(const char *s, const char *end,
+	const char **ts, const char **ts_end, long *pid)
+{
+	const char	*p = s;
+	const char	*sp;
+	const char	*q;
+
+	if (ts)
+		*ts = *ts_end = NULL;
+	for (int k = 0; k < 3 && p < end; k++)
+	{
+		if (starts(p, end, "[pid "))
+		{
+			if ((sp = memchr(p, ']', (size_t)(end - p))) == NULL)
+				return NULL;
+			if (pid)
+				*pid = strtol(p + 5, NULL, 10);
+			p = sp + 1;
+		}
+		else if (is_digit(*p) && (sp = memchr(p, ' ', (size_t)(end - p))) != NULL)
+		{
+			for (q = p; q < sp && is_digit(*q); q++)
+				;
+			if (q == sp)
+			{
+				if (pid)
+					*pid = strtol(p, NULL, 10);
+			}
+			else if (memchr(p, ':', (size_t)(sp - p)) || memchr(p, '.', (size_t)(sp - p)))
+			{
+				if (ts)
+				{
+					*ts = p;
+					*ts_end = sp;
+				}
+			}
+			else
+				break;
+			p = sp;
+		}
+		else
+			break;
+		while (p < end && *p == ' ')
+			p++;
+	}
+	return p;
+}
+
+const char	*trace_fd_annot(const char *p, const char *end, int32_t *fd)
+{
+	const char *q = p;
+
+	while (q < end && is_digit(*q))
+		q++;
+	if (q == p || q >= end || *q != '<' || q - p > 9)
+		return NULL;
+	if (fd)
+		*fd = (int32_t)strtol(p, NULL, 10);
+	return q + 1;
+}
+
+t_fdt	trace_fd_class(const char *p, const char *end)
+{
+	if (p >= end)
+		return FDT_OTHER;
+	if (*p == '/')
+		return FDT_FILE;
+	if (starts(p, end, "pipe:"))
+		return FDT_PIPE;
+	if (starts(p, end, "socket:") || starts(p, end, "TCP") || starts(p, end, "UDP")
+		|| starts(p, end, "UNIX") || starts(p, end, "NETLINK"))
+		return FDT_SOCKET;
+	if (starts(p, end, "anon_inode:"))
+		return FDT_ANON;
+	return FDT_OTHER;
+}
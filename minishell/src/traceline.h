@@ -0,0 +1,41 @@
+#ifndef TRACELINE_H
+#define TRACELINE_H
+
+#include <stdint.h>
+
+/*
+ * strace -tt -T -yy の 1 行を読む小物（summary.c と tracetool で共通）
+ *
+ * trace_line_prefix: 行頭の印（時刻と PID）を読み飛ばす。strace の出し方で並びが違うので順不同で見る:
+ *   "TS name("（-f なし）、"PID TS name("（-f -o FILE）、"[pid N] TS name("（-f で -o なし）、
+ *   "TS PID name("（-ff をマージした trace.txt）
+ * 時刻は ':' か '.' を含むトークン、PID は数字だけのトークン。
+ * ts / ts_end が NULL でなければ時刻の範囲（無ければ NULL）、pid が NULL でなければ PID（無ければ触らない）を入れる。
+ * 返り値: 印の直後（syscall 名か "<... " の先頭）。"[pid " が閉じていなければ NULL
+ */
+const char	*trace_line_prefix(const char *s, const char *end,
+				const char **ts, const char **ts_end, long *pid);
+
+/*
+ * -yy の fd 注釈（"3</tmp/x>", "4<pipe:[123]>", "5<TCP:[...]>" ...）の種類。
+ * 値は tracetool.ttc の fd 種類の列にそのまま入るので並びを変えない
+ */
+typedef enum e_fdt
+{
+	FDT_NONE = 0,   // 第 1 引数も返り値も fd ではない
+	FDT_PIPE,
+	FDT_FILE,
+	FDT_SOCKET,
+	FDT_ANON,
+	FDT_OTHER,
+	FDT_N
+}	t_fdt;
+
+/*
+ * trace_fd_annot: p が "数字列<" ならその '<' の次を返す（でなければ NULL）。fd が NULL でなければ数字を入れる
+ * trace_fd_class: 注釈の中身（'<' の次から）で種類を決める
+ */
+const char	*trace_fd_annot(const char *p, const char *end, int32_t *fd);
+t_fdt		trace_fd_class(const char *p, const char *end);
+
+#endif
@@ -0,0 +1,17 @@
+#include "util.h"
+
+void	json_str(FILE *fp, const char *s)
+{
+	fputc('"', fp);
+	for (; *s; s++)
+	{
+		unsigned char c = (unsigned char)*s;
+		if (c == '"' || c == '\\')
+			fprintf(fp, "\\%c", c);
+		else if (c < 0x20)
+			fprintf(fp, "\\u%04x", c);
+		else
+			fputc(c, fp);
+	}
+	fputc('"', fp);
+}
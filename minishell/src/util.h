@@ -0,0 +1,12 @@
+#ifndef UTIL_H
+#define UTIL_H
+
+#include <stdio.h>
+
+/*
+ * 出力まわりの小物（:time / :bench / summary.json で共通）
+ * - json_str: s を JSON の文字列として "..." で囲んで書く（'"' と '\' はエスケープ、制御文字は \uXXXX）
+ */
+void	json_str(FILE *fp, const char *s);
+
+#endif
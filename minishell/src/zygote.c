@@ -0,0 +1,510 @@
+#define _GNU_SOURCE
+#include "zygote.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "evtrace.h"
+
+#define ZMSG_SPAWN    1
+#define ZMSG_SPAWNED  2
+#define ZMSG_EXITED   3
+
+#define ZF_IN   0x1
+#define ZF_OUT  0x2
+
+#define ZMSG_MAX (64 * 1024)
+
+extern char	**environ;
+
+/*
+ * メッセージ（SOCK_SEQPACKET なので 1 send = 1 recv）
+ * SPAWN の後ろには argv[0..argc-1], envp[0..envc-1] を NUL 区切りで並べる。
+ */
+typedef struct s_zmsg
+{
+	uint32_t		type;
+	int32_t			pid;
+	int32_t			status;  // SPAWNED: errno（0 なら成功） / EXITED: wait status
+	uint32_t		flags;   // SPAWN: ZF_IN / ZF_OUT（SCM_RIGHTS で送る fd の有無）
+	uint32_t		argc;
+	uint32_t		envc;
+	struct rusage	ru;      // EXITED のときだけ
+}	t_zmsg;
+
+typedef struct s_zexit
+{
+	pid_t			pid;
+	int				status;
+	struct rusage	ru;
+}	t_zexit;
+
+static int		g_sock = -1;
+static pid_t	g_zygote_pid = -1;
+
+// zygote 経由で起動してまだ回収していない pid
+static pid_t	*g_owned;
+static int		g_nowned;
+static int		g_cap_owned;
+
+// 届いたが、まだ誰も取りに来ていない終了通知
+static t_zexit	*g_exits;
+static int		g_nexits;
+static int		g_cap_exits;
+
+/*
+ * --- 送受信 ---
+ */
+static ssize_t	send_msg(int sock, const t_zmsg *hdr, const char *payload, size_t plen,
+	const int *fds, int nfds)
+{
+	struct iovec	iov[2];
+	struct msghdr	mh;
+	char			cbuf[CMSG_SPACE(sizeof(int) * 2)];
+
+	iov[0].iov_base = (void *)hdr;
+	iov[0].iov_len = sizeof(*hdr);
+	iov[1].iov_base = (void *)payload;
+	iov[1].iov_len = plen;
+
+	memset(&mh, 0, sizeof(mh));
+	mh.msg_iov = iov;
+	mh.msg_iovlen = plen ? 2 : 1;
+	if (nfds > 0)
+	{
+		memset(cbuf, 0, sizeof(cbuf));
+		mh.msg_control = cbuf;
+		mh.msg_controllen = CMSG_SPACE(sizeof(int) * (size_t)nfds);
+		struct cmsghdr *cm = CMSG_FIRSTHDR(&mh);
+		cm->cmsg_level = SOL_SOCKET;
+		cm->cmsg_type = SCM_RIGHTS;
+		cm->cmsg_len = CMSG_LEN(sizeof(int) * (size_t)nfds);
+		memcpy(CMSG_DATA(cm), fds, sizeof(int) * (size_t)nfds);
+	}
+
+	ssize_t r;
+	do
+		r = sendmsg(sock, &mh, MSG_NOSIGNAL);
+	while (r < 0 && errno == EINTR);
+	return r;
+}
+
+static ssize_t	recv_msg(int sock, char *buf, size_t cap, int *fds, int *nfds, int flags)
+{
+	struct iovec	iov;
+	struct msghdr	mh;
+	char			cbuf[CMSG_SPACE(sizeof(int) * 2)];
+
+	iov.iov_base = buf;
+	iov.iov_len = cap;
+	memset(&mh, 0, sizeof(mh));
+	mh.msg_iov = &iov;
+	mh.msg_iovlen = 1;
+	mh.msg_control = cbuf;
+	mh.msg_controllen = sizeof(cbuf);
+
+	ssize_t r;
+	do
+		r = recvmsg(sock, &mh, MSG_CMSG_CLOEXEC | flags);
+	while (r < 0 && errno == EINTR);
+
+	*nfds = 0;
+	if (r > 0)
+	{
+		for (struct cmsghdr *cm = CMSG_FIRSTHDR(&mh); cm; cm = CMSG_NXTHDR(&mh, cm))
+		{
+			if (cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SCM_RIGHTS)
+				continue;
+			int n = (int)((cm->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+			if (n > 2)
+				n = 2;
+			memcpy(fds, CMSG_DATA(cm), sizeof(int) * (size_t)n);
+			*nfds = n;
+		}
+	}
+	return r;
+}
+
+/*
+ * --- zygote 側 ---
+ */
+static void	zygote_handle_spawn(int sock, const t_zmsg *req, char *payload, size_t plen,
+	const int *fds, int nfds, const sigset_t *oldmask)
+{
+	t_zmsg	rep = {.type = ZMSG_SPAWNED};
+	char	**argv = calloc((size_t)req->argc + 1, sizeof(char *));
+	char	**envp = calloc((size_t)req->envc + 1, sizeof(char *));
+	int		in_fd = -1;
+	int		out_fd = -1;
+	int		k = 0;
+
+	if (req->flags & ZF_IN && k < nfds)
+		in_fd = fds[k++];
+	if (req->flags & ZF_OUT && k < nfds)
+		out_fd = fds[k++];
+
+	// payload を argv / envp に割り当てる（payload は NUL 区切り）
+	size_t off = 0;
+	uint32_t i;
+	for (i = 0; argv && i < req->argc && off < plen; i++)
+	{
+		argv[i] = payload + off;
+		off += strlen(payload + off) + 1;
+	}
+	for (uint32_t e = 0; envp && e < req->envc && off < plen; e++)
+	{
+		envp[e] = payload + off;
+		off += strlen(payload + off) + 1;
+	}
+
+	if (!argv || !envp || i == 0)
+		rep.status = ENOMEM;
+	else
+	{
+		pid_t pid = fork();
+		if (pid < 0)
+			rep.status = errno;
+		else if (pid == 0)
+		{
+			sigprocmask(SIG_SETMASK, oldmask, NULL);
+			if (in_fd >= 0 && dup2(in_fd, STDIN_FILENO) < 0)
+				_exit(1);
+			if (in_fd >= 0)
+				evtrace_rec(EV_DUP2, -1, in_fd, STDIN_FILENO);
+			if (out_fd >= 0 && dup2(out_fd, STDOUT_FILENO) < 0)
+				_exit(1);
+			if (out_fd >= 0)
+				evtrace_rec(EV_DUP2, -1, out_fd, STDOUT_FILENO);
+			evtrace_rec(EV_EXEC, -1, 0, 0);
+			execvpe(argv[0], argv, envp);
+			evtrace_rec(EV_EXEC_FAIL, -1, 0, 0);
+			fprintf(stderr, "minishell: exec failed: %s\n", argv[0]);
+			_exit(127);
+		}
+		else
+			rep.pid = pid;
+	}
+
+	for (int j = 0; j < nfds; j++)
+		close(fds[j]);
+	free(argv);
+	free(envp);
+	send_msg(sock, &rep, NULL, 0, NULL, 0);
+}
+
+static void	zygote_reap(int sock)
+{
+	t_zmsg	ev = {.type = ZMSG_EXITED};
+	int		st;
+	pid_t	pid;
+
+	while ((pid = wait4(-1, &st, WNOHANG, &ev.ru)) > 0)
+	{
+		ev.pid = pid;
+		ev.status = st;
+		send_msg(sock, &ev, NULL, 0, NULL, 0);
+	}
+}
+
+static void	zygote_main(int sock)
+{
+	sigset_t	mask;
+	sigset_t	oldmask;
+	char		*buf = malloc(ZMSG_MAX);
+
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGCHLD);
+	sigprocmask(SIG_BLOCK, &mask, &oldmask);
+	int sfd = signalfd(-1, &mask, SFD_CLOEXEC | SFD_NONBLOCK);
+	if (!buf || sfd < 0)
+		_exit(1);
+
+	while (1)
+	{
+		struct pollfd pf[2] = {{sock, POLLIN, 0}, {sfd, POLLIN, 0}};
+		if (poll(pf, 2, -1) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		if (pf[1].revents & POLLIN)
+		{
+			struct signalfd_siginfo si;
+			while (read(sfd, &si, sizeof(si)) == (ssize_t)sizeof(si))
+				;
+			zygote_reap(sock);
+		}
+		if (pf[0].revents & (POLLIN | POLLHUP))
+		{
+			int fds[2];
+			int nfds;
+			ssize_t n = recv_msg(sock, buf, ZMSG_MAX, fds, &nfds, 0);
+			if (n <= 0)
+				break; // シェルが閉じた
+			if ((size_t)n < sizeof(t_zmsg))
+				continue;
+			t_zmsg req;
+			memcpy(&req, buf, sizeof(req));
+			if (req.type == ZMSG_SPAWN)
+				zygote_handle_spawn(sock, &req, buf + sizeof(req), (size_t)n - sizeof(req),
+					fds, nfds, &oldmask);
+			else
+				for (int j = 0; j < nfds; j++)
+					close(fds[j]);
+		}
+	}
+	_exit(0);
+}
+
+/*
+ * --- シェル側 ---
+ */
+static int	push_pid(pid_t pid)
+{
+	if (g_nowned == g_cap_owned)
+	{
+		int ncap = g_cap_owned ? g_cap_owned * 2 : 16;
+		pid_t *np = realloc(g_owned, (size_t)ncap * sizeof(pid_t));
+		if (!np)
+			return -1;
+		g_owned = np;
+		g_cap_owned = ncap;
+	}
+	g_owned[g_nowned++] = pid;
+	return 0;
+}
+
+static void	push_exit(const t_zmsg *m)
+{
+	if (g_nexits == g_cap_exits)
+	{
+		int ncap = g_cap_exits ? g_cap_exits * 2 : 16;
+		t_zexit *ne = realloc(g_exits, (size_t)ncap * sizeof(t_zexit));
+		if (!ne)
+			return;
+		g_exits = ne;
+		g_cap_exits = ncap;
+	}
+	g_exits[g_nexits++] = (t_zexit){m->pid, m->status, m->ru};
+}
+
+static void	zygote_dead(void)
+{
+	if (g_sock >= 0)
+		close(g_sock);
+	g_sock = -1;
+	if (g_zygote_pid > 0)
+		waitpid(g_zygote_pid, NULL, 0);
+	g_zygote_pid = -1;
+}
+
+// 1 メッセージ読んで処理する。SPAWNED ならその内容を *rep に返して 1
+static int	read_one(int flags, t_zmsg *rep)
+{
+	char	buf[sizeof(t_zmsg)];
+	int		fds[2];
+	int		nfds;
+
+	ssize_t n = recv_msg(g_sock, buf, sizeof(buf), fds, &nfds, flags);
+	for (int j = 0; j < nfds; j++)
+		close(fds[j]);
+	if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		return 0;
+	if (n <= 0)
+	{
+		zygote_dead();
+		return -1;
+	}
+	if ((size_t)n < sizeof(t_zmsg))
+		return 0;
+
+	t_zmsg m;
+	memcpy(&m, buf, sizeof(m));
+	if (m.type == ZMSG_EXITED)
+	{
+		push_exit(&m);
+		return 0;
+	}
+	if (m.type == ZMSG_SPAWNED && rep)
+	{
+		*rep = m;
+		return 1;
+	}
+	return 0;
+}
+
+int	zygote_start(void)
+{
+	int	sv[2];
+
+	if (g_sock >= 0)
+		return 0;
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) != 0)
+		return -1;
+
+	fflush(NULL);
+	pid_t pid = fork();
+	if (pid < 0)
+	{
+		close(sv[0]);
+		close(sv[1]);
+		return -1;
+	}
+	if (pid == 0)
+	{
+		close(sv[0]);
+		zygote_main(sv[1]);
+	}
+	close(sv[1]);
+	g_sock = sv[0];
+	g_zygote_pid = pid;
+	return 0;
+}
+
+void	zygote_stop(void)
+{
+	zygote_dead();
+}
+
+int	zygote_active(void)
+{
+	return g_sock >= 0;
+}
+
+int	zygote_fd(void)
+{
+	return g_sock;
+}
+
+pid_t	zygote_spawn(char *const argv[], int in_fd, int out_fd)
+{
+	t_zmsg	req = {.type = ZMSG_SPAWN};
+	char	*payload;
+	size_t	plen = 0;
+	int		fds[2];
+	int		nfds = 0;
+
+	if (g_sock < 0 || !argv || !argv[0])
+		return -1;
+
+	payload = malloc(ZMSG_MAX);
+	if (!payload)
+		return -1;
+	for (char *const *v = argv; *v; v++)
+		req.argc++;
+	for (char **e = environ; e && *e; e++)
+		req.envc++;
+
+	// argv, env の順に NUL 区切りで詰める（入りきらなければ諦めて呼び出し側が fork する）
+	for (int pass = 0; pass < 2; pass++)
+	{
+		char *const *v = (pass == 0) ? argv : environ;
+		for (; v && *v; v++)
+		{
+			size_t len = strlen(*v) + 1;
+			if (sizeof(req) + plen + len > ZMSG_MAX)
+			{
+				free(payload);
+				return -1;
+			}
+			memcpy(payload + plen, *v, len);
+			plen += len;
+		}
+	}
+
+	if (in_fd >= 0)
+	{
+		req.flags |= ZF_IN;
+		fds[nfds++] = in_fd;
+	}
+	if (out_fd >= 0)
+	{
+		req.flags |= ZF_OUT;
+		fds[nfds++] = out_fd;
+	}
+
+	ssize_t r = send_msg(g_sock, &req, payload, plen, fds, nfds);
+	free(payload);
+	if (r < 0)
+	{
+		zygote_dead();
+		return -1;
+	}
+
+	// SPAWNED が来るまで読む（途中の EXITED は溜めておく）
+	t_zmsg rep;
+	int got;
+	while ((got = read_one(0, &rep)) == 0)
+		;
+	if (got < 0)
+		return -1;
+	if (rep.status != 0)
+	{
+		errno = rep.status;
+		return -1;
+	}
+	push_pid(rep.pid);
+	return rep.pid;
+}
+
+int	zygote_owns(pid_t pid)
+{
+	for (int i = 0; i < g_nowned; i++)
+		if (g_owned[i] == pid)
+			return 1;
+	return 0;
+}
+
+void	zygote_pump(void)
+{
+	while (g_sock >= 0 && read_one(MSG_DONTWAIT, NULL) == 0)
+	{
+		// MSG_DONTWAIT で空になるまで読む
+		struct pollfd pf = {g_sock, POLLIN, 0};
+		if (poll(&pf, 1, 0) <= 0)
+			break;
+	}
+}
+
+int	zygote_take_exit(pid_t pid, int *status, struct rusage *ru)
+{
+	int found = 0;
+
+	for (int i = 0; i < g_nexits; i++)
+	{
+		if (g_exits[i].pid != pid)
+			continue;
+		*status = g_exits[i].status;
+		*ru = g_exits[i].ru;
+		g_exits[i] = g_exits[--g_nexits];
+		found = 1;
+		break;
+	}
+	if (!found && g_sock >= 0)
+		return 0;
+	if (!found)
+	{
+		*status = 1 << 8; // zygote が死んだので exit 1 扱い
+		memset(ru, 0, sizeof(*ru));
+	}
+
+	for (int i = 0; i < g_nowned; i++)
+	{
+		if (g_owned[i] == pid)
+		{
+			g_owned[i] = g_owned[--g_nowned];
+			break;
+		}
+	}
+	return found ? 1 : -1;
+}
@@ -0,0 +1,35 @@
+#ifndef ZYGOTE_H
+#define ZYGOTE_H
+
+#include <sys/resource.h>
+#include <sys/types.h>
+
+/*
+ * zygote: 起動直後に fork しておく小さな spawn 専用プロセス
+ *
+ * シェル本体（REPL の状態や履歴でメモリが増えていく側）を fork する代わりに、
+ * まだ小さいうちに分けておいた zygote に「argv / env / stdin・stdout の fd」を
+ * Unix ソケット（SOCK_SEQPACKET + SCM_RIGHTS）で渡して fork/exec してもらう。
+ * 子の親は zygote なので、終了は zygote が wait4 して rusage ごと送り返してくる。
+ *
+ * - zygote_start   : zygote を起動する（起動済みなら何もしない）
+ * - zygote_stop    : ソケットを閉じて zygote を終わらせる
+ * - zygote_active  : 使える状態なら 1
+ * - zygote_spawn   : 1 段分を spawn してもらい pid を返す（失敗は -1）
+ *                    in_fd / out_fd が -1 なら zygote の stdin / stdout を引き継ぐ
+ * - zygote_owns    : zygote 経由で起動してまだ回収していない pid なら 1
+ * - zygote_fd      : poll 用のソケット fd
+ * - zygote_pump    : 届いている終了通知を読み込む（ブロックしない）
+ * - zygote_take_exit: pid の終了通知があれば取り出す
+ *                    1: 取り出した / 0: まだ / -1: zygote が死んだ（status は失敗扱い）
+ */
+int		zygote_start(void);
+void	zygote_stop(void);
+int		zygote_active(void);
+pid_t	zygote_spawn(char *const argv[], int in_fd, int out_fd);
+int		zygote_owns(pid_t pid);
+int		zygote_fd(void);
+void	zygote_pump(void);
+int		zygote_take_exit(pid_t pid, int *status, struct rusage *ru);
+
+#endif
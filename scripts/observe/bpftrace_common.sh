@@ -0,0 +1,63 @@
+# bpftrace_run.sh / bpftrace_sched.sh が source する共通部分（単体では実行しない）
+#
+#   bpftrace_check
+#     bpftrace が PATH にあり root で動いているかを確かめる（だめなら exit 1）
+#
+#   bpftrace_prepare <tag> <command> [args...]
+#     artifacts/bpftrace/<name><tag>-<ts>/ を作り、command を stdout.txt / stderr.txt へ向けて
+#     exec する run.sh を書く。bpftrace -c は引数を空白で割るので、引数の quoting は run.sh に閉じ込め、
+#     -c には一時ディレクトリへ写した run.sh を env 経由で渡す（一時ディレクトリは EXIT で消す）。
+#     設定する変数: root_dir, outdir, cmd_for_bpftrace
+
+bpftrace_check() {
+  if ! command -v bpftrace >/dev/null 2>&1; then
+    echo "bpftrace not found in PATH" >&2
+    exit 1
+  fi
+  if [[ "$(id -u)" != "0" ]]; then
+    echo "bpftrace requires root privileges (run with sudo)" >&2
+    exit 1
+  fi
+}
+
+bpftrace_prepare() {
+  local tag="$1"
+  shift
+  local cmd="$1"
+  local ts safe_name tmp_root tmp_run launcher q
+  local cmd_quoted=()
+
+  ts="$(date +%Y%m%d-%H%M%S)"
+  safe_name="$(basename "$cmd" | tr -cd 'A-Za-z0-9._-')"
+  root_dir="$(pwd -P)"
+  outdir="${root_dir}/artifacts/bpftrace/${safe_name}${tag}-${ts}"
+  mkdir -p "$outdir"
+  tmp_root="${BPFTRACE_TMP_ROOT:-${root_dir}/tmp}"
+  mkdir -p "$tmp_root"
+
+  for arg in "$@"; do
+    printf -v q '%q' "$arg"
+    cmd_quoted+=("$q")
+  done
+
+  cat >"$outdir/run.sh" <<EOF_RUN
+#!/usr/bin/env bash
+set -euo pipefail
+cmd=(${cmd_quoted[*]})
+exec "\${cmd[@]}" >"$outdir/stdout.txt" 2>"$outdir/stderr.txt"
+EOF_RUN
+  chmod +x "$outdir/run.sh"
+
+  bpftrace_tmp_dir="$(mktemp -d "${tmp_root}/bpftrace${tag:--run}.XXXXXX")"
+  trap 'rm -rf "$bpftrace_tmp_dir"' EXIT
+  tmp_run="${bpftrace_tmp_dir}/run.sh"
+  cp "$outdir/run.sh" "$tmp_run"
+  chmod +x "$tmp_run"
+
+  launcher="/usr/bin/env"
+  if [[ ! -x "$launcher" ]]; then
+    echo "launcher not found or not executable: $launcher" >&2
+    exit 1
+  fi
+  cmd_for_bpftrace="$launcher $tmp_run"
+}
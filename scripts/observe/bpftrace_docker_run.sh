@@ -1,8 +1,20 @@
 #!/usr/bin/env bash
 set -euo pipefail
 
-if [[ $# -lt 2 || "$1" != "--" ]]; then
-  echo "Usage: $0 -- <command> [args...]" >&2
+# -- より前のオプション（--aggregate など）は bpftrace_run.sh にそのまま渡す
+# --sched のときは bpftrace_sched.sh を使う（残りのオプションはそちらへ）
+script="bpftrace_run.sh"
+run_opts=()
+while [[ $# -gt 0 && "$1" != "--" ]]; do
+  if [[ "$1" == "--sched" ]]; then
+    script="bpftrace_sched.sh"
+  else
+    run_opts+=("$1")
+  fi
+  shift
+done
+if [[ $# -lt 2 ]]; then
+  echo "Usage: $0 [--aggregate [--interval SEC] | --sched [--no-kprobes]] -- <command> [args...]" >&2
   exit 2
 fi
 shift # drop --
@@ -21,7 +33,13 @@ for arg in "$@"; do
   cmd_quoted+=("$q")
 done
 
-cmd_line="BPFTRACE_TMP_ROOT=/tmp ./scripts/observe/bpftrace_run.sh -- ${cmd_quoted[*]}"
+opts_quoted=()
+for arg in ${run_opts[@]+"${run_opts[@]}"}; do
+  printf -v q '%q' "$arg"
+  opts_quoted+=("$q")
+done
+
+cmd_line="BPFTRACE_TMP_ROOT=/tmp ./scripts/observe/${script} ${opts_quoted[*]+${opts_quoted[*]}} -- ${cmd_quoted[*]}"
 
 exec docker run --rm --privileged --pid=host \
   -v /sys:/sys \
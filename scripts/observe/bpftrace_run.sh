@@ -1,63 +1,60 @@
 #!/usr/bin/env bash
 set -euo pipefail
 
-if [[ $# -lt 2 || "$1" != "--" ]]; then
-  echo "Usage: $0 -- <command> [args...]" >&2
-  exit 2
-fi
-shift # drop --
-
-cmd="$1"
-shift || true
+source "$(dirname "${BASH_SOURCE[0]}")/bpftrace_common.sh"
+
+usage() {
+  cat >&2 <<USAGE
+Usage:
+  $0 [--aggregate [--interval SEC]] -- <command> [args...]
+
+Default:
+  - printf per event (openat/read/write/connect/accept) into trace.txt
+
+Options:
+  --aggregate      Keep everything in BPF maps instead of printing per event:
+                   per-syscall/per-comm latency histograms, byte-count
+                   distributions and error counts, printed into aggregate.txt
+                   at exit (no perf buffer traffic, so nothing is dropped).
+  --interval SEC   With --aggregate, also print (and reset) the maps every SEC
+                   seconds.
+USAGE
+}
 
-if ! command -v bpftrace >/dev/null 2>&1; then
-  echo "bpftrace not found in PATH" >&2
-  exit 1
+mode="events"
+interval=""
+while [[ $# -gt 0 && "$1" != "--" ]]; do
+  case "$1" in
+    --aggregate) mode="aggregate" ;;
+    --interval)
+      if [[ $# -lt 2 ]]; then
+        usage
+        exit 2
+      fi
+      interval="$2"
+      shift
+      ;;
+    *)
+      usage
+      exit 2
+      ;;
+  esac
+  shift
+done
+if [[ $# -lt 2 ]]; then
+  usage
+  exit 2
 fi
-if [[ "$(id -u)" != "0" ]]; then
-  echo "bpftrace requires root privileges (run with sudo)" >&2
-  exit 1
+if [[ -n "$interval" && ( "$mode" != "aggregate" || ! "$interval" =~ ^[1-9][0-9]*$ ) ]]; then
+  usage
+  exit 2
 fi
+shift # drop --
 
-ts="$(date +%Y%m%d-%H%M%S)"
-safe_name="$(basename "$cmd" | tr -cd 'A-Za-z0-9._-')"
-root_dir="$(pwd -P)"
-outdir="${root_dir}/artifacts/bpftrace/${safe_name}-${ts}"
-mkdir -p "$outdir"
-tmp_root="${BPFTRACE_TMP_ROOT:-${root_dir}/tmp}"
-mkdir -p "$tmp_root"
-
-cmd_quoted=()
-for arg in "$cmd" "$@"; do
-  printf -v q '%q' "$arg"
-  cmd_quoted+=("$q")
-done
-
-cat >"$outdir/run.sh" <<EOF_RUN
-#!/usr/bin/env bash
-set -euo pipefail
-cmd=(${cmd_quoted[*]})
-exec "\${cmd[@]}" >"$outdir/stdout.txt" 2>"$outdir/stderr.txt"
-EOF_RUN
-chmod +x "$outdir/run.sh"
-
-tmp_dir="$(mktemp -d "${tmp_root}/bpftrace-run.XXXXXX")"
-tmp_run="${tmp_dir}/run.sh"
-cp "$outdir/run.sh" "$tmp_run"
-chmod +x "$tmp_run"
-
-cleanup() {
-  rm -rf "$tmp_dir"
-}
-trap cleanup EXIT
-
-launcher="/usr/bin/env"
-if [[ ! -x "$launcher" ]]; then
-  echo "launcher not found or not executable: $launcher" >&2
-  exit 1
-fi
-cmd_for_bpftrace="$launcher $tmp_run"
+bpftrace_check
+bpftrace_prepare "" "$@"
 
+# 対象プロセス木の追跡（両モード共通）
 cat >"$outdir/trace.bt" <<'EOF_BT'
 BEGIN
 {
@@ -75,6 +72,76 @@ tracepoint:sched:sched_process_exit
 {
   delete(@trace[pid]);
 }
+EOF_BT
+
+if [[ "$mode" == "aggregate" ]]; then
+  # sys_enter_* / sys_exit_* を tid で対にして、マップに集計するだけ（イベントごとの printf はしない）
+  cat >>"$outdir/trace.bt" <<'EOF_BT'
+
+tracepoint:syscalls:sys_enter_*
+/@trace[pid]/
+{
+  @start[tid] = nsecs;
+}
+
+tracepoint:syscalls:sys_exit_*
+/@start[tid]/
+{
+  @lat_us[probe, comm] = hist((nsecs - @start[tid]) / 1000);
+  if (args->ret < 0) {
+    @errors[probe, comm, -args->ret] = count();
+  }
+  delete(@start[tid]);
+}
+
+tracepoint:syscalls:sys_exit_read,
+tracepoint:syscalls:sys_exit_write,
+tracepoint:syscalls:sys_exit_readv,
+tracepoint:syscalls:sys_exit_writev,
+tracepoint:syscalls:sys_exit_pread64,
+tracepoint:syscalls:sys_exit_pwrite64,
+tracepoint:syscalls:sys_exit_recvfrom,
+tracepoint:syscalls:sys_exit_sendto,
+tracepoint:syscalls:sys_exit_sendfile64
+/@trace[pid] && args->ret > 0/
+{
+  @bytes[probe, comm] = hist(args->ret);
+}
+
+// exit_group などは sys_exit が来ないので、スレッドの終わりで片付ける
+tracepoint:sched:sched_process_exit
+/@start[tid]/
+{
+  delete(@start[tid]);
+}
+EOF_BT
+  if [[ -n "$interval" ]]; then
+    cat >>"$outdir/trace.bt" <<EOF_BT
+
+interval:s:${interval}
+{
+  time("--- %H:%M:%S\n");
+  print(@lat_us);
+  print(@bytes);
+  print(@errors);
+  clear(@lat_us);
+  clear(@bytes);
+  clear(@errors);
+}
+EOF_BT
+  fi
+  cat >>"$outdir/trace.bt" <<'EOF_BT'
+
+END
+{
+  time("--- %H:%M:%S (exit)\n");
+  clear(@start);
+  clear(@trace);
+}
+EOF_BT
+  out_txt="$outdir/aggregate.txt"
+else
+  cat >>"$outdir/trace.bt" <<'EOF_BT'
 
 tracepoint:syscalls:sys_enter_openat
 /@trace[pid]/
@@ -118,8 +185,10 @@ tracepoint:syscalls:sys_enter_accept4
          comm, pid, args->fd);
 }
 EOF_BT
+  out_txt="$outdir/trace.txt"
+fi
 
-bpftrace -q -o "$outdir/trace.txt" "$outdir/trace.bt" -c "$cmd_for_bpftrace" \
+bpftrace -q -o "$out_txt" "$outdir/trace.bt" -c "$cmd_for_bpftrace" \
   >"$outdir/bpftrace_stdout.txt" \
   2>"$outdir/bpftrace_stderr.txt"
 
@@ -0,0 +1,151 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+source "$(dirname "${BASH_SOURCE[0]}")/bpftrace_common.sh"
+
+usage() {
+  cat >&2 <<USAGE
+Usage:
+  $0 [--no-kprobes] -- <command> [args...]
+
+Records scheduler events (sched_wakeup / sched_switch / fork / exec / exit)
+for the traced process tree into sched.txt, then summarizes them with
+"tracetool sched" (run-queue latency, off-CPU time by blocking reason,
+critical path through the pipeline stages).
+
+Options:
+  --no-kprobes   Do not attach kprobes on pipe_read/pipe_write/inet_csk_accept/
+                 do_wait. Blocking reasons then fall back to the syscall name.
+USAGE
+}
+
+kprobes=1
+while [[ $# -gt 0 && "$1" != "--" ]]; do
+  case "$1" in
+    --no-kprobes) kprobes=0 ;;
+    *)
+      usage
+      exit 2
+      ;;
+  esac
+  shift
+done
+if [[ $# -lt 2 ]]; then
+  usage
+  exit 2
+fi
+shift # drop --
+
+bpftrace_check
+bpftrace_prepare "-sched" "$@"
+
+# 1 行 1 イベント（時刻は nsecs）。tracetool sched が読む:
+#   T ns root            F ns parent child      C ns pid comm     X ns tid
+#   W ns tid waker       R ns tid（CPU に載った）
+#   S ns tid state kfn|syscall（CPU から降りた。state 0 はプリエンプト、それ以外は待ちに入った）
+# @trace は bpftrace_run.sh と同じくプロセス木だけに絞る（スレッドも tid で入る）
+cat >"$outdir/sched.bt" <<'EOF_BT'
+BEGIN
+{
+  @trace[cpid] = 1;
+  printf("T %llu %d\n", nsecs, cpid);
+}
+
+tracepoint:sched:sched_process_fork
+/@trace[args->parent_pid]/
+{
+  @trace[args->child_pid] = 1;
+  printf("F %llu %d %d\n", nsecs, args->parent_pid, args->child_pid);
+}
+
+tracepoint:sched:sched_process_exec
+/@trace[tid]/
+{
+  printf("C %llu %d %s\n", nsecs, tid, comm);
+}
+
+tracepoint:sched:sched_process_exit
+/@trace[tid]/
+{
+  printf("X %llu %d\n", nsecs, tid);
+  delete(@trace[tid]);
+  delete(@sys[tid]);
+  delete(@kfn[tid]);
+}
+
+tracepoint:sched:sched_wakeup,
+tracepoint:sched:sched_wakeup_new
+/@trace[args->pid]/
+{
+  printf("W %llu %d %d\n", nsecs, args->pid, tid);
+}
+
+tracepoint:sched:sched_switch
+/@trace[args->prev_pid]/
+{
+  printf("S %llu %d %d %s|%s\n", nsecs, args->prev_pid, args->prev_state,
+         @kfn[args->prev_pid], @sys[args->prev_pid]);
+}
+
+tracepoint:sched:sched_switch
+/@trace[args->next_pid]/
+{
+  printf("R %llu %d\n", nsecs, args->next_pid);
+}
+
+// 待ちに入ったときにどの syscall の中だったか
+tracepoint:syscalls:sys_enter_*
+/@trace[tid]/
+{
+  @sys[tid] = probe;
+}
+
+tracepoint:raw_syscalls:sys_exit
+/@trace[tid]/
+{
+  delete(@sys[tid]);
+}
+EOF_BT
+
+if [[ "$kprobes" == "1" ]]; then
+  # read(2) だけではパイプかファイルか分からないので、待ちの中身をカーネル関数で見分ける
+  for fn in pipe_read pipe_write inet_csk_accept do_wait; do
+    cat >>"$outdir/sched.bt" <<EOF_BT
+
+kprobe:${fn}
+/@trace[tid]/
+{
+  @kfn[tid] = "${fn}";
+}
+
+kretprobe:${fn}
+/@trace[tid]/
+{
+  delete(@kfn[tid]);
+}
+EOF_BT
+  done
+fi
+
+cat >>"$outdir/sched.bt" <<'EOF_BT'
+
+END
+{
+  clear(@trace);
+  clear(@sys);
+  clear(@kfn);
+}
+EOF_BT
+
+bpftrace -q -o "$outdir/sched.txt" "$outdir/sched.bt" -c "$cmd_for_bpftrace" \
+  >"$outdir/bpftrace_stdout.txt" \
+  2>"$outdir/bpftrace_stderr.txt"
+
+tracetool="${root_dir}/tracetool/tracetool"
+if [[ -x "$tracetool" ]]; then
+  "$tracetool" sched "$outdir" >/dev/null || true
+else
+  echo "tracetool not built; run: make -C tracetool && ./tracetool/tracetool sched $outdir" >&2
+fi
+
+printf '%s\n' "$outdir"
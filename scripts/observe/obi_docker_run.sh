@@ -14,8 +14,8 @@ if ! command -v docker >/dev/null 2>&1; then
   exit 1
 fi
 
-if [[ ! -x "$root_dir/minihttpd/minihttpd" ]]; then
-  echo "minihttpd binary not found: $root_dir/minihttpd/minihttpd" >&2
+if [[ ! -f "$root_dir/minihttpd/Dockerfile" ]]; then
+  echo "run from the repository root (minihttpd/Dockerfile not found)" >&2
   exit 1
 fi
 
@@ -88,8 +88,8 @@ docker run -d --name "$obi_name" \
   -e OTEL_EXPORTER_OTLP_ENDPOINT=http://127.0.0.1:4318 \
   docker.io/otel/ebpf-instrument:main >/dev/null
 
-# Build minihttpd image if needed and start container (after OBI so it can attach)
-docker build -q -t study-minihttpd-obi:local "$root_dir/minihttpd" >/dev/null
+# Build minihttpd image (release build inside the image) and start container (after OBI so it can attach)
+docker build -q -t study-minihttpd-obi:local -f "$root_dir/minihttpd/Dockerfile" "$root_dir" >/dev/null
 docker run -d --name "$minihttpd_name" --network=host --pid=host study-minihttpd-obi:local >/dev/null
 
 # Give processes time to start and be discovered
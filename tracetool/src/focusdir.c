@@ -0,0 +1,320 @@
+#define _GNU_SOURCE
+#include "focus.h"
+#include "focusdir.h"
+#include "pool.h"
+#include "tfile.h"
+#include "tindex.h"
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define OUT_FOCUS 0
+#define OUT_PIPE  1
+
+#define M_FOCUS FOCUS_M_ALL
+#define M_PIPE  FOCUS_M_PIPE
+
+/* --- 実行時の状態 --- */
+
+typedef struct s_buf
+{
+	char	*p;
+	size_t	len;
+	size_t	cap;
+}	t_buf;
+
+struct s_dir;
+
+typedef struct s_chunk
+{
+	struct s_dir	*dir;
+	uint32_t		file;
+	size_t			start;
+	size_t			end;
+	uint64_t		nl;          // 1 段目: このチャンクの改行の数
+	uint64_t		line0;       // 2 段目の前に決める: 直前までの行数
+	t_buf			out[2];
+	t_idx_part		part;
+	int				done;
+	int				err;
+}	t_chunk;
+
+typedef struct s_dir
+{
+	const char		*path;
+	t_tfiles		fs;
+	t_chunk			*chunks;     // 全体の配列の中の、このディレクトリの分
+	size_t			nchunks;
+	pthread_mutex_t	mu;
+	size_t			next;        // 次に書き出すチャンク
+	FILE			*out[2];
+	t_idx			ix;
+	int				err;
+}	t_dir;
+
+typedef struct s_run
+{
+	const t_focus_opts	*opts;
+	t_chunk				*chunks;
+	size_t				nchunks;
+}	t_run;
+
+static int	buf_put(t_buf *b, const char *s, size_t n)
+{
+	if (b->len + n > b->cap)
+	{
+		size_t	ncap = b->cap ? b->cap : 4096;
+		char	*np;
+
+		while (ncap < b->len + n)
+			ncap *= 2;
+		if ((np = realloc(b->p, ncap)) == NULL)
+			return -1;
+		b->p = np;
+		b->cap = ncap;
+	}
+	memcpy(b->p + b->len, s, n);
+	b->len += n;
+	return 0;
+}
+
+static int	buf_put_line(t_buf *b, uint64_t lineno, const char *s, size_t n)
+{
+	char	num[24];
+	int		k = snprintf(num, sizeof(num), "%llu:", (unsigned long long)lineno);
+
+	if (buf_put(b, num, (size_t)k) != 0 || buf_put(b, s, n) != 0)
+		return -1;
+	return buf_put(b, "\n", 1);
+}
+
+static void	task_count(void *ctx, size_t i)
+{
+	t_chunk		*c = &((t_run *)ctx)->chunks[i];
+	const char	*base = c->dir->fs.f[c->file].base;
+	const char	*p = base + c->start;
+	const char	*end = base + c->end;
+	uint64_t	nl = 0;
+
+	while ((p = memchr(p, '\n', (size_t)(end - p))) != NULL)
+	{
+		nl++;
+		p++;
+	}
+	c->nl = nl;
+}
+
+static void	dir_finish(t_dir *d, const t_focus_opts *o)
+{
+	char	path[PATH_MAX + 32];
+
+	for (int k = 0; k < 2; k++)
+		if (d->out[k] && fclose(d->out[k]) != 0)
+			d->err = 1;
+	d->out[0] = d->out[1] = NULL;
+	if (!o->no_index)
+	{
+		t_idx_file	*fi = calloc(d->fs.n ? d->fs.n : 1, sizeof(*fi));
+
+		snprintf(path, sizeof(path), "%s/%s", d->path, TINDEX_NAME);
+		for (size_t i = 0; fi && i < d->fs.n; i++)
+			fi[i] = (t_idx_file){d->fs.f[i].name, d->fs.f[i].size, d->fs.f[i].mtime};
+		if (!fi || idx_write(&d->ix, path, fi, d->fs.n) != 0)
+			d->err = 1;
+		free(fi);
+	}
+	idx_free(&d->ix);
+	tfiles_unmap(&d->fs);
+}
+
+// 先頭から揃ったチャンクを順に書き出す（出力の順番をスクリプトと同じにする）
+static void	dir_commit(t_dir *d, t_chunk *c, const t_focus_opts *o)
+{
+	pthread_mutex_lock(&d->mu);
+	c->done = 1;
+	while (d->next < d->nchunks && d->chunks[d->next].done)
+	{
+		t_chunk *x = &d->chunks[d->next];
+
+		if (x->err)
+			d->err = 1;
+		for (int k = 0; k < 2; k++)
+		{
+			if (x->out[k].len && fwrite(x->out[k].p, 1, x->out[k].len, d->out[k]) != x->out[k].len)
+				d->err = 1;
+			free(x->out[k].p);
+			x->out[k] = (t_buf){0};
+		}
+		if (!o->no_index && idx_merge(&d->ix, x->file, x->start, &x->part) != 0)
+			d->err = 1;
+		idx_part_free(&x->part);
+		d->next++;
+	}
+	if (d->next == d->nchunks)
+		dir_finish(d, o);
+	pthread_mutex_unlock(&d->mu);
+}
+
+static void	task_scan(void *ctx, size_t i)
+{
+	t_run		*run = ctx;
+	t_chunk		*c = &run->chunks[i];
+	const char	*base = c->dir->fs.f[c->file].base;
+	const char	*end = base + c->end;
+	uint64_t	lineno = c->line0;
+	int			keep_noise = run->opts->keep_noise;
+	int			want_idx = !run->opts->no_index;
+
+	for (const char *s = base + c->start; s < end && !c->err; )
+	{
+		const char	*nl = memchr(s, '\n', (size_t)(end - s));
+		size_t		n = nl ? (size_t)(nl - s) : (size_t)(end - s);
+		const char	*name;
+		size_t		nlen;
+		int			mask;
+
+		lineno++;
+		if (want_idx && (nlen = trace_line_name(s, n, &name)) > 0
+			&& idx_part_add(&c->part, name, nlen, (uint32_t)(s - (base + c->start))) != 0)
+			c->err = 1;
+		mask = focus_include_mask(s, n);
+		if (mask)
+		{
+			int noise = focus_noise(s, n);
+			if ((mask & M_FOCUS) && (keep_noise || !noise)
+				&& buf_put_line(&c->out[OUT_FOCUS], lineno, s, n) != 0)
+				c->err = 1;
+			if ((mask & M_PIPE) && !noise
+				&& buf_put_line(&c->out[OUT_PIPE], lineno, s, n) != 0)
+				c->err = 1;
+		}
+		s += n + 1;
+	}
+	dir_commit(c->dir, c, run->opts);
+}
+
+// ファイルを chunk バイト前後で、行の境目（改行の直後）に合わせて切る
+static size_t	plan_chunks(t_dir *d, size_t chunk, t_chunk *out)
+{
+	size_t n = 0;
+
+	for (size_t f = 0; f < d->fs.n; f++)
+	{
+		const char	*base = d->fs.f[f].base;
+		size_t		len = d->fs.f[f].len;
+
+		for (size_t start = 0; start < len; )
+		{
+			size_t end = start + chunk;
+			if (end >= len)
+				end = len;
+			else
+			{
+				const char *nl = memchr(base + end, '\n', len - end);
+				end = nl ? (size_t)(nl - base) + 1 : len;
+			}
+			if (out)
+				out[n] = (t_chunk){.dir = d, .file = (uint32_t)f, .start = start, .end = end};
+			n++;
+			start = end;
+		}
+	}
+	return n;
+}
+
+int	focus_dirs(char *const dirs[], int ndirs, const t_focus_opts *opts)
+{
+	t_dir	*ds = calloc((size_t)(ndirs > 0 ? ndirs : 1), sizeof(t_dir));
+	t_run	run = {.opts = opts};
+	int		rc = 0;
+
+	if (!ds)
+		return 1;
+	focus_tab_init();
+
+	// ディレクトリを開いてチャンクに切る
+	for (int i = 0; i < ndirs; i++)
+	{
+		t_dir *d = &ds[i];
+		char path[PATH_MAX + 32];
+
+		d->path = dirs[i];
+		pthread_mutex_init(&d->mu, NULL);
+		if (tfiles_open(d->path, &d->fs) != 0)
+		{
+			fprintf(stderr, "tracetool: %s: cannot open\n", d->path);
+			d->err = 1;
+			continue;
+		}
+		snprintf(path, sizeof(path), "%s/focus.txt", d->path);
+		d->out[OUT_FOCUS] = fopen(path, "w");
+		snprintf(path, sizeof(path), "%s/focus_pipe.txt", d->path);
+		d->out[OUT_PIPE] = fopen(path, "w");
+		if (!d->out[OUT_FOCUS] || !d->out[OUT_PIPE])
+		{
+			fprintf(stderr, "tracetool: %s: cannot write focus files\n", d->path);
+			d->err = 1;
+			for (int k = 0; k < 2; k++)
+				if (d->out[k])
+					fclose(d->out[k]);
+			d->out[0] = d->out[1] = NULL;
+			tfiles_free(&d->fs);
+			continue;
+		}
+		if (d->fs.n == 0)
+			fprintf(stderr, "No trace files found under: %s\n", d->path);
+		d->nchunks = plan_chunks(d, opts->chunk, NULL);
+		run.nchunks += d->nchunks;
+	}
+
+	run.chunks = calloc(run.nchunks ? run.nchunks : 1, sizeof(t_chunk));
+	if (!run.chunks)
+	{
+		free(ds);
+		return 1;
+	}
+	for (int i = 0, at = 0; i < ndirs; i++)
+	{
+		t_dir *d = &ds[i];
+
+		d->chunks = run.chunks + at;
+		plan_chunks(d, opts->chunk, d->chunks);
+		at += (int)d->nchunks;
+		if (d->nchunks == 0 && d->out[OUT_FOCUS])
+			dir_finish(d, opts);
+	}
+
+	// 1 段目: 改行を数えて、ファイルごとの行番号の起点を決める
+	pool_for(opts->nthreads, run.nchunks, task_count, &run);
+	for (size_t i = 0; i < run.nchunks; i++)
+	{
+		t_chunk *c = &run.chunks[i];
+		if (i > 0 && c[-1].dir == c->dir && c[-1].file == c->file)
+			c->line0 = c[-1].line0 + c[-1].nl;
+	}
+
+	// 2 段目: 抽出と索引。終わったチャンクからディレクトリごとに順に書き出される
+	pool_for(opts->nthreads, run.nchunks, task_scan, &run);
+
+	for (int i = 0; i < ndirs; i++)
+	{
+		t_dir *d = &ds[i];
+
+		if (d->err)
+		{
+			fprintf(stderr, "tracetool: %s: failed\n", d->path);
+			rc = 1;
+		}
+		else
+			printf("%s/focus.txt\n%s/focus_pipe.txt\n", d->path, d->path);
+		tfiles_free(&d->fs);
+		pthread_mutex_destroy(&d->mu);
+	}
+	free(run.chunks);
+	free(ds);
+	return rc;
+}
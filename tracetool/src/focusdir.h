@@ -0,0 +1,31 @@
+#ifndef FOCUSDIR_H
+#define FOCUSDIR_H
+
+#include <stddef.h>
+
+/*
+ * scripts/observe/strace_focus.sh / strace_focus_pipe.sh のまとめ処理
+ *
+ * 各 run ディレクトリの trace.*（名前順）について、スクリプトと同じ
+ *   grep -h -n -E <include> trace.* | grep -v -E <noise>
+ * の結果を focus.txt / focus_pipe.txt にバイト単位で同じ形で書く（"行番号:行"。
+ * 行番号はファイルごとに 1 から）。同時に tracetool.idx（tindex.h）も作る。
+ * 行の選び方（include の syscall 名とノイズ）は minishell の focus.h をそのまま使う。
+ *
+ * - ファイルは mmap し、chunk バイトごとに行の境目で切ったチャンクをタスクにする
+ * - 1 段目で各チャンクの改行を数えて行番号の起点を決め、2 段目で抽出と索引づくりをする
+ * - 2 段目が終わったチャンクはディレクトリごとに先頭から順に書き出す（出力の順序はスクリプトと同じ）
+ * - ディレクトリもファイルもまとめて 1 つのプールに流すので、小さな run が多くても大きな run が
+ *   1 つでも全スレッドが働く
+ */
+typedef struct s_focus_opts
+{
+	int		nthreads;
+	size_t	chunk;        // チャンクの目安（バイト）
+	int		keep_noise;   // focus.txt だけノイズを落とさない（strace_focus.sh --keep-noise）
+	int		no_index;
+}	t_focus_opts;
+
+int	focus_dirs(char *const dirs[], int ndirs, const t_focus_opts *opts);
+
+#endif
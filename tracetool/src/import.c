@@ -0,0 +1,365 @@
+#define _GNU_SOURCE
+#include "import.h"
+#include "tcol.h"
+#include "tfile.h"
+#include "tindex.h"
+#include "traceline.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct s_cur
+{
+	const char	*base;
+	const char	*p;
+	const char	*end;
+	uint32_t	file;
+	uint32_t	pid;     // ファイル名 trace.<pid> から。無ければ 0
+	t_rec		rec;     // 次に出すレコード
+}	t_cur;
+
+typedef struct s_imp
+{
+	t_tcolw	w;
+	int		flags;
+	int		err;
+}	t_imp;
+
+static int	is_digit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static int	starts(const char *p, const char *end, const char *lit)
+{
+	size_t k = strlen(lit);
+
+	return (size_t)(end - p) >= k && memcmp(p, lit, k) == 0;
+}
+
+static uint64_t	parse_uint(const char **pp, const char *end)
+{
+	const char	*p = *pp;
+	uint64_t	v = 0;
+
+	while (p < end && is_digit(*p))
+		v = v * 10 + (uint64_t)(*p++ - '0');
+	*pp = p;
+	return v;
+}
+
+static int	parse_dur(const char *p, const char *end, uint64_t *us)
+{
+	const char	*stop;
+	int			epoch;
+
+	if (p >= end || !is_digit(*p))
+		return 0;
+	*us = (uint64_t)ts_parse(p, end, &stop, &epoch);
+	return stop == end;
+}
+
+// 注釈の終わりの '>'（"TCP:[a->b]" のように中に '>' があっても [...] の中は飛ばす）
+static const char	*annot_end(const char *p, const char *end)
+{
+	int depth = 0;
+
+	for (; p < end; p++)
+	{
+		if (*p == '[')
+			depth++;
+		else if (*p == ']' && depth > 0)
+			depth--;
+		else if (*p == '>' && depth == 0)
+			return p;
+	}
+	return NULL;
+}
+
+static void	set_annot(t_imp *im, t_rec *o, const char *a, const char *end)
+{
+	const char *e = annot_end(a, end);
+
+	if (!e)
+		return;
+	o->fdt = (uint8_t)trace_fd_class(a, e);
+	if ((o->path = dict_intern(&im->w.paths, a, (size_t)(e - a))) == UINT32_MAX)
+	{
+		o->path = 0;
+		im->err = 1;
+	}
+}
+
+// 返り値: "N", "-1 ENOENT (...)", "0x7f..", "3</path>", "?"
+static void	parse_ret(t_imp *im, t_rec *o, const char *p, const char *end, const char **annot)
+{
+	int neg = 0;
+
+	if (p < end && *p == '?')
+	{
+		o->flags |= REC_RET_UNK;
+		return;
+	}
+	if (p < end && *p == '-')
+	{
+		neg = 1;
+		p++;
+	}
+	if (starts(p, end, "0x"))
+	{
+		char *q;
+		o->ret = (int64_t)strtoull(p, &q, 16);
+		p = q;
+	}
+	else
+		o->ret = (int64_t)parse_uint(&p, end);
+	if (neg)
+		o->ret = -o->ret;
+	if (p < end && *p == '<')
+		*annot = p + 1;
+	else if (p + 1 < end && *p == ' ' && p[1] >= 'A' && p[1] <= 'Z')
+	{
+		const char *e = ++p;
+		while (e < end && ((*e >= 'A' && *e <= 'Z') || is_digit(*e) || *e == '_'))
+			e++;
+		if ((o->err = dict_intern(&im->w.names, p, (size_t)(e - p))) == UINT32_MAX)
+		{
+			o->err = 0;
+			im->err = 1;
+		}
+	}
+}
+
+/*
+ * 1 行を読む。syscall の行でなければ 0。印（時刻・PID・"[pid N]"）の並びは trace_line_prefix を見る
+ *   [印 ]name(args) = ret[ ERRNO (...)] [<秒>]
+ *   [印 ]name(args <unfinished ...>
+ *   [印 ]<... name resumed>...) = ret [<秒>]
+ */
+static int	parse_line(t_imp *im, const char *s, size_t n, t_rec *o)
+{
+	const char	*end = s + n;
+	const char	*p;
+	const char	*ts;
+	const char	*ts_end;
+	long		pid = -1;
+	const char	*name;
+	const char	*ret_annot = NULL;
+	int			resumed = 0;
+	int			epoch = 0;
+
+	if ((p = trace_line_prefix(s, end, &ts, &ts_end, &pid)) == NULL)
+		return 0;
+	if (ts)
+	{
+		o->ts = ts_parse(ts, ts_end, NULL, &epoch);
+		if (epoch)
+			im->flags |= TCOL_EPOCH;
+	}
+	if (pid >= 0)
+		o->pid = (uint32_t)pid;
+	if (starts(p, end, "<... "))
+	{
+		p += 5;
+		resumed = 1;
+		o->flags |= REC_RESUMED;
+	}
+	name = p;
+	while (p < end && ((*p >= 'a' && *p <= 'z') || is_digit(*p) || *p == '_'))
+		p++;
+	if (p == name || p >= end)
+		return 0;
+	if (resumed ? !starts(p, end, " resumed>") : (*p != '('))
+		return 0;
+	if ((o->sys = dict_intern(&im->w.names, name, (size_t)(p - name))) == UINT32_MAX)
+		return -1;
+
+	const char *ret_end = end;
+	if (n >= 16 && memcmp(end - 16, "<unfinished ...>", 16) == 0)
+	{
+		o->flags |= REC_UNFINISHED;
+		ret_end = NULL;
+	}
+	else if (end[-1] == '>')
+	{
+		const char	*lt = memrchr(p, '<', (size_t)(end - p));
+		uint64_t	us;
+
+		if (lt && parse_dur(lt + 1, end - 1, &us))
+		{
+			o->flags |= REC_DUR;
+			o->dur = (us > UINT32_MAX) ? UINT32_MAX : (uint32_t)us;
+			ret_end = (lt > p && lt[-1] == ' ') ? lt - 1 : lt;
+		}
+	}
+	if (ret_end)
+	{
+		const char *eq = memmem(p, (size_t)(ret_end - p), ") = ", 4);
+		for (const char *x = eq; x; x = memmem(x + 1, (size_t)(ret_end - x - 1), ") = ", 4))
+			eq = x;
+		if (eq)
+			parse_ret(im, o, eq + 4, ret_end, &ret_annot);
+		else
+			o->flags |= REC_RET_UNK;
+	}
+
+	// fd とパス: 第 1 引数（pipe2 の "[3<pipe:[..]>, ..." も）の -yy 注釈、返り値の注釈、'/' で始まる文字列引数の順
+	const char	*a = resumed ? NULL : trace_fd_annot(p + 1 + (p + 1 < end && p[1] == '['), end, &o->fd);
+	if (!a && ret_annot)
+	{
+		a = ret_annot;
+		o->fd = (int32_t)o->ret;
+	}
+	if (a)
+		set_annot(im, o, a, end);
+	else if (!resumed)
+	{
+		const char *q = memchr(p, '"', (size_t)(end - p));
+		if (q && q + 1 < end && q[1] == '/')
+		{
+			const char *e = q + 1;
+			while (e < end && *e != '"' && *e != '\\')
+				e++;
+			if ((o->path = dict_intern(&im->w.paths, q + 1, (size_t)(e - q - 1))) == UINT32_MAX)
+				return -1;
+		}
+	}
+	return 1;
+}
+
+// 次の syscall の行まで進めて c->rec を埋める。終わりなら 0
+static int	cur_next(t_imp *im, t_cur *c)
+{
+	while (c->p < c->end)
+	{
+		const char	*s = c->p;
+		const char	*nl = memchr(s, '\n', (size_t)(c->end - s));
+		size_t		n = nl ? (size_t)(nl - s) : (size_t)(c->end - s);
+		int			rc;
+
+		c->p = nl ? nl + 1 : c->end;
+		c->rec = (t_rec){.pid = c->pid, .fd = -1, .file = c->file, .off = (uint64_t)(s - c->base)};
+		rc = parse_line(im, s, n, &c->rec);
+		if (rc < 0)
+			im->err = 1;
+		if (rc > 0)
+			return 1;
+	}
+	return 0;
+}
+
+static int	cur_less(const t_cur *a, const t_cur *b)
+{
+	if (a->rec.ts != b->rec.ts)
+		return a->rec.ts < b->rec.ts;
+	return a->file < b->file;
+}
+
+static void	heap_down(t_cur **h, size_t n, size_t i)
+{
+	for (;;)
+	{
+		size_t l = 2 * i + 1;
+		size_t m = i;
+
+		if (l < n && cur_less(h[l], h[m]))
+			m = l;
+		if (l + 1 < n && cur_less(h[l + 1], h[m]))
+			m = l + 1;
+		if (m == i)
+			return;
+		t_cur *t = h[i];
+		h[i] = h[m];
+		h[m] = t;
+		i = m;
+	}
+}
+
+static uint32_t	pid_from_name(const char *name)
+{
+	const char *p = name + 6;   // "trace."
+	const char *q = p;
+
+	while (is_digit(*q))
+		q++;
+	return (q > p && *q == '\0') ? (uint32_t)strtoul(p, NULL, 10) : 0;
+}
+
+int	import_dir(const char *dir, const char *out_path)
+{
+	char		path[PATH_MAX + 32];
+	t_tfiles	fs;
+	t_imp		im = {0};
+	t_cur		*cur;
+	t_cur		**heap;
+	t_tsrc		*src;
+	size_t		nh = 0;
+	uint64_t	nrec = 0;
+	int			rc;
+
+	if (tfiles_open(dir, &fs) != 0)
+	{
+		fprintf(stderr, "tracetool: %s: cannot open\n", dir);
+		return 1;
+	}
+	if (fs.n == 0)
+		fprintf(stderr, "No trace files found under: %s\n", dir);
+	if (!out_path)
+	{
+		snprintf(path, sizeof(path), "%s/%s", dir, TCOL_NAME);
+		out_path = path;
+	}
+	cur = calloc(fs.n ? fs.n : 1, sizeof(t_cur));
+	heap = calloc(fs.n ? fs.n : 1, sizeof(t_cur *));
+	src = calloc(fs.n ? fs.n : 1, sizeof(t_tsrc));
+	if (!cur || !heap || !src || tcolw_open(&im.w, out_path) != 0)
+	{
+		fprintf(stderr, "tracetool: %s: cannot write\n", out_path);
+		free(cur);
+		free(heap);
+		free(src);
+		tfiles_free(&fs);
+		return 1;
+	}
+
+	for (size_t i = 0; i < fs.n; i++)
+	{
+		src[i] = (t_tsrc){fs.f[i].name, fs.f[i].size, fs.f[i].mtime};
+		cur[i] = (t_cur){fs.f[i].base, fs.f[i].base, fs.f[i].base + fs.f[i].len, (uint32_t)i,
+			pid_from_name(fs.f[i].name), {0}};
+		if (cur[i].base && cur_next(&im, &cur[i]))
+			heap[nh++] = &cur[i];
+	}
+	for (size_t i = nh / 2; i-- > 0; )
+		heap_down(heap, nh, i);
+	while (nh > 0 && !im.err)
+	{
+		t_cur *c = heap[0];
+
+		if (tcolw_add(&im.w, &c->rec) != 0)
+			im.err = 1;
+		nrec++;
+		if (!cur_next(&im, c))
+			heap[0] = heap[--nh];
+		heap_down(heap, nh, 0);
+	}
+
+	if (im.err)
+	{
+		tcolw_abort(&im.w);
+		rc = 1;
+	}
+	else
+		rc = (tcolw_close(&im.w, im.flags, src, fs.n) == 0) ? 0 : 1;
+	if (rc != 0)
+		fprintf(stderr, "tracetool: %s: import failed\n", out_path);
+	else
+		printf("%s (%llu records)\n", out_path, (unsigned long long)nrec);
+	free(cur);
+	free(heap);
+	free(src);
+	tfiles_free(&fs);
+	return rc;
+}
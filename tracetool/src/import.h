@@ -0,0 +1,15 @@
+#ifndef IMPORT_H
+#define IMPORT_H
+
+/*
+ * run ディレクトリの trace.*（strace -ff -tt -T -yy のテキスト）を tracetool.ttc（tcol.h）に変換する
+ *
+ * - syscall の行だけをレコードにする（シグナルや "+++ exited" の行は落とす）
+ * - PID は行の PID 列 / "[pid N]"、無ければファイル名 trace.<pid> から
+ * - 各ファイルは時刻順なので、ファイルごとのカーソルを時刻で k-way マージして時刻順に並べる
+ *   （レコードを全部メモリに持たない）
+ * - "<unfinished ...>" と "<... resumed>" はそれぞれ 1 レコード（フラグで区別）
+ */
+int	import_dir(const char *dir, const char *out_path);
+
+#endif
@@ -0,0 +1,121 @@
+#include "lz.h"
+
+#include <string.h>
+
+#define LZ_HASH_BITS 14
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_DIST  65535
+
+typedef struct s_lzout
+{
+	uint8_t	*p;
+	size_t	len;
+	size_t	cap;
+}	t_lzout;
+
+static int	out_varint(t_lzout *o, uint64_t v)
+{
+	do
+	{
+		if (o->len >= o->cap)
+			return -1;
+		o->p[o->len++] = (uint8_t)((v & 0x7f) | (v >= 0x80 ? 0x80 : 0));
+		v >>= 7;
+	} while (v);
+	return 0;
+}
+
+static int	out_bytes(t_lzout *o, const uint8_t *s, size_t n)
+{
+	if (o->len + n > o->cap)
+		return -1;
+	memcpy(o->p + o->len, s, n);
+	o->len += n;
+	return 0;
+}
+
+static uint32_t	lz_hash(const uint8_t *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, 4);
+	return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+size_t	lz_compress(const uint8_t *in, size_t n, uint8_t *out)
+{
+	uint32_t	tab[1 << LZ_HASH_BITS];
+	t_lzout		o = {out, 0, n};
+	size_t		lit = 0;     // まだ出していないリテラルの先頭
+	size_t		i = 0;
+
+	memset(tab, 0xff, sizeof(tab));
+	while (n >= LZ_MIN_MATCH && i + LZ_MIN_MATCH <= n)
+	{
+		uint32_t	h = lz_hash(in + i);
+		uint32_t	cand = tab[h];
+
+		tab[h] = (uint32_t)i;
+		if (cand == UINT32_MAX || i - cand > LZ_MAX_DIST || memcmp(in + cand, in + i, LZ_MIN_MATCH) != 0)
+		{
+			i++;
+			continue;
+		}
+		size_t m = LZ_MIN_MATCH;
+		while (i + m < n && in[cand + m] == in[i + m])
+			m++;
+		if (out_varint(&o, i - lit) != 0 || out_bytes(&o, in + lit, i - lit) != 0
+			|| out_varint(&o, m) != 0 || out_varint(&o, i - cand) != 0)
+			return 0;
+		// 一致の中も飛び飛びに表へ入れておく（長い繰り返しの次の一致を拾いやすくする）
+		for (size_t k = i + 1; k + LZ_MIN_MATCH <= n && k < i + m; k += 2)
+			tab[lz_hash(in + k)] = (uint32_t)k;
+		i += m;
+		lit = i;
+	}
+	if (out_varint(&o, n - lit) != 0 || out_bytes(&o, in + lit, n - lit) != 0 || out_varint(&o, 0) != 0)
+		return 0;
+	return (o.len < n) ? o.len : 0;
+}
+
+static int	in_varint(const uint8_t **p, const uint8_t *end, uint64_t *v)
+{
+	*v = 0;
+	for (int sh = 0; *p < end && sh < 64; sh += 7)
+	{
+		uint8_t b = *(*p)++;
+		*v |= (uint64_t)(b & 0x7f) << sh;
+		if (!(b & 0x80))
+			return 0;
+	}
+	return -1;
+}
+
+int	lz_decompress(const uint8_t *in, size_t n, uint8_t *out, size_t outn)
+{
+	const uint8_t	*p = in;
+	const uint8_t	*end = in + n;
+	size_t			o = 0;
+	uint64_t		lit;
+	uint64_t		m;
+	uint64_t		dist;
+
+	for (;;)
+	{
+		if (in_varint(&p, end, &lit) != 0 || lit > (uint64_t)(end - p) || lit > outn - o)
+			return -1;
+		memcpy(out + o, p, lit);
+		p += lit;
+		o += lit;
+		if (in_varint(&p, end, &m) != 0)
+			return -1;
+		if (m == 0)
+			break;
+		if (in_varint(&p, end, &dist) != 0 || dist == 0 || dist > o || m > outn - o)
+			return -1;
+		// 重なる一致（dist < m）もあるので 1 バイトずつ
+		for (uint64_t k = 0; k < m; k++, o++)
+			out[o] = out[o - dist];
+	}
+	return (o == outn && p == end) ? 0 : -1;
+}
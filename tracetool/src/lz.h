@@ -0,0 +1,21 @@
+#ifndef LZ_H
+#define LZ_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * 列ブロック用の小さな LZ77（zlib は使わない）
+ *
+ * 形式は { varint lit_len, lit[lit_len], varint match_len, varint dist } の繰り返しで、
+ * match_len == 0 が終わり（dist は無い）。一致は 4 バイト以上、dist は 1..65535。
+ * varint/デルタ符号化した列は同じ並びが何度も出る（write(1<pipe:[..]>) が続く等）ので、それを畳む。
+ */
+
+// 圧縮して out（容量 n）に書いた長さを返す。n 以上になりそうなら 0（圧縮しないで置く）
+size_t	lz_compress(const uint8_t *in, size_t n, uint8_t *out);
+
+// ちょうど outn バイトに戻せたら 0
+int		lz_decompress(const uint8_t *in, size_t n, uint8_t *out, size_t outn);
+
+#endif
@@ -0,0 +1,232 @@
+#include "focusdir.h"
+#include "import.h"
+#include "pool.h"
+#include "query.h"
+#include "sched.h"
+#include "tcol.h"
+#include "tindex.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_CHUNK (4L << 20)
+
+static void	usage(void)
+{
+	fprintf(stderr,
+		"Usage:\n"
+		"  tracetool focus [-j N] [--chunk N[K|M]] [--keep-noise] [--no-index] <strace_outdir>...\n"
+		"  tracetool show <strace_outdir> <syscall>...\n"
+		"  tracetool import <strace_outdir>... | -o FILE <strace_outdir>\n"
+		"  tracetool query [-s SYS[,SYS]] [-p PID] [-t pipe|file|socket|anon|other|none]\n"
+		"                  [--from TS] [--to TS] [--errors] [--raw | --count] <strace_outdir|FILE>\n"
+		"  tracetool diff [-s SYS[,SYS] | --all] [--keep-noise] [--brief] <A> <B>\n"
+		"  tracetool sched <bpftrace_sched_outdir>...\n");
+}
+
+static long	parse_size(const char *p, char **end)
+{
+	long bytes = strtol(p, end, 10);
+
+	if (**end == 'K' || **end == 'k')
+	{
+		bytes *= 1024;
+		(*end)++;
+	}
+	else if (**end == 'M' || **end == 'm')
+	{
+		bytes *= 1024 * 1024;
+		(*end)++;
+	}
+	return bytes;
+}
+
+static int	cmd_focus(int argc, char **argv)
+{
+	t_focus_opts	o = {pool_default_threads(), DEFAULT_CHUNK, 0, 0};
+	int				i;
+
+	for (i = 0; i < argc && argv[i][0] == '-'; i++)
+	{
+		char *end;
+
+		if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+		{
+			o.nthreads = (int)strtol(argv[++i], &end, 10);
+			if (*end || o.nthreads <= 0)
+				return usage(), 2;
+		}
+		else if (strcmp(argv[i], "--chunk") == 0 && i + 1 < argc)
+		{
+			long n = parse_size(argv[++i], &end);
+			if (*end || n < 4096 || n > (1L << 30))
+				return usage(), 2;
+			o.chunk = (size_t)n;
+		}
+		else if (strcmp(argv[i], "--keep-noise") == 0)
+			o.keep_noise = 1;
+		else if (strcmp(argv[i], "--no-index") == 0)
+			o.no_index = 1;
+		else if (strcmp(argv[i], "--") == 0)
+		{
+			i++;
+			break;
+		}
+		else
+			return usage(), 2;
+	}
+	if (i == argc)
+		return usage(), 2;
+	return focus_dirs(argv + i, argc - i, &o);
+}
+
+// "a,b,c" を NULL 終わりの配列にする（argv の文字列をその場で切る）
+static char	**split_list(char *s, int *n)
+{
+	char	**v = calloc(strlen(s) / 2 + 2, sizeof(char *));
+	char	*save = NULL;
+
+	*n = 0;
+	for (char *t = v ? strtok_r(s, ",", &save) : NULL; t; t = strtok_r(NULL, ",", &save))
+		v[(*n)++] = t;
+	return v;
+}
+
+static int	cmd_import(int argc, char **argv)
+{
+	int rc = 0;
+
+	if (argc >= 1 && strcmp(argv[0], "-o") == 0)
+	{
+		if (argc != 3)
+			return usage(), 2;
+		return import_dir(argv[2], argv[1]);
+	}
+	if (argc < 1)
+		return usage(), 2;
+	for (int i = 0; i < argc; i++)
+		rc |= import_dir(argv[i], NULL);
+	return rc;
+}
+
+static int	cmd_query(int argc, char **argv)
+{
+	t_query	q = {NULL, 0, -1, -1, INT64_MIN, INT64_MAX, 0, 0, 0};
+	char	**sys = NULL;
+	int		i;
+	int		rc;
+
+	for (i = 0; i < argc - 1 && argv[i][0] == '-'; i++)
+	{
+		const char	*stop;
+		int			epoch;
+
+		if (strcmp(argv[i], "-s") == 0 && i + 1 < argc - 1)
+		{
+			free(sys);
+			if ((sys = split_list(argv[++i], &q.nsys)) == NULL)
+				return 1;
+			q.sys = sys;
+		}
+		else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc - 1)
+			q.pid = strtol(argv[++i], NULL, 10);
+		else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc - 1)
+		{
+			if ((q.fdt = fdt_parse(argv[++i])) < 0)
+				return free(sys), usage(), 2;
+		}
+		else if ((strcmp(argv[i], "--from") == 0 || strcmp(argv[i], "--to") == 0) && i + 1 < argc - 1)
+		{
+			int64_t *t = (argv[i][2] == 'f') ? &q.from : &q.to;
+			i++;
+			*t = ts_parse(argv[i], argv[i] + strlen(argv[i]), &stop, &epoch);
+			if (*stop)
+				return free(sys), usage(), 2;
+		}
+		else if (strcmp(argv[i], "--errors") == 0)
+			q.errors = 1;
+		else if (strcmp(argv[i], "--raw") == 0)
+			q.raw = 1;
+		else if (strcmp(argv[i], "--count") == 0)
+			q.count = 1;
+		else
+			return free(sys), usage(), 2;
+	}
+	if (i != argc - 1)
+		return free(sys), usage(), 2;
+	rc = query_run(argv[i], &q);
+	free(sys);
+	return rc;
+}
+
+static int	cmd_diff(int argc, char **argv)
+{
+	t_diff_opts	o = {NULL, 0, 0, 0, 0};
+	char		**sys = NULL;
+	int			i;
+	int			rc;
+
+	for (i = 0; i < argc - 2 && argv[i][0] == '-'; i++)
+	{
+		if (strcmp(argv[i], "-s") == 0 && i + 1 < argc - 2)
+		{
+			free(sys);
+			if ((sys = split_list(argv[++i], &o.nsys)) == NULL)
+				return 2;
+			o.sys = sys;
+		}
+		else if (strcmp(argv[i], "--all") == 0)
+			o.all = 1;
+		else if (strcmp(argv[i], "--keep-noise") == 0)
+			o.keep_noise = 1;
+		else if (strcmp(argv[i], "--brief") == 0)
+			o.brief = 1;
+		else
+			return free(sys), usage(), 2;
+	}
+	if (i != argc - 2)
+		return free(sys), usage(), 2;
+	rc = diff_runs(argv[i], argv[i + 1], &o);
+	free(sys);
+	return rc;
+}
+
+static int	cmd_sched(int argc, char **argv)
+{
+	int rc = 0;
+
+	if (argc < 1)
+		return usage(), 2;
+	for (int i = 0; i < argc; i++)
+		rc |= sched_summarize(argv[i]);
+	return rc;
+}
+
+static int	cmd_show(int argc, char **argv)
+{
+	if (argc < 2)
+		return usage(), 2;
+	return idx_show(argv[0], argv + 1, argc - 1, stdout) == 0 ? 0 : 1;
+}
+
+int	main(int argc, char **argv)
+{
+	if (argc < 2)
+		return usage(), 2;
+	if (strcmp(argv[1], "focus") == 0)
+		return cmd_focus(argc - 2, argv + 2);
+	if (strcmp(argv[1], "show") == 0)
+		return cmd_show(argc - 2, argv + 2);
+	if (strcmp(argv[1], "import") == 0)
+		return cmd_import(argc - 2, argv + 2);
+	if (strcmp(argv[1], "query") == 0)
+		return cmd_query(argc - 2, argv + 2);
+	if (strcmp(argv[1], "diff") == 0)
+		return cmd_diff(argc - 2, argv + 2);
+	if (strcmp(argv[1], "sched") == 0)
+		return cmd_sched(argc - 2, argv + 2);
+	usage();
+	return 2;
+}
@@ -0,0 +1,51 @@
+#include "pool.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+typedef struct s_pool
+{
+	size_t		next;
+	size_t		ntasks;
+	t_task_fn	fn;
+	void		*ctx;
+}	t_pool;
+
+int	pool_default_threads(void)
+{
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return (n > 0) ? (int)n : 1;
+}
+
+static void	*pool_worker(void *arg)
+{
+	t_pool	*p = arg;
+	size_t	i;
+
+	while ((i = __atomic_fetch_add(&p->next, 1, __ATOMIC_RELAXED)) < p->ntasks)
+		p->fn(p->ctx, i);
+	return NULL;
+}
+
+void	pool_for(int nthreads, size_t ntasks, t_task_fn fn, void *ctx)
+{
+	t_pool		p = {.ntasks = ntasks, .fn = fn, .ctx = ctx};
+	pthread_t	*th;
+	int			started = 0;
+
+	if (nthreads < 1)
+		nthreads = 1;
+	if ((size_t)nthreads > ntasks)
+		nthreads = (ntasks > 0) ? (int)ntasks : 1;
+	th = malloc(sizeof(pthread_t) * (size_t)nthreads);
+	// スレッドが作れなかった分は呼び出し元が引き受ける（1 本でも最後までは進む）
+	for (int i = 1; th && i < nthreads; i++)
+		if (pthread_create(&th[started], NULL, pool_worker, &p) == 0)
+			started++;
+	pool_worker(&p);
+	for (int i = 0; i < started; i++)
+		pthread_join(th[i], NULL);
+	free(th);
+}
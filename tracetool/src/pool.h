@@ -0,0 +1,18 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+/*
+ * 小さなスレッドプール
+ *
+ * pool_for は nthreads 本（呼び出し元のスレッドを含む）で fn(ctx, 0..ntasks-1) を 1 回ずつ実行し、
+ * 全部終わってから戻る。タスクは共有カウンタを atomic に進めて取り合うので、
+ * 大きさのばらつくタスク（ファイルのチャンク）でも空いたスレッドから次を取る。
+ */
+typedef void	(*t_task_fn)(void *ctx, size_t i);
+
+int		pool_default_threads(void);
+void	pool_for(int nthreads, size_t ntasks, t_task_fn fn, void *ctx);
+
+#endif
@@ -0,0 +1,550 @@
+#define _GNU_SOURCE
+#include "query.h"
+#include "tcol.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define DIFF_MAX_D 2048   // これより違う並びは揃えずに、残りを全部 -/+ で出す
+
+// 1 レコードを strace 風に書く（引数は fd と パスだけ）
+static void	put_rec(FILE *out, const t_tcol *c, const t_rec *r)
+{
+	const char *path = c->paths[r->path];
+
+	if (r->flags & REC_RESUMED)
+		fprintf(out, "<... %s resumed>", c->names[r->sys]);
+	else
+	{
+		fprintf(out, "%s(", c->names[r->sys]);
+		if (r->fd >= 0)
+			fprintf(out, r->path ? "%d<%s>" : "%d", r->fd, path);
+		else if (r->path)
+			fprintf(out, "\"%s\"", path);
+	}
+	if (r->flags & REC_UNFINISHED)
+		fputs(" <unfinished ...>", out);
+	else if (r->flags & REC_RET_UNK)
+		fputs(") = ?", out);
+	else
+	{
+		fprintf(out, (r->ret < -4096 || r->ret > (1LL << 32)) ? ") = %#llx" : ") = %lld", (long long)r->ret);
+		if (r->err)
+			fprintf(out, " %s", c->names[r->err]);
+	}
+	if (r->flags & REC_DUR)
+		fprintf(out, " <%u.%06u>", r->dur / 1000000, r->dur % 1000000);
+}
+
+/* --- query --- */
+
+typedef struct s_src_map
+{
+	const char	*base;
+	size_t		len;
+	int			state;    // 0: まだ, 1: 開いた, -1: 開けない / 古い
+}	t_src_map;
+
+// .ttc のあるディレクトリ（元の trace.* はここからの相対名）
+static void	base_dir(const char *path, char *dir, size_t n)
+{
+	struct stat	sb;
+	const char	*sl;
+
+	if (stat(path, &sb) == 0 && S_ISDIR(sb.st_mode))
+		snprintf(dir, n, "%s", path);
+	else if ((sl = strrchr(path, '/')) != NULL)
+		snprintf(dir, n, "%.*s", (int)(sl - path), path);
+	else
+		snprintf(dir, n, ".");
+}
+
+static int	src_line(const t_tcol *c, t_src_map *m, const char *dir, const t_rec *r, FILE *out)
+{
+	t_src_map	*s = &m[r->file];
+	const char	*p;
+	const char	*nl;
+
+	if (s->state == 0)
+	{
+		char		path[PATH_MAX + 300];
+		struct stat	sb;
+		int			fd;
+
+		s->state = -1;
+		snprintf(path, sizeof(path), "%s/%s", dir, c->src[r->file].name);
+		if ((fd = open(path, O_RDONLY | O_CLOEXEC)) >= 0)
+		{
+			if (fstat(fd, &sb) == 0 && (uint64_t)sb.st_size == c->src[r->file].size
+				&& (int64_t)sb.st_mtime == c->src[r->file].mtime && sb.st_size > 0)
+			{
+				s->base = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+				if (s->base != MAP_FAILED)
+				{
+					s->len = (size_t)sb.st_size;
+					s->state = 1;
+				}
+			}
+			close(fd);
+		}
+		if (s->state < 0)
+			fprintf(stderr, "tracetool: %s: missing or changed since import\n", path);
+	}
+	if (s->state < 0 || r->off >= s->len)
+		return -1;
+	p = s->base + r->off;
+	nl = memchr(p, '\n', s->len - r->off);
+	fprintf(out, "%s:%.*s\n", c->src[r->file].name, (int)(nl ? (size_t)(nl - p) : s->len - r->off), p);
+	return 0;
+}
+
+typedef struct s_cnt
+{
+	uint64_t	calls;
+	uint64_t	errors;
+	uint64_t	total_us;
+	uint32_t	sys;
+}	t_cnt;
+
+static int	cmp_cnt(const void *a, const void *b)
+{
+	const t_cnt *x = a;
+	const t_cnt *y = b;
+
+	if (x->calls != y->calls)
+		return (x->calls < y->calls) ? 1 : -1;
+	return (x->sys > y->sys) - (x->sys < y->sys);
+}
+
+static int	rec_match(const t_query *q, const uint8_t *want, const t_rec *r)
+{
+	return (!want || want[r->sys])
+		&& (q->pid < 0 || r->pid == (uint32_t)q->pid)
+		&& (q->fdt < 0 || r->fdt == q->fdt)
+		&& r->ts >= q->from && r->ts <= q->to
+		&& (!q->errors || r->err != 0);
+}
+
+int	query_run(const char *path, const t_query *q)
+{
+	t_tcol		c;
+	char		dir[PATH_MAX];
+	uint8_t		*want = NULL;
+	t_rec		*recs;
+	t_cnt		*cnt;
+	t_src_map	*srcm;
+	size_t		nseg_read = 0;
+	int			rc = 0;
+
+	if (tcol_open(path, &c) != 0)
+	{
+		fprintf(stderr, "tracetool: %s: no columnar trace (run `tracetool import` first)\n", path);
+		return 1;
+	}
+	base_dir(path, dir, sizeof(dir));
+	recs = malloc(SEG_RECS * sizeof(t_rec));
+	cnt = calloc(c.nnames, sizeof(t_cnt));
+	srcm = calloc(c.nsrc ? c.nsrc : 1, sizeof(t_src_map));
+	if (q->sys && (want = calloc(c.nnames, 1)) != NULL)
+		for (int i = 0; i < q->nsys; i++)
+			want[tcol_name_id(&c, q->sys[i])] = 1;
+	if (want)
+		want[0] = 0;
+	if (!recs || !cnt || !srcm || (q->sys && !want))
+		rc = 1;
+
+	for (size_t i = 0; i < c.nseg && rc == 0; i++)
+	{
+		t_tseg	h;
+		int		hit = !want;
+
+		if (tcol_seg_head(&c, i, &h) != 0)
+		{
+			rc = 1;
+			break;
+		}
+		if (h.ts_max < q->from || h.ts_min > q->to
+			|| (q->pid >= 0 && ((uint32_t)q->pid < h.pid_min || (uint32_t)q->pid > h.pid_max)))
+			continue;
+		for (size_t k = 1; !hit && k < c.nnames; k++)
+			hit = want[k] && tcol_seg_has_sys(&h, (uint32_t)k);
+		if (!hit)
+			continue;
+		if (tcol_seg_read(&c, &h, recs) != 0)
+		{
+			rc = 1;
+			break;
+		}
+		nseg_read++;
+		for (size_t k = 0; k < h.nrec; k++)
+		{
+			const t_rec *r = &recs[k];
+
+			if (!rec_match(q, want, r))
+				continue;
+			if (q->count)
+			{
+				cnt[r->sys].calls++;
+				cnt[r->sys].errors += (r->err != 0);
+				cnt[r->sys].total_us += r->dur;
+			}
+			else if (q->raw)
+			{
+				if (src_line(&c, srcm, dir, r, stdout) != 0)
+					rc = 1;
+			}
+			else
+			{
+				char ts[32];
+
+				ts_format(ts, sizeof(ts), r->ts, c.flags & TCOL_EPOCH);
+				printf("%s %u ", ts, r->pid);
+				put_rec(stdout, &c, r);
+				putchar('\n');
+			}
+		}
+	}
+	if (rc != 0)
+		fprintf(stderr, "tracetool: %s: broken or unreadable\n", path);
+	else if (q->count)
+	{
+		for (size_t i = 0; i < c.nnames; i++)
+			cnt[i].sys = (uint32_t)i;
+		qsort(cnt, c.nnames, sizeof(t_cnt), cmp_cnt);
+		printf("%-20s %10s %8s %12s\n", "syscall", "calls", "errors", "total_us");
+		for (size_t i = 0; i < c.nnames && cnt[i].calls; i++)
+			printf("%-20s %10llu %8llu %12llu\n", c.names[cnt[i].sys], (unsigned long long)cnt[i].calls,
+				(unsigned long long)cnt[i].errors, (unsigned long long)cnt[i].total_us);
+	}
+	if (getenv("TRACETOOL_STATS"))
+		fprintf(stderr, "tracetool: read %zu of %zu segments\n", nseg_read, c.nseg);
+	for (size_t i = 0; srcm && i < c.nsrc; i++)
+		if (srcm[i].state > 0)
+			munmap((void *)srcm[i].base, srcm[i].len);
+	free(srcm);
+	free(cnt);
+	free(recs);
+	free(want);
+	tcol_close(&c);
+	return rc;
+}
+
+/* --- diff --- */
+
+static const char	*g_skeleton[] = {
+	"execve", "clone", "clone3", "fork", "vfork", "wait4", "waitid", "exit_group",
+	"pipe", "pipe2", "dup", "dup2", "dup3", "openat", "close", "chdir", "setpgid", "kill",
+};
+
+typedef struct s_run
+{
+	t_tcol		c;
+	t_rec		*r;
+	uint64_t	*tok;
+	uint32_t	*pno;    // p0, p1, ...（PID を出てきた順に振り直したもの）
+	size_t		n;
+}	t_run;
+
+static int	is_noise_path(const char *s)
+{
+	return strstr(s, "/etc/ld.so.cache") || strstr(s, "/lib/") || strstr(s, "/usr/lib/")
+		|| strstr(s, "/usr/share/locale") || strstr(s, "locale-archive");
+}
+
+static uint64_t	tok_mix(uint64_t h, const char *s)
+{
+	while (*s)
+		h = (h ^ (unsigned char)*s++) * 1099511628211ull;
+	return (h ^ 0xff) * 1099511628211ull;
+}
+
+// 並びを比べるときの 1 行の値（PID、pipe/socket の inode、成功時の返り値は見ない）
+static uint64_t	rec_token(const t_tcol *c, const t_rec *r)
+{
+	uint64_t	h = 1469598103934665603ull;
+	char		num[32];
+
+	h = tok_mix(h, c->names[r->sys]);
+	snprintf(num, sizeof(num), "%d/%d", r->fd, r->fdt);
+	h = tok_mix(h, num);
+	if (r->fdt == FDT_FILE || (r->fd < 0 && r->path))
+		h = tok_mix(h, c->paths[r->path]);
+	h = tok_mix(h, r->err ? c->names[r->err] : (r->flags & REC_RET_UNK) ? "?" : "ok");
+	return h;
+}
+
+static int	run_load(t_run *run, const char *path, const t_diff_opts *o)
+{
+	t_rec		*seg = malloc(SEG_RECS * sizeof(t_rec));
+	uint8_t		*want = NULL;
+	uint8_t		*noise = NULL;
+	uint32_t	*pids = NULL;
+	size_t		npid = 0;
+	size_t		cap = 0;
+	int			rc = 0;
+
+	*run = (t_run){0};
+	if (tcol_open(path, &run->c) != 0)
+	{
+		fprintf(stderr, "tracetool: %s: no columnar trace (run `tracetool import` first)\n", path);
+		free(seg);
+		return -1;
+	}
+	want = calloc(run->c.nnames, 1);
+	noise = calloc(run->c.npaths, 1);
+	if (!seg || !want || !noise)
+		rc = -1;
+	for (size_t i = 1; want && i < run->c.nnames; i++)
+	{
+		if (o->all)
+			want[i] = 1;
+		else if (o->sys)
+			for (int k = 0; k < o->nsys && !want[i]; k++)
+				want[i] = (strcmp(run->c.names[i], o->sys[k]) == 0);
+		else
+			for (size_t k = 0; k < sizeof(g_skeleton) / sizeof(g_skeleton[0]) && !want[i]; k++)
+				want[i] = (strcmp(run->c.names[i], g_skeleton[k]) == 0);
+	}
+	for (size_t i = 1; noise && !o->keep_noise && i < run->c.npaths; i++)
+		noise[i] = (uint8_t)is_noise_path(run->c.paths[i]);
+
+	for (size_t s = 0; s < run->c.nseg && rc == 0; s++)
+	{
+		t_tseg h;
+
+		if (tcol_seg_head(&run->c, s, &h) != 0 || tcol_seg_read(&run->c, &h, seg) != 0)
+		{
+			rc = -1;
+			break;
+		}
+		for (size_t i = 0; i < h.nrec && rc == 0; i++)
+		{
+			const t_rec	*r = &seg[i];
+			size_t		p;
+
+			// resumed の行は unfinished の行と同じ呼び出しなので数えない
+			if (!want[r->sys] || noise[r->path] || (r->flags & REC_RESUMED))
+				continue;
+			if (run->n == cap)
+			{
+				cap = cap ? cap * 2 : 1024;
+				t_rec		*nr = realloc(run->r, cap * sizeof(t_rec));
+				uint64_t	*nt = nr ? realloc(run->tok, cap * sizeof(uint64_t)) : NULL;
+				uint32_t	*np = nt ? realloc(run->pno, cap * sizeof(uint32_t)) : NULL;
+				if (nr)
+					run->r = nr;
+				if (nt)
+					run->tok = nt;
+				if (!np)
+				{
+					rc = -1;
+					break;
+				}
+				run->pno = np;
+			}
+			for (p = 0; p < npid && pids[p] != r->pid; p++)
+				;
+			if (p == npid)
+			{
+				uint32_t *nps = realloc(pids, (npid + 1) * sizeof(uint32_t));
+				if (!nps)
+				{
+					rc = -1;
+					break;
+				}
+				pids = nps;
+				pids[npid++] = r->pid;
+			}
+			run->r[run->n] = *r;
+			run->tok[run->n] = rec_token(&run->c, r);
+			run->pno[run->n] = (uint32_t)p;
+			run->n++;
+		}
+	}
+	if (rc != 0)
+		fprintf(stderr, "tracetool: %s: broken or unreadable\n", path);
+	free(seg);
+	free(want);
+	free(noise);
+	free(pids);
+	return rc;
+}
+
+static void	run_free(t_run *run)
+{
+	free(run->r);
+	free(run->tok);
+	free(run->pno);
+	tcol_close(&run->c);
+}
+
+typedef struct s_dstat
+{
+	size_t	same;
+	size_t	del;
+	size_t	add;
+	int		brief;
+}	t_dstat;
+
+static void	put_line(char mark, const t_run *run, size_t i, t_dstat *st)
+{
+	if (mark == ' ')
+		st->same++;
+	else if (mark == '-')
+		st->del++;
+	else
+		st->add++;
+	if (st->brief)
+		return;
+	printf("%c p%-3u ", mark, run->pno[i]);
+	put_rec(stdout, &run->c, &run->r[i]);
+	putchar('\n');
+}
+
+/*
+ * Myers の O(ND) 差分。a[alo, ahi) と b[blo, bhi) を揃えて出す。
+ * d ごとの V を取っておいて後ろからたどる（d が DIFF_MAX_D を超えたら揃えるのをやめる）。
+ */
+static void	myers(const t_run *a, size_t alo, size_t ahi, const t_run *b, size_t blo, size_t bhi, t_dstat *st)
+{
+	long	n = (long)(ahi - alo);
+	long	m = (long)(bhi - blo);
+	long	max = n + m;
+	long	dmax = (max < DIFF_MAX_D) ? max : DIFF_MAX_D;
+	long	off = dmax + 1;
+	long	*v = calloc((size_t)(2 * dmax + 3), sizeof(long));
+	long	**trace = calloc((size_t)dmax + 1, sizeof(long *));
+	long	d;
+	long	found = -1;
+
+	for (d = 0; v && trace && d <= dmax && found < 0; d++)
+	{
+		for (long k = -d; k <= d; k += 2)
+		{
+			long x = (k == -d || (k != d && v[off + k - 1] < v[off + k + 1]))
+				? v[off + k + 1] : v[off + k - 1] + 1;
+			long y = x - k;
+
+			while (x < n && y < m && a->tok[alo + (size_t)x] == b->tok[blo + (size_t)y])
+			{
+				x++;
+				y++;
+			}
+			v[off + k] = x;
+			if (x >= n && y >= m)
+			{
+				found = d;
+				break;
+			}
+		}
+		// V の [-d, d] だけ取っておく（全部で O(D^2)）
+		if ((trace[d] = malloc((size_t)(2 * d + 1) * sizeof(long))) == NULL)
+		{
+			found = -1;
+			break;
+		}
+		memcpy(trace[d], v + off - d, (size_t)(2 * d + 1) * sizeof(long));
+	}
+
+	if (found < 0)
+	{
+		// 違いすぎる（か、メモリが無い）: 揃えずに並べる
+		fprintf(stderr, "tracetool: sequences differ in more than %d places; not aligning\n", DIFF_MAX_D);
+		for (size_t i = alo; i < ahi; i++)
+			put_line('-', a, i, st);
+		for (size_t i = blo; i < bhi; i++)
+			put_line('+', b, i, st);
+	}
+	else
+	{
+		// 後ろから編集の列をたどって、前から出す
+		char	*ops = malloc((size_t)(n + m) + 1);
+		size_t	nops = 0;
+		long	x = n;
+		long	y = m;
+
+		for (d = found; ops && d > 0; d--)
+		{
+			long	*pv = trace[d - 1] + (d - 1);   // pv[k] が V[k]
+			long	k = x - y;
+			long	pk = (k == -d || (k != d && pv[k - 1] < pv[k + 1])) ? k + 1 : k - 1;
+			long	px = pv[pk];
+			long	py = px - pk;
+
+			while (x > px && y > py)
+			{
+				ops[nops++] = ' ';
+				x--;
+				y--;
+			}
+			ops[nops++] = (pk == k + 1) ? '+' : '-';
+			x = px;
+			y = py;
+		}
+		while (ops && x > 0 && y > 0)
+		{
+			ops[nops++] = ' ';
+			x--;
+			y--;
+		}
+		x = 0;
+		y = 0;
+		while (ops && nops-- > 0)
+		{
+			char o = ops[nops];
+
+			if (o == ' ')
+			{
+				put_line(' ', b, blo + (size_t)y, st);
+				x++;
+				y++;
+			}
+			else if (o == '-')
+				put_line('-', a, alo + (size_t)x++, st);
+			else
+				put_line('+', b, blo + (size_t)y++, st);
+		}
+		free(ops);
+	}
+	for (long i = 0; trace && i <= dmax; i++)
+		free(trace[i]);
+	free(trace);
+	free(v);
+}
+
+int	diff_runs(const char *pa, const char *pb, const t_diff_opts *o)
+{
+	t_run	a;
+	t_run	b;
+	t_dstat	st = {0, 0, 0, o->brief};
+	size_t	pre = 0;
+	size_t	suf = 0;
+
+	if (run_load(&a, pa, o) != 0)
+		return 2;
+	if (run_load(&b, pb, o) != 0)
+	{
+		run_free(&a);
+		return 2;
+	}
+	if (!o->brief)
+		printf("--- %s\n+++ %s\n", pa, pb);
+	// 前後の同じ部分は差分にかけない
+	while (pre < a.n && pre < b.n && a.tok[pre] == b.tok[pre])
+		put_line(' ', &b, pre++, &st);
+	while (suf < a.n - pre && suf < b.n - pre && a.tok[a.n - 1 - suf] == b.tok[b.n - 1 - suf])
+		suf++;
+	myers(&a, pre, a.n - suf, &b, pre, b.n - suf, &st);
+	for (size_t i = b.n - suf; i < b.n; i++)
+		put_line(' ', &b, i, &st);
+	printf("# same %zu, only in %s %zu, only in %s %zu\n", st.same, pa, st.del, pb, st.add);
+	run_free(&a);
+	run_free(&b);
+	return (st.del || st.add) ? 1 : 0;
+}
@@ -0,0 +1,41 @@
+#ifndef QUERY_H
+#define QUERY_H
+
+#include <stdint.h>
+
+/*
+ * tracetool.ttc（tcol.h）を引く
+ *
+ * query: syscall / PID / fd の種類 / 時刻の範囲で絞って、1 行ずつ（--raw なら元の行を）出す。
+ *        セグメントのヘッダ（時刻・PID の範囲と syscall のビット表）で当たらないセグメントは読まない。
+ * diff:  2 つの run（例: bash と minishell）の syscall の並びを揃えて（Myers の差分）、
+ *        共通の行・片方にしか無い行を出す。PID は run ごとに出てきた順に p0, p1, ... と振り直し、
+ *        pipe/socket の inode は比べない。
+ */
+typedef struct s_query
+{
+	char *const	*sys;        // NULL なら全部
+	int			nsys;
+	long		pid;         // -1 なら全部
+	int			fdt;         // -1 なら全部
+	int64_t		from;        // INT64_MIN / INT64_MAX なら制限なし
+	int64_t		to;
+	int			errors;      // 失敗した呼び出しだけ
+	int			raw;         // 元の trace.* の行を出す
+	int			count;       // syscall ごとの回数・失敗数・合計時間だけ出す
+}	t_query;
+
+typedef struct s_diff_opts
+{
+	char *const	*sys;        // NULL なら骨格の syscall（execve/clone/pipe2/dup2/openat/close/wait4 など）
+	int			nsys;
+	int			all;         // syscall で絞らない
+	int			keep_noise;  // loader/lib/locale の行も比べる
+	int			brief;       // 件数だけ
+}	t_diff_opts;
+
+int	query_run(const char *path, const t_query *q);
+// 同じなら 0、違いがあれば 1、エラーは 2（diff(1) と同じ）
+int	diff_runs(const char *a, const char *b, const t_diff_opts *o);
+
+#endif
@@ -0,0 +1,605 @@
+#define _GNU_SOURCE
+#include "sched.h"
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LAT_NB      28       // runq 待ちのヒストグラム。0: <1us、b: [2^(b-1), 2^b) us
+#define WHY_MAX     32
+#define PATH_SHOW   200      // [critical] に並べる区間の数の上限
+
+typedef enum e_kind
+{
+	K_NONE = 0,
+	K_CPU,
+	K_RUNQ,
+	K_BLOCK,
+	K_DEAD
+}	t_kind;
+
+typedef struct s_ev
+{
+	uint64_t	ns;
+	size_t		seq;             // ファイルでの順番（同じ時刻の並びを保つ）
+	char		type;
+	int			a;
+	int			b;
+	long		c;
+	char		why[WHY_MAX];    // C: comm、S: 待ちの理由
+}	t_ev;
+
+typedef struct s_seg
+{
+	uint64_t	t0;
+	uint64_t	t1;
+	t_kind		kind;
+	int			why;      // g_why の番号（K_BLOCK のとき）
+	int			waker;    // 起こした tid（K_BLOCK のとき。0 = 不明）
+}	t_seg;
+
+typedef struct s_pwhy
+{
+	int			why;
+	uint64_t	n;
+	uint64_t	total;
+	uint64_t	max;
+}	t_pwhy;
+
+typedef struct s_proc
+{
+	int			tid;
+	int			parent;
+	char		comm[WHY_MAX];
+	uint64_t	fork_ns;
+	uint64_t	exit_ns;
+	t_kind		st;
+	uint64_t	since;
+	int			why;
+	uint64_t	cpu_ns;
+	uint64_t	runq_ns;
+	uint64_t	runq_n;
+	uint64_t	runq_max;
+	uint64_t	runq_hist[LAT_NB];
+	uint64_t	blocked_ns;
+	t_seg		*seg;
+	size_t		nseg;
+	size_t		segcap;
+	t_pwhy		*pw;
+	size_t		npw;
+}	t_proc;
+
+typedef struct s_sched
+{
+	t_proc		*p;
+	size_t		n;
+	size_t		cap;
+	char		(*why)[WHY_MAX];
+	size_t		nwhy;
+	int			root;
+	uint64_t	first_ns;
+	uint64_t	last_ns;
+	int			err;
+}	t_sched;
+
+/* --- 読み込み --- */
+
+static int	cmp_ev(const void *x, const void *y)
+{
+	const t_ev *a = x;
+	const t_ev *b = y;
+
+	if (a->ns != b->ns)
+		return (a->ns < b->ns) ? -1 : 1;
+	return (a->seq < b->seq) ? -1 : (a->seq > b->seq);
+}
+
+// "kfn|syscall" を読みやすい理由にする
+static void	why_label(const char *s, char *out, size_t n)
+{
+	static const char *kfn[][2] = {
+		{"pipe_read", "pipe read"}, {"pipe_write", "pipe write"},
+		{"inet_csk_accept", "socket accept"}, {"do_wait", "waitpid"},
+	};
+	const char *bar = strchr(s, '|');
+	const char *sys = bar ? bar + 1 : "";
+	const char *p;
+
+	for (size_t i = 0; i < sizeof(kfn) / sizeof(kfn[0]); i++)
+		if (bar && (size_t)(bar - s) == strlen(kfn[i][0]) && strncmp(s, kfn[i][0], (size_t)(bar - s)) == 0)
+		{
+			snprintf(out, n, "%s", kfn[i][1]);
+			return;
+		}
+	if ((p = strstr(sys, "sys_enter_")) != NULL)
+		sys = p + 10;
+	snprintf(out, n, "%s", *sys ? sys : "other");
+}
+
+static int	load_events(const char *path, t_ev **out, size_t *nout)
+{
+	FILE	*fp = fopen(path, "r");
+	char	*line = NULL;
+	size_t	lcap = 0;
+	t_ev	*ev = NULL;
+	size_t	n = 0;
+	size_t	cap = 0;
+
+	if (!fp)
+		return -1;
+	while (getline(&line, &lcap, fp) > 0)
+	{
+		t_ev		e = {0};
+		char		rest[WHY_MAX * 4] = "";
+		unsigned long long ns;
+		int			k;
+
+		if (line[0] == '\0' || line[1] != ' ' || !strchr("TFCXWRS", line[0]))
+			continue;
+		e.type = line[0];
+		k = sscanf(line + 2, "%llu %d %d", &ns, &e.a, &e.b);
+		if (k < 2)
+			continue;
+		e.ns = ns;
+		if (e.type == 'C' && sscanf(line + 2, "%*u %*d %127[^\n]", rest) == 1)
+			snprintf(e.why, sizeof(e.why), "%s", rest);
+		else if (e.type == 'S')
+		{
+			if (sscanf(line + 2, "%*u %*d %ld %127[^\n]", &e.c, rest) < 1)
+				continue;
+			why_label(rest, e.why, sizeof(e.why));
+		}
+		else if ((e.type == 'F' || e.type == 'W') && k < 3)
+			continue;
+		if (n == cap)
+		{
+			size_t	ncap = cap ? cap * 2 : 4096;
+			t_ev	*ne = realloc(ev, ncap * sizeof(t_ev));
+			if (!ne)
+				break;
+			ev = ne;
+			cap = ncap;
+		}
+		e.seq = n;
+		ev[n++] = e;
+	}
+	free(line);
+	fclose(fp);
+	qsort(ev, n, sizeof(t_ev), cmp_ev);
+	*out = ev;
+	*nout = n;
+	return 0;
+}
+
+/* --- プロセスごとの状態 --- */
+
+static t_proc	*proc_get(t_sched *s, int tid)
+{
+	for (size_t i = 0; i < s->n; i++)
+		if (s->p[i].tid == tid)
+			return &s->p[i];
+	if (s->n == s->cap)
+	{
+		size_t	ncap = s->cap ? s->cap * 2 : 64;
+		t_proc	*np = realloc(s->p, ncap * sizeof(t_proc));
+		if (!np)
+		{
+			s->err = 1;
+			return NULL;
+		}
+		s->p = np;
+		s->cap = ncap;
+	}
+	s->p[s->n] = (t_proc){.tid = tid, .comm = "?"};
+	return &s->p[s->n++];
+}
+
+static t_proc	*proc_find(const t_sched *s, int tid)
+{
+	for (size_t i = 0; i < s->n; i++)
+		if (s->p[i].tid == tid)
+			return &s->p[i];
+	return NULL;
+}
+
+static int	why_id(t_sched *s, const char *w)
+{
+	for (size_t i = 0; i < s->nwhy; i++)
+		if (strcmp(s->why[i], w) == 0)
+			return (int)i;
+	char (*nw)[WHY_MAX] = realloc(s->why, (s->nwhy + 1) * sizeof(*nw));
+	if (!nw)
+	{
+		s->err = 1;
+		return 0;
+	}
+	s->why = nw;
+	snprintf(s->why[s->nwhy], WHY_MAX, "%s", w);
+	return (int)s->nwhy++;
+}
+
+static int	lat_bucket(uint64_t us)
+{
+	int b;
+
+	if (us == 0)
+		return 0;
+	b = 64 - __builtin_clzll(us);
+	return (b < LAT_NB) ? b : LAT_NB - 1;
+}
+
+// いまの状態を ns で閉じて区間にする
+static void	seg_close(t_sched *s, t_proc *p, uint64_t ns, int waker)
+{
+	uint64_t d;
+
+	if (p->st == K_NONE || p->st == K_DEAD || ns < p->since)
+		return;
+	d = ns - p->since;
+	if (p->nseg == p->segcap)
+	{
+		size_t	ncap = p->segcap ? p->segcap * 2 : 64;
+		t_seg	*ns2 = realloc(p->seg, ncap * sizeof(t_seg));
+		if (!ns2)
+		{
+			s->err = 1;
+			return;
+		}
+		p->seg = ns2;
+		p->segcap = ncap;
+	}
+	p->seg[p->nseg++] = (t_seg){p->since, ns, p->st, p->why, waker};
+	if (p->st == K_CPU)
+		p->cpu_ns += d;
+	else if (p->st == K_RUNQ)
+	{
+		p->runq_ns += d;
+		p->runq_n++;
+		if (d > p->runq_max)
+			p->runq_max = d;
+		p->runq_hist[lat_bucket(d / 1000)]++;
+	}
+	else if (p->st == K_BLOCK)
+	{
+		size_t i;
+
+		p->blocked_ns += d;
+		for (i = 0; i < p->npw && p->pw[i].why != p->why; i++)
+			;
+		if (i == p->npw)
+		{
+			t_pwhy *npw = realloc(p->pw, (p->npw + 1) * sizeof(t_pwhy));
+			if (!npw)
+			{
+				s->err = 1;
+				return;
+			}
+			p->pw = npw;
+			p->pw[p->npw++] = (t_pwhy){p->why, 0, 0, 0};
+		}
+		p->pw[i].n++;
+		p->pw[i].total += d;
+		if (d > p->pw[i].max)
+			p->pw[i].max = d;
+	}
+}
+
+static void	apply(t_sched *s, const t_ev *e)
+{
+	t_proc *p;
+
+	if (e->type == 'T')
+	{
+		s->root = e->a;
+		proc_get(s, e->a);
+		return;
+	}
+	if ((p = proc_get(s, e->a)) == NULL)
+		return;
+	switch (e->type)
+	{
+	case 'F':
+	{
+		t_proc *c = proc_get(s, e->b);
+		p = proc_find(s, e->a);   // proc_get で配列が動いたかもしれない
+		if (c && p)
+		{
+			c->parent = p->tid;
+			c->fork_ns = e->ns;
+			memcpy(c->comm, p->comm, sizeof(c->comm));
+		}
+		break;
+	}
+	case 'C':
+		snprintf(p->comm, sizeof(p->comm), "%s", e->why);
+		break;
+	case 'W':
+		if (p->st == K_BLOCK)
+			seg_close(s, p, e->ns, e->b);
+		if (p->st == K_BLOCK || p->st == K_NONE)
+		{
+			p->st = K_RUNQ;
+			p->since = e->ns;
+		}
+		break;
+	case 'R':
+		if (p->st == K_DEAD)
+			break;
+		seg_close(s, p, e->ns, 0);
+		p->st = K_CPU;
+		p->since = e->ns;
+		break;
+	case 'S':
+		if (p->st == K_DEAD)
+			break;
+		seg_close(s, p, e->ns, 0);
+		// 5.18 以降のカーネルはプリエンプトを TASK_REPORT_MAX (0x100) で出す
+		p->st = (e->c == 0 || (e->c & 0x100)) ? K_RUNQ : K_BLOCK;
+		p->why = (p->st == K_RUNQ) ? 0 : why_id(s, e->why);
+		p->since = e->ns;
+		break;
+	case 'X':
+		seg_close(s, p, e->ns, 0);
+		p->st = K_DEAD;
+		p->exit_ns = e->ns;
+		break;
+	}
+}
+
+/* --- クリティカルパス --- */
+
+typedef struct s_crit
+{
+	int			tid;
+	char		label[WHY_MAX + 16];
+	uint64_t	ns;
+	uint64_t	t0;      // path のときだけ
+}	t_crit;
+
+typedef struct s_critv
+{
+	t_crit	*v;
+	size_t	n;
+	size_t	cap;
+}	t_critv;
+
+static void	crit_add(t_critv *cv, int tid, const char *label, uint64_t t0, uint64_t ns, int merge_any)
+{
+	if (ns == 0)
+		return;
+	for (size_t i = merge_any ? 0 : (cv->n ? cv->n - 1 : 0); i < cv->n; i++)
+		if (cv->v[i].tid == tid && strcmp(cv->v[i].label, label) == 0)
+		{
+			cv->v[i].ns += ns;
+			cv->v[i].t0 = t0;
+			return;
+		}
+	if (cv->n == cv->cap)
+	{
+		size_t	ncap = cv->cap ? cv->cap * 2 : 64;
+		t_crit	*nv = realloc(cv->v, ncap * sizeof(t_crit));
+		if (!nv)
+			return;
+		cv->v = nv;
+		cv->cap = ncap;
+	}
+	cv->v[cv->n] = (t_crit){tid, "", ns, t0};
+	snprintf(cv->v[cv->n].label, sizeof(cv->v[cv->n].label), "%s", label);
+	cv->n++;
+}
+
+// p の中で t より前に始まった最後の区間
+static const t_seg	*seg_before(const t_proc *p, uint64_t t)
+{
+	size_t lo = 0;
+	size_t hi = p->nseg;
+
+	while (lo < hi)
+	{
+		size_t mid = (lo + hi) / 2;
+		if (p->seg[mid].t0 < t)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo ? &p->seg[lo - 1] : NULL;
+}
+
+/*
+ * ルートの終わりから時間を逆にたどる。CPU / runq の区間はそのプロセスの分として数え、
+ * 待ちの区間は起こした側（waker）が木の中にいればそちらへ飛ぶ（待っていた時間は waker が進めていた）。
+ * 木の外から起こされた待ち（端末の入力、クライアントの接続など）はそのプロセスの blocked として数える。
+ */
+static void	critical_path(const t_sched *s, t_critv *tot, t_critv *path, uint64_t *start, uint64_t *end)
+{
+	const t_proc	*cur = proc_find(s, s->root);
+	uint64_t		t;
+	uint64_t		last_jump = UINT64_MAX;
+	char			label[WHY_MAX + 16];
+
+	*start = *end = 0;
+	if (!cur || cur->nseg == 0)
+		return;
+	*start = cur->seg[0].t0;
+	*end = t = cur->exit_ns ? cur->exit_ns : cur->seg[cur->nseg - 1].t1;
+	for (size_t steps = 0; t > *start && steps < 10000000; steps++)
+	{
+		const t_seg *g = seg_before(cur, t);
+
+		if (!g)
+		{
+			// このプロセスが生まれる前: fork した親へ戻る
+			const t_proc *par = cur->parent ? proc_find(s, cur->parent) : NULL;
+			if (!par || cur->tid == s->root)
+				break;
+			if (cur->fork_ns && cur->fork_ns < t)
+				t = cur->fork_ns;
+			cur = par;
+			continue;
+		}
+		if (g->t1 < t)
+		{
+			// 最後の区間のあと（exit の後始末で親を起こした、など）
+			const char *gap = (g->t1 == cur->exit_ns) ? "exit" : "untracked";
+			crit_add(tot, cur->tid, gap, g->t1, t - g->t1, 1);
+			crit_add(path, cur->tid, gap, g->t1, t - g->t1, 0);
+			t = g->t1;
+		}
+		if (g->kind == K_BLOCK && g->waker && g->waker != cur->tid && t != last_jump
+			&& proc_find(s, g->waker))
+		{
+			last_jump = t;
+			cur = proc_find(s, g->waker);
+			continue;
+		}
+		if (g->kind == K_CPU)
+			snprintf(label, sizeof(label), "cpu");
+		else if (g->kind == K_RUNQ)
+			snprintf(label, sizeof(label), "runq");
+		else
+			snprintf(label, sizeof(label), "blocked: %s", s->why[g->why]);
+		crit_add(tot, cur->tid, label, g->t0, t - g->t0, 1);
+		crit_add(path, cur->tid, label, g->t0, t - g->t0, 0);
+		t = g->t0;
+	}
+}
+
+/* --- 出力 --- */
+
+static uint64_t	hist_pct_us(const t_proc *p, int permille)
+{
+	uint64_t need = (p->runq_n * (uint64_t)permille + 999) / 1000;
+	uint64_t acc = 0;
+
+	for (int b = 0; b < LAT_NB && p->runq_n; b++)
+	{
+		acc += p->runq_hist[b];
+		if (acc >= need)
+		{
+			uint64_t up = (b == 0) ? 1 : (1ull << b);
+			return (up < p->runq_max / 1000) ? up : p->runq_max / 1000;
+		}
+	}
+	return p->runq_max / 1000;
+}
+
+static const char	*comm_of(const t_sched *s, int tid)
+{
+	const t_proc *p = proc_find(s, tid);
+
+	return p ? p->comm : "?";
+}
+
+static int	cmp_crit(const void *x, const void *y)
+{
+	const t_crit *a = x;
+	const t_crit *b = y;
+
+	return (a->ns < b->ns) - (a->ns > b->ns);
+}
+
+static void	write_summary(const t_sched *s, FILE *out)
+{
+	t_critv		tot = {0};
+	t_critv		path = {0};
+	uint64_t	start;
+	uint64_t	end;
+
+	fprintf(out, "[proc]\n");
+	fprintf(out, "%-8s %-16s %10s %8s %10s %8s %10s %12s\n",
+		"tid", "comm", "cpu_us", "runq_n", "runq_us", "p99_us", "max_us", "blocked_us");
+	for (size_t i = 0; i < s->n; i++)
+	{
+		const t_proc *p = &s->p[i];
+
+		fprintf(out, "%-8d %-16s %10llu %8llu %10llu %8llu %10llu %12llu\n", p->tid, p->comm,
+			(unsigned long long)(p->cpu_ns / 1000), (unsigned long long)p->runq_n,
+			(unsigned long long)(p->runq_ns / 1000), (unsigned long long)hist_pct_us(p, 990),
+			(unsigned long long)(p->runq_max / 1000), (unsigned long long)(p->blocked_ns / 1000));
+	}
+
+	fprintf(out, "\n[offcpu]\n");
+	fprintf(out, "%-8s %-16s %-20s %8s %12s %10s\n", "tid", "comm", "reason", "count", "total_us", "max_us");
+	for (size_t i = 0; i < s->n; i++)
+		for (size_t k = 0; k < s->p[i].npw; k++)
+		{
+			const t_pwhy *w = &s->p[i].pw[k];
+			fprintf(out, "%-8d %-16s %-20s %8llu %12llu %10llu\n", s->p[i].tid, s->p[i].comm,
+				s->why[w->why], (unsigned long long)w->n, (unsigned long long)(w->total / 1000),
+				(unsigned long long)(w->max / 1000));
+		}
+
+	critical_path(s, &tot, &path, &start, &end);
+	fprintf(out, "\n[critical]\n");
+	fprintf(out, "root %d %s, %llu us\n", s->root, comm_of(s, s->root),
+		(unsigned long long)((end - start) / 1000));
+	qsort(tot.v, tot.n, sizeof(t_crit), cmp_crit);
+	fprintf(out, "%-8s %-16s %-28s %10s %6s\n", "tid", "comm", "where", "us", "%");
+	for (size_t i = 0; i < tot.n; i++)
+		fprintf(out, "%-8d %-16s %-28s %10llu %5.1f%%\n", tot.v[i].tid, comm_of(s, tot.v[i].tid), tot.v[i].label,
+			(unsigned long long)(tot.v[i].ns / 1000), end > start ? 100.0 * (double)tot.v[i].ns / (double)(end - start) : 0.0);
+
+	// path は後ろから積んだので、逆順に出すと時間順になる
+	fprintf(out, "\n[path]\n");
+	fprintf(out, "%10s %-8s %-16s %-28s %10s\n", "at_us", "tid", "comm", "where", "us");
+	for (size_t i = path.n, shown = 0; i-- > 0 && shown < PATH_SHOW; shown++)
+		fprintf(out, "%10llu %-8d %-16s %-28s %10llu\n", (unsigned long long)((path.v[i].t0 - start) / 1000),
+			path.v[i].tid, comm_of(s, path.v[i].tid), path.v[i].label, (unsigned long long)(path.v[i].ns / 1000));
+	if (path.n > PATH_SHOW)
+		fprintf(out, "... (%zu more)\n", path.n - PATH_SHOW);
+	free(tot.v);
+	free(path.v);
+}
+
+int	sched_summarize(const char *dir)
+{
+	char	path[PATH_MAX + 32];
+	t_sched	s = {0};
+	t_ev	*ev = NULL;
+	size_t	nev = 0;
+	char	*buf = NULL;
+	size_t	blen = 0;
+	FILE	*mem;
+	FILE	*fp;
+	int		rc = 0;
+
+	snprintf(path, sizeof(path), "%s/sched.txt", dir);
+	if (load_events(path, &ev, &nev) != 0)
+	{
+		fprintf(stderr, "tracetool: %s: cannot read\n", path);
+		return 1;
+	}
+	why_id(&s, "-");
+	for (size_t i = 0; i < nev && !s.err; i++)
+		apply(&s, &ev[i]);
+	if (s.root == 0 && nev > 0)
+		fprintf(stderr, "tracetool: %s: no root (T) line\n", path);
+
+	if (s.err || (mem = open_memstream(&buf, &blen)) == NULL)
+		rc = 1;
+	else
+	{
+		write_summary(&s, mem);
+		fclose(mem);
+		snprintf(path, sizeof(path), "%s/sched_summary.txt", dir);
+		if ((fp = fopen(path, "w")) == NULL || fwrite(buf, 1, blen, fp) != blen)
+			rc = 1;
+		if (fp && fclose(fp) != 0)
+			rc = 1;
+		fwrite(buf, 1, blen, stdout);
+	}
+	if (rc != 0)
+		fprintf(stderr, "tracetool: %s: failed\n", dir);
+	free(buf);
+	free(ev);
+	for (size_t i = 0; i < s.n; i++)
+	{
+		free(s.p[i].seg);
+		free(s.p[i].pw);
+	}
+	free(s.p);
+	free(s.why);
+	return rc;
+}
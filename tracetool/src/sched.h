@@ -0,0 +1,16 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+/*
+ * scripts/observe/bpftrace_sched.sh が書いた sched.txt のまとめ（sched_summary.txt）
+ *
+ * プロセス（tid）ごとに wakeup / switch のイベントから時間を CPU・実行待ち（runq）・待ち（blocked）に分け、
+ *   [proc]     プロセスごとの CPU 時間、runq 待ちの回数・合計・p99・最大、blocked の合計
+ *   [offcpu]   待ちの理由（パイプの read、accept、waitpid、syscall 名など）ごとの回数と時間
+ *   [critical] ルートの終わりから起こした側（waker）をたどって、パイプラインの各段の
+ *              どこに時間がかかったか（クリティカルパス）と、その区間を時間順に並べた [path]
+ * を書く。
+ */
+int	sched_summarize(const char *dir);
+
+#endif
@@ -0,0 +1,651 @@
+#define _GNU_SOURCE
+#include "tcol.h"
+#include "lz.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TCOL_MAGIC "TTCOL1\n"
+
+static const char	*g_fdt_names[FDT_N] = {"none", "pipe", "file", "socket", "anon", "other"};
+
+const char	*fdt_name(int fdt)
+{
+	return (fdt >= 0 && fdt < FDT_N) ? g_fdt_names[fdt] : "?";
+}
+
+int	fdt_parse(const char *s)
+{
+	for (int i = 0; i < FDT_N; i++)
+		if (strcmp(s, g_fdt_names[i]) == 0)
+			return i;
+	return -1;
+}
+
+static uint64_t	parse_uint(const char **pp, const char *end)
+{
+	const char	*p = *pp;
+	uint64_t	v = 0;
+
+	while (p < end && *p >= '0' && *p <= '9')
+		v = v * 10 + (uint64_t)(*p++ - '0');
+	*pp = p;
+	return v;
+}
+
+int64_t	ts_parse(const char *p, const char *end, const char **stop, int *epoch)
+{
+	uint64_t	v = parse_uint(&p, end);
+	uint64_t	us = 0;
+	int			nd = 0;
+
+	*epoch = 0;
+	if (p < end && *p == ':')
+	{
+		p++;
+		v = v * 60 + parse_uint(&p, end);
+		if (p < end && *p == ':')
+		{
+			p++;
+			v = v * 60 + parse_uint(&p, end);
+		}
+	}
+	else
+		*epoch = 1;
+	if (p < end && *p == '.')
+		for (p++; p < end && *p >= '0' && *p <= '9'; p++)
+			if (nd < 6)
+			{
+				us = us * 10 + (uint64_t)(*p - '0');
+				nd++;
+			}
+	while (nd++ < 6)
+		us *= 10;
+	if (stop)
+		*stop = p;
+	return (int64_t)(v * 1000000 + us);
+}
+
+void	ts_format(char *buf, size_t n, int64_t ts, int epoch)
+{
+	long long sec = (long long)(ts / 1000000);
+
+	if (epoch)
+		snprintf(buf, n, "%lld.%06lld", sec, (long long)(ts % 1000000));
+	else
+		snprintf(buf, n, "%02lld:%02lld:%02lld.%06lld",
+			sec / 3600, sec / 60 % 60, sec % 60, (long long)(ts % 1000000));
+}
+
+static uint64_t	zz(int64_t v)
+{
+	return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t	unzz(uint64_t v)
+{
+	return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+/* --- 辞書 --- */
+
+static uint64_t	hash_str(const char *s, size_t n)
+{
+	uint64_t h = 1469598103934665603ull;
+
+	for (size_t i = 0; i < n; i++)
+		h = (h ^ (unsigned char)s[i]) * 1099511628211ull;
+	return h;
+}
+
+static int	dict_rehash(t_dict *d, size_t tcap)
+{
+	uint32_t *t = calloc(tcap, sizeof(uint32_t));
+
+	if (!t)
+		return -1;
+	for (size_t i = 0; i < d->n; i++)
+	{
+		uint64_t h = hash_str(d->s[i], strlen(d->s[i]));
+		while (t[h & (tcap - 1)])
+			h++;
+		t[h & (tcap - 1)] = (uint32_t)i + 1;
+	}
+	free(d->tab);
+	d->tab = t;
+	d->tcap = tcap;
+	return 0;
+}
+
+int	dict_init(t_dict *d)
+{
+	*d = (t_dict){0};
+	return (dict_intern(d, "", 0) == 0) ? 0 : -1;
+}
+
+uint32_t	dict_intern(t_dict *d, const char *s, size_t n)
+{
+	uint64_t	h;
+	uint32_t	id;
+
+	if ((d->n + 1) * 2 > d->tcap && dict_rehash(d, d->tcap ? d->tcap * 2 : 256) != 0)
+		return UINT32_MAX;
+	for (h = hash_str(s, n); (id = d->tab[h & (d->tcap - 1)]) != 0; h++)
+		if (strncmp(d->s[id - 1], s, n) == 0 && d->s[id - 1][n] == '\0')
+			return id - 1;
+	if (d->n == d->cap)
+	{
+		size_t	ncap = d->cap ? d->cap * 2 : 256;
+		char	**ns = realloc(d->s, ncap * sizeof(char *));
+		if (!ns)
+			return UINT32_MAX;
+		d->s = ns;
+		d->cap = ncap;
+	}
+	if ((d->s[d->n] = strndup(s, n)) == NULL)
+		return UINT32_MAX;
+	d->tab[h & (d->tcap - 1)] = (uint32_t)d->n + 1;
+	return (uint32_t)d->n++;
+}
+
+void	dict_free(t_dict *d)
+{
+	for (size_t i = 0; i < d->n; i++)
+		free(d->s[i]);
+	free(d->s);
+	free(d->tab);
+	*d = (t_dict){0};
+}
+
+/* --- 書く側 --- */
+
+typedef struct s_bytes
+{
+	uint8_t	*p;
+	size_t	len;
+	size_t	cap;
+}	t_bytes;
+
+static int	put_varint(t_bytes *b, uint64_t v)
+{
+	if (b->len + 10 > b->cap)
+	{
+		size_t	ncap = b->cap ? b->cap * 2 : 4096;
+		uint8_t	*np = realloc(b->p, ncap);
+		if (!np)
+			return -1;
+		b->p = np;
+		b->cap = ncap;
+	}
+	while (v >= 0x80)
+	{
+		b->p[b->len++] = (uint8_t)(v | 0x80);
+		v >>= 7;
+	}
+	b->p[b->len++] = (uint8_t)v;
+	return 0;
+}
+
+static void	w_bytes(t_tcolw *w, const void *p, size_t n)
+{
+	if (n && fwrite(p, 1, n, w->fp) != n)
+		w->err = 1;
+	w->pos += n;
+}
+
+static void	w_varint(t_tcolw *w, uint64_t v)
+{
+	uint8_t	b[10];
+	size_t	n = 0;
+
+	while (v >= 0x80)
+	{
+		b[n++] = (uint8_t)(v | 0x80);
+		v >>= 7;
+	}
+	b[n++] = (uint8_t)v;
+	w_bytes(w, b, n);
+}
+
+static void	w_str(t_tcolw *w, const char *s)
+{
+	size_t n = strlen(s);
+
+	w_varint(w, n);
+	w_bytes(w, s, n);
+}
+
+int	tcolw_open(t_tcolw *w, const char *path)
+{
+	*w = (t_tcolw){0};
+	w->path = strdup(path);
+	w->buf = malloc(SEG_RECS * sizeof(t_rec));
+	if (w->path && asprintf(&w->tmp, "%s.tmp", path) < 0)
+		w->tmp = NULL;
+	if (!w->path || !w->tmp || !w->buf || dict_init(&w->names) != 0 || dict_init(&w->paths) != 0
+		|| (w->fp = fopen(w->tmp, "w")) == NULL)
+	{
+		tcolw_abort(w);
+		return -1;
+	}
+	setvbuf(w->fp, NULL, _IOFBF, 1 << 20);
+	w_bytes(w, TCOL_MAGIC, strlen(TCOL_MAGIC));
+	return 0;
+}
+
+// 今のセグメント（w->buf）を列に分けて書く
+static int	seg_flush(t_tcolw *w)
+{
+	t_bytes		col[COL_N] = {{0}};
+	uint8_t		*sysmap;
+	size_t		nmap = (w->names.n + 7) / 8;
+	uint64_t	*last_off;
+	size_t		nfile = 1;
+	int64_t		ts_min = INT64_MAX;
+	int64_t		ts_max = INT64_MIN;
+	uint32_t	pid_min = UINT32_MAX;
+	uint32_t	pid_max = 0;
+	int64_t		pts = 0;
+	int64_t		ppid = 0;
+	int			rc = 0;
+
+	if (w->nbuf == 0)
+		return 0;
+	for (size_t i = 0; i < w->nbuf; i++)
+		if (w->buf[i].file + 1 > nfile)
+			nfile = w->buf[i].file + 1;
+	sysmap = calloc(nmap ? nmap : 1, 1);
+	last_off = calloc(nfile, sizeof(uint64_t));
+	if (!sysmap || !last_off)
+		rc = -1;
+	for (size_t i = 0; i < w->nbuf && rc == 0; i++)
+	{
+		const t_rec *r = &w->buf[i];
+
+		if (r->ts < ts_min)
+			ts_min = r->ts;
+		if (r->ts > ts_max)
+			ts_max = r->ts;
+		if (r->pid < pid_min)
+			pid_min = r->pid;
+		if (r->pid > pid_max)
+			pid_max = r->pid;
+		sysmap[r->sys >> 3] |= (uint8_t)(1 << (r->sys & 7));
+		rc |= put_varint(&col[COL_TS], zz(r->ts - pts));
+		rc |= put_varint(&col[COL_PID], zz((int64_t)r->pid - ppid));
+		rc |= put_varint(&col[COL_SYS], r->sys);
+		rc |= put_varint(&col[COL_FD], ((uint64_t)(r->fd + 1) << 3) | r->fdt);
+		rc |= put_varint(&col[COL_PATH], r->path);
+		rc |= put_varint(&col[COL_RET], zz(r->ret));
+		rc |= put_varint(&col[COL_ERR], ((uint64_t)r->err << 4) | r->flags);
+		rc |= put_varint(&col[COL_DUR], r->dur);
+		rc |= put_varint(&col[COL_SRC], r->file);
+		rc |= put_varint(&col[COL_SRC], r->off - last_off[r->file]);
+		pts = r->ts;
+		ppid = r->pid;
+		last_off[r->file] = r->off;
+	}
+
+	if (rc == 0)
+	{
+		uint8_t	*z[COL_N] = {0};
+		size_t	zn[COL_N] = {0};
+
+		for (int k = 0; k < COL_N; k++)
+			if ((z[k] = malloc(col[k].len ? col[k].len : 1)) != NULL)
+				zn[k] = lz_compress(col[k].p, col[k].len, z[k]);
+		if (w->nseg == w->seg_cap)
+		{
+			size_t		ncap = w->seg_cap ? w->seg_cap * 2 : 64;
+			uint64_t	*ns = realloc(w->seg_off, ncap * sizeof(uint64_t));
+			if (ns)
+			{
+				w->seg_off = ns;
+				w->seg_cap = ncap;
+			}
+		}
+		if (w->nseg < w->seg_cap)
+		{
+			w->seg_off[w->nseg++] = w->pos;
+			w_varint(w, w->nbuf);
+			w_varint(w, zz(ts_min));
+			w_varint(w, zz(ts_max));
+			w_varint(w, pid_min);
+			w_varint(w, pid_max);
+			w_varint(w, nmap);
+			w_bytes(w, sysmap, nmap);
+			for (int k = 0; k < COL_N; k++)
+			{
+				w_varint(w, col[k].len);
+				w_varint(w, zn[k] ? (zn[k] << 1 | 1) : (col[k].len << 1));
+			}
+			for (int k = 0; k < COL_N; k++)
+				w_bytes(w, zn[k] ? z[k] : col[k].p, zn[k] ? zn[k] : col[k].len);
+		}
+		else
+			rc = -1;
+		for (int k = 0; k < COL_N; k++)
+			free(z[k]);
+	}
+	for (int k = 0; k < COL_N; k++)
+		free(col[k].p);
+	free(sysmap);
+	free(last_off);
+	w->nbuf = 0;
+	if (rc != 0)
+		w->err = 1;
+	return rc;
+}
+
+int	tcolw_add(t_tcolw *w, const t_rec *r)
+{
+	w->buf[w->nbuf++] = *r;
+	if (w->nbuf == SEG_RECS)
+		return seg_flush(w);
+	return 0;
+}
+
+int	tcolw_close(t_tcolw *w, int flags, const t_tsrc *src, size_t nsrc)
+{
+	uint64_t	trailer;
+	uint8_t		le[8];
+	int			rc;
+
+	seg_flush(w);
+	trailer = w->pos;
+	w_varint(w, (uint64_t)flags);
+	w_varint(w, w->names.n);
+	for (size_t i = 0; i < w->names.n; i++)
+		w_str(w, w->names.s[i]);
+	w_varint(w, w->paths.n);
+	for (size_t i = 0; i < w->paths.n; i++)
+		w_str(w, w->paths.s[i]);
+	w_varint(w, nsrc);
+	for (size_t i = 0; i < nsrc; i++)
+	{
+		w_str(w, src[i].name);
+		w_varint(w, src[i].size);
+		w_varint(w, (uint64_t)src[i].mtime);
+	}
+	w_varint(w, w->nseg);
+	for (size_t i = 0; i < w->nseg; i++)
+		w_varint(w, w->seg_off[i] - (i ? w->seg_off[i - 1] : 0));
+	for (int i = 0; i < 8; i++)
+		le[i] = (uint8_t)(trailer >> (8 * i));
+	w_bytes(w, le, 8);
+
+	rc = (fclose(w->fp) != 0 || w->err) ? -1 : 0;
+	w->fp = NULL;
+	if (rc == 0 && rename(w->tmp, w->path) != 0)
+		rc = -1;
+	tcolw_abort(w);
+	return rc;
+}
+
+void	tcolw_abort(t_tcolw *w)
+{
+	if (w->fp)
+		fclose(w->fp);
+	if (w->tmp)
+		unlink(w->tmp);
+	free(w->path);
+	free(w->tmp);
+	free(w->buf);
+	free(w->seg_off);
+	dict_free(&w->names);
+	dict_free(&w->paths);
+	*w = (t_tcolw){0};
+}
+
+/* --- 読む側 --- */
+
+typedef struct s_rd
+{
+	const uint8_t	*p;
+	const uint8_t	*end;
+	int				bad;
+}	t_rd;
+
+static uint64_t	get_varint(t_rd *r)
+{
+	uint64_t v = 0;
+
+	for (int sh = 0; sh < 64; sh += 7)
+	{
+		if (r->p >= r->end)
+			break;
+		uint8_t b = *r->p++;
+		v |= (uint64_t)(b & 0x7f) << sh;
+		if (!(b & 0x80))
+			return v;
+	}
+	r->bad = 1;
+	return 0;
+}
+
+static char	**get_strs(t_rd *r, size_t *n)
+{
+	char	**v;
+
+	*n = get_varint(r);
+	if (r->bad || *n > (size_t)(r->end - r->p) || (v = calloc(*n ? *n : 1, sizeof(char *))) == NULL)
+		return NULL;
+	for (size_t i = 0; i < *n; i++)
+	{
+		size_t k = get_varint(r);
+		if (r->bad || k > (size_t)(r->end - r->p) || (v[i] = strndup((const char *)r->p, k)) == NULL)
+		{
+			*n = i;
+			r->bad = 1;
+			return v;
+		}
+		r->p += k;
+	}
+	return v;
+}
+
+int	tcol_open(const char *path, t_tcol *c)
+{
+	char		buf[PATH_MAX + 32];
+	struct stat	sb;
+	int			fd;
+	uint64_t	tr = 0;
+	t_rd		r;
+
+	*c = (t_tcol){0};
+	if (stat(path, &sb) == 0 && S_ISDIR(sb.st_mode))
+	{
+		snprintf(buf, sizeof(buf), "%s/%s", path, TCOL_NAME);
+		path = buf;
+	}
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+		return -1;
+	if (fstat(fd, &sb) != 0 || sb.st_size < (off_t)strlen(TCOL_MAGIC) + 8)
+	{
+		close(fd);
+		return -1;
+	}
+	c->len = (size_t)sb.st_size;
+	c->base = mmap(NULL, c->len, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (c->base == MAP_FAILED)
+	{
+		*c = (t_tcol){0};
+		return -1;
+	}
+	for (int i = 0; i < 8; i++)
+		tr |= (uint64_t)c->base[c->len - 8 + i] << (8 * i);
+	if (memcmp(c->base, TCOL_MAGIC, strlen(TCOL_MAGIC)) != 0 || tr >= c->len - 8)
+	{
+		tcol_close(c);
+		return -1;
+	}
+
+	r = (t_rd){c->base + tr, c->base + c->len - 8, 0};
+	c->flags = (int)get_varint(&r);
+	c->names = get_strs(&r, &c->nnames);
+	c->paths = get_strs(&r, &c->npaths);
+	c->nsrc = get_varint(&r);
+	if (!r.bad && c->nsrc <= (size_t)(r.end - r.p) && (c->src = calloc(c->nsrc ? c->nsrc : 1, sizeof(t_tsrc))))
+		for (size_t i = 0; i < c->nsrc && !r.bad; i++)
+		{
+			size_t k = get_varint(&r);
+			if (r.bad || k > (size_t)(r.end - r.p) || (c->src[i].name = strndup((const char *)r.p, k)) == NULL)
+			{
+				r.bad = 1;
+				break;
+			}
+			r.p += k;
+			c->src[i].size = get_varint(&r);
+			c->src[i].mtime = (int64_t)get_varint(&r);
+		}
+	else
+		r.bad = 1;
+	c->nseg = get_varint(&r);
+	if (!r.bad && c->nseg <= (size_t)(r.end - r.p) && (c->seg_off = calloc(c->nseg ? c->nseg : 1, sizeof(uint64_t))))
+		for (size_t i = 0; i < c->nseg; i++)
+			c->seg_off[i] = (i ? c->seg_off[i - 1] : 0) + get_varint(&r);
+	else
+		r.bad = 1;
+	if (r.bad || !c->names || !c->paths || c->nnames == 0 || c->npaths == 0)
+	{
+		tcol_close(c);
+		return -1;
+	}
+	return 0;
+}
+
+static void	free_strs(char **v, size_t n)
+{
+	for (size_t i = 0; v && i < n; i++)
+		free(v[i]);
+	free(v);
+}
+
+void	tcol_close(t_tcol *c)
+{
+	if (c->base && c->base != MAP_FAILED)
+		munmap((void *)c->base, c->len);
+	free_strs(c->names, c->nnames);
+	free_strs(c->paths, c->npaths);
+	for (size_t i = 0; c->src && i < c->nsrc; i++)
+		free(c->src[i].name);
+	free(c->src);
+	free(c->seg_off);
+	*c = (t_tcol){0};
+}
+
+int	tcol_seg_head(const t_tcol *c, size_t i, t_tseg *h)
+{
+	t_rd r;
+
+	if (i >= c->nseg || c->seg_off[i] >= c->len)
+		return -1;
+	r = (t_rd){c->base + c->seg_off[i], c->base + c->len, 0};
+	h->nrec = get_varint(&r);
+	h->ts_min = unzz(get_varint(&r));
+	h->ts_max = unzz(get_varint(&r));
+	h->pid_min = (uint32_t)get_varint(&r);
+	h->pid_max = (uint32_t)get_varint(&r);
+	h->nmap = get_varint(&r);
+	if (r.bad || h->nmap > (size_t)(r.end - r.p) || h->nrec > SEG_RECS)
+		return -1;
+	h->sysmap = r.p;
+	r.p += h->nmap;
+	for (int k = 0; k < COL_N; k++)
+	{
+		uint64_t s;
+
+		h->raw_len[k] = get_varint(&r);
+		s = get_varint(&r);
+		h->lz[k] = (int)(s & 1);
+		h->stored_len[k] = s >> 1;
+	}
+	for (int k = 0; k < COL_N; k++)
+	{
+		if (r.bad || h->stored_len[k] > (size_t)(r.end - r.p))
+			return -1;
+		h->col[k] = r.p;
+		r.p += h->stored_len[k];
+	}
+	return 0;
+}
+
+int	tcol_seg_has_sys(const t_tseg *h, uint32_t sys)
+{
+	return (sys >> 3) < h->nmap && (h->sysmap[sys >> 3] & (1 << (sys & 7)));
+}
+
+int	tcol_seg_read(const t_tcol *c, const t_tseg *h, t_rec *out)
+{
+	t_rd		r[COL_N] = {{0}};
+	uint8_t		*tmp[COL_N] = {0};
+	uint64_t	*last_off = calloc(c->nsrc ? c->nsrc : 1, sizeof(uint64_t));
+	int64_t		ts = 0;
+	int64_t		pid = 0;
+	int			rc = last_off ? 0 : -1;
+
+	for (int k = 0; k < COL_N && rc == 0; k++)
+	{
+		const uint8_t *p = h->col[k];
+
+		if (h->lz[k])
+		{
+			if ((tmp[k] = malloc(h->raw_len[k] ? h->raw_len[k] : 1)) == NULL
+				|| lz_decompress(h->col[k], h->stored_len[k], tmp[k], h->raw_len[k]) != 0)
+				rc = -1;
+			p = tmp[k];
+		}
+		r[k] = (t_rd){p, p + h->raw_len[k], 0};
+	}
+	for (size_t i = 0; i < h->nrec && rc == 0; i++)
+	{
+		t_rec		*o = &out[i];
+		uint64_t	fd;
+		uint64_t	err;
+
+		ts += unzz(get_varint(&r[COL_TS]));
+		pid += unzz(get_varint(&r[COL_PID]));
+		o->ts = ts;
+		o->pid = (uint32_t)pid;
+		o->sys = (uint32_t)get_varint(&r[COL_SYS]);
+		fd = get_varint(&r[COL_FD]);
+		o->fd = (int32_t)(fd >> 3) - 1;
+		o->fdt = (uint8_t)(fd & 7);
+		o->path = (uint32_t)get_varint(&r[COL_PATH]);
+		o->ret = unzz(get_varint(&r[COL_RET]));
+		err = get_varint(&r[COL_ERR]);
+		o->err = (uint32_t)(err >> 4);
+		o->flags = (uint8_t)(err & 15);
+		o->dur = (uint32_t)get_varint(&r[COL_DUR]);
+		o->file = (uint32_t)get_varint(&r[COL_SRC]);
+		if (o->file >= c->nsrc || o->sys >= c->nnames || o->err >= c->nnames || o->path >= c->npaths)
+		{
+			rc = -1;
+			break;
+		}
+		o->off = last_off[o->file] += get_varint(&r[COL_SRC]);
+	}
+	for (int k = 0; k < COL_N; k++)
+	{
+		if (r[k].bad)
+			rc = -1;
+		free(tmp[k]);
+	}
+	free(last_off);
+	return rc;
+}
+
+uint32_t	tcol_name_id(const t_tcol *c, const char *name)
+{
+	for (size_t i = 1; i < c->nnames; i++)
+		if (strcmp(c->names[i], name) == 0)
+			return (uint32_t)i;
+	return 0;
+}
@@ -0,0 +1,176 @@
+#ifndef TCOL_H
+#define TCOL_H
+
+#include "traceline.h"   // t_fdt（fd の種類。minishell と共通）
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * strace ログの列指向バイナリ形式（tracetool.ttc）
+ *
+ * 1 行 = 1 レコード。レコードは時刻順に SEG_RECS 件ずつのセグメントにまとめ、セグメントの中は列ごとに
+ * 別のブロックにする（同じ種類の値が並ぶので varint とデルタがよく効き、そのうえ lz.h で畳む）。
+ *
+ *   "TTCOL1\n"
+ *   segment * nseg
+ *   trailer
+ *   trailer の位置（8 バイト、little endian）
+ *
+ * segment（数値は varint、z は zigzag）:
+ *   nrec, ts_min(z), ts_max(z), pid_min, pid_max, nmap, sysmap[nmap]
+ *   { raw_len, stored_len << 1 | lz } * COL_N, 列のデータ * COL_N
+ *   sysmap は「このセグメントに出てくる syscall」のビット表。時刻・PID・syscall で絞るときは
+ *   ヘッダだけ見て飛ばせる。
+ *
+ * 列（セグメントごとに前の値は 0 から）:
+ *   COL_TS   時刻 us の差（z）。-tt は 0 時からの us、-ttt は epoch からの us
+ *   COL_PID  PID の差（z）
+ *   COL_SYS  syscall 名の辞書番号
+ *   COL_FD   (fd + 1) << 3 | fd の種類（fd が無ければ fd + 1 = 0）
+ *   COL_PATH パスの辞書番号（0 = なし）。-yy の注釈、無ければ '/' で始まる文字列引数
+ *   COL_RET  返り値（z）
+ *   COL_ERR  errno 名の辞書番号 << 4 | REC_* フラグ
+ *   COL_DUR  <秒> の us
+ *   COL_SRC  元のファイル番号、同じファイルの前の行からのバイト差（--raw で元の行を引く）
+ *
+ * trailer: flags, 名前の辞書（syscall と errno 名）, パスの辞書, 元ファイル { name, size, mtime },
+ *          セグメントの位置の一覧
+ */
+
+#define TCOL_NAME "tracetool.ttc"
+#define SEG_RECS  65536
+
+#define TCOL_EPOCH 1      // 時刻が -ttt（epoch 秒）
+
+#define REC_DUR        1   // <秒> がある
+#define REC_UNFINISHED 2   // "<unfinished ...>"（返り値は後の resumed の行にある）
+#define REC_RESUMED    4   // "<... name resumed>"
+#define REC_RET_UNK    8   // "= ?"
+
+enum
+{
+	COL_TS = 0,
+	COL_PID,
+	COL_SYS,
+	COL_FD,
+	COL_PATH,
+	COL_RET,
+	COL_ERR,
+	COL_DUR,
+	COL_SRC,
+	COL_N
+};
+
+typedef struct s_rec
+{
+	int64_t		ts;
+	int64_t		ret;
+	uint64_t	off;     // 元ファイルの中の行の先頭
+	uint32_t	pid;
+	uint32_t	sys;     // 名前の辞書番号
+	uint32_t	path;    // パスの辞書番号。0 = なし
+	uint32_t	err;     // 名前の辞書番号。0 = なし
+	uint32_t	dur;     // us
+	uint32_t	file;
+	int32_t		fd;      // -1 = なし
+	uint8_t		fdt;
+	uint8_t		flags;
+}	t_rec;
+
+typedef struct s_tsrc
+{
+	char		*name;
+	uint64_t	size;
+	int64_t		mtime;
+}	t_tsrc;
+
+// 辞書（番号 0 は空文字列 = なし）
+typedef struct s_dict
+{
+	char		**s;
+	size_t		n;
+	size_t		cap;
+	uint32_t	*tab;    // 番号 + 1 の open addressing 表（0 = 空き）
+	size_t		tcap;
+}	t_dict;
+
+const char	*fdt_name(int fdt);
+int			fdt_parse(const char *s);
+
+// "HH:MM:SS[.uuuuuu]"（-tt）なら 0 時からの us、"SSSS[.uuuuuu]"（-ttt、<秒>）なら us で *epoch = 1
+int64_t		ts_parse(const char *p, const char *end, const char **stop, int *epoch);
+void		ts_format(char *buf, size_t n, int64_t ts, int epoch);
+
+/* --- 書く側 --- */
+
+typedef struct s_tcolw
+{
+	FILE		*fp;
+	char		*path;
+	char		*tmp;
+	uint64_t	pos;
+	t_dict		names;
+	t_dict		paths;
+	uint64_t	*seg_off;
+	size_t		nseg;
+	size_t		seg_cap;
+	t_rec		*buf;    // 今のセグメントの分
+	size_t		nbuf;
+	int			err;
+}	t_tcolw;
+
+int			dict_init(t_dict *d);
+uint32_t	dict_intern(t_dict *d, const char *s, size_t n);   // 失敗したら UINT32_MAX
+void		dict_free(t_dict *d);
+
+int			tcolw_open(t_tcolw *w, const char *path);
+int			tcolw_add(t_tcolw *w, const t_rec *r);
+// 残りを書いて trailer を付け、path に rename する
+int			tcolw_close(t_tcolw *w, int flags, const t_tsrc *src, size_t nsrc);
+void		tcolw_abort(t_tcolw *w);
+
+/* --- 読む側 --- */
+
+typedef struct s_tcol
+{
+	const uint8_t	*base;
+	size_t			len;
+	int				flags;
+	char			**names;
+	size_t			nnames;
+	char			**paths;
+	size_t			npaths;
+	t_tsrc			*src;
+	size_t			nsrc;
+	uint64_t		*seg_off;
+	size_t			nseg;
+}	t_tcol;
+
+typedef struct s_tseg
+{
+	size_t			nrec;
+	int64_t			ts_min;
+	int64_t			ts_max;
+	uint32_t		pid_min;
+	uint32_t		pid_max;
+	const uint8_t	*sysmap;
+	size_t			nmap;
+	size_t			raw_len[COL_N];
+	size_t			stored_len[COL_N];
+	int				lz[COL_N];
+	const uint8_t	*col[COL_N];
+}	t_tseg;
+
+// path はファイルでもディレクトリ（中の tracetool.ttc）でもよい
+int			tcol_open(const char *path, t_tcol *c);
+void		tcol_close(t_tcol *c);
+int			tcol_seg_head(const t_tcol *c, size_t i, t_tseg *h);
+int			tcol_seg_has_sys(const t_tseg *h, uint32_t sys);
+// h の全レコードを out[h->nrec] に戻す
+int			tcol_seg_read(const t_tcol *c, const t_tseg *h, t_rec *out);
+// name の辞書番号。無ければ 0
+uint32_t	tcol_name_id(const t_tcol *c, const char *name);
+
+#endif
@@ -0,0 +1,96 @@
+#include "tfile.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static int	cmp_name(const void *a, const void *b)
+{
+	return strcmp(((const t_tfile *)a)->name, ((const t_tfile *)b)->name);
+}
+
+int	tfiles_open(const char *dir, t_tfiles *fs)
+{
+	DIR				*dp = opendir(dir);
+	struct dirent	*de;
+	size_t			cap = 0;
+
+	*fs = (t_tfiles){0};
+	if (!dp)
+		return -1;
+	while ((de = readdir(dp)) != NULL)
+	{
+		if (strncmp(de->d_name, "trace.", 6) != 0)
+			continue;
+		if (fs->n == cap)
+		{
+			size_t	ncap = cap ? cap * 2 : 64;
+			t_tfile	*nf = realloc(fs->f, ncap * sizeof(t_tfile));
+			if (!nf)
+				break;
+			fs->f = nf;
+			cap = ncap;
+		}
+
+		char		path[PATH_MAX + 300];
+		struct stat	sb;
+		snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+		int fd = open(path, O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+			continue;
+		if (fstat(fd, &sb) != 0 || !S_ISREG(sb.st_mode))
+		{
+			close(fd);
+			continue;
+		}
+		t_tfile *f = &fs->f[fs->n];
+		*f = (t_tfile){.name = strdup(de->d_name), .size = (uint64_t)sb.st_size, .mtime = sb.st_mtime};
+		if (sb.st_size > 0)
+		{
+			void *m = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (m != MAP_FAILED)
+			{
+				f->base = m;
+				f->len = (size_t)sb.st_size;
+				madvise(m, f->len, MADV_SEQUENTIAL);
+			}
+		}
+		close(fd);
+		if (!f->name)
+		{
+			if (f->len)
+				munmap((void *)f->base, f->len);
+			continue;
+		}
+		fs->n++;
+	}
+	closedir(dp);
+	qsort(fs->f, fs->n, sizeof(t_tfile), cmp_name);
+	return 0;
+}
+
+void	tfiles_unmap(t_tfiles *fs)
+{
+	for (size_t i = 0; i < fs->n; i++)
+		if (fs->f[i].len > 0)
+		{
+			munmap((void *)fs->f[i].base, fs->f[i].len);
+			fs->f[i].base = NULL;
+			fs->f[i].len = 0;
+		}
+}
+
+void	tfiles_free(t_tfiles *fs)
+{
+	tfiles_unmap(fs);
+	for (size_t i = 0; i < fs->n; i++)
+		free(fs->f[i].name);
+	free(fs->f);
+	*fs = (t_tfiles){0};
+}
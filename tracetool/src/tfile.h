@@ -0,0 +1,32 @@
+#ifndef TFILE_H
+#define TFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * run ディレクトリの trace.*（strace -ff の PID ごとのファイル、またはマージ済みの trace.txt）
+ *
+ * スクリプトの glob と同じく、通常ファイルだけを名前順（C ロケールの strcmp 順）に並べて mmap する。
+ * 空のファイルは base = NULL, len = 0。
+ */
+typedef struct s_tfile
+{
+	char		*name;    // ディレクトリからの相対名
+	const char	*base;
+	size_t		len;      // マップしている長さ（unmap 後は 0）
+	uint64_t	size;
+	int64_t		mtime;
+}	t_tfile;
+
+typedef struct s_tfiles
+{
+	t_tfile	*f;
+	size_t	n;
+}	t_tfiles;
+
+int		tfiles_open(const char *dir, t_tfiles *fs);
+void	tfiles_unmap(t_tfiles *fs);
+void	tfiles_free(t_tfiles *fs);
+
+#endif
@@ -0,0 +1,474 @@
+#define _GNU_SOURCE
+#include "tindex.h"
+#include "traceline.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TINDEX_MAGIC "TTIDX1\n"
+
+static int	is_digit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static int	starts(const char *p, const char *end, const char *lit)
+{
+	size_t k = strlen(lit);
+
+	return (size_t)(end - p) >= k && memcmp(p, lit, k) == 0;
+}
+
+size_t	trace_line_name(const char *s, size_t n, const char **name)
+{
+	const char	*end = s + n;
+	const char	*p;
+	int			resumed = 0;
+
+	if ((p = trace_line_prefix(s, end, NULL, NULL, NULL)) == NULL)
+		return 0;
+	if (starts(p, end, "<... "))
+	{
+		p += 5;
+		resumed = 1;
+	}
+	*name = p;
+	while (p < end && ((*p >= 'a' && *p <= 'z') || is_digit(*p) || *p == '_'))
+		p++;
+	if (p == *name || p >= end)
+		return 0;
+	if (resumed ? !starts(p, end, " resumed>") : (*p != '('))
+		return 0;
+	return (size_t)(p - *name);
+}
+
+static uint64_t	hash_key(const char *s, size_t n)
+{
+	uint64_t h = 1469598103934665603ull;
+
+	for (size_t i = 0; i < n; i++)
+		h = (h ^ (unsigned char)s[i]) * 1099511628211ull;
+	return h;
+}
+
+static int	key_eq(const char *key, const char *k, size_t kn)
+{
+	return strncmp(key, k, kn) == 0 && key[kn] == '\0';
+}
+
+/* --- チャンク分 --- */
+
+static t_idx_part_ent	*part_slot(t_idx_part_ent *e, size_t cap, const char *k, size_t kn)
+{
+	for (uint64_t h = hash_key(k, kn); ; h++)
+	{
+		t_idx_part_ent *x = &e[h & (cap - 1)];
+		if (x->key[0] == '\0' || key_eq(x->key, k, kn))
+			return x;
+	}
+}
+
+int	idx_part_add(t_idx_part *pt, const char *name, size_t nlen, uint32_t off)
+{
+	t_idx_part_ent *x;
+
+	if (nlen == 0 || nlen >= TINDEX_KEY_MAX)
+		return 0;
+	if ((pt->n + 1) * 2 > pt->cap)
+	{
+		size_t			ncap = pt->cap ? pt->cap * 2 : 64;
+		t_idx_part_ent	*ne = calloc(ncap, sizeof(*ne));
+
+		if (!ne)
+			return -1;
+		for (size_t i = 0; i < pt->cap; i++)
+			if (pt->e[i].key[0])
+				*part_slot(ne, ncap, pt->e[i].key, strlen(pt->e[i].key)) = pt->e[i];
+		free(pt->e);
+		pt->e = ne;
+		pt->cap = ncap;
+	}
+	x = part_slot(pt->e, pt->cap, name, nlen);
+	if (x->key[0] == '\0')
+	{
+		memcpy(x->key, name, nlen);
+		x->key[nlen] = '\0';
+		pt->n++;
+	}
+	if (x->n == x->cap)
+	{
+		size_t		ncap = x->cap ? x->cap * 2 : 256;
+		uint32_t	*no = realloc(x->off, ncap * sizeof(uint32_t));
+
+		if (!no)
+			return -1;
+		x->off = no;
+		x->cap = ncap;
+	}
+	x->off[x->n++] = off;
+	return 0;
+}
+
+void	idx_part_free(t_idx_part *pt)
+{
+	for (size_t i = 0; i < pt->cap; i++)
+		free(pt->e[i].off);
+	free(pt->e);
+	*pt = (t_idx_part){0};
+}
+
+/* --- ディレクトリ全体 --- */
+
+static t_idx_ent	*ent_slot(t_idx_ent *e, size_t cap, const char *k, size_t kn)
+{
+	for (uint64_t h = hash_key(k, kn); ; h++)
+	{
+		t_idx_ent *x = &e[h & (cap - 1)];
+		if (x->key[0] == '\0' || key_eq(x->key, k, kn))
+			return x;
+	}
+}
+
+static t_idx_ent	*idx_get(t_idx *ix, const char *k)
+{
+	size_t		kn = strlen(k);
+	t_idx_ent	*x;
+
+	if ((ix->n + 1) * 2 > ix->cap)
+	{
+		size_t		ncap = ix->cap ? ix->cap * 2 : 64;
+		t_idx_ent	*ne = calloc(ncap, sizeof(*ne));
+
+		if (!ne)
+			return NULL;
+		for (size_t i = 0; i < ix->cap; i++)
+			if (ix->e[i].key[0])
+				*ent_slot(ne, ncap, ix->e[i].key, strlen(ix->e[i].key)) = ix->e[i];
+		free(ix->e);
+		ix->e = ne;
+		ix->cap = ncap;
+	}
+	x = ent_slot(ix->e, ix->cap, k, kn);
+	if (x->key[0] == '\0')
+	{
+		memcpy(x->key, k, kn + 1);
+		ix->n++;
+	}
+	return x;
+}
+
+static int	put_varint(t_idx_ent *x, uint64_t v)
+{
+	if (x->len + 10 > x->cap)
+	{
+		size_t	ncap = x->cap ? x->cap * 2 : 256;
+		uint8_t	*nb = realloc(x->buf, ncap);
+
+		if (!nb)
+			return -1;
+		x->buf = nb;
+		x->cap = ncap;
+	}
+	while (v >= 0x80)
+	{
+		x->buf[x->len++] = (uint8_t)(v | 0x80);
+		v >>= 7;
+	}
+	x->buf[x->len++] = (uint8_t)v;
+	return 0;
+}
+
+int	idx_merge(t_idx *ix, uint32_t file, uint64_t base, const t_idx_part *pt)
+{
+	for (size_t i = 0; i < pt->cap; i++)
+	{
+		const t_idx_part_ent	*pe = &pt->e[i];
+		t_idx_ent				*x;
+
+		if (!pe->key[0])
+			continue;
+		if ((x = idx_get(ix, pe->key)) == NULL)
+			return -1;
+		for (size_t k = 0; k < pe->n; k++)
+		{
+			uint64_t off = base + pe->off[k];
+			int same = (x->count > 0 && x->last_file == file);
+
+			if (put_varint(x, x->count > 0 ? file - x->last_file : file) != 0
+				|| put_varint(x, same ? off - x->last_off : off) != 0)
+				return -1;
+			x->count++;
+			x->last_file = file;
+			x->last_off = off;
+		}
+	}
+	return 0;
+}
+
+void	idx_free(t_idx *ix)
+{
+	for (size_t i = 0; i < ix->cap; i++)
+		free(ix->e[i].buf);
+	free(ix->e);
+	*ix = (t_idx){0};
+}
+
+static void	fput_varint(FILE *fp, uint64_t v)
+{
+	while (v >= 0x80)
+	{
+		fputc((int)(v | 0x80) & 0xff, fp);
+		v >>= 7;
+	}
+	fputc((int)v, fp);
+}
+
+static void	fput_str(FILE *fp, const char *s)
+{
+	size_t n = strlen(s);
+
+	fput_varint(fp, n);
+	fwrite(s, 1, n, fp);
+}
+
+static int	cmp_ent(const void *a, const void *b)
+{
+	return strcmp((*(t_idx_ent *const *)a)->key, (*(t_idx_ent *const *)b)->key);
+}
+
+int	idx_write(const t_idx *ix, const char *path, const t_idx_file *files, size_t nfiles)
+{
+	char		tmp[PATH_MAX + 8];
+	t_idx_ent	**v = malloc((ix->n ? ix->n : 1) * sizeof(*v));
+	size_t		k = 0;
+	FILE		*fp;
+
+	if (!v)
+		return -1;
+	for (size_t i = 0; i < ix->cap; i++)
+		if (ix->e[i].key[0])
+			v[k++] = &ix->e[i];
+	qsort(v, k, sizeof(*v), cmp_ent);
+
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	if ((fp = fopen(tmp, "w")) == NULL)
+	{
+		free(v);
+		return -1;
+	}
+	fputs(TINDEX_MAGIC, fp);
+	fput_varint(fp, nfiles);
+	for (size_t i = 0; i < nfiles; i++)
+	{
+		fput_str(fp, files[i].name);
+		fput_varint(fp, files[i].size);
+		fput_varint(fp, (uint64_t)files[i].mtime);
+	}
+	fput_varint(fp, k);
+	for (size_t i = 0; i < k; i++)
+	{
+		fput_str(fp, v[i]->key);
+		fput_varint(fp, v[i]->count);
+		fput_varint(fp, v[i]->len);
+		fwrite(v[i]->buf, 1, v[i]->len, fp);
+	}
+	free(v);
+	if (fclose(fp) != 0 || rename(tmp, path) != 0)
+	{
+		unlink(tmp);
+		return -1;
+	}
+	return 0;
+}
+
+/* --- 読む側 --- */
+
+typedef struct s_rd
+{
+	const uint8_t	*p;
+	const uint8_t	*end;
+	int				bad;
+}	t_rd;
+
+static uint64_t	get_varint(t_rd *r)
+{
+	uint64_t	v = 0;
+	int			sh = 0;
+
+	while (r->p < r->end && sh < 64)
+	{
+		uint8_t b = *r->p++;
+		v |= (uint64_t)(b & 0x7f) << sh;
+		if (!(b & 0x80))
+			return v;
+		sh += 7;
+	}
+	r->bad = 1;
+	return 0;
+}
+
+static const char	*get_str(t_rd *r, size_t *n)
+{
+	const char *s;
+
+	*n = get_varint(r);
+	if (r->bad || *n > (size_t)(r->end - r->p))
+	{
+		r->bad = 1;
+		return NULL;
+	}
+	s = (const char *)r->p;
+	r->p += *n;
+	return s;
+}
+
+typedef struct s_map
+{
+	const char	*base;
+	size_t		len;
+}	t_map;
+
+static int	map_file(const char *path, t_map *m)
+{
+	int			fd = open(path, O_RDONLY | O_CLOEXEC);
+	struct stat	sb;
+
+	m->base = MAP_FAILED;
+	m->len = 0;
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &sb) == 0 && sb.st_size > 0)
+	{
+		m->len = (size_t)sb.st_size;
+		m->base = mmap(NULL, m->len, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	close(fd);
+	return (m->base == MAP_FAILED) ? -1 : 0;
+}
+
+static void	unmap_file(t_map *m)
+{
+	if (m->base != MAP_FAILED)
+		munmap((void *)m->base, m->len);
+	m->base = MAP_FAILED;
+}
+
+static void	show_line(FILE *out, const char *fname, const t_map *m, uint64_t off)
+{
+	const char	*s;
+	const char	*nl;
+
+	if (off >= m->len)
+		return;
+	s = m->base + off;
+	nl = memchr(s, '\n', m->len - off);
+	fprintf(out, "%s:%.*s\n", fname, (int)(nl ? (size_t)(nl - s) : m->len - off), s);
+}
+
+int	idx_show(const char *dir, char *const names[], int nnames, FILE *out)
+{
+	char		path[PATH_MAX + 64];
+	t_map		ix;
+	t_rd		r;
+	const char	**fname = NULL;
+	size_t		nfiles;
+	int			rc = -1;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, TINDEX_NAME);
+	if (map_file(path, &ix) != 0 || ix.len < strlen(TINDEX_MAGIC)
+		|| memcmp(ix.base, TINDEX_MAGIC, strlen(TINDEX_MAGIC)) != 0)
+	{
+		fprintf(stderr, "tracetool: %s: no index (run `tracetool focus` first)\n", path);
+		unmap_file(&ix);
+		return -1;
+	}
+	r = (t_rd){(const uint8_t *)ix.base + strlen(TINDEX_MAGIC), (const uint8_t *)ix.base + ix.len, 0};
+
+	// ファイル一覧（大きさと mtime が今と同じか確かめる）
+	nfiles = get_varint(&r);
+	if (r.bad || nfiles > ix.len)
+		goto out;
+	fname = calloc(nfiles ? nfiles : 1, sizeof(char *));
+	if (!fname)
+		goto out;
+	for (size_t i = 0; i < nfiles; i++)
+	{
+		size_t		n;
+		const char	*s = get_str(&r, &n);
+		uint64_t	size = get_varint(&r);
+		int64_t		mtime = (int64_t)get_varint(&r);
+		struct stat	sb;
+
+		if (r.bad || (fname[i] = strndup(s, n)) == NULL)
+			goto out;
+		snprintf(path, sizeof(path), "%s/%s", dir, fname[i]);
+		if (stat(path, &sb) != 0 || (uint64_t)sb.st_size != size || (int64_t)sb.st_mtime != mtime)
+		{
+			fprintf(stderr, "tracetool: %s: index is stale (%s changed)\n", dir, fname[i]);
+			goto out;
+		}
+	}
+
+	size_t nsys = get_varint(&r);
+	for (size_t i = 0; i < nsys && !r.bad; i++)
+	{
+		size_t		kn;
+		const char	*key = get_str(&r, &kn);
+		uint64_t	count = get_varint(&r);
+		size_t		nbytes = get_varint(&r);
+		int			want = 0;
+
+		if (r.bad || nbytes > (size_t)(r.end - r.p))
+			goto out;
+		for (int k = 0; k < nnames && !want; k++)
+			want = (strlen(names[k]) == kn && memcmp(names[k], key, kn) == 0);
+		if (!want)
+		{
+			r.p += nbytes;
+			continue;
+		}
+
+		t_rd		er = {r.p, r.p + nbytes, 0};
+		t_map		m = {MAP_FAILED, 0};
+		uint64_t	file = 0;
+		uint64_t	off = 0;
+		uint64_t	cur = UINT64_MAX;
+		for (uint64_t c = 0; c < count && !er.bad; c++)
+		{
+			uint64_t df = get_varint(&er);
+			uint64_t d = get_varint(&er);
+
+			file += df;
+			off = (c > 0 && df == 0) ? off + d : d;
+			if (file >= nfiles)
+				break;
+			if (file != cur)
+			{
+				unmap_file(&m);
+				snprintf(path, sizeof(path), "%s/%s", dir, fname[file]);
+				map_file(path, &m);
+				cur = file;
+			}
+			if (m.base != MAP_FAILED)
+				show_line(out, fname[file], &m, off);
+		}
+		unmap_file(&m);
+		r.p += nbytes;
+	}
+	rc = r.bad ? -1 : 0;
+
+out:
+	if (rc != 0 && r.bad)
+		fprintf(stderr, "tracetool: %s: broken index\n", dir);
+	if (fname)
+		for (size_t i = 0; i < nfiles; i++)
+			free((void *)fname[i]);
+	free(fname);
+	unmap_file(&ix);
+	return rc;
+}
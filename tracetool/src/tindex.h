@@ -0,0 +1,87 @@
+#ifndef TINDEX_H
+#define TINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * run ディレクトリごとの小さな索引（tracetool.idx）
+ *
+ * syscall 名 -> （trace.* のどのファイルの何バイト目の行か）の一覧。
+ * 後から「execve の行だけ」「dup2 と pipe2 だけ」を見るときに raw ログを全部なめ直さずに済む。
+ * 名前は "trace." で始めない（スクリプトの trace.* の glob に拾われないように）。
+ *
+ * 形式（数値はすべて LEB128 の varint）:
+ *   "TTIDX1\n"
+ *   nfiles, { namelen, name, size, mtime } * nfiles
+ *   nsys,   { namelen, name, count, nbytes, entries[nbytes] } * nsys
+ *   entries は { dfile, doff } の並び。dfile は前の項目とのファイル番号の差で、
+ *   同じファイルなら doff は前のオフセットとの差、ファイルが変わったら先頭からのオフセット。
+ *   ファイル size / mtime が今のものと違えば索引は古いとみなす。
+ */
+
+#define TINDEX_NAME "tracetool.idx"
+#define TINDEX_KEY_MAX 32
+
+// 1 チャンク分（syscall 名 -> チャンク内オフセット）。ワーカーが 1 本で埋める
+typedef struct s_idx_part_ent
+{
+	char		key[TINDEX_KEY_MAX];
+	uint32_t	*off;
+	size_t		n;
+	size_t		cap;
+}	t_idx_part_ent;
+
+typedef struct s_idx_part
+{
+	t_idx_part_ent	*e;
+	size_t			cap;
+	size_t			n;
+}	t_idx_part;
+
+// ディレクトリ全体。チャンクをファイル順・オフセット順に idx_merge していく
+typedef struct s_idx_ent
+{
+	char		key[TINDEX_KEY_MAX];
+	uint8_t		*buf;
+	size_t		len;
+	size_t		cap;
+	uint64_t	count;
+	uint32_t	last_file;
+	uint64_t	last_off;
+}	t_idx_ent;
+
+typedef struct s_idx
+{
+	t_idx_ent	*e;
+	size_t		cap;
+	size_t		n;
+}	t_idx;
+
+typedef struct s_idx_file
+{
+	const char	*name;    // ディレクトリからの相対名
+	uint64_t	size;
+	int64_t		mtime;
+}	t_idx_file;
+
+/*
+ * 行の syscall 名を取り出す（traceline.h の trace_line_prefix の印と "<... name resumed>" を読み飛ばす）。
+ * syscall の行でなければ 0。
+ */
+size_t		trace_line_name(const char *s, size_t n, const char **name);
+
+int		idx_part_add(t_idx_part *pt, const char *name, size_t nlen, uint32_t off);
+void	idx_part_free(t_idx_part *pt);
+int		idx_merge(t_idx *ix, uint32_t file, uint64_t base, const t_idx_part *pt);
+int		idx_write(const t_idx *ix, const char *path, const t_idx_file *files, size_t nfiles);
+void	idx_free(t_idx *ix);
+
+/*
+ * dir/tracetool.idx を引いて names の行を "file:line" で out に出す。
+ * 索引が無い・古いときは -1（メッセージは stderr）。
+ */
+int		idx_show(const char *dir, char *const names[], int nnames, FILE *out);
+
+#endif